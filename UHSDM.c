@@ -1,75 +1,299 @@
 ﻿#define _CRT_SECURE_NO_WARNINGS
-#include <windows.h>
+#include "platform.h"
+#ifdef _WIN32
 #include <setupapi.h>
 #include <devguid.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
 #include <stdio.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <string.h>
-#include <tchar.h>
-#include <ntddser.h>
+#include "modem.h"
+#include "reactor.h"
+#include "receiver.h"
+#include "transmitter.h"
+#include "arq.h"
+#include "fec.h"
+#include "compress.h"
+#include "scheduler.h"
+#include "bond.h"
+#include "bench.h"
+#include "capture.h"
+#include "rxlog.h"
+#include "metrics.h"
+#include "service.h"
+#include "batch.h"
+#include "hotplug.h"
+#include "clocksync.h"
+#include "autobaud.h"
+#include "crc.h"
+#include "frame.h"
 
-#define MAX_PORT_NAME 20
 #define INI_FILE_NAME TEXT("SETTINGS.INI")
 
-typedef struct {
-    TCHAR portName[MAX_PORT_NAME];
-    int baudRate;
-    int byteSize;
-    int stopBits;
-    int parity;
-    HANDLE hSerial;
-} ModemConfig;
-
-ModemConfig acousticModem = { TEXT("COM4"), CBR_115200, 8, ONESTOPBIT, NOPARITY, INVALID_HANDLE_VALUE };
-ModemConfig lightModem = { TEXT("COM6"), CBR_115200, 8, ONESTOPBIT, NOPARITY, INVALID_HANDLE_VALUE };
-
-typedef struct {
-    ModemConfig acousticModem;
-    ModemConfig lightModem;
-} ModemSettings;
+// 메시지를 보낼 경로
+#define ROUTE_MODEM 0 // 선택한 모뎀으로
+#define ROUTE_AUTO 1  // 스케줄러가 고른 링크로
+#define ROUTE_ALL 2   // 살아 있는 모든 링크로 동시에 (먼저 도착한 사본이 전달됨)
 
 volatile bool keepRunning = true;
 void FlushStdInBuffer();
 void GetIniFilePath(TCHAR* iniFilePath);
 void CreateDefaultSettingsIfNotExists();
-void LoadSettings(ModemConfig* modem, const TCHAR* modemName);
-void ReadFullSettings(ModemSettings* settings);
-bool IsValidBaudRate(int baudRate);
+void LoadCompressDictionary();
+void LoadModemRegistry();
 void ValidateModemConfig(ModemConfig* modem, const TCHAR* modemName);
-void WriteFullSettings(const ModemSettings* settings);
-void SaveSettings(const ModemConfig* modem, const TCHAR* modemName);
+bool WriteFullSettings(const ModemRegistry* settings);
+bool SaveSettings();
 void ListSerialPorts();
-void UpdateModemSettings(ModemConfig* modem, const TCHAR* modemName);
-void SendMessageToModem(const ModemConfig* modem);
+ModemConfig* SelectModem();
+ModemConfig* SelectRoute(int* route, bool allowAll);
+void UpdateModemSettings(ModemConfig* modem);
+void SendMessageToModem(ModemConfig* modem, int route);
+void SendFileToModem(ModemConfig* modem);
 void DisplayHelp();
-bool OpenSerialPort(ModemConfig* modem);
-void CloseSerialPort(HANDLE* hSerial);
 void DisplayMenu();
 void HandleUserInput();
-DWORD WINAPI ReadThread(LPVOID param);
+void OnModemReceive(ModemConfig* modem, const FrameHeader* header, const BYTE* data, DWORD size);
+void OnModemError(ModemConfig* modem, DWORD errorCode);
+void OnPortChange(ModemConfig* modem, bool up);
+void OnTransmitDone(ModemConfig* modem, uint32_t messageId, bool success);
+void OnArqReceive(ModemConfig* modem, BYTE kind, const BYTE* data, DWORD length);
+void OnArqDone(ModemConfig* modem, uint16_t transferId, bool success);
+void OnSchedulerReceive(ModemConfig* modem, const BYTE* data, DWORD length);
+void OnSchedulerDone(ModemConfig* modem, uint32_t messageId, bool success);
+void OnBondDone(uint16_t transferId, bool success, const BondReport* report);
 void SignalHandler(int signal);
+int RunReplay(int argc, TCHAR* argv[]);
+int RunBatchSend(int argc, TCHAR* argv[]);
+
+int _tmain(int argc, TCHAR* argv[]) {
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-rx")) == 0) {
+        return RunRxLatencyBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-tx")) == 0) {
+        return RunTxBurstBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-arq")) == 0) {
+        return RunArqLossBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-fec")) == 0) {
+        return RunFecBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-compress")) == 0) {
+        return RunCompressBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-log")) == 0) {
+        return RunLogBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-link")) == 0) {
+        return RunLinkFailoverBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-bond")) == 0) {
+        return RunBondBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-redundant")) == 0) {
+        return RunRedundantBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-suite")) == 0) {
+        return RunBenchSuite(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-priority")) == 0) {
+        return RunPriorityBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-reconfig")) == 0) {
+        return RunReconfigBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-pool")) == 0) {
+        return RunPoolBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-clock")) == 0) {
+        return RunClockBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--bench-autobaud")) == 0) {
+        return RunAutoBaudBench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--replay")) == 0) {
+        return RunReplay(argc - 2, argv + 2);
+    }
+    if (argc > 1 && _tcscmp(argv[1], TEXT("--send")) == 0) {
+        return RunBatchSend(argc - 2, argv + 2);
+    }
+    // --capture <파일>: 평소처럼 실행하면서 모든 송수신을 기록
+    // --rx-log <파일> [최대 MB] [세그먼트 수]: 받은 메시지를 콘솔 대신 파일에 기록 (최대 크기를 넘으면 돌려 가며 보관)
+    // --metrics <파일> [간격 ms]: 모뎀별 지표 스냅숏을 주기적으로 덧붙임
+    // --daemon [경로]: 메뉴 없이 실행하고 로컬 소켓(이름 있는 파이프)으로 클라이언트의 요청을 받음
+    const TCHAR* capturePath = NULL;
+    const TCHAR* metricsPath = NULL;
+    const TCHAR* servicePath = NULL;
+    const TCHAR* rxLogPath = NULL;
+    int64_t rxLogMaxBytes = (int64_t)RXLOG_DEFAULT_MB * 1024 * 1024;
+    int rxLogSegments = 0;
+    DWORD metricsIntervalMs = METRICS_SNAPSHOT_MS;
+    for (int i = 1; i < argc; i++) {
+        if (_tcscmp(argv[i], TEXT("--daemon")) == 0) {
+            servicePath = i + 1 < argc && argv[i + 1][0] != TEXT('-') ? argv[++i] : SERVICE_DEFAULT_PATH;
+        }
+        else if (i + 1 >= argc) {
+            break;
+        }
+        else if (_tcscmp(argv[i], TEXT("--capture")) == 0) {
+            capturePath = argv[++i];
+        }
+        else if (_tcscmp(argv[i], TEXT("--rx-log")) == 0) {
+            rxLogPath = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != TEXT('-')) {
+                rxLogMaxBytes = (int64_t)_ttoi(argv[++i]) * 1024 * 1024;
+            }
+            if (i + 1 < argc && argv[i + 1][0] != TEXT('-')) {
+                rxLogSegments = _ttoi(argv[++i]);
+            }
+        }
+        else if (_tcscmp(argv[i], TEXT("--metrics")) == 0) {
+            metricsPath = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != TEXT('-')) {
+                metricsIntervalMs = (DWORD)_ttoi(argv[++i]);
+            }
+        }
+    }
 
-int main() {
     signal(SIGINT, SignalHandler);
+    signal(SIGTERM, SignalHandler);
+    CrcInit();
+    FecInit();
+    RxLogInit();
+    LoadCompressDictionary();
     CreateDefaultSettingsIfNotExists();
-    LoadSettings(&acousticModem, TEXT("AcousticModem"));
-    LoadSettings(&lightModem, TEXT("LightModem"));
-    OpenSerialPort(&acousticModem);
-    OpenSerialPort(&lightModem);
-    HANDLE readThreadAcoustic = CreateThread(NULL, 0, ReadThread, &acousticModem, 0, NULL);
-    HANDLE readThreadLight = CreateThread(NULL, 0, ReadThread, &lightModem, 0, NULL);
+    LoadModemRegistry();
+    if (capturePath != NULL && !CaptureStart(capturePath)) {
+        _ftprintf(stderr, TEXT("Failed to start capture to %s.\n"), capturePath);
+        return 1;
+    }
+    if (metricsPath != NULL && !MetricsStartSnapshots(metricsPath, metricsIntervalMs)) {
+        return 1;
+    }
 
-    while (keepRunning) {
-        DisplayMenu();
-        HandleUserInput();
+    // 받은 메시지는 수신 처리 스레드가 로그 큐에 복사만 하고, 출력은 로그 스레드가 모아서 함
+    if (!RxLogStart(rxLogPath, rxLogMaxBytes, rxLogSegments)) {
+        _ftprintf(stderr, TEXT("Failed to start receive log.\n"));
+        return 1;
     }
 
-    WaitForSingleObject(readThreadAcoustic, INFINITE);
-    WaitForSingleObject(readThreadLight, INFINITE);
+    // 리액터는 수신 바이트를 모뎀별 링에 복사만 하고, 프레임 해석과 전달은 수신 처리 스레드가 담당
+    ClockSyncInit();
+    if (!ReceiverStart(OnModemReceive)) {
+        _ftprintf(stderr, TEXT("Failed to start receive thread.\n"));
+        return 1;
+    }
 
-    CloseSerialPort(&acousticModem.hSerial);
-    CloseSerialPort(&lightModem.hSerial);
+    // 모든 포트의 수신은 하나의 리액터 스레드가 처리
+    if (!ReactorStart(ReceiverPush, OnModemError)) {
+        _ftprintf(stderr, TEXT("Failed to start I/O reactor.\n"));
+        return 1;
+    }
+    for (int i = 0; i < modemRegistry.count; i++) {
+        if (OpenSerialPort(&modemRegistry.modems[i])) {
+            ReactorAdd(&modemRegistry.modems[i]);
+        }
+    }
+
+    // 송신은 모뎀별 송신 스레드가 큐에서 묶어서 처리 (UI 스레드는 블록하지 않음)
+    if (!TransmitterStart(OnTransmitDone)) {
+        _ftprintf(stderr, TEXT("Failed to start transmit threads.\n"));
+        return 1;
+    }
+    // 상대가 같은 사전으로 풀 수 있는지 확인될 때까지는 압축하지 않고 보냄
+    for (int i = 0; i < modemRegistry.count; i++) {
+        if (modemRegistry.modems[i].hSerial != INVALID_HANDLE_VALUE) {
+            CompressNegotiate(&modemRegistry.modems[i]);
+        }
+    }
+    // BaudRate=auto 인 포트는 설정된 속도로 연 채 탐색 스레드가 상대가 답하는 속도를 찾음 (시작을 막지 않음)
+    if (!AutoBaudStart()) {
+        _ftprintf(stderr, TEXT("Failed to start baud rate search.\n"));
+        return 1;
+    }
+    // Timestamps=1 인 링크는 상대 시계와의 차이를 재고 보내는 프레임에 보낸 시각을 붙임 (단방향 지연 측정)
+    if (!ClockSyncStart()) {
+        _ftprintf(stderr, TEXT("Failed to start clock synchronization.\n"));
+        return 1;
+    }
+    // 큰 메시지와 파일은 조각으로 나누어 선택적 재전송으로 보냄
+    if (!ArqStart(OnArqReceive, OnArqDone)) {
+        _ftprintf(stderr, TEXT("Failed to start ARQ thread.\n"));
+        return 1;
+    }
+    // 'auto' 로 보낸 메시지는 프레임 모드 모뎀 중 가장 좋은 링크로 자동 전송
+    ModemConfig* links[MAX_MODEMS];
+    int linkCount = 0;
+    for (int i = 0; i < modemRegistry.count; i++) {
+        if (modemRegistry.modems[i].framing == FRAMING_COBS) {
+            links[linkCount++] = &modemRegistry.modems[i];
+        }
+    }
+    if (!SchedulerStart(links, linkCount, OnSchedulerReceive, OnSchedulerDone)) {
+        _ftprintf(stderr, TEXT("Failed to start link scheduler.\n"));
+        return 1;
+    }
+    // 'auto' 로 보낸 큰 메시지와 파일은 모든 링크에 나누어 동시에 전송 (수신은 ARQ 전송과 같게 처리)
+    if (!BondStart(OnArqReceive, OnBondDone)) {
+        _ftprintf(stderr, TEXT("Failed to start link bonding.\n"));
+        return 1;
+    }
+
+    // 빠진 포트(USB 시리얼 어댑터 분리 등)는 감시 스레드가 닫고 장치가 돌아오면 다시 엶
+    if (!HotplugStart(OnPortChange)) {
+        _ftprintf(stderr, TEXT("Failed to start port watcher.\n"));
+        return 1;
+    }
+
+    if (servicePath != NULL) {
+        if (!ServiceStart(servicePath)) {
+            _ftprintf(stderr, TEXT("Failed to start service on %s.\n"), servicePath);
+            return 1;
+        }
+        _tprintf(TEXT("UHSDM service listening on %s (%d modems). Press Ctrl+C to stop.\n"), servicePath, modemRegistry.count);
+        fflush(stdout);
+        while (keepRunning) {
+            PlatformSleepMs(200);
+        }
+        ServiceStop();
+        ServiceStats service;
+        ServiceQueryStats(&service);
+        _tprintf(TEXT("Service stopped: %ld clients, %lld requests, %lld packets sent in %lld writes, %lld dropped\n"),
+            (long)service.accepted, (long long)service.requests, (long long)service.packetsOut, (long long)service.writes,
+            (long long)service.droppedPackets);
+    }
+    else {
+        while (keepRunning) {
+            DisplayMenu();
+            HandleUserInput();
+        }
+    }
+
+    MetricsStopSnapshots();
+    HotplugStop();
+    AutoBaudStop();
+    // 수신을 먼저 멈춘 뒤 송신 큐를 비우고 ARQ 를 정리
+    ReactorStop();
+    ReceiverStop();
+    SchedulerStop();
+    BondStop();
+    ClockSyncStop();
+    TransmitterStop();
+    ArqStop();
+    for (int i = 0; i < modemRegistry.count; i++) {
+        CloseSerialPort(&modemRegistry.modems[i]);
+        RingFree(&modemRegistry.modems[i].rxRing);
+        FrameParserFree(&modemRegistry.modems[i].rxFrame);
+    }
+    CaptureStop();
+    RxLogStop();
+    EmulatorStop();
 
     return 0;
 }
@@ -83,8 +307,13 @@ void FlushStdInBuffer() {
 }
 
 void GetIniFilePath(TCHAR* iniFilePath) {
+#ifdef _WIN32
     GetModuleFileName(NULL, iniFilePath, MAX_PATH);
-    TCHAR* lastBackslash = _tcsrchr(iniFilePath, TEXT('\\'));
+#else
+    ssize_t pathLength = readlink("/proc/self/exe", iniFilePath, MAX_PATH - 1);
+    iniFilePath[pathLength > 0 ? pathLength : 0] = '\0';
+#endif
+    TCHAR* lastBackslash = _tcsrchr(iniFilePath, PATH_SEPARATOR);
     if (lastBackslash) {
         *(lastBackslash + 1) = TEXT('\0'); // 경로의 마지막에 파일 이름을 제거
     }
@@ -98,6 +327,15 @@ void GetIniFilePath(TCHAR* iniFilePath) {
     _tcscat(iniFilePath, INI_FILE_NAME);
 }
 
+// 압축 사전은 INI 파일과 같은 폴더에 있으면 그것을, 없으면 내장 사전을 사용
+void LoadCompressDictionary() {
+    TCHAR dictionaryPath[MAX_PATH];
+    GetIniFilePath(dictionaryPath);
+    TCHAR* dictionaryName = _tcsrchr(dictionaryPath, PATH_SEPARATOR);
+    _tcscpy(dictionaryName != NULL ? dictionaryName + 1 : dictionaryPath, COMPRESS_DICTIONARY_FILE);
+    CompressInit(dictionaryPath);
+}
+
 void CreateDefaultSettingsIfNotExists() {
     TCHAR iniFilePath[MAX_PATH];
     GetIniFilePath(iniFilePath);
@@ -108,9 +346,9 @@ void CreateDefaultSettingsIfNotExists() {
         file = _tfopen(iniFilePath, TEXT("w"));
         if (file) {
             _ftprintf(file, TEXT("[AcousticModem]\n"));
-            _ftprintf(file, TEXT("Port=COM4\nBaudRate=115200\nByteSize=8\nStopBits=1\nParity=0\n"));
+            _ftprintf(file, TEXT("Port=%s\nBaudRate=115200\nByteSize=8\nStopBits=1\nParity=0\nRxRingSize=%d\nFraming=%d\nArqWindow=%d\nArqTimeoutMs=%d\nFecRate=0\nCompression=%d\nLinkRate=0\nEmulator=%s\nTxWeights=0\nTimestamps=0\nAutoBaudMs=%d\n"), DEFAULT_ACOUSTIC_PORT, RING_DEFAULT_SIZE, FRAMING_COBS, ARQ_DEFAULT_WINDOW, ARQ_DEFAULT_TIMEOUT_MS, COMPRESS_LZ, EMULATOR_DEFAULT_PROFILE, AUTOBAUD_DEFAULT_WAIT_MS);
             _ftprintf(file, TEXT("[LightModem]\n"));
-            _ftprintf(file, TEXT("Port=COM6\nBaudRate=115200\nByteSize=8\nStopBits=1\nParity=0\n"));
+            _ftprintf(file, TEXT("Port=%s\nBaudRate=115200\nByteSize=8\nStopBits=1\nParity=0\nRxRingSize=%d\nFraming=%d\nArqWindow=%d\nArqTimeoutMs=%d\nFecRate=0\nCompression=%d\nLinkRate=0\nEmulator=%s\nTxWeights=0\nTimestamps=0\nAutoBaudMs=%d\n"), DEFAULT_LIGHT_PORT, RING_DEFAULT_SIZE, FRAMING_COBS, ARQ_DEFAULT_WINDOW, ARQ_DEFAULT_TIMEOUT_MS, COMPRESS_LZ, EMULATOR_DEFAULT_PROFILE, AUTOBAUD_DEFAULT_WAIT_MS);
             fclose(file);
         }
     }
@@ -119,128 +357,296 @@ void CreateDefaultSettingsIfNotExists() {
     }
 }
 
-void LoadSettings(ModemConfig* modem, const TCHAR* modemName) {
+#define MODEM_SETTINGS 16 // Port, BaudRate, ByteSize, StopBits, Parity, RxRingSize, Framing, ArqWindow, ArqTimeoutMs, FecRate, Compression, LinkRate, Emulator, TxWeights, Timestamps, AutoBaudMs
+
+// TxWeights=C,N,B 를 읽는다. 0 이나 잘못된 값이면 엄격한 우선순위 (모두 0)
+static void ParseTxWeights(ModemConfig* modem, const TCHAR* value) {
+    int weights[TX_CLASSES] = { 0 };
+    bool valid = _stscanf(value, TEXT("%d,%d,%d"), &weights[0], &weights[1], &weights[2]) == TX_CLASSES;
+    for (int c = 0; c < TX_CLASSES; c++) {
+        valid = valid && weights[c] > 0 && weights[c] <= TX_MAX_WEIGHT;
+    }
+    for (int c = 0; c < TX_CLASSES; c++) {
+        modem->txWeights[c] = valid ? weights[c] : 0;
+    }
+}
+
+// FEC 부호율 검증. 잘못된 값이면 FEC 를 끔
+static void ValidateFecRate(ModemConfig* modem) {
+    if (modem->fecData <= 0 || modem->fecParity <= 0 || modem->fecData + modem->fecParity > FEC_MAX_SHARDS) {
+        modem->fecData = 0;
+        modem->fecParity = 0;
+    }
+}
+
+// 섹션 안의 한 줄을 읽어 modem 에 채우는 함수. settings 는 이미 읽은 설정 (같은 설정이 두 번 있으면 처음 것만 씀)
+static void ParseModemSetting(ModemConfig* modem, const TCHAR* line, bool settings[MODEM_SETTINGS]) {
+    if (_tcsstr(line, TEXT("Port=")) && !settings[0]) {
+        _stscanf(line, TEXT("Port=%63s"), modem->portName);
+        settings[0] = true;
+    }
+    else if (_tcsstr(line, TEXT("BaudRate=")) && !settings[1]) {
+        // 숫자 또는 auto (포트를 열 때 가장 빠른 속도를 찾음)
+        TCHAR value[16] = TEXT("");
+        _stscanf(line, TEXT("BaudRate=%15s"), value);
+        modem->autoBaud = _tcsicmp(value, TEXT("auto")) == 0;
+        int baudRate = _ttoi(value);
+        if (IsValidBaudRate(baudRate)) {
+            modem->baudRate = baudRate;
+        }
+        else {
+            modem->baudRate = CBR_115200; // 기본값
+        }
+        settings[1] = true;
+    }
+    else if (_tcsstr(line, TEXT("ByteSize=")) && !settings[2]) {
+        int byteSize;
+        _stscanf(line, TEXT("ByteSize=%d"), &byteSize);
+        modem->byteSize = byteSize > 0 ? byteSize : 8; // 기본값
+        settings[2] = true;
+    }
+    else if (_tcsstr(line, TEXT("StopBits=")) && !settings[3]) {
+        int stopBits;
+        _stscanf(line, TEXT("StopBits=%d"), &stopBits);
+        modem->stopBits = stopBits == 1 ? ONESTOPBIT : TWOSTOPBITS; // 기본값
+        settings[3] = true;
+    }
+    else if (_tcsstr(line, TEXT("Parity=")) && !settings[4]) {
+        int parity;
+        _stscanf(line, TEXT("Parity=%d"), &parity);
+        modem->parity = (parity == 1 || parity == 2) ? parity : NOPARITY; // 기본값
+        settings[4] = true;
+    }
+    else if (_tcsstr(line, TEXT("RxRingSize=")) && !settings[5]) {
+        int rxRingSize;
+        _stscanf(line, TEXT("RxRingSize=%d"), &rxRingSize);
+        modem->rxRingSize = rxRingSize >= RING_MIN_SIZE && rxRingSize <= RING_MAX_SIZE ? rxRingSize : RING_DEFAULT_SIZE; // 기본값
+        settings[5] = true;
+    }
+    else if (_tcsstr(line, TEXT("Framing=")) && !settings[6]) {
+        int framing;
+        _stscanf(line, TEXT("Framing=%d"), &framing);
+        modem->framing = framing == FRAMING_RAW ? FRAMING_RAW : FRAMING_COBS; // 기본값
+        settings[6] = true;
+    }
+    else if (_tcsstr(line, TEXT("ArqWindow=")) && !settings[7]) {
+        int arqWindow;
+        _stscanf(line, TEXT("ArqWindow=%d"), &arqWindow);
+        modem->arqWindow = arqWindow >= 1 && arqWindow <= ARQ_MAX_WINDOW ? arqWindow : ARQ_DEFAULT_WINDOW; // 기본값
+        settings[7] = true;
+    }
+    else if (_tcsstr(line, TEXT("ArqTimeoutMs=")) && !settings[8]) {
+        int arqTimeoutMs;
+        _stscanf(line, TEXT("ArqTimeoutMs=%d"), &arqTimeoutMs);
+        modem->arqTimeoutMs = arqTimeoutMs >= ARQ_MIN_TIMEOUT_MS && arqTimeoutMs <= ARQ_MAX_TIMEOUT_MS ? arqTimeoutMs : ARQ_DEFAULT_TIMEOUT_MS; // 기본값
+        settings[8] = true;
+    }
+    else if (_tcsstr(line, TEXT("FecRate=")) && !settings[9]) {
+        // K/N: 데이터 조각 K 개마다 N 개를 보냄. 0 이면 FEC 를 쓰지 않음
+        int fecData = 0;
+        int fecTotal = 0;
+        _stscanf(line, TEXT("FecRate=%d/%d"), &fecData, &fecTotal);
+        modem->fecData = fecData;
+        modem->fecParity = fecTotal - fecData;
+        settings[9] = true;
+    }
+    else if (_tcsstr(line, TEXT("Compression=")) && !settings[10]) {
+        int compression;
+        _stscanf(line, TEXT("Compression=%d"), &compression);
+        modem->compression = compression == COMPRESS_NONE ? COMPRESS_NONE : COMPRESS_LZ; // 기본값
+        settings[10] = true;
+    }
+    else if (_tcsstr(line, TEXT("LinkRate=")) && !settings[11]) {
+        // 0 이면 BaudRate 를 따름
+        modem->linkRate = 0;
+        _stscanf(line, TEXT("LinkRate=%d"), &modem->linkRate);
+        modem->linkRateSet = modem->linkRate > 0;
+        settings[11] = true;
+    }
+    else if (_tcsstr(line, TEXT("Emulator=")) && !settings[12]) {
+        // 에뮬레이터 포트(Port=EMU:...)에서만 쓰임
+        EmulatorProfile profile;
+        _stscanf(line, TEXT("Emulator=%63s"), modem->emulator);
+        settings[12] = EmulatorParseProfile(modem->emulator, &profile);
+    }
+    else if (_tcsstr(line, TEXT("TxWeights=")) && !settings[13]) {
+        ParseTxWeights(modem, _tcschr(line, TEXT('=')) + 1);
+        settings[13] = true;
+    }
+    else if (_tcsstr(line, TEXT("Timestamps=")) && !settings[14]) {
+        int timestamps = 0;
+        _stscanf(line, TEXT("Timestamps=%d"), &timestamps);
+        modem->timestamps = timestamps != 0 ? 1 : 0;
+        settings[14] = true;
+    }
+    else if (_tcsstr(line, TEXT("AutoBaudMs=")) && !settings[15]) {
+        // BaudRate=auto 에서 한 속도마다 응답을 기다리는 시간 (링크의 왕복 시간보다 길게)
+        int autoBaudMs = 0;
+        _stscanf(line, TEXT("AutoBaudMs=%d"), &autoBaudMs);
+        modem->autoBaudMs = autoBaudMs >= AUTOBAUD_MIN_WAIT_MS && autoBaudMs <= AUTOBAUD_MAX_WAIT_MS ? autoBaudMs : AUTOBAUD_DEFAULT_WAIT_MS; // 기본값
+        settings[15] = true;
+    }
+}
+
+// 섹션에 없던 설정을 기본값으로 채우는 함수. 채운 것이 있으면 true
+static bool FillMissingSettings(ModemConfig* modem, const bool settings[MODEM_SETTINGS]) {
+    bool settingsChanged = false;
+    if (!settings[0]){ 
+        _tcscpy(modem->portName, modem->name[0] == TEXT('A') ? DEFAULT_ACOUSTIC_PORT : DEFAULT_LIGHT_PORT); // 기본 포트
+        settingsChanged = true;
+    }
+    if (!settings[1]){ 
+        modem->baudRate = CBR_115200; // 기본 보레이트
+        settingsChanged = true;
+    }
+    if (!settings[2]){ 
+        modem->byteSize = 8; // 기본 바이트 크기
+        settingsChanged = true;
+    }
+    if (!settings[3]){ 
+        modem->stopBits = ONESTOPBIT; // 기본 스톱 비트
+        settingsChanged = true;
+    }
+    if (!settings[4]){ 
+        modem->parity = NOPARITY; // 기본 패리티
+        settingsChanged = true;
+    }
+    if (!settings[5]){ 
+        modem->rxRingSize = RING_DEFAULT_SIZE; // 기본 수신 링 크기
+        settingsChanged = true;
+    }
+    if (!settings[6]){ 
+        modem->framing = FRAMING_COBS; // 기본은 프레임 모드
+        settingsChanged = true;
+    }
+    if (!settings[7]){ 
+        modem->arqWindow = ARQ_DEFAULT_WINDOW; // 기본 ARQ 창 크기
+        settingsChanged = true;
+    }
+    if (!settings[8]){ 
+        modem->arqTimeoutMs = ARQ_DEFAULT_TIMEOUT_MS; // 기본 재전송 타이머
+        settingsChanged = true;
+    }
+    if (!settings[9]){ 
+        modem->fecData = 0; // 기본은 FEC 사용 안 함
+        modem->fecParity = 0;
+        settingsChanged = true;
+    }
+    if (!settings[10]){ 
+        modem->compression = COMPRESS_LZ; // 기본은 압축 사용 (상대와 협상된 경우에만 적용)
+        settingsChanged = true;
+    }
+    if (!settings[11] || modem->linkRate <= 0){ 
+        modem->linkRate = modem->baudRate; // 기본은 시리얼 속도와 같다고 봄
+        modem->linkRateSet = false;
+        settingsChanged = settingsChanged || !settings[11];
+    }
+    if (!settings[12]){ 
+        _tcscpy(modem->emulator, EMULATOR_DEFAULT_PROFILE); // 기본은 BaudRate 속도의 손실 없는 선
+        settingsChanged = true;
+    }
+    if (!settings[13]){ 
+        memset(modem->txWeights, 0, sizeof(modem->txWeights)); // 기본은 엄격한 우선순위
+        settingsChanged = true;
+    }
+    if (!settings[14]){ 
+        modem->timestamps = 0; // 기본은 타임스탬프 없음 (상대가 붙여 보내면 동기화는 함)
+        settingsChanged = true;
+    }
+    if (!settings[15]){ 
+        modem->autoBaudMs = AUTOBAUD_DEFAULT_WAIT_MS; // 기본 응답 대기 시간 (유선 모뎀 기준)
+        settingsChanged = true;
+    }
+    ValidateFecRate(modem);
+    return settingsChanged;
+}
+
+// INI 파일을 처음부터 끝까지 한 번 읽어 모든 모뎀 섹션을 settings 에 채우는 함수.
+// 누락된 설정을 기본값으로 채웠으면 (파일에 다시 써야 하면) true
+static bool ParseSettingsFile(ModemRegistry* settings) {
     TCHAR iniFilePath[MAX_PATH];
     GetIniFilePath(iniFilePath);
 
+    settings->count = 0;
     FILE* file = _tfopen(iniFilePath, TEXT("r"));
-    bool settingsChanged = false;  // 설정이 변경되었는지 추적
-    if (file != NULL) {
-        TCHAR sectionName[50];
-        _stprintf(sectionName, TEXT("[%s]"), modemName);
-        TCHAR line[100];
-        bool foundSection = false;
-        bool settings[5] = { false }; // Port, BaudRate, ByteSize, StopBits, Parity
-
-        while (_fgetts(line, sizeof(line), file)) {
-            if (_tcsstr(line, sectionName)) {
-                foundSection = true;
-                continue;
-            }
+    if (file == NULL) {
+        return true;
+    }
 
-            if (foundSection) {
-                if (_tcsstr(line, TEXT("Port=")) && !settings[0]) {
-                    _stscanf(line, TEXT("Port=%19s"), modem->portName);
-                    settings[0] = true;
-                }
-                else if (_tcsstr(line, TEXT("BaudRate=")) && !settings[1]) {
-                    int baudRate;
-                    _stscanf(line, TEXT("BaudRate=%d"), &baudRate);
-                    if (IsValidBaudRate(baudRate)) {
-                        modem->baudRate = baudRate;
-                    }
-                    else {
-                        modem->baudRate = CBR_115200; // 기본값
-                    }
-                    settings[1] = true;
-                }
-                else if (_tcsstr(line, TEXT("ByteSize=")) && !settings[2]) {
-                    int byteSize;
-                    _stscanf(line, TEXT("ByteSize=%d"), &byteSize);
-                    modem->byteSize = byteSize > 0 ? byteSize : 8; // 기본값
-                    settings[2] = true;
-                }
-                else if (_tcsstr(line, TEXT("StopBits=")) && !settings[3]) {
-                    int stopBits;
-                    _stscanf(line, TEXT("StopBits=%d"), &stopBits);
-                    modem->stopBits = stopBits == 1 ? ONESTOPBIT : TWOSTOPBITS; // 기본값
-                    settings[3] = true;
-                }
-                else if (_tcsstr(line, TEXT("Parity=")) && !settings[4]) {
-                    int parity;
-                    _stscanf(line, TEXT("Parity=%d"), &parity);
-                    modem->parity = (parity == 1 || parity == 2) ? parity : NOPARITY; // 기본값
-                    settings[4] = true;
-                }
+    bool found[MAX_MODEMS][MODEM_SETTINGS] = { { false } };
+    ModemConfig* modem = NULL; // 지금 읽고 있는 섹션의 모뎀
+    TCHAR line[100];
+    while (_fgetts(line, sizeof(line) / sizeof(line[0]), file)) {
+        if (line[0] == TEXT('[')) {
+            // 새 섹션 시작. 이름이 잘못되었거나 모뎀이 너무 많으면 다음 섹션까지 무시
+            TCHAR* end = _tcschr(line, TEXT(']'));
+            size_t length = end ? (size_t)(end - line - 1) : 0;
+            modem = NULL;
+            if (length == 0 || length >= MAX_MODEM_NAME || settings->count == MAX_MODEMS) {
+                continue;
             }
+            modem = &settings->modems[settings->count++];
+            memset(modem, 0, sizeof(*modem));
+            modem->hSerial = INVALID_HANDLE_VALUE;
+            size_t copied = length < MAX_MODEM_NAME - 1 ? length : MAX_MODEM_NAME - 1;
+            memcpy(modem->name, line + 1, copied * sizeof(TCHAR));
+            modem->name[copied] = TEXT('\0');
+            continue;
         }
-        fclose(file);
-
-        // 누락된 설정을 기본값으로 채움
-        if (!settings[0]){ 
-            _tcscpy(modem->portName, modemName[0] == TEXT('A') ? TEXT("COM4") : TEXT("COM6")); // 기본 포트
-            settingsChanged = true;
-        }
-        if (!settings[1]){ 
-            modem->baudRate = CBR_115200; // 기본 보레이트
-            settingsChanged = true;
+        if (modem != NULL) {
+            ParseModemSetting(modem, line, found[modem - settings->modems]);
         }
-        if (!settings[2]){ 
-            modem->byteSize = 8; // 기본 바이트 크기
-            settingsChanged = true;
-        }
-        if (!settings[3]){ 
-            modem->stopBits = ONESTOPBIT; // 기본 스톱 비트
-            settingsChanged = true;
-        }
-        if (!settings[4]){ 
-            modem->parity = NOPARITY; // 기본 패리티
+    }
+    fclose(file);
+
+    bool settingsChanged = false;
+    for (int i = 0; i < settings->count; i++) {
+        if (FillMissingSettings(&settings->modems[i], found[i])) {
             settingsChanged = true;
         }
+    }
+    return settingsChanged;
+}
 
-        // 변경된 설정이 있으면 INI 파일 업데이트
-        if (settingsChanged) {
-            SaveSettings(modem, modemName);
+// INI 파일을 한 번 읽어 모뎀 목록을 만드는 함수.
+// 이후 설정 변경은 모두 이 목록(modemRegistry)에 먼저 반영하고 SaveSettings 로 파일 전체를 다시 쓴다
+void LoadModemRegistry() {
+    memset(&modemRegistry, 0, sizeof(modemRegistry));
+    bool settingsChanged = ParseSettingsFile(&modemRegistry);
+    if (modemRegistry.count == 0) {
+        // 섹션이 하나도 없으면 기본 모뎀 두 개로 시작
+        static const bool none[MODEM_SETTINGS] = { false };
+        _tcscpy(modemRegistry.modems[0].name, TEXT("AcousticModem"));
+        _tcscpy(modemRegistry.modems[1].name, TEXT("LightModem"));
+        modemRegistry.count = 2;
+        for (int i = 0; i < modemRegistry.count; i++) {
+            modemRegistry.modems[i].hSerial = INVALID_HANDLE_VALUE;
+            FillMissingSettings(&modemRegistry.modems[i], none);
         }
+        settingsChanged = true;
     }
-    else {
-        // 파일이 없을 경우 기본값 설정
-        _tcscpy(modem->portName, modemName[0] == TEXT('A') ? TEXT("COM4") : TEXT("COM6"));
-        modem->baudRate = CBR_115200;
-        modem->byteSize = 8;
-        modem->stopBits = ONESTOPBIT;
-        modem->parity = NOPARITY;
-        SaveSettings(modem, modemName);  // 변경된 설정을 INI 파일에 저장
-    }
-}
 
-    // 기존 설정을 읽어오는 함수
-void ReadFullSettings(ModemSettings* settings) {
-    // LoadSettings 함수를 활용하여 각 모뎀 설정을 읽음
-    LoadSettings(&settings->acousticModem, TEXT("AcousticModem"));
-    LoadSettings(&settings->lightModem, TEXT("LightModem"));
-}
+    for (int i = 0; i < modemRegistry.count; i++) {
+        ModemConfig* modem = &modemRegistry.modems[i];
+        if (!RingInit(&modem->rxRing, (uint32_t)modem->rxRingSize)) {
+            _ftprintf(stderr, TEXT("Failed to allocate receive buffer for %s\n"), modem->name);
+        }
+        if (!FrameParserInit(&modem->rxFrame)) {
+            _ftprintf(stderr, TEXT("Failed to allocate frame parser for %s\n"), modem->name);
+        }
+    }
 
-bool IsValidBaudRate(int baudRate) {
-    // 유효한 보레이트 값들을 확인하는 함수
-    // 예: 9600, 19200, 38400, 57600, 115200 등
-    switch (baudRate) {
-    case CBR_9600:
-    case CBR_19200:
-    case CBR_38400:
-    case CBR_57600:
-    case CBR_115200:
-        return true;
-    default:
-        return false;
+    // 변경된 설정이 있으면 INI 파일 업데이트
+    if (settingsChanged) {
+        SaveSettings();
     }
 }
 
 // 각 설정을 검증하고 필요한 경우 디폴트 값으로 설정하는 함수
 void ValidateModemConfig(ModemConfig* modem, const TCHAR* modemName) {
-    // 포트 설정 검증
-    if (_tcslen(modem->portName) == 0 || _tcsstr(modem->portName, TEXT("COM")) == NULL) {
-        _tcscpy(modem->portName, _tcscmp(modemName, TEXT("AcousticModem")) == 0 ? TEXT("COM4") : TEXT("COM6"));
+    // 포트 설정 검증 (에뮬레이터 포트는 그대로 둠)
+    if (_tcslen(modem->portName) == 0 || (_tcsstr(modem->portName, SERIAL_PORT_PREFIX) == NULL && !EmulatorIsPort(modem->portName))) {
+        _tcscpy(modem->portName, _tcscmp(modemName, TEXT("AcousticModem")) == 0 ? DEFAULT_ACOUSTIC_PORT : DEFAULT_LIGHT_PORT);
     }
 
     // 보레이트 설정 검증
@@ -252,55 +658,102 @@ void ValidateModemConfig(ModemConfig* modem, const TCHAR* modemName) {
     modem->byteSize = modem->byteSize > 0 ? modem->byteSize : 8;
     modem->stopBits = modem->stopBits == ONESTOPBIT || modem->stopBits == TWOSTOPBITS ? modem->stopBits : ONESTOPBIT;
     modem->parity = modem->parity == NOPARITY || modem->parity == ODDPARITY || modem->parity == EVENPARITY ? modem->parity : NOPARITY;
+    modem->rxRingSize = modem->rxRingSize >= RING_MIN_SIZE && modem->rxRingSize <= RING_MAX_SIZE ? modem->rxRingSize : RING_DEFAULT_SIZE;
+    modem->framing = modem->framing == FRAMING_RAW ? FRAMING_RAW : FRAMING_COBS;
+    modem->arqWindow = modem->arqWindow >= 1 && modem->arqWindow <= ARQ_MAX_WINDOW ? modem->arqWindow : ARQ_DEFAULT_WINDOW;
+    modem->arqTimeoutMs = modem->arqTimeoutMs >= ARQ_MIN_TIMEOUT_MS && modem->arqTimeoutMs <= ARQ_MAX_TIMEOUT_MS ? modem->arqTimeoutMs : ARQ_DEFAULT_TIMEOUT_MS;
+    ValidateFecRate(modem);
+    modem->compression = modem->compression == COMPRESS_NONE ? COMPRESS_NONE : COMPRESS_LZ;
+    modem->linkRate = modem->linkRate > 0 ? modem->linkRate : modem->baudRate;
+    modem->timestamps = modem->timestamps != 0 ? 1 : 0;
+    modem->autoBaudMs = modem->autoBaudMs >= AUTOBAUD_MIN_WAIT_MS && modem->autoBaudMs <= AUTOBAUD_MAX_WAIT_MS ? modem->autoBaudMs : AUTOBAUD_DEFAULT_WAIT_MS;
+    EmulatorProfile profile;
+    if (!EmulatorParseProfile(modem->emulator, &profile)) {
+        _tcscpy(modem->emulator, EMULATOR_DEFAULT_PROFILE);
+    }
 }
 
-void WriteFullSettings(const ModemSettings* settings) {
-    // 전체 설정을 파일에 쓰는 함수
+bool WriteFullSettings(const ModemRegistry* settings) {
+    // 전체 설정을 임시 파일에 쓴 뒤 INI 파일과 바꾸는 함수.
+    // 쓰는 도중에 멈추거나 디스크가 가득 차도 INI 파일은 이전 내용이나 새 내용 중 하나로 온전히 남는다
     TCHAR iniFilePath[MAX_PATH];
+    TCHAR tempFilePath[MAX_PATH + 4];
     GetIniFilePath(iniFilePath);
+    _stprintf(tempFilePath, TEXT("%s.tmp"), iniFilePath);
 
-    FILE* file = _tfopen(iniFilePath, TEXT("w"));
+    FILE* file = _tfopen(tempFilePath, TEXT("w"));
     if (file != NULL) {
-        // AcousticModem 설정 작성
-        _ftprintf(file, TEXT("[AcousticModem]\n"));
-        _ftprintf(file, TEXT("Port=%s\n"), settings->acousticModem.portName);
-        _ftprintf(file, TEXT("BaudRate=%d\n"), settings->acousticModem.baudRate);
-        _ftprintf(file, TEXT("ByteSize=%d\n"), settings->acousticModem.byteSize);
-        _ftprintf(file, TEXT("StopBits=%d\n"), settings->acousticModem.stopBits);
-        _ftprintf(file, TEXT("Parity=%d\n"), settings->acousticModem.parity);
-
-        // LightModem 설정 작성
-        _ftprintf(file, TEXT("[LightModem]\n"));
-        _ftprintf(file, TEXT("Port=%s\n"), settings->lightModem.portName);
-        _ftprintf(file, TEXT("BaudRate=%d\n"), settings->lightModem.baudRate);
-        _ftprintf(file, TEXT("ByteSize=%d\n"), settings->lightModem.byteSize);
-        _ftprintf(file, TEXT("StopBits=%d\n"), settings->lightModem.stopBits);
-        _ftprintf(file, TEXT("Parity=%d\n"), settings->lightModem.parity);
+        // 모뎀마다 섹션 하나씩 작성
+        for (int i = 0; i < settings->count; i++) {
+            const ModemConfig* modem = &settings->modems[i];
+            _ftprintf(file, TEXT("[%s]\n"), modem->name);
+            _ftprintf(file, TEXT("Port=%s\n"), modem->portName);
+            if (modem->autoBaud) {
+                _ftprintf(file, TEXT("BaudRate=auto\n"));
+            }
+            else {
+                _ftprintf(file, TEXT("BaudRate=%d\n"), modem->baudRate);
+            }
+            _ftprintf(file, TEXT("ByteSize=%d\n"), modem->byteSize);
+            _ftprintf(file, TEXT("StopBits=%d\n"), modem->stopBits == TWOSTOPBITS ? 2 : 1);
+            _ftprintf(file, TEXT("Parity=%d\n"), modem->parity);
+            _ftprintf(file, TEXT("RxRingSize=%d\n"), modem->rxRingSize);
+            _ftprintf(file, TEXT("Framing=%d\n"), modem->framing);
+            _ftprintf(file, TEXT("ArqWindow=%d\n"), modem->arqWindow);
+            _ftprintf(file, TEXT("ArqTimeoutMs=%d\n"), modem->arqTimeoutMs);
+            if (modem->fecData > 0) {
+                _ftprintf(file, TEXT("FecRate=%d/%d\n"), modem->fecData, modem->fecData + modem->fecParity);
+            }
+            else {
+                _ftprintf(file, TEXT("FecRate=0\n"));
+            }
+            _ftprintf(file, TEXT("Compression=%d\n"), modem->compression);
+            _ftprintf(file, TEXT("LinkRate=%d\n"), modem->linkRateSet ? modem->linkRate : 0);
+            _ftprintf(file, TEXT("Emulator=%s\n"), modem->emulator);
+            if (modem->txWeights[0] > 0) {
+                _ftprintf(file, TEXT("TxWeights=%d,%d,%d\n"), modem->txWeights[0], modem->txWeights[1], modem->txWeights[2]);
+            }
+            else {
+                _ftprintf(file, TEXT("TxWeights=0\n"));
+            }
+            _ftprintf(file, TEXT("Timestamps=%d\n"), modem->timestamps);
+            _ftprintf(file, TEXT("AutoBaudMs=%d\n"), modem->autoBaudMs);
+        }
 
-        fclose(file);
+        // 내용이 디스크에 닿은 뒤에 이름을 바꿔야 교체 후 전원이 나가도 빈 파일이 남지 않음
+        bool written = fflush(file) == 0 && !ferror(file);
+#ifdef _WIN32
+        written = written && _commit(_fileno(file)) == 0;
+#else
+        written = written && fsync(fileno(file)) == 0;
+#endif
+        written = fclose(file) == 0 && written;
+        if (written) {
+#ifdef _WIN32
+            if (MoveFileEx(tempFilePath, iniFilePath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+                return true;
+            }
+#else
+            if (rename(tempFilePath, iniFilePath) == 0) {
+                return true;
+            }
+#endif
+        }
+        _tremove(tempFilePath);
     }
+    _ftprintf(stderr, TEXT("Failed to write %s\n"), iniFilePath);
+    return false;
 }
 
-void SaveSettings(const ModemConfig* modem, const TCHAR* modemName) {
-    // 전체 설정을 읽어온 후 특정 모뎀 설정을 업데이트하고, 다시 파일에 씀
-    ModemSettings settings;
-    ReadFullSettings(&settings);
-
-    // 특정 모뎀 설정 업데이트
-    if (_tcscmp(modemName, TEXT("AcousticModem")) == 0) {
-        settings.acousticModem = *modem;
+bool SaveSettings() {
+    // 메모리에 있는 설정 모델을 검증한 뒤 그대로 파일에 씀 (파일을 다시 읽지 않음)
+    for (int i = 0; i < modemRegistry.count; i++) {
+        ValidateModemConfig(&modemRegistry.modems[i], modemRegistry.modems[i].name);
     }
-    else if (_tcscmp(modemName, TEXT("LightModem")) == 0) {
-        settings.lightModem = *modem;
-    }
-
-    // 설정 검증 및 필요한 경우 디폴트 값으로 설정
-    ValidateModemConfig(&settings.acousticModem, TEXT("AcousticModem"));
-    ValidateModemConfig(&settings.lightModem, TEXT("LightModem"));
-
-    WriteFullSettings(&settings);
+    return WriteFullSettings(&modemRegistry);
 }
 
+#ifdef _WIN32
 void ListSerialPorts() {
     HDEVINFO deviceInfoSet = SetupDiGetClassDevs(&GUID_DEVCLASS_PORTS, NULL, NULL, DIGCF_PRESENT);
     if (deviceInfoSet == INVALID_HANDLE_VALUE) {
@@ -334,27 +787,61 @@ void ListSerialPorts() {
 
     SetupDiDestroyDeviceInfoList(deviceInfoSet);
 }
+#else
+void ListSerialPorts() {
+    DIR* dir = opendir("/dev");
+    if (dir == NULL) {
+        _tprintf(TEXT("Failed to get device information set.\n"));
+        return;
+    }
+    _tprintf(TEXT("Available serial ports:\n"));
+    int portCount = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        // USB 시리얼 어댑터와 내장 UART
+        if (strncmp(entry->d_name, "ttyUSB", 6) == 0 || strncmp(entry->d_name, "ttyACM", 6) == 0 || strncmp(entry->d_name, "ttyS", 4) == 0) {
+            _tprintf(TEXT("  Device Name: /dev/%s\n"), entry->d_name);
+            portCount++;
+        }
+    }
 
-void UpdateModemSettings(ModemConfig* modem, const TCHAR* modemName) {
+    // 시리얼 포트가 없는 경우 메시지 출력
+    if (portCount == 0) {
+        _tprintf(TEXT("  No serial ports available.\n"));
+    }
+
+    closedir(dir);
+}
+#endif
+
+void UpdateModemSettings(ModemConfig* modem) {
 
     // 사용 가능한 시리얼 포트 나열
     ListSerialPorts();
 
-    _tprintf(TEXT("Update settings for %s\n"), modemName);
+    _tprintf(TEXT("Update settings for %s\n"), modem->name);
 
-    ModemConfig newModemConfig = { TEXT("COM6"), CBR_115200, 8, ONESTOPBIT, NOPARITY, INVALID_HANDLE_VALUE };
+    // 프레이밍, 압축, LinkRate, 에뮬레이터 프로파일 등은 그대로 두고 포트와 회선 설정만 새로 받음
+    ModemConfig newModemConfig = *modem;
+    newModemConfig.hSerial = INVALID_HANDLE_VALUE;
+    memset(&newModemConfig.io, 0, sizeof(newModemConfig.io));
+    newModemConfig.io.rxMode = modem->io.rxMode;
 
-    _tprintf(TEXT("Enter COM port name (e.g., COM6): \n"));
-    _tscanf(TEXT("%s"), newModemConfig.portName);
+    _tprintf(TEXT("Enter COM port name (e.g., %s, or %s<link> for an emulated modem): \n"), DEFAULT_LIGHT_PORT, EMULATOR_PORT_PREFIX);
+    _tscanf(TEXT("%63s"), newModemConfig.portName);
     FlushStdInBuffer();
 
-    _tprintf(TEXT("Enter baud rate (e.g., 115200): \n"));
-    int baudRate = 0;
+    _tprintf(TEXT("Enter baud rate (e.g., 115200, 921600 or any rate the adapter supports, 0 = find the rate the peer answers at): \n"));
+    int baudRate = -1;
     _tscanf(TEXT("%d"), &baudRate);
     FlushStdInBuffer();
+    newModemConfig.autoBaud = baudRate == 0;
     if (IsValidBaudRate(baudRate)) {
         newModemConfig.baudRate = baudRate;
     }
+    else if (newModemConfig.autoBaud) {
+        newModemConfig.baudRate = modem->baudRate; // 찾기 전까지는 지금 속도
+    }
     else {
         newModemConfig.baudRate = CBR_115200; // 기본값
     }
@@ -377,199 +864,451 @@ void UpdateModemSettings(ModemConfig* modem, const TCHAR* modemName) {
     FlushStdInBuffer();
     newModemConfig.parity = parityInput == 1 ? ODDPARITY : parityInput == 2 ? EVENPARITY : NOPARITY;
 
-    // 새로운 설정으로 모뎀 열기 시도
+    // 같은 포트가 열려 있으면 닫지 않고 회선 설정만 바꿈. 수신은 리액터가 계속 받고, 송신은 잠시 멈춘 채
+    // 드라이버에 남은 바이트를 이전 설정으로 다 내보낸 뒤 바꾼다 (보내던 프레임이 새 속도로 깨지지 않도록)
+    // 진행 중인 속도 탐색은 멈추고 설정된 속도로 되돌린 뒤 바꿈
+    AutoBaudCancel(modem);
+    if (_tcscmp(newModemConfig.portName, modem->portName) == 0 && modem->hSerial != INVALID_HANDLE_VALUE) {
+        uint64_t startNs = PlatformNowNs();
+        TransmitterLockPort(modem);
+        SerialDrain(modem);
+        uint64_t drainedNs = PlatformNowNs();
+        // auto 면 지금 속도로 회선 설정만 바꾸고, 속도는 잠금을 푼 뒤 탐색 스레드가 찾음
+        bool applied = SerialReconfigure(modem, newModemConfig.baudRate, newModemConfig.byteSize, newModemConfig.stopBits, newModemConfig.parity);
+        if (applied) {
+            modem->baudRate = newModemConfig.baudRate;
+            modem->autoBaud = newModemConfig.autoBaud;
+            modem->byteSize = newModemConfig.byteSize;
+            modem->stopBits = newModemConfig.stopBits;
+            modem->parity = newModemConfig.parity;
+            modem->linkRate = modem->linkRateSet ? modem->linkRate : modem->baudRate; // 따로 지정하지 않았으면 따라감
+        }
+        TransmitterUnlockPort(modem);
+        uint64_t doneNs = PlatformNowNs();
+        if (!applied) {
+            _tprintf(TEXT("Failed to apply new settings to %s.\n"), modem->portName);
+            return;
+        }
+        MetricsRecordReconfigure(&modem->metrics, doneNs - startNs);
+        ReactorResize(modem);
+        _tprintf(TEXT("Applied %d bps in place: transmit paused %.2f ms (drain %.2f ms, switch %.2f ms).\n"), modem->baudRate,
+            (doneNs - startNs) / 1e6, (drainedNs - startNs) / 1e6, (doneNs - drainedNs) / 1e6);
+        if (modem->autoBaud && AutoBaudRequest(modem)) {
+            _tprintf(TEXT("Searching for the rate the peer answers at in the background (up to %d ms per rate).\n"), modem->autoBaudMs);
+        }
+        SaveSettings();
+        return;
+    }
+
+    // 다른 포트면 새로운 설정으로 모뎀 열기 시도
     if (OpenSerialPort(&newModemConfig)) {
         // OPEN에 성공한 경우에만 기존 모뎀 연결을 닫고 새로운 설정 적용
-        CloseSerialPort(&modem->hSerial);
-        *modem = newModemConfig;
+        TransmitterLockPort(modem);
+        ReactorRemove(modem);
+        CloseSerialPort(modem);
+        // 포트 관련 필드만 교체 (수신 링은 수신 처리 스레드가 계속 사용 중)
+        _tcscpy(modem->portName, newModemConfig.portName);
+        modem->baudRate = newModemConfig.baudRate;
+        modem->autoBaud = newModemConfig.autoBaud;
+        modem->byteSize = newModemConfig.byteSize;
+        modem->stopBits = newModemConfig.stopBits;
+        modem->parity = newModemConfig.parity;
+        modem->linkRate = modem->linkRateSet ? modem->linkRate : modem->baudRate;
+        modem->io = newModemConfig.io;
+        modem->hSerial = newModemConfig.hSerial;
+        AtomicAddRelaxed32(&modem->metrics.reconnects, 1);
+        ReactorAdd(modem);
+        TransmitterUnlockPort(modem);
+        if (modem->autoBaud) {
+            AutoBaudRequest(modem);
+        }
+        CompressNegotiate(modem); // 상대가 바뀌었을 수 있으므로 다시 협상
+        ClockSyncReset(modem);
         // OPEN에 성공한 경우에만 설정 변경
-        SaveSettings(modem, modemName);
+        SaveSettings();
     }
     else {
         _tprintf(TEXT("Failed to open modem with new settings.\n"));
     }
 }
 
-void SendMessageToModem(const ModemConfig* modem) {
-    if (modem->hSerial == INVALID_HANDLE_VALUE) {
+// 스케줄러로 보냄. 한 프레임에 들어가지 않는 메시지는 모든 링크에 나누어 보냄 (결과는 OnBondDone)
+// redundant 면 같은 메시지를 모든 링크로 보냄 (한 프레임에 들어가는 메시지만)
+static void SendRoutedMessage(const BYTE* data, DWORD length, bool redundant) {
+    if (redundant && length > SCHED_MAX_MESSAGE) {
+        _tprintf(TEXT("Message is too large to send on all links (max %d bytes).\n"), SCHED_MAX_MESSAGE);
+        return;
+    }
+    if (length > SCHED_MAX_MESSAGE) {
+        uint16_t transferId = BondSend(ARQ_KIND_MESSAGE, data, length);
+        if (transferId == 0) {
+            _tprintf(TEXT("Failed to start transfer.\n"));
+        }
+        else {
+            _tprintf(TEXT("Bonded transfer #%u started (%lu bytes).\n"), (unsigned)transferId, (unsigned long)length);
+        }
+        return;
+    }
+    uint32_t messageId = redundant ? SchedulerSendRedundant(data, length) : SchedulerSend(data, length);
+    if (messageId == 0) {
+        _tprintf(TEXT("Failed to queue message (no link or too many pending messages).\n"));
+    }
+    else {
+        _tprintf(TEXT("Message #%lu routed%s (%lu bytes).\n"), (unsigned long)messageId, redundant ? TEXT(" on all links") : TEXT(""),
+            (unsigned long)length);
+    }
+}
+
+// route 가 ROUTE_MODEM 이 아니면 modem 은 NULL 이고 스케줄러가 보냄
+void SendMessageToModem(ModemConfig* modem, int route) {
+    if (modem != NULL && modem->hSerial == INVALID_HANDLE_VALUE) {
         _tprintf(TEXT("Modem is not connected.\n"));
         return;
     }
 
-    TCHAR hexString[60];
     _tprintf(TEXT("Enter HEX message: \n"));
-    _tscanf(TEXT("%[^\n]s"), hexString);  // 전체 라인 읽기
-    FlushStdInBuffer();
-    // 입력받은 HEX 문자열을 바이트 배열로 변환
-    BYTE byteArray[30]; // 최대 30 바이트
-    int byteArrayIndex = 0;
+    // 한 줄 전체를 읽으면서 HEX 쌍을 바이트로 변환 (길이 제한 없음)
+    DWORD capacity = 256;
+    DWORD length = 0;
+    BYTE* byteArray = (BYTE*)malloc(capacity);
+    if (byteArray == NULL) {
+        FlushStdInBuffer();
+        return;
+    }
     TCHAR hexPair[3] = { 0 }; // HEX 쌍을 저장할 배열
     int hexPairIndex = 0;
-
-    for (int i = 0; hexString[i] != '\0' && i < 59 && byteArrayIndex < 30; ++i) {
-        if (hexString[i] != ' ' && hexString[i] != '\n' && hexString[i] != '\r') {
-            hexPair[hexPairIndex++] = hexString[i];
-            if (hexPairIndex == 2) {
-                hexPair[hexPairIndex] = '\0'; // 널 문자로 종료
-                byteArray[byteArrayIndex++] = (BYTE)_tcstoul(hexPair, NULL, 16);
-                hexPairIndex = 0; // HEX 쌍 인덱스 초기화
+    int c;
+    while ((c = _gettchar()) != '\n' && c != EOF) {
+        if (c == ' ' || c == '\r' || c == '\t') {
+            continue;
+        }
+        hexPair[hexPairIndex++] = (TCHAR)c;
+        if (hexPairIndex < 2) {
+            continue;
+        }
+        hexPairIndex = 0; // HEX 쌍 인덱스 초기화
+        if (length == capacity) {
+            BYTE* grown = (BYTE*)realloc(byteArray, capacity * 2);
+            if (grown == NULL) {
+                break;
             }
+            byteArray = grown;
+            capacity *= 2;
         }
+        byteArray[length++] = (BYTE)_tcstoul(hexPair, NULL, 16);
     }
 
-    DWORD bytesWritten;
-    if (!WriteFile(modem->hSerial, byteArray, byteArrayIndex, &bytesWritten, NULL)) {
-        _tprintf(TEXT("Failed to send message.\n"));
-    }
-    else {
-        _tprintf(TEXT("Message sent.\n"));
+    if (route != ROUTE_MODEM) {
+        if (length > 0) {
+            SendRoutedMessage(byteArray, length, route == ROUTE_ALL);
+        }
+        free(byteArray);
+        return;
     }
-}
-
-void DisplayHelp() {
-    _tprintf(TEXT("Help:\n"));
-    _tprintf(TEXT("1. Acoustic Modem Settings - Update settings for the Acoustic Modem.\n"));
-    _tprintf(TEXT("2. Light Modem Settings - Update settings for the Light Modem.\n"));
-    _tprintf(TEXT("3. Send a message to an Acoustic Modem - Send a message through the Acoustic Modem.\n"));
-    _tprintf(TEXT("4. Send a message to a Light Modem - Send a message through the Light Modem.\n"));
-    _tprintf(TEXT("5. Help - Display this help message.\n"));
-    _tprintf(TEXT("6. Exit - Exit the program.\n"));
-}
 
-bool OpenSerialPort(ModemConfig* modem) {
-    //시리얼 포트 오픈
-    modem->hSerial = CreateFile(modem->portName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (modem->hSerial == INVALID_HANDLE_VALUE) {
-        _ftprintf(stderr, TEXT("Error opening serial port %s\n"), modem->portName);
-        _ftprintf(stderr, TEXT("  Error Code: %d\n"), GetLastError());
-        return false;
+    // 프레임 하나에 들어가지 않는 메시지는 ARQ 로 조각내어 보냄 (결과는 OnArqDone)
+    if (modem->framing == FRAMING_COBS && length > FRAME_MAX_PAYLOAD) {
+        uint16_t transferId = ArqSend(modem, ARQ_KIND_MESSAGE, byteArray, length);
+        free(byteArray);
+        if (transferId == 0) {
+            _tprintf(TEXT("Failed to start transfer.\n"));
+        }
+        else {
+            _tprintf(TEXT("Transfer #%u started (%lu bytes).\n"), (unsigned)transferId, (unsigned long)length);
+        }
+        return;
     }
 
-    // 큐 사이즈 설정
-    if (!SetupComm(modem->hSerial, 4096, 4096)) {
-        _ftprintf(stderr, TEXT("Error setting queue size for %s\n"), modem->portName);
-        CloseSerialPort(&modem->hSerial);
-        return false;
+    // 송신 큐에 넣고 바로 반환. 전송 결과는 OnTransmitDone 으로 통지됨
+    CompressReport report;
+    uint32_t messageId = CompressEnqueue(modem, byteArray, length, &report);
+    free(byteArray);
+    if (messageId == 0) {
+        _tprintf(TEXT("Failed to queue message (transmit queue full).\n"));
     }
-
-    //타임 아웃 설정
-    COMMTIMEOUTS timeouts = { 0 };
-    timeouts.ReadIntervalTimeout = 0;
-    timeouts.ReadTotalTimeoutMultiplier = 0;
-    timeouts.ReadTotalTimeoutConstant = 30;
-    if (!SetCommTimeouts(modem->hSerial, &timeouts)) {
-        _ftprintf(stderr, TEXT("Error setting timeout for %s\n"), modem->portName);
-        CloseSerialPort(&modem->hSerial);
-        return false;
+    else if (report.compressed) {
+        _tprintf(TEXT("Message #%lu queued (%lu bytes, compressed to %lu bytes = %.1f%% in %.1f us).\n"), (unsigned long)messageId,
+            (unsigned long)length, (unsigned long)report.sentBytes, 100.0 * report.sentBytes / length, report.elapsedNs / 1000.0);
     }
-
-    // 이벤트 마스크 설정 (EV_ERR: 에러 이벤트)
-    if (!SetCommMask(modem->hSerial, EV_ERR)) {
-        _ftprintf(stderr, TEXT("Error setting event mask for %s\n"), modem->portName);
-        CloseSerialPort(&modem->hSerial);
-        return false;
+    else {
+        _tprintf(TEXT("Message #%lu queued (%lu bytes).\n"), (unsigned long)messageId, (unsigned long)length);
     }
+}
 
-    //DCB 설정 가져오기
-    DCB dcbSerialParams = { 0 };
-    dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
-    if (!GetCommState(modem->hSerial, &dcbSerialParams)) {
-        _ftprintf(stderr, TEXT("Error getting comm state for %s\n"), modem->portName);
-        CloseSerialPort(&modem->hSerial);
-        return false;
+// 파일을 읽어 ARQ 로 전송하는 함수. 전송 데이터 = 이름 길이(1) | 파일 이름(UTF-8) | 파일 내용
+// modem 이 NULL 이면 모든 링크에 나누어 보냄
+void SendFileToModem(ModemConfig* modem) {
+    if (modem != NULL && modem->hSerial == INVALID_HANDLE_VALUE) {
+        _tprintf(TEXT("Modem is not connected.\n"));
+        return;
     }
-
-    //DCB 설정 적용
-    dcbSerialParams.BaudRate = modem->baudRate;
-    dcbSerialParams.ByteSize = modem->byteSize;
-    dcbSerialParams.StopBits = modem->stopBits;
-    dcbSerialParams.Parity = modem->parity;
-    if (!SetCommState(modem->hSerial, &dcbSerialParams)) {
-        _ftprintf(stderr, TEXT("Error setting comm state for %s\n"), modem->portName);
-        CloseSerialPort(&modem->hSerial);
-        return false;
+    if (modem != NULL && modem->framing != FRAMING_COBS) {
+        _tprintf(TEXT("File transfer requires Framing=1.\n"));
+        return;
     }
 
-    //디바이스 컨트롤
-    DWORD dwBytesReturned = 0;
-
-    SERIAL_CHARS SerialChars = { 0 };
-    SerialChars.EofChar = 0x0;
-    SerialChars.ErrorChar = 0x0;
-    SerialChars.BreakChar = 0x0;
-    SerialChars.EventChar = 0x0;
-    SerialChars.XonChar = 0x11;
-    SerialChars.XoffChar = 0x13;
+    TCHAR path[MAX_PATH] = { 0 };
+    _tprintf(TEXT("Enter file path: \n"));
+    _tscanf(TEXT("%[^\n]"), path);
+    FlushStdInBuffer();
 
-    if (!DeviceIoControl(modem->hSerial, IOCTL_SERIAL_SET_CHARS, &SerialChars, sizeof(SerialChars), NULL, 0, &dwBytesReturned, NULL)) {
-        _ftprintf(stderr, TEXT("Error setting comm SERIAL CHARS for %s\n"), modem->portName);
-        CloseSerialPort(&modem->hSerial);
-        return false;
+    FILE* file = _tfopen(path, TEXT("rb"));
+    if (file == NULL) {
+        _tprintf(TEXT("Failed to open file: %s\n"), path);
+        return;
     }
-
-    SERIAL_HANDFLOW HandFlow = { 0 };
-    HandFlow.ControlHandShake = 0x1;
-    HandFlow.FlowReplace = 0x40;
-    HandFlow.XonLimit = 0;
-    HandFlow.XoffLimit = 16384;
-
-    if (!DeviceIoControl(modem->hSerial, IOCTL_SERIAL_SET_HANDFLOW, &HandFlow, sizeof(HandFlow), NULL, 0, &dwBytesReturned, NULL)) {
-        _ftprintf(stderr, TEXT("Error setting comm SERIAL HANDFLOW for %s\n"), modem->portName);
-        CloseSerialPort(&modem->hSerial);
-        return false;
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // 경로를 뺀 파일 이름만 보냄
+    const TCHAR* baseName = path;
+    for (const TCHAR* p = path; *p != TEXT('\0'); p++) {
+        if (*p == TEXT('/') || *p == TEXT('\\')) {
+            baseName = p + 1;
+        }
+    }
+    char name[256];
+#ifdef _WIN32
+    int nameLength = WideCharToMultiByte(CP_UTF8, 0, baseName, -1, name, sizeof(name), NULL, NULL) - 1;
+#else
+    int nameLength = (int)strlen(baseName);
+    if (nameLength < (int)sizeof(name)) {
+        memcpy(name, baseName, nameLength);
+    }
+#endif
+    if (nameLength <= 0 || nameLength > 255 || fileSize < 0 || fileSize > ARQ_MAX_TRANSFER - 256) {
+        _tprintf(TEXT("File name or size is not supported (max %d bytes).\n"), ARQ_MAX_TRANSFER - 256);
+        fclose(file);
+        return;
     }
 
-    // 퍼지 커맨드 실행
-    if (!PurgeComm(modem->hSerial, PURGE_TXABORT | PURGE_RXABORT | PURGE_TXCLEAR | PURGE_RXCLEAR)) {
-        _ftprintf(stderr, TEXT("Error purging comm ports for %s\n"), modem->portName);
-        CloseSerialPort(&modem->hSerial);
-        return false;
+    DWORD length = 1 + (DWORD)nameLength + (DWORD)fileSize;
+    BYTE* data = (BYTE*)malloc(length);
+    if (data == NULL) {
+        fclose(file);
+        return;
+    }
+    data[0] = (BYTE)nameLength;
+    memcpy(data + 1, name, nameLength);
+    size_t bytesRead = fread(data + 1 + nameLength, 1, (size_t)fileSize, file);
+    fclose(file);
+    if (bytesRead != (size_t)fileSize) {
+        _tprintf(TEXT("Failed to read file: %s\n"), path);
+        free(data);
+        return;
     }
 
-    return true;
+    uint16_t transferId = modem != NULL ? ArqSend(modem, ARQ_KIND_FILE, data, length) : BondSend(ARQ_KIND_FILE, data, length);
+    free(data);
+    if (transferId == 0) {
+        _tprintf(TEXT("Failed to start transfer.\n"));
+    }
+    else {
+        _tprintf(TEXT("%s #%u started: %s (%ld bytes).\n"), modem != NULL ? TEXT("Transfer") : TEXT("Bonded transfer"),
+            (unsigned)transferId, baseName, fileSize);
+    }
 }
 
-void CloseSerialPort(HANDLE* hSerial) {
-    if (*hSerial != INVALID_HANDLE_VALUE) {
-        CloseHandle(*hSerial);
-        *hSerial = INVALID_HANDLE_VALUE;
-    }
+void DisplayHelp() {
+    _tprintf(TEXT("Help:\n"));
+    _tprintf(TEXT("Modems are listed as [id] name (port). Select a modem by its id or name.\n"));
+    _tprintf(TEXT("Add a new [name] section to %s to register more modems.\n"), INI_FILE_NAME);
+    _tprintf(TEXT("Messages are sent as CRC-checked frames. Set Framing=0 in a section to exchange raw bytes instead.\n"));
+    _tprintf(TEXT("Set Port=%s<link> to use an emulated modem instead of a serial port (POSIX builds). Modems with the same link\n"), EMULATOR_PORT_PREFIX);
+    _tprintf(TEXT("are connected to each other, a modem alone on its link receives its own bytes. Emulator= sets the medium it sends on:\n"));
+    _tprintf(TEXT("wire, light, acoustic or ideal, optionally followed by rate=<bps>,delay=<ms>,jitter=<ms>,ber=<rate>,loss=<%%>,burst=<ms>.\n"));
+    _tprintf(TEXT("Messages are compressed once the other side reports the same dictionary (%s next to %s, or the built-in one). Set Compression=0 to disable.\n"),
+        COMPRESS_DICTIONARY_FILE, INI_FILE_NAME);
+    _tprintf(TEXT("Start with --capture <file> to record all modem traffic, and --replay <file> [speed] to play the received bytes\n"));
+    _tprintf(TEXT("back through the receive path (speed 0 = as fast as possible).\n"));
+    _tprintf(TEXT("Received messages are printed as text, or as a hex dump if they contain other bytes. Start with --rx-log <file> [max MB]\n"));
+    _tprintf(TEXT("to write them to a file instead, kept as <file>.1 to .%d once it grows past the limit (default %d MB).\n"), RXLOG_FILES - 1, RXLOG_DEFAULT_MB);
+    _tprintf(TEXT("A third value sets the number of %d KB log buffers (default %d). Raise it if the receive log line in the metrics\n"),
+        RXLOG_SEGMENT_SIZE / 1024, RXLOG_SEGMENTS);
+    _tprintf(TEXT("shows dropped messages.\n"));
+    _tprintf(TEXT("Start with --daemon [path] to run without this menu and serve local client applications on a %s\n"),
+#ifdef _WIN32
+        TEXT("named pipe"));
+#else
+        TEXT("Unix domain socket"));
+#endif
+    _tprintf(TEXT("(default %s). The packet format is described in service.h.\n"), SERVICE_DEFAULT_PATH);
+    _tprintf(TEXT("Start with --send <modem id | all> [file | -] [--binary] to send every message in a file or stdin and report the\n"));
+    _tprintf(TEXT("goodput. Each line is one HEX message, or with --binary each message is a 4-byte little-endian length and the data.\n"));
+    _tprintf(TEXT("A port that fails or whose device is unplugged is closed and reopened with the same settings when the device is back.\n"));
+    _tprintf(TEXT("Messages routed with 'auto' move to another live link at once and the link rejoins after reconnecting.\n"));
+    _tprintf(TEXT("1. Modem Settings - Update settings for the selected modem.\n"));
+    _tprintf(TEXT("   Baud rate 0 (BaudRate=auto) opens the port at the last rate and searches in the background for the rate the\n"));
+    _tprintf(TEXT("   peer answers at, waiting AutoBaudMs per rate (set it above the link round trip, e.g. seconds for acoustic).\n"));
+    _tprintf(TEXT("   The peer must use Framing=1 and a fixed BaudRate; two ends both set to auto never find each other.\n"));
+    _tprintf(TEXT("2. Send a message to a Modem - Send a message through the selected modem. Enter 'auto' to let the\n"));
+    _tprintf(TEXT("   scheduler pick the fastest live link and resend on another link if it is not acknowledged.\n"));
+    _tprintf(TEXT("   Messages larger than one frame are split into chunks and sent over all live links at once (bonding).\n"));
+    _tprintf(TEXT("   Enter 'all' to send a short urgent message on every live link at once. The first copy to arrive is\n"));
+    _tprintf(TEXT("   delivered and the later ones are dropped as duplicates.\n"));
+    _tprintf(TEXT("   Set LinkRate to the real medium speed (bps) of each modem. It is used until the speed has been measured.\n"));
+    _tprintf(TEXT("   LinkRate=0 follows BaudRate, including the rate found by BaudRate=auto.\n"));
+    _tprintf(TEXT("   Each modem sends control frames and urgent messages first, then messages, then bulk transfer fragments,\n"));
+    _tprintf(TEXT("   switching at the next fragment. Set TxWeights=C,N,B to share the line by fragment counts per round instead.\n"));
+    _tprintf(TEXT("   Bulk fragments are paced to the measured link speed, or to LinkRate when it differs from BaudRate,\n"));
+    _tprintf(TEXT("   so that urgent messages do not wait behind data already in the driver.\n"));
+    _tprintf(TEXT("3. Send a file to a Modem - Send a file with retransmission. Received files are saved next to %s.\n"), INI_FILE_NAME);
+    _tprintf(TEXT("   Enter 'auto' to split the file over all live links in proportion to their measured speed.\n"));
+    _tprintf(TEXT("4. Help - Display this help message.\n"));
+    _tprintf(TEXT("5. Metrics - Show per-modem byte/message counters, errors, queue depths and send/receive latency percentiles.\n"));
+    _tprintf(TEXT("   Start with --metrics <file> [interval ms] to append the same figures to a file as one JSON line per interval.\n"));
+    _tprintf(TEXT("   Set Timestamps=1 on a modem to synchronize clocks with the other side and stamp every frame with its send time.\n"));
+    _tprintf(TEXT("   The receiving side then shows one-way latency percentiles, jitter and the clock offset for that link.\n"));
+    _tprintf(TEXT("6. Exit - Exit the program.\n"));
 }
 
 void DisplayMenu() {
+    BondStats bond;
+    BondQueryStats(&bond);
     _tprintf(TEXT("\n============\n"));
-    _tprintf(TEXT("Acoustic Modem : %s\n"), acousticModem.hSerial != INVALID_HANDLE_VALUE ? TEXT("ON") : TEXT("OFF"));
-    _tprintf(TEXT("Light Modem : %s\n"), lightModem.hSerial != INVALID_HANDLE_VALUE ? TEXT("ON") : TEXT("OFF"));
-    _tprintf(TEXT("1. Acoustic Modem Settings\n"));
-    _tprintf(TEXT("2. Light Modem Settings\n"));
-    _tprintf(TEXT("3. Send a message to an Acoustic Modem\n"));
-    _tprintf(TEXT("4. Send a message to a Light Modem\n"));
-    _tprintf(TEXT("5. Help\n"));
+    for (int i = 0; i < modemRegistry.count; i++) {
+        const ModemConfig* modem = &modemRegistry.modems[i];
+        _tprintf(TEXT("[%d] %s (%s) : %s\n"), i, modem->name, modem->portName, modem->hSerial != INVALID_HANDLE_VALUE ? TEXT("ON") : TEXT("OFF"));
+        // 수신 링 사용량과 오버런 (버려진 바이트가 없는지 확인용)
+        _tprintf(TEXT("    rx buffer %lu/%lu (peak %ld), dropped %lld bytes in %ld overruns, driver overruns %lu\n"),
+            (unsigned long)RingUsed(&modem->rxRing), (unsigned long)modem->rxRing.capacity, (long)modem->rxRing.highWater,
+            (long long)modem->rxRing.droppedBytes, (long)modem->rxRing.overrunCount, (unsigned long)SerialQueryOverruns((ModemConfig*)modem));
+        _tprintf(TEXT("    tx queued %ld bytes, sent %ld messages (%ld failed) in %ld writes, %lld bytes\n"),
+            (long)modem->txQueue.queuedBytes, (long)modem->txQueue.messagesSent, (long)modem->txQueue.messagesFailed,
+            (long)modem->txQueue.writes, (long long)modem->txQueue.bytesWritten);
+        if (modem->framing == FRAMING_COBS) {
+            _tprintf(TEXT("    frames %ld, crc errors %ld, format errors %ld\n"),
+                (long)modem->rxFrame.frames, (long)modem->rxFrame.crcErrors, (long)modem->rxFrame.formatErrors);
+            ArqStats arqStats;
+            ArqQueryStats(modem, &arqStats);
+            _tprintf(TEXT("    transfers sent %ld (%ld failed), received %ld, fragments %ld, retransmissions %ld\n"),
+                (long)arqStats.transfersSent, (long)arqStats.transfersFailed, (long)arqStats.transfersReceived,
+                (long)arqStats.fragmentsSent, (long)arqStats.retransmissions);
+            if (modem->fecData > 0) {
+                _tprintf(TEXT("    fec %d/%d, parity sent %ld, recovered %ld fragments\n"), modem->fecData, modem->fecData + modem->fecParity,
+                    (long)arqStats.paritySent, (long)arqStats.fecRecovered);
+            }
+            const CompressStats* compress = &modem->compress;
+            _tprintf(TEXT("    compression %s, %ld messages %lld -> %lld bytes (%.1f%%, %.1f us each), %ld stored\n"),
+                AtomicLoadAcquire32(&modem->peerCompression) == COMPRESS_LZ ? TEXT("on") : modem->compression == COMPRESS_LZ ? TEXT("not negotiated") : TEXT("off"),
+                (long)compress->messagesCompressed, (long long)compress->bytesIn, (long long)compress->bytesOut,
+                compress->bytesIn > 0 ? 100.0 * compress->bytesOut / compress->bytesIn : 100.0,
+                compress->messagesCompressed + compress->messagesStored > 0 ? compress->compressNs / 1000.0 / (compress->messagesCompressed + compress->messagesStored) : 0.0,
+                (long)compress->messagesStored);
+            _tprintf(TEXT("    expanded %ld messages (%.1f us each), %ld errors\n"), (long)compress->messagesExpanded,
+                compress->messagesExpanded > 0 ? compress->expandNs / 1000.0 / compress->messagesExpanded : 0.0, (long)compress->expandErrors);
+            LinkStats link;
+            if (SchedulerQueryLink(modem, &link)) {
+                _tprintf(TEXT("    link %s, rtt %.1f ms (+-%.1f), loss %.1f%%, routed %ld (%ld acked, %ld timeouts), down %ld times\n"),
+                    link.up ? TEXT("up") : TEXT("down"), link.rttMs, link.rttVarMs, link.loss * 100.0,
+                    (long)link.messagesSent, (long)link.messagesAcked, (long)link.timeouts, (long)link.downs);
+                _tprintf(TEXT("    rate %d bps (%s), bonded chunks %ld\n"), link.rateBps, link.rateMeasured ? TEXT("measured") : TEXT("LinkRate"),
+                    (long)bond.chunksAcked[i]);
+            }
+        }
+        EmulatorStats emulated;
+        if (EmulatorQueryStats(modem, &emulated)) {
+            _tprintf(TEXT("    emulated (%s): sent %lld bytes, delivered %lld, burst lost %ld, bit errors %ld, overflow %ld, garbled %ld\n"),
+                modem->emulator, (long long)emulated.bytesSent, (long long)emulated.bytesDelivered, (long)emulated.burstDropped,
+                (long)emulated.bitErrors, (long)emulated.overflowDropped, (long)emulated.garbled);
+        }
+    }
+    SchedulerStats scheduler;
+    SchedulerQueryStats(&scheduler);
+    _tprintf(TEXT("auto: routed %ld (%ld on all links), delivered %ld (%ld failed, %ld rerouted, %ld duplicates), %.1f B/s, failover last %.0f ms / max %.0f ms\n"),
+        (long)scheduler.routed, (long)scheduler.redundant, (long)scheduler.delivered, (long)scheduler.failed, (long)scheduler.rerouted,
+        (long)scheduler.duplicates,
+        scheduler.throughput, scheduler.lastFailoverMs, scheduler.maxFailoverMs);
+    _tprintf(TEXT("bond: sent %ld transfers (%ld failed) in %ld chunks, received %ld, last %.1f KB/s\n"),
+        (long)bond.transfersSent, (long)bond.transfersFailed, (long)bond.chunksSent, (long)bond.transfersReceived, bond.lastThroughput / 1024.0);
+    if (CaptureActive()) {
+        CaptureStats capture;
+        CaptureQueryStats(&capture);
+        _tprintf(TEXT("capture: %lld records, rx %lld bytes, tx %lld bytes, %lld bytes written, %lld records dropped\n"),
+            (long long)capture.records, (long long)capture.bytes[CAPTURE_RX], (long long)capture.bytes[CAPTURE_TX],
+            (long long)capture.fileBytes, (long long)capture.droppedRecords);
+    }
+    _tprintf(TEXT("1. Modem Settings\n"));
+    _tprintf(TEXT("2. Send a message to a Modem\n"));
+    _tprintf(TEXT("3. Send a file to a Modem\n"));
+    _tprintf(TEXT("4. Help\n"));
+    _tprintf(TEXT("5. Metrics\n"));
     _tprintf(TEXT("6. Exit\n"));
     _tprintf(TEXT("============\n"));
 }
 
+// 모뎀 id(번호 또는 이름)를 입력받는 함수
+ModemConfig* SelectModem() {
+    TCHAR id[MAX_MODEM_NAME] = { 0 };
+    _tprintf(TEXT("Enter modem id (0-%d or name): \n"), modemRegistry.count - 1);
+    _tscanf(TEXT("%31s"), id);
+    FlushStdInBuffer();
+
+    ModemConfig* modem = FindModem(id);
+    if (modem == NULL) {
+        _tprintf(TEXT("Unknown modem: %s\n"), id);
+    }
+    return modem;
+}
+
+// 전송용: 'auto' 나 'all' 을 입력하면 NULL 과 함께 *route 에 ROUTE_AUTO / ROUTE_ALL (스케줄러가 보냄)
+// 'all' 은 allowAll 일 때만 받음
+ModemConfig* SelectRoute(int* route, bool allowAll) {
+    TCHAR id[MAX_MODEM_NAME] = { 0 };
+    _tprintf(allowAll ? TEXT("Enter modem id (0-%d, name, auto or all): \n") : TEXT("Enter modem id (0-%d, name or auto): \n"),
+        modemRegistry.count - 1);
+    _tscanf(TEXT("%31s"), id);
+    FlushStdInBuffer();
+
+    *route = ROUTE_MODEM;
+    if (_tcsicmp(id, TEXT("auto")) == 0) {
+        *route = ROUTE_AUTO;
+        return NULL;
+    }
+    if (allowAll && _tcsicmp(id, TEXT("all")) == 0) {
+        *route = ROUTE_ALL;
+        return NULL;
+    }
+    ModemConfig* modem = FindModem(id);
+    if (modem == NULL) {
+        _tprintf(TEXT("Unknown modem: %s\n"), id);
+    }
+    return modem;
+}
+
 void HandleUserInput() {
     int choice;
+    ModemConfig* modem;
     _tprintf(TEXT("Enter your choice: \n"));
     _tscanf(TEXT("%d"), &choice);
     FlushStdInBuffer();
 
     switch (choice) {
     case 1:
-        UpdateModemSettings(&acousticModem, TEXT("AcousticModem"));
+        if ((modem = SelectModem()) != NULL) {
+            UpdateModemSettings(modem);
+        }
         break;
-    case 2:
-        UpdateModemSettings(&lightModem, TEXT("LightModem"));
+    case 2: {
+        int route = ROUTE_MODEM;
+        if ((modem = SelectRoute(&route, true)) != NULL || route != ROUTE_MODEM) {
+            SendMessageToModem(modem, route);
+        }
         break;
-    case 3:
-        SendMessageToModem(&acousticModem);
+    }
+    case 3: {
+        int route = ROUTE_MODEM;
+        if ((modem = SelectRoute(&route, false)) != NULL || route != ROUTE_MODEM) {
+            SendFileToModem(modem);
+        }
         break;
+    }
     case 4:
-        SendMessageToModem(&lightModem);
+        DisplayHelp();
         break;
     case 5:
-        DisplayHelp();
+        MetricsPrint();
         break;
     case 6:
         keepRunning = false;
@@ -581,31 +1320,306 @@ void HandleUserInput() {
     }
 }
 
-DWORD WINAPI ReadThread(LPVOID param) {
-    ModemConfig* modem = (ModemConfig*)param;
-    TCHAR buffer[2048];
-    DWORD bytesRead;
-    DWORD dwEventMask = 0;
-
-    while (keepRunning) {
-        dwEventMask = 0;
-        if (ReadFile(modem->hSerial, buffer, 2047, &bytesRead, NULL)) {
-            if (bytesRead > 0) {
-                buffer[bytesRead] = '\0';
-                if (modem->portName[0] == TEXT('A')) {
-                    _tprintf(TEXT("Received Message(%s) >> %s\n"), modem->portName, buffer);
-                }
-                else {
-                    printf("Received Message(%s) >> %s\n", modem->portName, buffer);
-                }
-            }
+// 수신 처리 스레드에서 호출되는 수신 콜백
+// 출력은 로그 스레드가 함 (rxlog.h). 0x00 등 출력할 수 없는 바이트가 있으면 HEX 덤프로 출력
+void OnModemReceive(ModemConfig* modem, const FrameHeader* header, const BYTE* data, DWORD size) {
+    if (SchedulerHandleFrame(modem, header, data, size)) {
+        return; // 링크 확인 프레임, 스케줄러 메시지는 OnSchedulerReceive 로 전달됨
+    }
+    if (ArqHandleFrame(modem, header, data, size)) {
+        return; // ARQ 조각/ACK 는 전송이 끝나면 OnArqReceive 로 전달됨
+    }
+    if (CompressHandleFrame(modem, header, data, size)) {
+        return; // 압축 협상
+    }
+    if (ServiceActive()) {
+        ServicePublish(modem, ARQ_KIND_MESSAGE, data, size);
+        return;
+    }
+    RxLogRecord(modem, header != NULL, data, size);
+}
+
+// 송신 스레드에서 호출되는 송신 완료 콜백
+void OnTransmitDone(ModemConfig* modem, uint32_t messageId, bool success) {
+    if (ServiceActive()) {
+        ServiceNotifyDone(SERVICE_SOURCE_MODEM, modem, messageId, success);
+        return;
+    }
+    if (success) {
+        _tprintf(TEXT("Message #%lu sent to %s.\n"), (unsigned long)messageId, modem->name);
+    }
+    else {
+        _tprintf(TEXT("Message #%lu to %s failed.\n"), (unsigned long)messageId, modem->name);
+    }
+}
+
+// 받은 파일을 INI 파일과 같은 폴더에 저장 (같은 이름이 있으면 뒤에 번호를 붙임)
+static void SaveReceivedFile(ModemConfig* modem, const BYTE* data, DWORD length) {
+    DWORD nameLength = data[0];
+    if (length < 1 + nameLength || nameLength == 0) {
+        return;
+    }
+    TCHAR name[256];
+#ifdef _WIN32
+    int converted = MultiByteToWideChar(CP_UTF8, 0, (const char*)data + 1, (int)nameLength, name, 255);
+    name[converted > 0 ? converted : 0] = TEXT('\0');
+#else
+    memcpy(name, data + 1, nameLength);
+    name[nameLength] = '\0';
+#endif
+    // 상대가 보낸 이름에서 경로 구분자 등은 제거
+    for (TCHAR* p = name; *p != TEXT('\0'); p++) {
+        if (*p == TEXT('/') || *p == TEXT('\\') || *p == TEXT(':')) {
+            *p = TEXT('_');
         }
     }
-    return 0;
+    if (_tcscmp(name, TEXT(".")) == 0 || _tcscmp(name, TEXT("..")) == 0 || name[0] == TEXT('\0')) {
+        _tcscpy(name, TEXT("received.bin"));
+    }
+
+    TCHAR path[MAX_PATH];
+    GetIniFilePath(path);
+    TCHAR* fileName = _tcsrchr(path, PATH_SEPARATOR);
+    fileName = fileName != NULL ? fileName + 1 : path;
+    size_t room = MAX_PATH - (fileName - path) - 8;
+    _sntprintf(fileName, room, TEXT("%s"), name);
+    size_t pathLength = _tcslen(path);
+    FILE* file;
+    for (int suffix = 1; (file = _tfopen(path, TEXT("r"))) != NULL && suffix < 1000; suffix++) {
+        fclose(file);
+        _stprintf(path + pathLength, TEXT(".%d"), suffix);
+    }
+
+    file = _tfopen(path, TEXT("wb"));
+    if (file == NULL || fwrite(data + 1 + nameLength, 1, length - 1 - nameLength, file) != length - 1 - nameLength) {
+        _tprintf(TEXT("Failed to save file from %s: %s\n"), modem->name, path);
+    }
+    else {
+        _tprintf(TEXT("Received File(%s) >> %s (%lu bytes)\n"), modem->name, path, (unsigned long)(length - 1 - nameLength));
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+}
+
+// 수신 처리 스레드에서 호출되는 ARQ 전송 수신 콜백
+void OnArqReceive(ModemConfig* modem, BYTE kind, const BYTE* data, DWORD length) {
+    if (ServiceActive()) {
+        ServicePublish(modem, kind, data, length);
+    }
+    else if (kind == ARQ_KIND_FILE) {
+        SaveReceivedFile(modem, data, length);
+    }
+    else {
+        FrameHeader header = { FRAME_TYPE_DATA, 0, 0 };
+        OnModemReceive(modem, &header, data, length);
+    }
+}
+
+// 수신 처리 스레드에서 호출되는 스케줄러 메시지 수신 콜백
+void OnSchedulerReceive(ModemConfig* modem, const BYTE* data, DWORD length) {
+    FrameHeader header = { FRAME_TYPE_DATA, 0, (uint16_t)length };
+    OnModemReceive(modem, &header, data, length);
+}
+
+// 스케줄러로 보낸 메시지가 확인되었거나 포기됨
+void OnSchedulerDone(ModemConfig* modem, uint32_t messageId, bool success) {
+    if (ServiceActive()) {
+        ServiceNotifyDone(SERVICE_SOURCE_AUTO, modem, messageId, success);
+        return;
+    }
+    if (success) {
+        _tprintf(TEXT("Message #%lu delivered via %s.\n"), (unsigned long)messageId, modem->name);
+    }
+    else {
+        _tprintf(TEXT("Message #%lu could not be delivered.\n"), (unsigned long)messageId);
+    }
+}
+
+// 묶음 전송이 끝남. 링크별로 나뉜 조각 수를 함께 출력
+void OnBondDone(uint16_t transferId, bool success, const BondReport* report) {
+    if (ServiceActive()) {
+        ServiceNotifyDone(SERVICE_SOURCE_BOND, NULL, transferId, success);
+        return;
+    }
+    if (!success) {
+        _tprintf(TEXT("Bonded transfer #%u failed.\n"), (unsigned)transferId);
+        return;
+    }
+    double seconds = report->elapsedNs / 1e9;
+    _tprintf(TEXT("Bonded transfer #%u completed (%lu bytes in %.2f s, %.1f KB/s):"), (unsigned)transferId,
+        (unsigned long)report->length, seconds, seconds > 0.0 ? report->length / seconds / 1024.0 : 0.0);
+    for (int i = 0; i < modemRegistry.count; i++) {
+        if (report->chunks[i] > 0) {
+            _tprintf(TEXT(" %s %ld chunks"), modemRegistry.modems[i].name, (long)report->chunks[i]);
+        }
+    }
+    _tprintf(TEXT("\n"));
+}
+
+// ARQ 스레드에서 호출되는 전송 완료 콜백
+void OnArqDone(ModemConfig* modem, uint16_t transferId, bool success) {
+    if (ServiceActive()) {
+        ServiceNotifyDone(SERVICE_SOURCE_ARQ, modem, transferId, success);
+        return;
+    }
+    if (success) {
+        _tprintf(TEXT("Transfer #%u to %s completed.\n"), (unsigned)transferId, modem->name);
+    }
+    else {
+        _tprintf(TEXT("Transfer #%u to %s failed.\n"), (unsigned)transferId, modem->name);
+    }
+}
+
+void OnModemError(ModemConfig* modem, DWORD errorCode) {
+    _tprintf(TEXT("Serial error on %s (%s): %lu\n"), modem->name, modem->portName, (unsigned long)errorCode);
+    HotplugPortFailed(modem, errorCode);
+}
+
+// 포트 감시 스레드에서 호출되는 분리/재연결 콜백
+void OnPortChange(ModemConfig* modem, bool up) {
+    if (up) {
+        _tprintf(TEXT("%s (%s) reconnected after %.0f ms.\n"), modem->name, modem->portName,
+            AtomicLoadAcquire64(&modem->metrics.lastReconnectUs) / 1000.0);
+        CompressNegotiate(modem); // 상대가 바뀌었을 수 있으므로 다시 협상
+        ClockSyncReset(modem);
+    }
+    else {
+        _tprintf(TEXT("%s (%s) disconnected, reconnecting when the device is back.\n"), modem->name, modem->portName);
+    }
 }
 
 void SignalHandler(int signal) {
-    if (signal == SIGINT) {
+    if (signal == SIGINT || signal == SIGTERM) {
         keepRunning = false;
     }
 }
+
+// --replay <파일> [배속]: 캡처의 수신 바이트를 수신 처리 스레드로 다시 흘려 보내 평소처럼 출력한다
+int RunReplay(int argc, TCHAR* argv[]) {
+    if (argc < 1) {
+        _ftprintf(stderr, TEXT("Usage: UHSDM --replay <capture file> [speed, 0 = as fast as possible]\n"));
+        return 1;
+    }
+    double speed = argc >= 2 ? _tcstod(argv[1], NULL) : 1.0;
+    speed = speed > 0.0 ? speed : 0.0;
+    CrcInit();
+    RxLogInit();
+    LoadCompressDictionary();
+
+    CaptureReplay replay;
+    if (!CaptureReplayOpen(&replay, argv[0])) {
+        return 1;
+    }
+    ClockSyncInit(); // 캡처에 타임스탬프 프레임이 있으면 단방향 지연을 계산하려 함
+    if (!RxLogStart(NULL, 0, 0) || !ReceiverStart(OnModemReceive)) {
+        _ftprintf(stderr, TEXT("Failed to start receive thread.\n"));
+        RxLogStop();
+        CaptureReplayClose(&replay);
+        return 1;
+    }
+    bool complete = CaptureReplayRun(&replay, speed, ReceiverPush);
+    ReceiverStop();
+    RxLogStop();
+
+    double seconds = replay.elapsedNs / 1e9;
+    _tprintf(TEXT("Replayed %lld records (rx %lld bytes, tx %lld bytes) covering %.3f s in %.3f s, %.1f MB/s%s\n"),
+        (long long)replay.records, (long long)replay.bytes[CAPTURE_RX], (long long)replay.bytes[CAPTURE_TX], replay.durationNs / 1e9,
+        seconds, seconds > 0.0 ? replay.bytes[CAPTURE_RX] / seconds / 1e6 : 0.0, complete ? TEXT("") : TEXT(" (capture truncated)"));
+    for (int i = 0; i < modemRegistry.count; i++) {
+        const ModemConfig* modem = &modemRegistry.modems[i];
+        _tprintf(TEXT("[%d] %s: frames %ld, crc errors %ld, format errors %ld, dropped %lld bytes\n"), i, modem->name,
+            (long)modem->rxFrame.frames, (long)modem->rxFrame.crcErrors, (long)modem->rxFrame.formatErrors, (long long)modem->rxRing.droppedBytes);
+    }
+    CaptureReplayClose(&replay);
+    return 0;
+}
+
+// 문자 하나를 보내는 데 드는 비트 수 (시작 비트 + 데이터 + 패리티 + 정지 비트)
+static int BitsPerCharacter(const ModemConfig* modem) {
+    return 1 + modem->byteSize + (modem->parity != NOPARITY ? 1 : 0) + (modem->stopBits == TWOSTOPBITS ? 2 : 1);
+}
+
+// --send <모뎀 id | all> [파일 | -] [--binary]: 메시지를 읽는 대로 보내고 걸린 시간과 goodput 을 출력한다
+int RunBatchSend(int argc, TCHAR* argv[]) {
+    if (argc < 1) {
+        _ftprintf(stderr, TEXT("Usage: UHSDM --send <modem id | all> [file | -, default stdin] [--binary]\n"));
+        return 1;
+    }
+    const TCHAR* path = NULL;
+    int format = BATCH_FORMAT_HEX;
+    for (int i = 1; i < argc; i++) {
+        if (_tcscmp(argv[i], TEXT("--binary")) == 0) {
+            format = BATCH_FORMAT_BINARY;
+        }
+        else {
+            path = argv[i];
+        }
+    }
+    signal(SIGINT, SignalHandler);
+    CrcInit();
+    CreateDefaultSettingsIfNotExists();
+    LoadModemRegistry();
+
+    bool all = _tcsicmp(argv[0], TEXT("all")) == 0;
+    ModemConfig* selected = all ? NULL : FindModem(argv[0]);
+    if (!all && selected == NULL) {
+        _ftprintf(stderr, TEXT("Unknown modem: %s\n"), argv[0]);
+        return 1;
+    }
+    ModemConfig* targets[MAX_MODEMS];
+    int count = 0;
+    for (int i = 0; i < modemRegistry.count; i++) {
+        ModemConfig* modem = &modemRegistry.modems[i];
+        if ((all || modem == selected) && OpenSerialPort(modem)) {
+            targets[count++] = modem;
+        }
+    }
+    FILE* input = stdin;
+    if (path != NULL && _tcscmp(path, TEXT("-")) != 0) {
+        input = _tfopen(path, TEXT("rb"));
+    }
+#ifdef _WIN32
+    else {
+        _setmode(_fileno(stdin), _O_BINARY);
+    }
+#endif
+    bool ready = count > 0 && input != NULL && TransmitterStart(NULL);
+    if (count == 0) {
+        _ftprintf(stderr, TEXT("No modem to send to.\n"));
+    }
+    else if (input == NULL) {
+        _ftprintf(stderr, TEXT("Failed to open file: %s\n"), path);
+    }
+
+    BatchReport report;
+    if (ready && BatchSend(input, format, targets, count, &keepRunning, &report)) {
+        double seconds = report.elapsedNs / 1e9;
+        int64_t payload = report.messages > 0 ? report.bytes * report.sent / report.messages : 0;
+        _tprintf(TEXT("Sent %lld of %lld messages (%lld bytes each way) to %d modem(s) in %.3f s, goodput %.1f KB/s%s\n"),
+            (long long)report.sent, (long long)report.messages * count, (long long)report.bytes, count, seconds,
+            seconds > 0.0 ? payload / seconds / 1024.0 : 0.0, report.cancelled ? TEXT(" (cancelled)") : TEXT(""));
+        if (report.failed > 0 || report.invalid > 0 || report.truncated) {
+            _tprintf(TEXT("%lld failed, %lld invalid %s%s\n"), (long long)report.failed, (long long)report.invalid,
+                format == BATCH_FORMAT_BINARY ? TEXT("records") : TEXT("lines"), report.truncated ? TEXT(", input ends inside a record") : TEXT(""));
+        }
+        for (int i = 0; i < count; i++) {
+            const ModemConfig* modem = targets[i];
+            double lineBytesPerSecond = (double)modem->baudRate / BitsPerCharacter(modem);
+            _tprintf(TEXT("[%d] %s: %lld bytes on the wire, %.1f KB/s, line busy %.1f%% at %d baud\n"), ModemIndex(modem), modem->name,
+                (long long)report.wireBytes[i], seconds > 0.0 ? report.wireBytes[i] / seconds / 1024.0 : 0.0,
+                seconds > 0.0 ? 100.0 * report.wireBytes[i] / seconds / lineBytesPerSecond : 0.0, modem->baudRate);
+        }
+    }
+    TransmitterStop();
+    if (input != NULL && input != stdin) {
+        fclose(input);
+    }
+    for (int i = 0; i < modemRegistry.count; i++) {
+        CloseSerialPort(&modemRegistry.modems[i]);
+        RingFree(&modemRegistry.modems[i].rxRing);
+        FrameParserFree(&modemRegistry.modems[i].rxFrame);
+    }
+    EmulatorStop();
+    return ready ? 0 : 1;
+}
@@ -0,0 +1,704 @@
+﻿#include "platform.h"
+#include "arq.h"
+#include "fec.h"
+#include "pool.h"
+
+// 조각 헤더: id(2) | kind(1) | FEC 블록 크기 K(1, 0 이면 FEC 없음) | 조각 크기(2) | 조각 번호(4) | 전체 길이(4)
+// 패리티 조각의 조각 번호는 (블록 번호 << 8) | 패리티 행
+#define ARQ_DATA_HEADER 14
+// ACK: id(2) | 예약(2) | 누적 번호(4) | 비트맵(8, bit i = 누적 번호 + 1 + i)
+#define ARQ_ACK_SIZE 16
+
+#define ARQ_RX_IDLE_MS 60000      // 이 시간 동안 조각이 오지 않으면 수신 중인 전송을 버림
+#define ARQ_COMPLETED_HISTORY 8   // 끝난 전송의 늦은 조각에 다시 ACK 하기 위한 기록
+#define ARQ_RETRY_DELAY_MS 10     // 송신 큐가 가득 찼을 때 다시 시도하는 간격
+
+#define SLOT_IDLE 0   // 보내야 함
+#define SLOT_QUEUED 1 // 송신 큐에 있음 (타이머 정지)
+#define SLOT_SENT 2   // 쓰기 완료, ACK 대기
+
+typedef struct {
+    uint32_t index;   // 이 슬롯을 쓰는 조각 번호
+    BYTE state;
+    BYTE retries;
+    uint32_t txId;    // 송신 큐 메시지 id
+    uint64_t sentNs;
+} ArqSlot;
+
+typedef struct ArqSender {
+    struct ArqSender* next;
+    ModemConfig* modem;
+    uint16_t id;
+    BYTE kind;
+    bool failed;
+    BYTE* data;
+    DWORD length;
+    uint32_t count;
+    uint32_t base;     // 처음으로 확인되지 않은 조각
+    BYTE* acked;       // 조각별 확인 여부
+    ArqSlot slots[ARQ_MAX_WINDOW]; // 조각 번호 % ARQ_MAX_WINDOW
+    int fecData;       // 블록당 데이터 조각 수 K (0 이면 FEC 없음)
+    int fecParity;     // 블록당 패리티 조각 수
+    BYTE* parity;      // 블록마다 fecParity 개의 패리티 조각
+    BYTE* paritySent;  // 블록별 패리티 전송 여부
+} ArqSender;
+
+typedef struct ArqReceiver {
+    struct ArqReceiver* next;
+    ModemConfig* modem;
+    uint16_t id;
+    BYTE kind;
+    BYTE* data;
+    DWORD length;
+    DWORD fragmentSize;
+    uint32_t count;
+    BYTE* received;
+    uint32_t receivedCount;
+    uint32_t cumulative; // 0 .. cumulative-1 은 모두 수신
+    uint64_t lastNs;
+    int fecData;         // 블록당 데이터 조각 수 (0 이면 FEC 없음)
+    uint32_t blocks;
+    BYTE* blockReceived; // 블록별 받은 데이터 조각 수
+    BYTE* blockParity;   // 블록별 받은 패리티 조각 수
+    BYTE** parity;       // [블록 * FEC_MAX_SHARDS + 행], 복구 전까지만 보관
+} ArqReceiver;
+
+typedef struct {
+    uint16_t completed[ARQ_COMPLETED_HISTORY];
+    int completedNext;
+    ArqStats stats;
+} ArqLink;
+
+static struct {
+    ArqDeliverProc deliver;
+    ArqDoneProc done;
+    PlatformMutex lock;
+    PlatformEvent wake;
+    PlatformThread thread;
+    volatile int32_t running;
+    ArqSender* senders;
+    ArqReceiver* receivers;
+    ArqLink links[MAX_MODEMS];
+    uint16_t nextId;
+} arq;
+
+static void PutU16(BYTE* p, uint32_t value) {
+    p[0] = (BYTE)value;
+    p[1] = (BYTE)(value >> 8);
+}
+
+static void PutU32(BYTE* p, uint32_t value) {
+    PutU16(p, value);
+    PutU16(p + 2, value >> 16);
+}
+
+static uint32_t GetU16(const BYTE* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+static uint32_t GetU32(const BYTE* p) {
+    return GetU16(p) | GetU16(p + 2) << 16;
+}
+
+static uint64_t TimeoutNs(const ModemConfig* modem) {
+    return (uint64_t)modem->arqTimeoutMs * 1000000ULL;
+}
+
+static void FreeSender(ArqSender* sender) {
+    PoolRelease(sender->data);
+    free(sender->acked);
+    PoolRelease(sender->parity);
+    free(sender->paritySent);
+    free(sender);
+}
+
+static void FreeReceiver(ArqReceiver* receiver) {
+    if (receiver->parity != NULL) {
+        for (uint32_t i = 0; i < receiver->blocks * FEC_MAX_SHARDS; i++) {
+            free(receiver->parity[i]);
+        }
+    }
+    free(receiver->parity);
+    free(receiver->blockReceived);
+    free(receiver->blockParity);
+    free(receiver->data);
+    free(receiver->received);
+    free(receiver);
+}
+
+// 송신 스레드에서 호출: 조각이 실제로 쓰인 시점부터 재전송 타이머 시작
+static void OnFragmentWritten(ModemConfig* modem, uint32_t messageId, bool success) {
+    (void)success; // 쓰기 실패도 타이머 만료 후 재전송
+    PlatformMutexLock(&arq.lock);
+    for (ArqSender* sender = arq.senders; sender != NULL; sender = sender->next) {
+        if (sender->modem != modem) {
+            continue;
+        }
+        for (int i = 0; i < ARQ_MAX_WINDOW; i++) {
+            ArqSlot* slot = &sender->slots[i];
+            if (slot->state == SLOT_QUEUED && slot->txId == messageId) {
+                slot->state = SLOT_SENT;
+                slot->sentNs = PlatformNowNs();
+                break;
+            }
+        }
+    }
+    PlatformMutexUnlock(&arq.lock);
+    PlatformEventSet(&arq.wake);
+}
+
+// ACK 와 패리티는 완료를 따로 알릴 필요가 없음 (사용자 메시지 완료 통지에 섞이지 않도록)
+static void OnControlWritten(ModemConfig* modem, uint32_t messageId, bool success) {
+    (void)modem;
+    (void)messageId;
+    (void)success;
+}
+
+static void PutFragmentHeader(BYTE* buffer, const ArqSender* sender, uint32_t index) {
+    PutU16(buffer, sender->id);
+    buffer[2] = sender->kind;
+    buffer[3] = (BYTE)sender->fecData;
+    PutU16(buffer + 4, ARQ_FRAGMENT_SIZE);
+    PutU32(buffer + 6, index);
+    PutU32(buffer + 10, sender->length);
+}
+
+// 블록의 패리티 조각을 모두 보냄. 패리티는 재전송하지 않음 (잃으면 ARQ 가 데이터 조각을 다시 보냄)
+static void SendParity(ArqSender* sender, uint32_t block) {
+    BYTE header[ARQ_DATA_HEADER];
+    for (int row = 0; row < sender->fecParity; row++) {
+        PutFragmentHeader(header, sender, block << 8 | (uint32_t)row);
+        const BYTE* parity = sender->parity + ((size_t)block * sender->fecParity + row) * ARQ_FRAGMENT_SIZE;
+        if (TransmitEnqueueGather(sender->modem, TX_CLASS_BULK, FRAME_TYPE_ARQ_PARITY, header, sizeof(header), sender->parity, parity,
+                ARQ_FRAGMENT_SIZE, OnControlWritten) != 0) {
+            arq.links[ModemIndex(sender->modem)].stats.paritySent++;
+        }
+    }
+    sender->paritySent[block] = 1;
+}
+
+static bool SendFragment(ArqSender* sender, uint32_t index, ArqSlot* slot) {
+    BYTE header[ARQ_DATA_HEADER];
+    DWORD offset = index * ARQ_FRAGMENT_SIZE;
+    DWORD size = sender->length - offset < ARQ_FRAGMENT_SIZE ? sender->length - offset : ARQ_FRAGMENT_SIZE;
+    PutFragmentHeader(header, sender, index);
+
+    // 조각 본문은 sender->data 를 그대로 가리킴 (전송이 먼저 끝나 풀어도 송신 큐가 참조를 잡고 있음)
+    uint32_t txId = TransmitEnqueueGather(sender->modem, TX_CLASS_BULK, FRAME_TYPE_ARQ_DATA, header, sizeof(header), sender->data,
+        sender->data + offset, size, OnFragmentWritten);
+    if (txId == 0) {
+        return false;
+    }
+    slot->state = SLOT_QUEUED;
+    slot->txId = txId;
+    arq.links[ModemIndex(sender->modem)].stats.fragmentsSent++;
+
+    // 블록의 마지막 데이터 조각을 처음 보낼 때 그 블록의 패리티를 이어서 보냄
+    if (sender->fecData > 0 && slot->retries == 0) {
+        uint32_t block = index / (uint32_t)sender->fecData;
+        uint32_t last = (block + 1) * (uint32_t)sender->fecData;
+        if ((index + 1 == last || index + 1 == sender->count) && !sender->paritySent[block]) {
+            SendParity(sender, block);
+        }
+    }
+    return true;
+}
+
+// 창 안의 조각을 보내거나 재전송한다. 다음에 깨어나야 할 시각을 반환 (없으면 UINT64_MAX)
+static uint64_t ServiceSender(ArqSender* sender, uint64_t now) {
+    while (sender->base < sender->count && sender->acked[sender->base]) {
+        sender->base++;
+    }
+    if (sender->base == sender->count) {
+        return UINT64_MAX;
+    }
+
+    ArqLink* link = &arq.links[ModemIndex(sender->modem)];
+    uint64_t timeout = TimeoutNs(sender->modem);
+    uint64_t deadline = UINT64_MAX;
+    uint32_t window = (uint32_t)sender->modem->arqWindow;
+    uint32_t end = sender->count - sender->base < window ? sender->count : sender->base + window;
+    for (uint32_t i = sender->base; i < end; i++) {
+        if (sender->acked[i]) {
+            continue;
+        }
+        ArqSlot* slot = &sender->slots[i % ARQ_MAX_WINDOW];
+        if (slot->index != i) {
+            // 창에 새로 들어온 조각
+            memset(slot, 0, sizeof(*slot));
+            slot->index = i;
+        }
+        if (slot->state == SLOT_SENT && now - slot->sentNs >= timeout) {
+            if (slot->retries >= ARQ_MAX_RETRIES) {
+                sender->failed = true;
+                return UINT64_MAX;
+            }
+            slot->retries++;
+            slot->state = SLOT_IDLE;
+            link->stats.retransmissions++;
+        }
+        if (slot->state == SLOT_IDLE && !SendFragment(sender, i, slot)) {
+            uint64_t retry = now + ARQ_RETRY_DELAY_MS * 1000000ULL;
+            deadline = retry < deadline ? retry : deadline;
+        }
+        if (slot->state == SLOT_SENT && slot->sentNs + timeout < deadline) {
+            deadline = slot->sentNs + timeout;
+        }
+    }
+    return deadline;
+}
+
+static DWORD WINAPI ArqThread(LPVOID param) {
+    (void)param;
+    while (AtomicLoadAcquire32(&arq.running)) {
+        ArqSender* finished = NULL;
+        uint64_t deadline = UINT64_MAX;
+
+        PlatformMutexLock(&arq.lock);
+        uint64_t now = PlatformNowNs();
+        ArqSender** link = &arq.senders;
+        while (*link != NULL) {
+            ArqSender* sender = *link;
+            uint64_t next = ServiceSender(sender, now);
+            if (sender->failed || sender->base == sender->count) {
+                ArqStats* stats = &arq.links[ModemIndex(sender->modem)].stats;
+                if (sender->failed) {
+                    stats->transfersFailed++;
+                }
+                else {
+                    stats->transfersSent++;
+                }
+                *link = sender->next;
+                sender->next = finished;
+                finished = sender;
+                continue;
+            }
+            deadline = next < deadline ? next : deadline;
+            link = &sender->next;
+        }
+
+        // 송신 측이 포기한 수신 전송 정리
+        ArqReceiver** receiverLink = &arq.receivers;
+        while (*receiverLink != NULL) {
+            ArqReceiver* receiver = *receiverLink;
+            uint64_t expire = receiver->lastNs + ARQ_RX_IDLE_MS * 1000000ULL;
+            if (now >= expire) {
+                *receiverLink = receiver->next;
+                FreeReceiver(receiver);
+                continue;
+            }
+            deadline = expire < deadline ? expire : deadline;
+            receiverLink = &receiver->next;
+        }
+        PlatformMutexUnlock(&arq.lock);
+
+        while (finished != NULL) {
+            ArqSender* next = finished->next;
+            if (arq.done != NULL) {
+                arq.done(finished->modem, finished->id, !finished->failed);
+            }
+            FreeSender(finished);
+            finished = next;
+        }
+
+        DWORD waitMs = INFINITE;
+        if (deadline != UINT64_MAX) {
+            now = PlatformNowNs();
+            waitMs = deadline > now ? (DWORD)((deadline - now + 999999) / 1000000) : 0;
+        }
+        PlatformEventWait(&arq.wake, waitMs);
+    }
+    return 0;
+}
+
+bool ArqStart(ArqDeliverProc deliver, ArqDoneProc done) {
+    memset(&arq, 0, sizeof(arq));
+    arq.deliver = deliver;
+    arq.done = done;
+    // 재시작한 상대가 끝난 전송 기록과 같은 id 를 받지 않도록 임의의 값에서 시작
+    arq.nextId = (uint16_t)(PlatformNowNs() >> 10);
+    PlatformMutexInit(&arq.lock);
+    if (!PlatformEventInit(&arq.wake)) {
+        return false;
+    }
+    AtomicStoreRelease32(&arq.running, 1);
+    if (!PlatformThreadStart(&arq.thread, ArqThread, NULL)) {
+        AtomicStoreRelease32(&arq.running, 0);
+        PlatformEventDestroy(&arq.wake);
+        return false;
+    }
+    return true;
+}
+
+void ArqStop(void) {
+    if (!AtomicLoadAcquire32(&arq.running)) {
+        return;
+    }
+    AtomicStoreRelease32(&arq.running, 0);
+    PlatformEventSet(&arq.wake);
+    PlatformThreadJoin(arq.thread);
+
+    while (arq.senders != NULL) {
+        ArqSender* sender = arq.senders;
+        arq.senders = sender->next;
+        if (arq.done != NULL) {
+            arq.done(sender->modem, sender->id, false);
+        }
+        FreeSender(sender);
+    }
+    while (arq.receivers != NULL) {
+        ArqReceiver* receiver = arq.receivers;
+        arq.receivers = receiver->next;
+        FreeReceiver(receiver);
+    }
+    PlatformEventDestroy(&arq.wake);
+    PlatformMutexDestroy(&arq.lock);
+}
+
+uint16_t ArqSend(ModemConfig* modem, BYTE kind, const BYTE* data, DWORD length) {
+    if (!AtomicLoadAcquire32(&arq.running) || modem->framing != FRAMING_COBS || length == 0 || length > ARQ_MAX_TRANSFER) {
+        return 0;
+    }
+    ArqSender* sender = (ArqSender*)calloc(1, sizeof(ArqSender));
+    if (sender == NULL) {
+        return 0;
+    }
+    sender->modem = modem;
+    sender->kind = kind;
+    sender->length = length;
+    sender->count = (length + ARQ_FRAGMENT_SIZE - 1) / ARQ_FRAGMENT_SIZE;
+    // 마지막 조각은 FEC 부호화를 위해 0 으로 채운 크기로 잡음. 조각을 송신 큐에 복사하지 않고 넘기도록 풀 블록에 담음
+    DWORD padded = sender->count * ARQ_FRAGMENT_SIZE;
+    sender->data = PoolAlloc(padded);
+    sender->acked = (BYTE*)calloc(sender->count, 1);
+    if (sender->data == NULL || sender->acked == NULL) {
+        FreeSender(sender);
+        return 0;
+    }
+    memcpy(sender->data, data, length);
+    memset(sender->data + length, 0, padded - length);
+
+    if (modem->fecData > 0 && modem->fecParity > 0) {
+        int dataCount = modem->fecData;
+        int parityCount = modem->fecParity;
+        uint32_t blocks = (sender->count + dataCount - 1) / dataCount;
+        sender->parity = PoolAlloc(blocks * (DWORD)parityCount * ARQ_FRAGMENT_SIZE);
+        sender->paritySent = (BYTE*)calloc(blocks, 1);
+        if (sender->parity == NULL || sender->paritySent == NULL) {
+            FreeSender(sender);
+            return 0;
+        }
+        for (uint32_t block = 0; block < blocks; block++) {
+            const BYTE* shards[FEC_MAX_SHARDS];
+            BYTE* parity[FEC_MAX_SHARDS];
+            uint32_t first = block * dataCount;
+            int blockData = sender->count - first < (uint32_t)dataCount ? (int)(sender->count - first) : dataCount;
+            for (int i = 0; i < blockData; i++) {
+                shards[i] = sender->data + (size_t)(first + i) * ARQ_FRAGMENT_SIZE;
+            }
+            for (int row = 0; row < parityCount; row++) {
+                parity[row] = sender->parity + ((size_t)block * parityCount + row) * ARQ_FRAGMENT_SIZE;
+            }
+            FecEncode(blockData, parityCount, shards, parity, ARQ_FRAGMENT_SIZE);
+        }
+        sender->fecData = dataCount;
+        sender->fecParity = parityCount;
+    }
+
+    PlatformMutexLock(&arq.lock);
+    if (++arq.nextId == 0) {
+        arq.nextId = 1; // 0 은 실패를 뜻함
+    }
+    sender->id = arq.nextId;
+    // 먼저 시작한 전송이 먼저 창을 채우도록 목록 끝에 추가
+    ArqSender** link = &arq.senders;
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+    *link = sender;
+    uint16_t id = sender->id;
+    PlatformMutexUnlock(&arq.lock);
+
+    PlatformEventSet(&arq.wake);
+    return id;
+}
+
+static void SendAck(ModemConfig* modem, uint16_t id, uint32_t cumulative, const BYTE* received, uint32_t count) {
+    BYTE ack[ARQ_ACK_SIZE];
+    PutU16(ack, id);
+    PutU16(ack + 2, 0);
+    PutU32(ack + 4, cumulative);
+    uint32_t low = 0;
+    uint32_t high = 0;
+    for (uint32_t bit = 0; bit < 64 && received != NULL && cumulative + 1 + bit < count; bit++) {
+        if (received[cumulative + 1 + bit]) {
+            if (bit < 32) {
+                low |= 1u << bit;
+            }
+            else {
+                high |= 1u << (bit - 32);
+            }
+        }
+    }
+    PutU32(ack + 8, low);
+    PutU32(ack + 12, high);
+    TransmitEnqueueNotify(modem, FRAME_TYPE_ARQ_ACK, ack, sizeof(ack), OnControlWritten);
+}
+
+static void HandleAck(ModemConfig* modem, const BYTE* payload, DWORD length) {
+    if (length != ARQ_ACK_SIZE) {
+        return;
+    }
+    uint16_t id = (uint16_t)GetU16(payload);
+    uint32_t cumulative = GetU32(payload + 4);
+    uint64_t bitmap = (uint64_t)GetU32(payload + 8) | (uint64_t)GetU32(payload + 12) << 32;
+
+    PlatformMutexLock(&arq.lock);
+    for (ArqSender* sender = arq.senders; sender != NULL; sender = sender->next) {
+        if (sender->modem != modem || sender->id != id) {
+            continue;
+        }
+        for (uint32_t i = sender->base; i < cumulative && i < sender->count; i++) {
+            sender->acked[i] = 1;
+        }
+        for (uint32_t bit = 0; bit < 64; bit++) {
+            if ((bitmap >> bit) & 1) {
+                uint32_t index = cumulative + 1 + bit;
+                if (index < sender->count) {
+                    sender->acked[index] = 1;
+                }
+            }
+        }
+        break;
+    }
+    PlatformMutexUnlock(&arq.lock);
+    PlatformEventSet(&arq.wake);
+}
+
+// 수신 측 조각 번호가 새로 채워졌을 때 누적 번호와 수신 수를 갱신
+static void MarkReceived(ArqReceiver* receiver, uint32_t index) {
+    receiver->received[index] = 1;
+    receiver->receivedCount++;
+    if (receiver->fecData > 0) {
+        receiver->blockReceived[index / receiver->fecData]++;
+    }
+    while (receiver->cumulative < receiver->count && receiver->received[receiver->cumulative]) {
+        receiver->cumulative++;
+    }
+}
+
+// 블록에서 받은 조각(데이터 + 패리티)이 K 개 이상이면 빠진 데이터 조각을 복구
+static void TryRecoverBlock(ArqReceiver* receiver, uint32_t block, ArqLink* link) {
+    uint32_t first = block * receiver->fecData;
+    int blockData = receiver->count - first < (uint32_t)receiver->fecData ? (int)(receiver->count - first) : receiver->fecData;
+    int have = receiver->blockReceived[block];
+    if (have >= blockData || have + receiver->blockParity[block] < blockData) {
+        return;
+    }
+
+    int indexes[FEC_MAX_SHARDS];
+    const BYTE* shards[FEC_MAX_SHARDS];
+    int missing[FEC_MAX_SHARDS];
+    BYTE* output[FEC_MAX_SHARDS];
+    int shardCount = 0;
+    int missingCount = 0;
+    for (int i = 0; i < blockData; i++) {
+        BYTE* fragment = receiver->data + (size_t)(first + i) * receiver->fragmentSize;
+        if (receiver->received[first + i]) {
+            indexes[shardCount] = i;
+            shards[shardCount++] = fragment;
+        }
+        else {
+            missing[missingCount] = i;
+            output[missingCount++] = fragment;
+        }
+    }
+    BYTE** parity = receiver->parity + (size_t)block * FEC_MAX_SHARDS;
+    for (int row = 0; row < FEC_MAX_SHARDS && shardCount < blockData; row++) {
+        if (parity[row] != NULL) {
+            indexes[shardCount] = blockData + row;
+            shards[shardCount++] = parity[row];
+        }
+    }
+    if (!FecDecode(blockData, indexes, shards, missingCount, missing, output, receiver->fragmentSize)) {
+        return;
+    }
+    for (int i = 0; i < missingCount; i++) {
+        MarkReceived(receiver, first + missing[i]);
+    }
+    link->stats.fecRecovered += missingCount;
+    for (int row = 0; row < FEC_MAX_SHARDS; row++) {
+        free(parity[row]);
+        parity[row] = NULL;
+    }
+}
+
+static ArqReceiver* CreateReceiver(ModemConfig* modem, uint16_t id, BYTE kind, DWORD total, DWORD fragmentSize, int fecData) {
+    ArqReceiver* receiver = (ArqReceiver*)calloc(1, sizeof(ArqReceiver));
+    if (receiver == NULL) {
+        return NULL;
+    }
+    receiver->modem = modem;
+    receiver->id = id;
+    receiver->kind = kind;
+    receiver->length = total;
+    receiver->fragmentSize = fragmentSize;
+    receiver->count = (total + fragmentSize - 1) / fragmentSize;
+    receiver->fecData = fecData;
+    // 마지막 조각도 조각 크기만큼 잡아 둠 (FEC 복구 시 0 으로 채운 상태여야 함)
+    receiver->data = (BYTE*)calloc(receiver->count, fragmentSize);
+    receiver->received = (BYTE*)calloc(receiver->count, 1);
+    bool allocated = receiver->data != NULL && receiver->received != NULL;
+    if (allocated && fecData > 0) {
+        receiver->blocks = (receiver->count + fecData - 1) / fecData;
+        receiver->blockReceived = (BYTE*)calloc(receiver->blocks, 1);
+        receiver->blockParity = (BYTE*)calloc(receiver->blocks, 1);
+        receiver->parity = (BYTE**)calloc((size_t)receiver->blocks * FEC_MAX_SHARDS, sizeof(BYTE*));
+        allocated = receiver->blockReceived != NULL && receiver->blockParity != NULL && receiver->parity != NULL;
+    }
+    if (!allocated) {
+        FreeReceiver(receiver);
+        return NULL;
+    }
+    return receiver;
+}
+
+static void HandleData(ModemConfig* modem, const BYTE* payload, DWORD length, bool isParity) {
+    if (length <= ARQ_DATA_HEADER) {
+        return;
+    }
+    uint16_t id = (uint16_t)GetU16(payload);
+    BYTE kind = payload[2];
+    int fecData = payload[3];
+    DWORD fragmentSize = GetU16(payload + 4);
+    uint32_t index = GetU32(payload + 6);
+    DWORD total = GetU32(payload + 10);
+    if (fragmentSize == 0 || total == 0 || total > ARQ_MAX_TRANSFER || fecData >= FEC_MAX_SHARDS) {
+        return;
+    }
+    uint32_t count = (total + fragmentSize - 1) / fragmentSize;
+    DWORD size = length - ARQ_DATA_HEADER;
+    uint32_t block = 0;
+    int row = 0;
+    if (isParity) {
+        // 패리티 조각은 항상 조각 크기 그대로
+        block = index >> 8;
+        row = (int)(index & 0xFF);
+        if (fecData == 0 || block >= (count + fecData - 1) / fecData || row >= FEC_MAX_SHARDS - fecData || size != fragmentSize) {
+            return;
+        }
+    }
+    else {
+        DWORD offset = index * fragmentSize;
+        if (index >= count || size != (total - offset < fragmentSize ? total - offset : fragmentSize)) {
+            return;
+        }
+    }
+
+    ArqLink* link = &arq.links[ModemIndex(modem)];
+    ArqReceiver* complete = NULL;
+    PlatformMutexLock(&arq.lock);
+    for (int i = 0; i < ARQ_COMPLETED_HISTORY; i++) {
+        if (link->completed[i] == id) {
+            // 이미 전달한 전송: 마지막 ACK 가 유실된 경우이므로 다시 확인만 해 줌
+            if (!isParity) {
+                link->stats.duplicates++;
+            }
+            PlatformMutexUnlock(&arq.lock);
+            if (!isParity) {
+                SendAck(modem, id, count, NULL, count);
+            }
+            return;
+        }
+    }
+
+    ArqReceiver** receiverLink = &arq.receivers;
+    while (*receiverLink != NULL && ((*receiverLink)->modem != modem || (*receiverLink)->id != id)) {
+        receiverLink = &(*receiverLink)->next;
+    }
+    ArqReceiver* receiver = *receiverLink;
+    if (receiver == NULL) {
+        receiver = CreateReceiver(modem, id, kind, total, fragmentSize, fecData);
+        if (receiver == NULL) {
+            PlatformMutexUnlock(&arq.lock);
+            return;
+        }
+        receiver->next = arq.receivers;
+        arq.receivers = receiver;
+        receiverLink = &arq.receivers;
+    }
+    else if (receiver->length != total || receiver->fragmentSize != fragmentSize || receiver->fecData != fecData) {
+        PlatformMutexUnlock(&arq.lock);
+        return;
+    }
+    receiver->lastNs = PlatformNowNs();
+
+    if (isParity) {
+        // 블록이 이미 다 모였으면 필요 없음
+        BYTE** slot = &receiver->parity[(size_t)block * FEC_MAX_SHARDS + row];
+        uint32_t first = block * fecData;
+        int blockData = count - first < (uint32_t)fecData ? (int)(count - first) : fecData;
+        if (receiver->blockReceived[block] < blockData && *slot == NULL && (*slot = (BYTE*)malloc(fragmentSize)) != NULL) {
+            memcpy(*slot, payload + ARQ_DATA_HEADER, fragmentSize);
+            receiver->blockParity[block]++;
+            uint32_t before = receiver->receivedCount;
+            TryRecoverBlock(receiver, block, link);
+            if (receiver->receivedCount != before) {
+                SendAck(modem, id, receiver->cumulative, receiver->received, count);
+            }
+        }
+    }
+    else if (receiver->received[index]) {
+        link->stats.duplicates++;
+        SendAck(modem, id, receiver->cumulative, receiver->received, count);
+    }
+    else {
+        memcpy(receiver->data + (size_t)index * fragmentSize, payload + ARQ_DATA_HEADER, size);
+        MarkReceived(receiver, index);
+        if (fecData > 0) {
+            TryRecoverBlock(receiver, index / fecData, link);
+        }
+        SendAck(modem, id, receiver->cumulative, receiver->received, count);
+    }
+
+    if (receiver->receivedCount == count) {
+        *receiverLink = receiver->next;
+        link->completed[link->completedNext] = id;
+        link->completedNext = (link->completedNext + 1) % ARQ_COMPLETED_HISTORY;
+        link->stats.transfersReceived++;
+        complete = receiver;
+    }
+    PlatformMutexUnlock(&arq.lock);
+
+    if (complete != NULL) {
+        if (arq.deliver != NULL) {
+            arq.deliver(modem, complete->kind, complete->data, complete->length);
+        }
+        FreeReceiver(complete);
+    }
+}
+
+bool ArqHandleFrame(ModemConfig* modem, const FrameHeader* header, const BYTE* payload, DWORD length) {
+    if (header == NULL || !AtomicLoadAcquire32(&arq.running)) {
+        return false;
+    }
+    if (header->type == FRAME_TYPE_ARQ_DATA || header->type == FRAME_TYPE_ARQ_PARITY) {
+        HandleData(modem, payload, length, header->type == FRAME_TYPE_ARQ_PARITY);
+        return true;
+    }
+    if (header->type == FRAME_TYPE_ARQ_ACK) {
+        HandleAck(modem, payload, length);
+        return true;
+    }
+    return false;
+}
+
+void ArqQueryStats(const ModemConfig* modem, ArqStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!AtomicLoadAcquire32(&arq.running)) {
+        return;
+    }
+    PlatformMutexLock(&arq.lock);
+    *stats = arq.links[ModemIndex(modem)].stats;
+    PlatformMutexUnlock(&arq.lock);
+}
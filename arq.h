@@ -0,0 +1,55 @@
+﻿#pragma once
+#include "platform.h"
+#include "modem.h"
+
+// 큰 데이터 전송용 선택적 재전송(selective repeat) ARQ
+// 데이터를 조각으로 나누어 FRAME_TYPE_ARQ_DATA 프레임으로 보내고, 수신 측은 순서와 상관없이
+// 조각을 모아 모두 도착하면 한 번에 전달한다.
+// 송신 측은 창(ArqWindow) 크기만큼의 조각을 ACK 를 기다리지 않고 연속으로 보내며,
+// 조각마다 타이머(ArqTimeoutMs)가 만료되면 그 조각만 다시 보낸다.
+// 타이머는 조각이 송신 큐를 빠져나가 실제로 쓰인 시점부터 잰다.
+// ACK 는 누적 번호(처음으로 빠진 조각)와 그 뒤 64개 조각의 수신 비트맵을 담는다.
+// 프레임 모드(Framing=1) 모뎀에서만 사용할 수 있다.
+// FecRate=K/N 이 설정된 모뎀은 데이터 조각 K 개마다 패리티 조각 N-K 개를 함께 보내므로,
+// 한 블록에서 N-K 개까지의 조각 손실은 재전송 없이 수신 측에서 복구된다.
+
+#define ARQ_FRAGMENT_SIZE 1024
+#define ARQ_MAX_WINDOW 64
+#define ARQ_DEFAULT_WINDOW 16
+#define ARQ_DEFAULT_TIMEOUT_MS 2000
+#define ARQ_MIN_TIMEOUT_MS 50
+#define ARQ_MAX_TIMEOUT_MS 60000
+#define ARQ_MAX_RETRIES 10                 // 한 조각의 재전송 한도. 넘으면 전송 실패
+#define ARQ_MAX_TRANSFER (16 * 1024 * 1024)
+
+// 전송 종류
+#define ARQ_KIND_MESSAGE 0
+#define ARQ_KIND_FILE 1 // 이름 길이(1) | 파일 이름 | 파일 내용
+
+// 수신 처리 스레드에서 호출: 전송 하나가 모두 도착함
+typedef void (*ArqDeliverProc)(ModemConfig* modem, BYTE kind, const BYTE* data, DWORD length);
+// ARQ 스레드에서 호출: 송신한 전송이 모두 확인되었거나(success) 포기됨
+typedef void (*ArqDoneProc)(ModemConfig* modem, uint16_t transferId, bool success);
+
+typedef struct {
+    int32_t transfersSent;
+    int32_t transfersFailed;
+    int32_t transfersReceived;
+    int32_t fragmentsSent;
+    int32_t retransmissions;
+    int32_t duplicates;     // 이미 받은 조각을 다시 받음 (ACK 유실)
+    int32_t paritySent;     // 보낸 FEC 패리티 조각
+    int32_t fecRecovered;   // 재전송 없이 FEC 로 복구한 조각
+} ArqStats;
+
+bool ArqStart(ArqDeliverProc deliver, ArqDoneProc done);
+// 진행 중인 송신은 실패로 통지하고 종료
+void ArqStop(void);
+
+// 전송을 시작하고 전송 id 를 반환한다 (실패하면 0). data 는 복사된다
+uint16_t ArqSend(ModemConfig* modem, BYTE kind, const BYTE* data, DWORD length);
+
+// 수신 처리 스레드에서 프레임마다 호출. ARQ 프레임이면 처리하고 true 를 반환
+bool ArqHandleFrame(ModemConfig* modem, const FrameHeader* header, const BYTE* payload, DWORD length);
+
+void ArqQueryStats(const ModemConfig* modem, ArqStats* stats);
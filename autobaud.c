@@ -0,0 +1,215 @@
+﻿#include "platform.h"
+#include "autobaud.h"
+#include "serial.h"
+#include "reactor.h"
+#include "compress.h"
+
+typedef struct {
+    volatile int32_t state;    // AUTOBAUD_*
+    int candidate;             // 다음에 시도할 rates 의 index (-1 = 설정된 속도)
+    int rate;                  // 지금 응답을 기다리는 속도 (0 = 아직 바꾸지 않음)
+    int configuredRate;        // 찾지 못하면 돌아갈 속도
+    int32_t frames;            // 이 속도로 바꿨을 때 파서가 받은 프레임 수
+    uint64_t startNs;
+    uint64_t deadlineNs;       // 이 속도에서 응답을 기다리는 끝
+} AutoBaudSearch;
+
+static struct {
+    AutoBaudSearch searches[MAX_MODEMS];
+    PlatformMutex lock;        // searches (탐색 스레드 <-> 요청하는 스레드)
+    PlatformEvent wake;
+    PlatformThread thread;
+    volatile int32_t running;
+} autobaud;
+
+// 설정된 속도 다음에 시도하는 속도 (빠른 것부터)
+static const int rates[] = { 4000000, 3000000, 2000000, 1500000, 1000000, 921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600 };
+#define AUTOBAUD_RATES ((int)(sizeof(rates) / sizeof(rates[0])))
+
+static DWORD WaitMs(const ModemConfig* modem) {
+    return modem->autoBaudMs > 0 ? (DWORD)modem->autoBaudMs : AUTOBAUD_DEFAULT_WAIT_MS;
+}
+
+// 수신 처리 스레드가 링에 있는 바이트를 다 해석할 때까지 잠깐 기다림
+// (앞 속도에서 받은 프레임을 다음 속도의 응답으로 세거나, 늦게 해석된 응답을 놓치지 않도록)
+static void WaitParsed(ModemConfig* modem) {
+    for (int i = 0; i < AUTOBAUD_POLL_MS && RingUsed(&modem->rxRing) > 0; i++) {
+        PlatformSleepMs(1);
+    }
+}
+
+// 포트를 rate 로 바꾼다 (포트 잠금은 바꾸는 동안만). 포트가 닫혔으면 false
+static bool SwitchRate(ModemConfig* modem, int rate) {
+    TransmitterLockPort(modem);
+    bool switched = modem->hSerial != INVALID_HANDLE_VALUE &&
+        SerialReconfigure(modem, rate, modem->byteSize, modem->stopBits, modem->parity);
+    if (switched) {
+        SerialPurgeInput(modem); // 앞 속도에서 받은 깨진 바이트
+    }
+    TransmitterUnlockPort(modem);
+    if (switched) {
+        ReactorResize(modem);
+    }
+    return switched;
+}
+
+// rate 로 바꾸고 HELLO(응답 요청) 를 보낸 뒤 응답을 기다리기 시작한다 (lock 을 잡은 상태)
+static bool TryRate(ModemConfig* modem, AutoBaudSearch* search, int rate) {
+    // 앞의 구분자는 상대 파서가 다른 속도에서 받은 깨진 바이트를 끊고 이 프레임부터 다시 읽게 함
+    BYTE hello[64];
+    hello[0] = FRAME_DELIMITER;
+    DWORD helloSize = CompressEncodeHello(modem, hello + 1, sizeof(hello) - 1);
+    if (helloSize == 0 || !SwitchRate(modem, rate)) {
+        return false;
+    }
+    WaitParsed(modem);
+    search->rate = rate;
+    search->frames = AtomicLoadAcquire32(&modem->rxFrame.frames);
+    search->deadlineNs = PlatformNowNs() + WaitMs(modem) * 1000000ULL;
+    TransmitterLockPort(modem);
+    DWORD written = 0;
+    bool sent = modem->hSerial != INVALID_HANDLE_VALUE && SerialWrite(modem, hello, helloSize + 1, &written);
+    TransmitterUnlockPort(modem);
+    return sent;
+}
+
+static bool Answered(const ModemConfig* modem, const AutoBaudSearch* search) {
+    return search->rate > 0 && AtomicLoadAcquire32(&modem->rxFrame.frames) != search->frames;
+}
+
+// 탐색 하나를 진행한다: 응답이 왔으면 그 속도로 끝내고, 기다리는 시간이 지났으면 다음 속도로 (lock 을 잡은 상태)
+static void StepSearch(ModemConfig* modem, AutoBaudSearch* search) {
+    if (modem->hSerial == INVALID_HANDLE_VALUE) {
+        AtomicStoreRelease32(&search->state, AUTOBAUD_IDLE); // 다시 열리면 감시 스레드가 다시 요청함
+        return;
+    }
+    uint64_t now = PlatformNowNs();
+    if (search->rate > 0 && now < search->deadlineNs && !Answered(modem, search)) {
+        return;
+    }
+    if (search->rate > 0) {
+        WaitParsed(modem);
+    }
+    if (Answered(modem, search)) {
+        modem->baudRate = search->rate;
+        modem->linkRate = modem->linkRateSet ? modem->linkRate : search->rate; // 따로 지정하지 않았으면 따라감
+        AtomicStoreRelease32(&search->state, AUTOBAUD_FOUND);
+        _tprintf(TEXT("%s: peer answered at %d bps (BaudRate=auto, %.1f s).\n"), modem->name, search->rate,
+            (PlatformNowNs() - search->startNs) / 1e9);
+        return;
+    }
+    while (search->candidate < AUTOBAUD_RATES) {
+        int rate = search->candidate < 0 ? search->configuredRate : rates[search->candidate];
+        search->candidate++;
+        if (search->candidate > 0 && rate == search->configuredRate) {
+            continue;
+        }
+        if (now - search->startNs + WaitMs(modem) * 1000000ULL > AUTOBAUD_MAX_SEARCH_MS * 1000000ULL) {
+            break;
+        }
+        if (TryRate(modem, search, rate)) {
+            return;
+        }
+        if (modem->hSerial == INVALID_HANDLE_VALUE) {
+            AtomicStoreRelease32(&search->state, AUTOBAUD_IDLE);
+            return;
+        }
+    }
+    SwitchRate(modem, search->configuredRate);
+    AtomicStoreRelease32(&search->state, AUTOBAUD_FAILED);
+    _tprintf(TEXT("%s: no peer answered on %s at any rate (BaudRate=auto needs Framing=1 and a fixed BaudRate on the other end); using %d bps.\n"),
+        modem->name, modem->portName, search->configuredRate);
+}
+
+static DWORD WINAPI AutoBaudThread(LPVOID param) {
+    (void)param;
+    while (AtomicLoadAcquire32(&autobaud.running)) {
+        DWORD waitMs = INFINITE;
+        PlatformMutexLock(&autobaud.lock);
+        for (int i = 0; i < modemRegistry.count; i++) {
+            AutoBaudSearch* search = &autobaud.searches[i];
+            if (AtomicLoadAcquire32(&search->state) != AUTOBAUD_SEARCHING) {
+                continue;
+            }
+            StepSearch(&modemRegistry.modems[i], search);
+            if (AtomicLoadAcquire32(&search->state) == AUTOBAUD_SEARCHING) {
+                waitMs = AUTOBAUD_POLL_MS;
+            }
+        }
+        PlatformMutexUnlock(&autobaud.lock);
+        PlatformEventWait(&autobaud.wake, waitMs);
+    }
+    return 0;
+}
+
+bool AutoBaudStart(void) {
+    memset(autobaud.searches, 0, sizeof(autobaud.searches));
+    PlatformMutexInit(&autobaud.lock);
+    if (!PlatformEventInit(&autobaud.wake)) {
+        PlatformMutexDestroy(&autobaud.lock);
+        return false;
+    }
+    AtomicStoreRelease32(&autobaud.running, 1);
+    if (!PlatformThreadStart(&autobaud.thread, AutoBaudThread, NULL)) {
+        AtomicStoreRelease32(&autobaud.running, 0);
+        PlatformEventDestroy(&autobaud.wake);
+        PlatformMutexDestroy(&autobaud.lock);
+        return false;
+    }
+    for (int i = 0; i < modemRegistry.count; i++) {
+        ModemConfig* modem = &modemRegistry.modems[i];
+        if (modem->autoBaud && modem->hSerial != INVALID_HANDLE_VALUE) {
+            AutoBaudRequest(modem);
+        }
+    }
+    return true;
+}
+
+void AutoBaudStop(void) {
+    if (!AtomicLoadAcquire32(&autobaud.running)) {
+        return;
+    }
+    AtomicStoreRelease32(&autobaud.running, 0);
+    PlatformEventSet(&autobaud.wake);
+    PlatformThreadJoin(autobaud.thread);
+    PlatformEventDestroy(&autobaud.wake);
+    PlatformMutexDestroy(&autobaud.lock);
+}
+
+bool AutoBaudRequest(ModemConfig* modem) {
+    int index = ModemIndex(modem);
+    if (!AtomicLoadAcquire32(&autobaud.running) || index < 0 || modem->framing != FRAMING_COBS) {
+        return false;
+    }
+    PlatformMutexLock(&autobaud.lock);
+    AutoBaudSearch* search = &autobaud.searches[index];
+    search->candidate = -1;
+    search->rate = 0;
+    search->configuredRate = modem->baudRate;
+    search->startNs = PlatformNowNs();
+    AtomicStoreRelease32(&search->state, AUTOBAUD_SEARCHING);
+    PlatformMutexUnlock(&autobaud.lock);
+    PlatformEventSet(&autobaud.wake);
+    return true;
+}
+
+void AutoBaudCancel(ModemConfig* modem) {
+    int index = ModemIndex(modem);
+    if (!AtomicLoadAcquire32(&autobaud.running) || index < 0) {
+        return;
+    }
+    PlatformMutexLock(&autobaud.lock);
+    AutoBaudSearch* search = &autobaud.searches[index];
+    if (AtomicLoadAcquire32(&search->state) == AUTOBAUD_SEARCHING) {
+        if (search->rate > 0 && search->rate != search->configuredRate) {
+            SwitchRate(modem, search->configuredRate);
+        }
+        AtomicStoreRelease32(&search->state, AUTOBAUD_IDLE);
+    }
+    PlatformMutexUnlock(&autobaud.lock);
+}
+
+int AutoBaudState(const ModemConfig* modem) {
+    int index = ModemIndex(modem);
+    return index >= 0 ? AtomicLoadAcquire32(&autobaud.searches[index].state) : AUTOBAUD_IDLE;
+}
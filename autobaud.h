@@ -0,0 +1,37 @@
+﻿#pragma once
+#include "platform.h"
+#include "modem.h"
+
+// BaudRate=auto 속도 찾기
+// 드라이버(와 USB 어댑터)는 대개 모든 속도를 받아들이므로, 상대가 실제로 답하는 속도를 찾는다.
+// 포트는 설정된(마지막으로 찾은) 속도로 평소처럼 열고, 탐색 스레드가 열린 포트의 속도를 설정된 속도부터
+// 빠른 속도 순으로 바꿔 가며 HELLO(응답 요청) 를 보낸다. 응답은 평소의 수신 경로(리액터 -> 수신 처리 스레드)로
+// 받으므로, 그 속도에서 AutoBaudMs 안에 CRC 가 맞는 프레임이 하나라도 들어오면 그 속도를 쓴다.
+// 탐색 스레드 하나가 모든 포트를 함께 찾으므로 시작이나 다시 열기를 막지 않고, 포트 잠금(TransmitterLockPort)은
+// 속도를 바꾸는 동안만 잡는다. 응답을 기다리는 동안 나간 다른 프레임은 깨질 수 있다 (ARQ 와 스케줄러가 다시 보냄).
+// 한 포트의 탐색은 AUTOBAUD_MAX_SEARCH_MS 를 넘지 않고, 답한 속도가 없으면 설정된 속도로 돌아간다.
+// 응답을 기다리는 시간(AutoBaudMs)은 링크의 왕복 시간보다 길어야 한다 (음향 모뎀은 수 초).
+// 탐색하는 쪽은 자기 HELLO 에만 답을 기다리므로 양쪽 모두 auto 면 서로 찾지 못한다. 적어도 한쪽은 속도를 고정한다.
+// 프레임으로 답을 확인하므로 Framing=1 인 모뎀에서만 찾는다.
+
+#define AUTOBAUD_DEFAULT_WAIT_MS 500
+#define AUTOBAUD_MIN_WAIT_MS 100
+#define AUTOBAUD_MAX_WAIT_MS 30000
+#define AUTOBAUD_MAX_SEARCH_MS 60000 // 한 포트의 탐색 전체 시간 상한
+#define AUTOBAUD_POLL_MS 10          // 응답(프레임 수)을 확인하는 간격
+
+// AutoBaudState
+#define AUTOBAUD_IDLE 0
+#define AUTOBAUD_SEARCHING 1
+#define AUTOBAUD_FOUND 2
+#define AUTOBAUD_FAILED 3  // 답한 속도가 없어 설정된 속도로 돌아감
+
+// 탐색 스레드를 시작하고, 열린 포트 가운데 BaudRate=auto 인 모뎀을 모두 찾기 시작한다
+// (리액터, 수신 처리 스레드, 송신 스레드를 시작한 뒤)
+bool AutoBaudStart(void);
+void AutoBaudStop(void);
+// 열린 포트의 속도를 (다시) 찾기 시작한다. 탐색 스레드가 돌지 않거나 Framing=1 이 아니면 false
+bool AutoBaudRequest(ModemConfig* modem);
+// 진행 중인 탐색을 멈추고 포트를 설정된 속도로 되돌린다 (설정을 직접 바꾸기 전에)
+void AutoBaudCancel(ModemConfig* modem);
+int AutoBaudState(const ModemConfig* modem);
@@ -0,0 +1,201 @@
+﻿#include "platform.h"
+#include "batch.h"
+#include "frame.h"
+
+static struct {
+    volatile int32_t completed;  // 모뎀별로 끝난 메시지 (성공 + 실패)
+    volatile int32_t failed;
+    volatile int32_t waiting;    // 생산자가 progress 를 기다리는 중
+    PlatformEvent progress;
+    volatile int64_t lastDoneNs;
+} batch;
+
+// 송신 스레드에서 호출. 기다리는 생산자가 있을 때만 깨움 (메시지마다 시스템 호출하지 않도록)
+static void OnBatchDone(ModemConfig* modem, uint32_t messageId, bool success) {
+    (void)modem;
+    (void)messageId;
+    if (!success) {
+        AtomicIncrement32(&batch.failed);
+    }
+    AtomicStoreRelease64(&batch.lastDoneNs, (int64_t)PlatformNowNs());
+    AtomicIncrement32(&batch.completed);
+    if (AtomicLoadAcquire32(&batch.waiting)) {
+        PlatformEventSet(&batch.progress);
+    }
+}
+
+// 메시지 하나를 모든 대상 모뎀의 큐에 넣는다. 큐가 가득 차 있으면 빌 때까지 기다림
+static void Enqueue(ModemConfig* const* modems, int count, const BYTE* data, DWORD length, int64_t* queued, BatchReport* report) {
+    for (int i = 0; i < count; i++) {
+        bool accepted;
+        while (!(accepted = TransmitEnqueueNotify(modems[i], FRAME_TYPE_DATA, data, length, OnBatchDone) != 0)) {
+            if (!AtomicLoadAcquire32(&modems[i]->txQueue.running)) {
+                report->failed++;
+                break;
+            }
+            AtomicStoreRelease32(&batch.waiting, 1);
+            // 플래그를 세운 뒤 다시 확인 (그사이 끝난 통지를 놓치지 않도록)
+            if (AtomicLoadAcquire32(&batch.completed) == *queued) {
+                AtomicStoreRelease32(&batch.waiting, 0);
+                continue;
+            }
+            PlatformEventWait(&batch.progress, BATCH_WAIT_MS);
+            AtomicStoreRelease32(&batch.waiting, 0);
+        }
+        if (accepted) {
+            (*queued)++;
+        }
+    }
+}
+
+bool BatchSend(FILE* input, int format, ModemConfig* const* modems, int count, const volatile bool* running, BatchReport* report) {
+    memset(report, 0, sizeof(*report));
+    memset(&batch, 0, sizeof(batch));
+    if (!PlatformEventInit(&batch.progress)) {
+        return false;
+    }
+    BYTE* chunk = (BYTE*)malloc(BATCH_READ_SIZE);
+    BYTE* message = (BYTE*)malloc(BATCH_MAX_MESSAGE);
+    if (chunk == NULL || message == NULL) {
+        free(chunk);
+        free(message);
+        PlatformEventDestroy(&batch.progress);
+        return false;
+    }
+    int64_t startWire[MAX_MODEMS];
+    for (int i = 0; i < count; i++) {
+        startWire[i] = modems[i]->txQueue.bytesWritten;
+    }
+
+    int64_t queued = 0;         // 큐에 넣은 (메시지, 모뎀) 수. failed 로 센 것 제외
+    uint64_t startNs = 0;
+    DWORD length = 0;           // 만들고 있는 메시지
+    // HEX: 반쪽 바이트, 주석/잘못된 줄 / 이진: 길이 머리
+    int nibble = -1;
+    bool skipLine = false;
+    bool invalidLine = false;
+    BYTE header[4];
+    DWORD headerLength = 0;
+    DWORD expected = 0;         // 이진: 읽을 메시지 길이
+    bool skipping = false;      // 이진: 너무 긴 메시지를 건너뛰는 중
+
+    size_t read;
+    while (*running && (read = fread(chunk, 1, BATCH_READ_SIZE, input)) > 0) {
+        for (size_t i = 0; i < read; ) {
+            if (format == BATCH_FORMAT_BINARY) {
+                if (headerLength < 4) {
+                    header[headerLength++] = chunk[i++];
+                    if (headerLength == 4) {
+                        expected = (DWORD)header[0] | ((DWORD)header[1] << 8) | ((DWORD)header[2] << 16) | ((DWORD)header[3] << 24);
+                        skipping = expected == 0 || expected > BATCH_MAX_MESSAGE;
+                        length = 0;
+                        if (skipping) {
+                            report->invalid++;
+                        }
+                        if (expected == 0) {
+                            headerLength = 0;
+                        }
+                    }
+                    continue;
+                }
+                size_t take = read - i < expected - length ? read - i : expected - length;
+                if (!skipping) {
+                    memcpy(message + length, chunk + i, take);
+                }
+                length += (DWORD)take;
+                i += take;
+                if (length < expected) {
+                    continue;
+                }
+                headerLength = 0;
+                if (skipping) {
+                    continue;
+                }
+            }
+            else {
+                BYTE c = chunk[i++];
+                if (c != '\n') {
+                    int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+                    if (skipLine || c == ' ' || c == '\t' || c == '\r') {
+                        continue;
+                    }
+                    if (c == '#') {
+                        skipLine = true;
+                    }
+                    else if (digit < 0 || (nibble < 0 && length == BATCH_MAX_MESSAGE)) {
+                        skipLine = true;
+                        invalidLine = true;
+                    }
+                    else if (nibble < 0) {
+                        nibble = digit;
+                    }
+                    else {
+                        message[length++] = (BYTE)(nibble << 4 | digit);
+                        nibble = -1;
+                    }
+                    continue;
+                }
+                // 줄 끝: 홀수 자리 HEX 나 잘못된 문자가 있던 줄은 보내지 않음
+                bool complete = !invalidLine && nibble < 0 && length > 0;
+                if (invalidLine || nibble >= 0) {
+                    report->invalid++;
+                }
+                skipLine = false;
+                invalidLine = false;
+                nibble = -1;
+                if (!complete) {
+                    length = 0;
+                    continue;
+                }
+            }
+            if (startNs == 0) {
+                startNs = PlatformNowNs();
+            }
+            Enqueue(modems, count, message, length, &queued, report);
+            report->messages++;
+            report->bytes += length;
+            length = 0;
+        }
+    }
+    if (!*running) {
+        report->cancelled = true;
+    }
+    else if (format == BATCH_FORMAT_BINARY) {
+        report->truncated = headerLength > 0;
+    }
+    else if (!invalidLine && nibble < 0 && length > 0) {
+        // 마지막 줄에 줄바꿈이 없음
+        if (startNs == 0) {
+            startNs = PlatformNowNs();
+        }
+        Enqueue(modems, count, message, length, &queued, report);
+        report->messages++;
+        report->bytes += length;
+    }
+
+    // 넣은 메시지가 모두 끝날 때까지
+    AtomicStoreRelease32(&batch.waiting, 1);
+    while (AtomicLoadAcquire32(&batch.completed) < queued) {
+        PlatformEventWait(&batch.progress, BATCH_WAIT_MS);
+    }
+    AtomicStoreRelease32(&batch.waiting, 0);
+    // 쓰기 완료는 드라이버 버퍼에 들어간 시점이므로, 회선으로 다 나간 때까지를 잼
+    if (queued > 0) {
+        for (int i = 0; i < count; i++) {
+            SerialDrain(modems[i]);
+        }
+        AtomicStoreRelease64(&batch.lastDoneNs, (int64_t)PlatformNowNs());
+    }
+
+    report->failed += AtomicLoadAcquire32(&batch.failed);
+    report->sent = queued - AtomicLoadAcquire32(&batch.failed);
+    uint64_t lastDoneNs = (uint64_t)AtomicLoadAcquire64(&batch.lastDoneNs);
+    report->elapsedNs = startNs > 0 && lastDoneNs > startNs ? lastDoneNs - startNs : 0;
+    for (int i = 0; i < count; i++) {
+        report->wireBytes[i] = modems[i]->txQueue.bytesWritten - startWire[i];
+    }
+    free(chunk);
+    free(message);
+    PlatformEventDestroy(&batch.progress);
+    return true;
+}
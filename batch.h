@@ -0,0 +1,34 @@
+﻿#pragma once
+#include "platform.h"
+#include "modem.h"
+
+// 배치 전송
+// 파일이나 표준 입력에서 메시지를 읽는 대로 바로 모뎀 송신 큐에 넣는다. 송신 스레드가 앞의 메시지를
+// 쓰는 동안 다음 메시지를 해석하므로 회선이 배치 내내 쉬지 않는다. 큐가 가득 차면(TX_QUEUE_LIMIT)
+// 메시지가 끝나기를 기다렸다가 이어서 넣는다.
+//   BATCH_FORMAT_HEX     한 줄에 메시지 하나 (HEX 쌍, 공백 무시, 빈 줄과 '#' 뒤는 건너뜀)
+//   BATCH_FORMAT_BINARY  길이(4, 리틀 엔디언) | 데이터 를 반복
+// UHSDM --send <모뎀 id | all> [파일 | -] [--binary]
+
+#define BATCH_FORMAT_HEX 0
+#define BATCH_FORMAT_BINARY 1
+
+#define BATCH_READ_SIZE 65536
+#define BATCH_MAX_MESSAGE (64 * 1024)
+#define BATCH_WAIT_MS 100
+
+typedef struct {
+    int64_t messages;       // 읽은 메시지 (모뎀마다 한 번씩 보냄)
+    int64_t bytes;          // 읽은 메시지 데이터
+    int64_t sent;           // 모뎀별로 전송을 마친 메시지
+    int64_t failed;
+    int64_t invalid;        // 해석할 수 없었던 줄 / 너무 긴 메시지
+    int64_t wireBytes[MAX_MODEMS]; // 포트에 쓴 바이트 (프레임 포함)
+    uint64_t elapsedNs;     // 첫 메시지를 넣은 때부터 마지막 바이트가 회선으로 나갈 때까지
+    bool truncated;         // 이진 입력이 메시지 중간에 끝남
+    bool cancelled;
+} BatchReport;
+
+// 송신 스레드를 시작한 뒤 호출. 모든 메시지의 전송이 끝나면 반환한다
+// running 이 false 가 되면 더 읽지 않고 넣은 메시지가 끝나기를 기다림
+bool BatchSend(FILE* input, int format, ModemConfig* const* modems, int count, const volatile bool* running, BatchReport* report);
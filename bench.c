@@ -0,0 +1,2545 @@
+﻿#include "platform.h"
+#include "modem.h"
+#include "bench.h"
+#include "reactor.h"
+#include "receiver.h"
+#include "arq.h"
+#include "crc.h"
+#include "fec.h"
+#include "compress.h"
+#include "scheduler.h"
+#include "bond.h"
+#include "hotplug.h"
+#include "pool.h"
+#include "rxlog.h"
+#include "clocksync.h"
+#include "autobaud.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#define BENCH_DEFAULT_SAMPLES 200
+#define BENCH_TIMEOUT_NS 1000000000ULL
+#define BENCH_DEFAULT_MESSAGES 20000
+#define BENCH_MESSAGE_SIZE 16
+#define BENCH_ARQ_DEFAULT_KB 256
+#define BENCH_ARQ_DEFAULT_LOSS 10
+#define BENCH_ARQ_TIMEOUT_MS 200
+#define BENCH_COMPRESS_MESSAGES 2000
+#define BENCH_LINK_PHASE_MS 2000
+#define BENCH_LINK_ACOUSTIC_RATE 19200
+#define BENCH_LINK_MESSAGE_SIZE 64
+#define BENCH_LINK_WINDOW 32
+#define BENCH_LINK_MAX_MESSAGES 200000
+#define BENCH_BOND_DEFAULT_KB 128
+#define BENCH_BOND_LIGHT_RATE 230400
+#define BENCH_BOND_ACOUSTIC_RATE 115200
+#define BENCH_REDUNDANT_COMMANDS 200
+#define BENCH_REDUNDANT_LOSS 20
+#define BENCH_REDUNDANT_INTERVAL_MS 50
+#define BENCH_REDUNDANT_COMMAND_SIZE 16
+#define BENCH_SUITE_POINT_MS 1000
+#define BENCH_SUITE_MIN_MESSAGES 4
+#define BENCH_SUITE_MAX_MESSAGES 200000
+#define BENCH_SUITE_WINDOW 4
+#define BENCH_PRIORITY_COMMANDS 20
+#define BENCH_PRIORITY_RATE 19200
+#define BENCH_PRIORITY_PORT_RATE CBR_115200 // 매체보다 빠른 포트 (LinkRate 로 매체 속도를 알려 줌)
+#define BENCH_PRIORITY_INTERVAL_MS 250
+#define BENCH_PRIORITY_COMMAND_SIZE 16
+#define BENCH_PRIORITY_BULK_SIZE (2 * FRAME_MAX_PAYLOAD)
+#define BENCH_RECONFIG_FROM 115200
+#define BENCH_RECONFIG_TO 57600
+#define BENCH_RECONFIG_PHASE_MS 1000
+#define BENCH_RECONFIG_MESSAGE_SIZE 64
+#define BENCH_RECONFIG_MAX_MESSAGES 100000
+#define BENCH_POOL_MESSAGES 50000
+#define BENCH_POOL_MESSAGE_SIZE 256
+#define BENCH_POOL_RATE 4000000      // 포트 설정값 (매체는 속도 제한 없는 ideal)
+#define BENCH_POOL_WINDOW 8192       // 전달을 기다리는 바이트 상한 (pty 와 수신 링이 넘치지 않도록)
+#define BENCH_AUTOBAUD_CONFIGURED 19200 // 답이 없을 때 돌아갈 설정 속도 (탐색 목록의 처음이 아니도록)
+#define BENCH_AUTOBAUD_DELAY_MS 300       // 왕복 600ms 가 넘는 링크 (기본 대기 시간보다 김)
+#define BENCH_AUTOBAUD_DELAY_WAIT_MS 1000
+#define BENCH_CLOCK_MESSAGES 40
+#define BENCH_CLOCK_MESSAGE_SIZE 64
+#define BENCH_CLOCK_RATE 115200
+#define BENCH_CLOCK_MIN_INTERVAL_MS 20
+#define BENCH_LOG_MESSAGES 100000
+#define BENCH_LOG_MESSAGE_SIZE 64
+#define BENCH_LOG_DUMP_SIZE 4096
+#define BENCH_LOG_DUMP_ROUNDS 2000
+#define BENCH_LOG_SEGMENTS 64 // 쉬지 않고 넣는 기본 메시지 수가 로그 스레드보다 앞서는 만큼을 받아 둠
+#ifdef _WIN32
+#define BENCH_LOG_SINK TEXT("NUL")
+#else
+#define BENCH_LOG_SINK TEXT("/dev/null")
+#endif
+
+typedef struct {
+    ModemConfig* rx;
+    volatile int32_t running;
+    volatile int32_t delivered;   // 수신 스레드가 전달한 바이트 수
+    volatile int64_t deliveredNs; // 마지막 전달 시각
+} RxBench;
+
+static DWORD WINAPI BenchReadThread(LPVOID param) {
+    RxBench* bench = (RxBench*)param;
+    BYTE buffer[256];
+    DWORD bytesRead = 0;
+
+    while (AtomicLoadAcquire32(&bench->running)) {
+        int result = SerialWaitRead(bench->rx, buffer, sizeof(buffer), &bytesRead);
+        if (result == SERIAL_OK && bytesRead > 0) {
+            AtomicStoreRelease64(&bench->deliveredNs, (int64_t)PlatformNowNs());
+            AtomicStoreRelease32(&bench->delivered, AtomicLoadAcquire32(&bench->delivered) + (int32_t)bytesRead);
+        }
+        else if (result == SERIAL_ERROR) {
+            break;
+        }
+    }
+    return 0;
+}
+
+static int CompareU64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// 한 가지 수신 방식으로 samples 회 측정. 성공하면 중앙값과 p99 (마이크로초)를 채운다
+static bool MeasureMode(ModemConfig* tx, ModemConfig* rxTemplate, int rxMode, int samples, double* median, double* p99) {
+    ModemConfig rx = *rxTemplate;
+    rx.io.rxMode = rxMode;
+    if (!OpenSerialPort(&rx)) {
+        return false;
+    }
+
+    uint64_t* latencies = (uint64_t*)malloc(sizeof(uint64_t) * samples);
+    if (latencies == NULL) {
+        CloseSerialPort(&rx);
+        return false;
+    }
+
+    RxBench bench = { &rx, 1, 0, 0 };
+    PlatformThread reader;
+    if (!PlatformThreadStart(&reader, BenchReadThread, &bench)) {
+        free(latencies);
+        CloseSerialPort(&rx);
+        return false;
+    }
+    PlatformSleepMs(50);
+
+    int count = 0;
+    for (int i = 0; i < samples; i++) {
+        BYTE value = (BYTE)i;
+        DWORD written = 0;
+        int32_t before = AtomicLoadAcquire32(&bench.delivered);
+        uint64_t sentNs = PlatformNowNs();
+        if (!SerialWrite(tx, &value, 1, &written)) {
+            break;
+        }
+
+        // 전달될 때까지 대기 (시계 해상도에 영향을 주지 않도록 Sleep 대신 양보만 함)
+        while (AtomicLoadAcquire32(&bench.delivered) == before && PlatformNowNs() - sentNs < BENCH_TIMEOUT_NS) {
+            PlatformSleepMs(0);
+        }
+        if (AtomicLoadAcquire32(&bench.delivered) == before) {
+            continue;
+        }
+        latencies[count++] = (uint64_t)AtomicLoadAcquire64(&bench.deliveredNs) - sentNs;
+
+        // 폴링 주기와 위상이 맞물리지 않도록 송신 간격을 흔든다
+        PlatformSleepMs((DWORD)(rand() % 4));
+    }
+
+    AtomicStoreRelease32(&bench.running, 0);
+    SerialWake(&rx);
+    PlatformThreadJoin(reader);
+    CloseSerialPort(&rx);
+
+    if (count > 0) {
+        qsort(latencies, count, sizeof(uint64_t), CompareU64);
+        int p99Index = count * 99 / 100;
+        *median = latencies[count / 2] / 1000.0;
+        *p99 = latencies[p99Index < count ? p99Index : count - 1] / 1000.0;
+    }
+    free(latencies);
+    return count > 0;
+}
+
+int RunRxLatencyBench(int argc, TCHAR* argv[]) {
+    ModemConfig tx = { TEXT(""), CBR_115200, 8, ONESTOPBIT, NOPARITY, INVALID_HANDLE_VALUE };
+    ModemConfig rx = { TEXT(""), CBR_115200, 8, ONESTOPBIT, NOPARITY, INVALID_HANDLE_VALUE };
+    int samples = BENCH_DEFAULT_SAMPLES;
+
+    if (argc >= 2) {
+        // 널 모뎀으로 연결된 실제 포트 쌍
+        _tcsncpy(tx.portName, argv[0], MAX_PORT_NAME - 1);
+        _tcsncpy(rx.portName, argv[1], MAX_PORT_NAME - 1);
+        if (argc >= 3) {
+            samples = _ttoi(argv[2]);
+        }
+        if (!OpenSerialPort(&tx)) {
+            return 1;
+        }
+    }
+    else {
+#ifdef _WIN32
+        _ftprintf(stderr, TEXT("Usage: UHSDM --bench-rx <tx port> <rx port> [samples]\n"));
+        return 1;
+#else
+        // pty 쌍: 마스터 쪽에 쓰고 슬레이브 쪽을 모뎀 포트로 연다
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+            _ftprintf(stderr, TEXT("Failed to create pty pair.\n"));
+            return 1;
+        }
+        _tcsncpy(rx.portName, ptsname(master), MAX_PORT_NAME - 1);
+        tx.hSerial = master;
+        if (argc >= 1) {
+            samples = _ttoi(argv[0]);
+        }
+#endif
+    }
+    if (samples <= 0) {
+        samples = BENCH_DEFAULT_SAMPLES;
+    }
+
+    _tprintf(TEXT("RX latency benchmark: %s -> %s, %d samples\n"), tx.portName[0] ? tx.portName : TEXT("pty"), rx.portName, samples);
+    _tprintf(TEXT("%-8s %12s %12s\n"), TEXT("mode"), TEXT("median(us)"), TEXT("p99(us)"));
+
+    const int modes[2] = { SERIAL_RX_POLL, SERIAL_RX_EVENT };
+    const TCHAR* names[2] = { TEXT("poll"), TEXT("event") };
+    int exitCode = 0;
+    for (int i = 0; i < 2; i++) {
+        double median = 0.0;
+        double p99 = 0.0;
+        if (MeasureMode(&tx, &rx, modes[i], samples, &median, &p99)) {
+            _tprintf(TEXT("%-8s %12.1f %12.1f\n"), names[i], median, p99);
+        }
+        else {
+            _tprintf(TEXT("%-8s %12s %12s\n"), names[i], TEXT("failed"), TEXT("-"));
+            exitCode = 1;
+        }
+    }
+
+#ifdef _WIN32
+    CloseSerialPort(&tx);
+#else
+    if (tx.portName[0]) {
+        CloseSerialPort(&tx);
+    }
+    else {
+        close((int)tx.hSerial);
+    }
+#endif
+    return exitCode;
+}
+
+typedef struct {
+    ModemConfig* rx;    // NULL 이면 pty 마스터(masterFd)에서 읽음
+    int masterFd;
+    volatile int32_t running;
+    volatile int64_t received;
+} TxBench;
+
+// 수신 쪽을 계속 비워서 송신이 막히지 않게 한다
+static DWORD WINAPI BenchDrainThread(LPVOID param) {
+    TxBench* bench = (TxBench*)param;
+    BYTE buffer[4096];
+    while (AtomicLoadAcquire32(&bench->running)) {
+        DWORD bytesRead = 0;
+#ifndef _WIN32
+        if (bench->rx == NULL) {
+            struct pollfd pfd = { bench->masterFd, POLLIN, 0 };
+            if (poll(&pfd, 1, 100) > 0) {
+                ssize_t n = read(bench->masterFd, buffer, sizeof(buffer));
+                bytesRead = n > 0 ? (DWORD)n : 0;
+            }
+            AtomicStoreRelease64(&bench->received, AtomicLoadAcquire64(&bench->received) + bytesRead);
+            continue;
+        }
+#endif
+        int result = SerialWaitRead(bench->rx, buffer, sizeof(buffer), &bytesRead);
+        if (result == SERIAL_ERROR) {
+            break;
+        }
+        if (result == SERIAL_OK) {
+            AtomicStoreRelease64(&bench->received, AtomicLoadAcquire64(&bench->received) + bytesRead);
+        }
+    }
+    return 0;
+}
+
+// 모든 바이트가 수신 쪽에 도착할 때까지 대기. 진행이 멈추면 false
+static bool WaitReceived(TxBench* bench, int64_t total) {
+    int64_t last = -1;
+    uint64_t lastProgressNs = PlatformNowNs();
+    for (;;) {
+        int64_t received = AtomicLoadAcquire64(&bench->received);
+        if (received >= total) {
+            return true;
+        }
+        if (received != last) {
+            last = received;
+            lastProgressNs = PlatformNowNs();
+        }
+        else if (PlatformNowNs() - lastProgressNs > 2 * BENCH_TIMEOUT_NS) {
+            return false;
+        }
+        PlatformSleepMs(1);
+    }
+}
+
+static void PrintTxResult(const TCHAR* mode, int messages, int64_t bytes, uint64_t elapsedNs, long writes) {
+    double seconds = elapsedNs / 1e9;
+    _tprintf(TEXT("%-8s %12.0f %12.1f %10ld\n"), mode, messages / seconds, bytes / seconds / 1024.0, writes);
+}
+
+// 두 가지 송신 방식으로 messages 개를 보내고 결과를 출력. 실패가 있으면 1
+static int MeasureTxBurst(ModemConfig* modem, TxBench* bench, int messages) {
+    _tprintf(TEXT("TX burst benchmark: %s, %d messages of %d bytes (line rate %.1f KB/s)\n"),
+        modem->portName, messages, BENCH_MESSAGE_SIZE, modem->baudRate / 10 / 1024.0);
+    _tprintf(TEXT("%-8s %12s %12s %10s\n"), TEXT("mode"), TEXT("msg/s"), TEXT("KB/s"), TEXT("writes"));
+
+    BYTE message[BENCH_MESSAGE_SIZE];
+    for (int i = 0; i < BENCH_MESSAGE_SIZE; i++) {
+        message[i] = (BYTE)('a' + i);
+    }
+    int64_t total = (int64_t)messages * BENCH_MESSAGE_SIZE;
+    int exitCode = 0;
+
+    // 기존 방식: 메시지마다 SerialWrite 한 번
+    uint64_t startNs = PlatformNowNs();
+    for (int i = 0; i < messages; i++) {
+        DWORD written = 0;
+        if (!SerialWrite(modem, message, BENCH_MESSAGE_SIZE, &written)) {
+            break;
+        }
+    }
+    if (WaitReceived(bench, total)) {
+        PrintTxResult(TEXT("direct"), messages, total, PlatformNowNs() - startNs, (long)messages);
+    }
+    else {
+        _tprintf(TEXT("%-8s %12s\n"), TEXT("direct"), TEXT("failed"));
+        exitCode = 1;
+    }
+
+    // 송신 큐: 연속된 메시지를 TX_BATCH_SIZE 단위로 묶어서 씀
+    AtomicStoreRelease64(&bench->received, 0);
+    if (TransmitterStart(NULL)) {
+        startNs = PlatformNowNs();
+        for (int i = 0; i < messages; i++) {
+            while (TransmitEnqueue(modem, FRAME_TYPE_DATA, message, BENCH_MESSAGE_SIZE) == 0) {
+                PlatformSleepMs(1); // 큐가 가득 참
+            }
+        }
+        if (WaitReceived(bench, total)) {
+            PrintTxResult(TEXT("queued"), messages, total, PlatformNowNs() - startNs, (long)modem->txQueue.writes);
+        }
+        else {
+            _tprintf(TEXT("%-8s %12s\n"), TEXT("queued"), TEXT("failed"));
+            exitCode = 1;
+        }
+    }
+    else {
+        exitCode = 1;
+    }
+    TransmitterStop();
+    return exitCode;
+}
+
+int RunTxBurstBench(int argc, TCHAR* argv[]) {
+    ModemConfig tx = { TEXT(""), CBR_115200, 8, ONESTOPBIT, NOPARITY, INVALID_HANDLE_VALUE };
+    ModemConfig rx = { TEXT(""), CBR_115200, 8, ONESTOPBIT, NOPARITY, INVALID_HANDLE_VALUE };
+    TxBench bench = { NULL, -1, 1, 0 };
+    int messages = BENCH_DEFAULT_MESSAGES;
+
+    if (argc >= 2) {
+        _tcsncpy(tx.portName, argv[0], MAX_PORT_NAME - 1);
+        _tcsncpy(rx.portName, argv[1], MAX_PORT_NAME - 1);
+        if (argc >= 3) {
+            messages = _ttoi(argv[2]);
+        }
+        if (!OpenSerialPort(&rx)) {
+            return 1;
+        }
+        bench.rx = &rx;
+    }
+    else {
+#ifdef _WIN32
+        _ftprintf(stderr, TEXT("Usage: UHSDM --bench-tx <tx port> <rx port> [messages]\n"));
+        return 1;
+#else
+        // pty 쌍: 슬레이브 쪽을 모뎀 포트로 열고 마스터 쪽에서 읽는다
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+            _ftprintf(stderr, TEXT("Failed to create pty pair.\n"));
+            return 1;
+        }
+        _tcsncpy(tx.portName, ptsname(master), MAX_PORT_NAME - 1);
+        bench.masterFd = master;
+        if (argc >= 1) {
+            messages = _ttoi(argv[0]);
+        }
+#endif
+    }
+    if (messages <= 0) {
+        messages = BENCH_DEFAULT_MESSAGES;
+    }
+
+    // 송신 스레드는 모뎀 목록의 모뎀을 대상으로 하므로 송신 포트를 목록에 등록
+    memset(&modemRegistry, 0, sizeof(modemRegistry));
+    ModemConfig* modem = &modemRegistry.modems[0];
+    *modem = tx;
+    _tcscpy(modem->name, TEXT("bench"));
+    modem->framing = FRAMING_RAW;
+    modemRegistry.count = 1;
+    int exitCode = 1;
+    PlatformThread drain;
+    if (OpenSerialPort(modem)) {
+        if (PlatformThreadStart(&drain, BenchDrainThread, &bench)) {
+            exitCode = MeasureTxBurst(modem, &bench, messages);
+            AtomicStoreRelease32(&bench.running, 0);
+            if (bench.rx != NULL) {
+                SerialWake(bench.rx);
+            }
+            PlatformThreadJoin(drain);
+        }
+        CloseSerialPort(modem);
+    }
+
+    if (bench.rx != NULL) {
+        CloseSerialPort(bench.rx);
+    }
+#ifndef _WIN32
+    if (bench.masterFd >= 0) {
+        close(bench.masterFd);
+    }
+#endif
+    return exitCode;
+}
+
+// 한 가지 경로로 부호화와 복구(데이터 조각 M 개 손실)를 반복해 MB/s 를 구한다
+static void MeasureFec(int dataCount, int parityCount, BYTE* const* shards, double* encodeRate, double* decodeRate) {
+    const int rounds = 2000;
+    BYTE* const* parity = shards + dataCount;
+    uint64_t startNs = PlatformNowNs();
+    for (int r = 0; r < rounds; r++) {
+        FecEncode(dataCount, parityCount, (const BYTE* const*)shards, parity, ARQ_FRAGMENT_SIZE);
+    }
+    double bytes = (double)rounds * dataCount * ARQ_FRAGMENT_SIZE;
+    *encodeRate = bytes / ((PlatformNowNs() - startNs) / 1e9) / 1e6;
+
+    // 앞쪽 데이터 조각 parityCount 개를 잃었다고 보고 나머지 데이터 + 패리티로 복구
+    int indexes[FEC_MAX_SHARDS];
+    const BYTE* received[FEC_MAX_SHARDS];
+    int missing[FEC_MAX_SHARDS];
+    BYTE* output[FEC_MAX_SHARDS];
+    int lost = parityCount < dataCount ? parityCount : dataCount;
+    for (int i = 0; i < dataCount; i++) {
+        indexes[i] = i < lost ? dataCount + i : i;
+        received[i] = shards[indexes[i]];
+    }
+    for (int i = 0; i < lost; i++) {
+        missing[i] = i;
+        output[i] = shards[dataCount + parityCount + i]; // 복구 결과용 여분
+    }
+    startNs = PlatformNowNs();
+    for (int r = 0; r < rounds; r++) {
+        FecDecode(dataCount, indexes, received, lost, missing, output, ARQ_FRAGMENT_SIZE);
+    }
+    *decodeRate = bytes / ((PlatformNowNs() - startNs) / 1e9) / 1e6;
+}
+
+int RunFecBench(int argc, TCHAR* argv[]) {
+    int dataCount = 8;
+    int total = 10;
+    if (argc >= 1) {
+        _stscanf(argv[0], TEXT("%d/%d"), &dataCount, &total);
+    }
+    if (dataCount <= 0 || total <= dataCount || total > FEC_MAX_SHARDS) {
+        _ftprintf(stderr, TEXT("FEC rate must be K/N with 0 < K < N <= %d\n"), FEC_MAX_SHARDS);
+        return 1;
+    }
+    int parityCount = total - dataCount;
+
+    FecInit();
+    BYTE* shards[FEC_MAX_SHARDS * 2];
+    BYTE* memory = (BYTE*)malloc((size_t)FEC_MAX_SHARDS * 2 * ARQ_FRAGMENT_SIZE);
+    if (memory == NULL) {
+        return 1;
+    }
+    for (int i = 0; i < FEC_MAX_SHARDS * 2; i++) {
+        shards[i] = memory + (size_t)i * ARQ_FRAGMENT_SIZE;
+    }
+    for (int i = 0; i < FEC_MAX_SHARDS * 2 * ARQ_FRAGMENT_SIZE; i++) {
+        memory[i] = (BYTE)rand();
+    }
+
+    _tprintf(TEXT("FEC benchmark: rate %d/%d, %d byte fragments (115200 baud needs %.3f MB/s)\n"),
+        dataCount, total, ARQ_FRAGMENT_SIZE, 115200 / 10 / 1e6);
+    _tprintf(TEXT("%-8s %14s %14s\n"), TEXT("path"), TEXT("encode(MB/s)"), TEXT("decode(MB/s)"));
+    bool simd = FecUsesSimd();
+    for (int pass = 0; pass < (simd ? 2 : 1); pass++) {
+        double encodeRate = 0.0;
+        double decodeRate = 0.0;
+        FecEnableSimd(pass == 1);
+        MeasureFec(dataCount, parityCount, shards, &encodeRate, &decodeRate);
+        _tprintf(TEXT("%-8s %14.1f %14.1f\n"), pass == 1 ? TEXT("ssse3") : TEXT("table"), encodeRate, decodeRate);
+    }
+    FecEnableSimd(true);
+    free(memory);
+    return 0;
+}
+
+typedef struct {
+    char** messages;
+    DWORD* lengths;
+    int count;
+} CompressSamples;
+
+static bool AddSample(CompressSamples* samples, const char* text, DWORD length) {
+    if (length == 0 || length > COMPRESS_MAX_INPUT || samples->count == BENCH_COMPRESS_MESSAGES) {
+        return false;
+    }
+    samples->messages[samples->count] = (char*)malloc(length);
+    if (samples->messages[samples->count] == NULL) {
+        return false;
+    }
+    memcpy(samples->messages[samples->count], text, length);
+    samples->lengths[samples->count++] = length;
+    return true;
+}
+
+// 센서 값이 조금씩 변하는 텔레메트리 메시지를 만든다 (shape 0: key=value 한 줄, 1: JSON, 2: 16줄 묶음)
+static void MakeTelemetry(CompressSamples* samples, int shape) {
+    double depth = 35.0;
+    double temperature = 14.5;
+    double battery = 12.6;
+    char text[COMPRESS_MAX_INPUT];
+    for (int i = 0; i < BENCH_COMPRESS_MESSAGES; i++) {
+        int length = 0;
+        int lines = shape == 2 ? 16 : 1;
+        for (int line = 0; line < lines; line++) {
+            int n = i * lines + line;
+            depth += (rand() % 21 - 10) / 100.0;
+            temperature += (rand() % 11 - 5) / 100.0;
+            battery -= (rand() % 3) / 1000.0;
+            if (shape == 1) {
+                length += snprintf(text + length, sizeof(text) - length,
+                    "{\"type\":\"telemetry\",\"id\":%d,\"ts\":%d,\"depth\":%.2f,\"temperature\":%.2f,\"pressure\":%.1f,\"heading\":%.1f,\"battery\":%.2f,\"status\":\"OK\"}",
+                    n, 1700000000 + n, depth, temperature, 1013.25 + depth * 100.5, (double)(n * 7 % 3600) / 10.0, battery);
+            }
+            else {
+                length += snprintf(text + length, sizeof(text) - length,
+                    "$UHSDM,TLM,id=%d,depth=%.2f,temp=%.2f,heading=%.1f,battery=%.2f,status=OK\r\n",
+                    n, depth, temperature, (double)(n * 7 % 3600) / 10.0, battery);
+            }
+        }
+        AddSample(samples, text, (DWORD)length);
+    }
+}
+
+// 한 줄을 메시지 하나로 읽음
+static void ReadSamples(CompressSamples* samples, const TCHAR* path) {
+    FILE* file = _tfopen(path, TEXT("rb"));
+    if (file == NULL) {
+        _ftprintf(stderr, TEXT("Failed to open %s\n"), path);
+        return;
+    }
+    char line[COMPRESS_MAX_INPUT];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        AddSample(samples, line, (DWORD)strlen(line));
+    }
+    fclose(file);
+}
+
+static bool MeasureCompress(const TCHAR* name, const CompressSamples* samples) {
+    BYTE packed[COMPRESS_MAX_INPUT];
+    BYTE expanded[COMPRESS_MAX_INPUT];
+    for (int pass = 0; pass < 2; pass++) {
+        CompressUseDictionary(pass == 1);
+        int64_t bytesIn = 0;
+        int64_t bytesOut = 0;
+        uint64_t compressNs = 0;
+        uint64_t expandNs = 0;
+        for (int i = 0; i < samples->count; i++) {
+            const BYTE* message = (const BYTE*)samples->messages[i];
+            DWORD length = samples->lengths[i];
+            uint64_t startNs = PlatformNowNs();
+            DWORD packedLength = CompressBlock(message, length, packed, sizeof(packed));
+            compressNs += PlatformNowNs() - startNs;
+            bytesIn += length;
+            bytesOut += packedLength > 0 ? packedLength : length;
+            if (packedLength == 0) {
+                continue;
+            }
+            DWORD expandedLength = 0;
+            startNs = PlatformNowNs();
+            bool ok = CompressExpand(packed, packedLength, expanded, sizeof(expanded), &expandedLength);
+            expandNs += PlatformNowNs() - startNs;
+            if (!ok || expandedLength != length || memcmp(expanded, message, length) != 0) {
+                _ftprintf(stderr, TEXT("Round trip failed for message %d\n"), i);
+                CompressUseDictionary(true);
+                return false;
+            }
+        }
+        _tprintf(TEXT("%-10s %-6s %8.0f %8.0f %7.1f%% %10.2f %10.2f\n"), name, pass == 1 ? TEXT("yes") : TEXT("no"),
+            (double)bytesIn / samples->count, (double)bytesOut / samples->count, 100.0 * bytesOut / bytesIn,
+            compressNs / 1000.0 / samples->count, expandNs / 1000.0 / samples->count);
+    }
+    CompressUseDictionary(true);
+    return true;
+}
+
+int RunCompressBench(int argc, TCHAR* argv[]) {
+    CrcInit();
+    CompressInit(NULL);
+    CompressSamples samples;
+    samples.messages = (char**)calloc(BENCH_COMPRESS_MESSAGES, sizeof(char*));
+    samples.lengths = (DWORD*)calloc(BENCH_COMPRESS_MESSAGES, sizeof(DWORD));
+    if (samples.messages == NULL || samples.lengths == NULL) {
+        free(samples.messages);
+        free(samples.lengths);
+        return 1;
+    }
+
+    _tprintf(TEXT("Compression benchmark: built-in dictionary %08lX\n"), (unsigned long)CompressDictionaryId());
+    _tprintf(TEXT("%-10s %-6s %8s %8s %8s %10s %10s\n"), TEXT("messages"), TEXT("dict"), TEXT("in(B)"), TEXT("out(B)"),
+        TEXT("ratio"), TEXT("comp(us)"), TEXT("expand(us)"));
+    static const TCHAR* shapes[] = { TEXT("line"), TEXT("json"), TEXT("batch16") };
+    bool ok = true;
+    for (int shape = 0; shape < (argc >= 1 ? 1 : 3) && ok; shape++) {
+        samples.count = 0;
+        if (argc >= 1) {
+            ReadSamples(&samples, argv[0]);
+        }
+        else {
+            MakeTelemetry(&samples, shape);
+        }
+        if (samples.count > 0) {
+            ok = MeasureCompress(argc >= 1 ? TEXT("file") : shapes[shape], &samples);
+        }
+        for (int i = 0; i < samples.count; i++) {
+            free(samples.messages[i]);
+        }
+    }
+    free(samples.messages);
+    free(samples.lengths);
+    return ok ? 0 : 1;
+}
+
+// 로그 스레드가 생기기 전의 출력 방식: 수신 처리 스레드가 메시지마다 HEX 문자열을 만들어 바로 출력
+static void PrintReceived(FILE* file, const TCHAR* name, const BYTE* data, DWORD size) {
+    static TCHAR buffer[FRAME_MAX_PAYLOAD * 3 + 1];
+    static const TCHAR hexDigits[] = TEXT("0123456789ABCDEF");
+    DWORD position = 0;
+    for (DWORD i = 0; i < size && i < FRAME_MAX_PAYLOAD; i++) {
+        buffer[position++] = hexDigits[data[i] >> 4];
+        buffer[position++] = hexDigits[data[i] & 0x0F];
+        buffer[position++] = TEXT(' ');
+    }
+    buffer[position] = TEXT('\0');
+    _ftprintf(file, TEXT("Received Message(%s) [%lu bytes] >> %s\n"), name, (unsigned long)size, buffer);
+}
+
+int RunLogBench(int argc, TCHAR* argv[]) {
+    int messages = argc >= 1 ? _ttoi(argv[0]) : BENCH_LOG_MESSAGES;
+    DWORD size = argc >= 2 ? (DWORD)_ttoi(argv[1]) : BENCH_LOG_MESSAGE_SIZE;
+    int segments = argc >= 3 ? _ttoi(argv[2]) : BENCH_LOG_SEGMENTS;
+    if (messages <= 0 || size == 0 || size > FRAME_MAX_PAYLOAD || segments < 2 || segments > RXLOG_MAX_SEGMENTS) {
+        _ftprintf(stderr, TEXT("Usage: UHSDM --bench-log [messages] [size, 1..%d] [segments, 2..%d]\n"), FRAME_MAX_PAYLOAD,
+            RXLOG_MAX_SEGMENTS);
+        return 1;
+    }
+    RxLogInit();
+    BYTE* data = (BYTE*)malloc(BENCH_LOG_DUMP_SIZE);
+    char* dump = (char*)malloc(RxLogDumpSize(BENCH_LOG_DUMP_SIZE));
+    if (data == NULL || dump == NULL) {
+        free(data);
+        free(dump);
+        return 1;
+    }
+    for (int i = 0; i < BENCH_LOG_DUMP_SIZE; i++) {
+        data[i] = (BYTE)rand();
+    }
+
+    // 덤프 변환만: 입력 바이트 기준 처리량
+    _tprintf(TEXT("Receive log benchmark: hex dump of %d byte blocks, then %d binary messages of %lu bytes to %s, %d log segments\n"),
+        BENCH_LOG_DUMP_SIZE, messages, (unsigned long)size, BENCH_LOG_SINK, segments);
+    _tprintf(TEXT("%-8s %14s\n"), TEXT("path"), TEXT("dump(MB/s)"));
+    bool simd = RxLogUsesSimd();
+    for (int pass = 0; pass < (simd ? 2 : 1); pass++) {
+        RxLogEnableSimd(pass == 1);
+        uint64_t startNs = PlatformNowNs();
+        DWORD check = 0;
+        for (int r = 0; r < BENCH_LOG_DUMP_ROUNDS; r++) {
+            check += RxLogDump(data, BENCH_LOG_DUMP_SIZE, dump);
+        }
+        double seconds = (PlatformNowNs() - startNs) / 1e9;
+        _tprintf(TEXT("%-8s %14.1f\n"), pass == 1 ? TEXT("ssse3") : TEXT("table"),
+            check > 0 ? (double)BENCH_LOG_DUMP_SIZE * BENCH_LOG_DUMP_ROUNDS / seconds / 1e6 : 0.0);
+    }
+    RxLogEnableSimd(true);
+
+    // 수신 처리 스레드가 메시지 하나에 쓰는 시간: 바로 출력 / 로그 큐에 복사
+    memset(&modemRegistry, 0, sizeof(modemRegistry));
+    modemRegistry.count = 1;
+    _tcscpy(modemRegistry.modems[0].name, TEXT("bench0"));
+    const ModemConfig* modem = &modemRegistry.modems[0];
+    // 메시지를 쉬지 않고 넣으므로 로그 스레드가 밀린 만큼을 세그먼트가 받아 둠. waited 는 마지막 세그먼트에 담은 레코드,
+    // dropped 는 세그먼트가 모자라 버린 레코드 (호출한 쪽은 출력을 기다리지 않음)
+    _tprintf(TEXT("%-8s %14s %14s %14s %10s %10s\n"), TEXT("output"), TEXT("caller(ns)"), TEXT("total(ms)"), TEXT("logged(msg/s)"),
+        TEXT("waited"), TEXT("dropped"));
+    FILE* sink = _tfopen(BENCH_LOG_SINK, TEXT("w"));
+    bool ok = sink != NULL;
+    if (ok) {
+        uint64_t startNs = PlatformNowNs();
+        for (int i = 0; i < messages; i++) {
+            PrintReceived(sink, modem->name, data + (i * 16) % (BENCH_LOG_DUMP_SIZE - size + 1), size);
+        }
+        fflush(sink);
+        uint64_t elapsedNs = PlatformNowNs() - startNs;
+        fclose(sink);
+        _tprintf(TEXT("%-8s %14.0f %14.1f %14.0f %10d %10d\n"), TEXT("direct"), (double)elapsedNs / messages, elapsedNs / 1e6,
+            messages / (elapsedNs / 1e9), 0, 0);
+    }
+    ok = ok && RxLogStart(BENCH_LOG_SINK, 0, segments);
+    if (ok) {
+        uint64_t startNs = PlatformNowNs();
+        for (int i = 0; i < messages; i++) {
+            RxLogRecord(modem, true, data + (i * 16) % (BENCH_LOG_DUMP_SIZE - size + 1), size);
+        }
+        uint64_t callerNs = PlatformNowNs() - startNs;
+        RxLogStop();
+        uint64_t elapsedNs = PlatformNowNs() - startNs;
+        RxLogStats stats;
+        RxLogQueryStats(&stats);
+        _tprintf(TEXT("%-8s %14.0f %14.1f %14.0f %10lld %10lld\n"), TEXT("rxlog"), (double)callerNs / messages, elapsedNs / 1e6,
+            (messages - stats.droppedRecords) / (elapsedNs / 1e9), (long long)stats.waitedRecords, (long long)stats.droppedRecords);
+        _tprintf(TEXT("rxlog wrote %lld bytes in %lld writes (%.0f KB per write)\n"), (long long)stats.outputBytes,
+            (long long)stats.writes, stats.writes > 0 ? stats.outputBytes / 1024.0 / stats.writes : 0.0);
+    }
+    memset(&modemRegistry, 0, sizeof(modemRegistry));
+    free(data);
+    free(dump);
+    return ok ? 0 : 1;
+}
+
+#ifdef _WIN32
+
+int RunArqLossBench(int argc, TCHAR* argv[]) {
+    (void)argc;
+    (void)argv;
+    _ftprintf(stderr, TEXT("--bench-arq needs pty pairs and is only available on POSIX builds.\n"));
+    return 1;
+}
+
+int RunLinkFailoverBench(int argc, TCHAR* argv[]) {
+    (void)argc;
+    (void)argv;
+    _ftprintf(stderr, TEXT("--bench-link needs pty pairs and is only available on POSIX builds.\n"));
+    return 1;
+}
+
+int RunBondBench(int argc, TCHAR* argv[]) {
+    (void)argc;
+    (void)argv;
+    _ftprintf(stderr, TEXT("--bench-bond needs pty pairs and is only available on POSIX builds.\n"));
+    return 1;
+}
+
+int RunRedundantBench(int argc, TCHAR* argv[]) {
+    (void)argc;
+    (void)argv;
+    _ftprintf(stderr, TEXT("--bench-redundant needs pty pairs and is only available on POSIX builds.\n"));
+    return 1;
+}
+
+int RunBenchSuite(int argc, TCHAR* argv[]) {
+    (void)argc;
+    (void)argv;
+    _ftprintf(stderr, TEXT("--bench-suite needs the modem emulator and is only available on POSIX builds.\n"));
+    return 1;
+}
+
+int RunPriorityBench(int argc, TCHAR* argv[]) {
+    (void)argc;
+    (void)argv;
+    _ftprintf(stderr, TEXT("--bench-priority needs the modem emulator and is only available on POSIX builds.\n"));
+    return 1;
+}
+
+int RunReconfigBench(int argc, TCHAR* argv[]) {
+    (void)argc;
+    (void)argv;
+    _ftprintf(stderr, TEXT("--bench-reconfig needs the modem emulator and is only available on POSIX builds.\n"));
+    return 1;
+}
+
+int RunPoolBench(int argc, TCHAR* argv[]) {
+    (void)argc;
+    (void)argv;
+    _ftprintf(stderr, TEXT("--bench-pool needs the modem emulator and is only available on POSIX builds.\n"));
+    return 1;
+}
+
+int RunClockBench(int argc, TCHAR* argv[]) {
+    (void)argc;
+    (void)argv;
+    _ftprintf(stderr, TEXT("--bench-clock needs the modem emulator and is only available on POSIX builds.\n"));
+    return 1;
+}
+
+int RunAutoBaudBench(int argc, TCHAR* argv[]) {
+    (void)argc;
+    (void)argv;
+    _ftprintf(stderr, TEXT("--bench-autobaud needs the modem emulator and is only available on POSIX builds.\n"));
+    return 1;
+}
+
+#else
+
+// 모뎀 목록의 index 번째를 프레임 모드 벤치 모뎀으로 만들고 pty 슬레이브 쪽을 연다 (마스터는 *master)
+static bool OpenPtyModem(int index, int* master) {
+    *master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (*master < 0 || grantpt(*master) != 0 || unlockpt(*master) != 0) {
+        _ftprintf(stderr, TEXT("Failed to create pty pair.\n"));
+        return false;
+    }
+    ModemConfig* modem = &modemRegistry.modems[index];
+    _tcsncpy(modem->portName, ptsname(*master), MAX_PORT_NAME - 1);
+    _stprintf(modem->name, TEXT("bench%d"), index);
+    modem->baudRate = CBR_115200;
+    modem->byteSize = 8;
+    modem->stopBits = ONESTOPBIT;
+    modem->parity = NOPARITY;
+    modem->hSerial = INVALID_HANDLE_VALUE;
+    modem->framing = FRAMING_COBS;
+    modem->arqWindow = ARQ_DEFAULT_WINDOW;
+    modem->arqTimeoutMs = BENCH_ARQ_TIMEOUT_MS;
+    modem->linkRate = CBR_115200;
+    return RingInit(&modem->rxRing, RING_DEFAULT_SIZE) && FrameParserInit(&modem->rxFrame) && OpenSerialPort(modem);
+}
+
+static void CloseBenchModems(const int* masters, int count) {
+    for (int i = 0; i < count; i++) {
+        CloseSerialPort(&modemRegistry.modems[i]);
+        RingFree(&modemRegistry.modems[i].rxRing);
+        FrameParserFree(&modemRegistry.modems[i].rxFrame);
+        close(masters[i]);
+    }
+}
+
+// 버퍼가 빌 때까지 씀 (pty 가 가득 차면 잠시 대기)
+static void WriteAll(int fd, const BYTE* data, DWORD length) {
+    DWORD written = 0;
+    while (written < length) {
+        ssize_t n = write(fd, data + written, length - written);
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                break;
+            }
+            PlatformSleepMs(1);
+            continue;
+        }
+        written += (DWORD)n;
+    }
+}
+
+typedef struct {
+    int masters[2];         // 모뎀 0, 1 의 pty 마스터
+    int lossPercent;
+    volatile int32_t running;
+    volatile int32_t dropped;
+    volatile int32_t forwarded;
+    BYTE* expected;
+    DWORD expectedLength;
+    volatile int32_t delivered;  // 1 = 일치, -1 = 불일치
+    volatile int32_t finished;   // 1 = 성공, -1 = 실패
+} ArqBench;
+
+static ArqBench arqBench;
+
+// 한 방향의 바이트를 프레임 단위(0x00 구분)로 모아서 lossPercent 확률로 버리고 나머지는 건넴
+typedef struct {
+    BYTE frame[FRAME_MAX_ENCODED];
+    DWORD length;
+} RelayDirection;
+
+static void RelayBytes(RelayDirection* direction, const BYTE* data, DWORD size, int outFd, int lossPercent,
+    volatile int32_t* dropped, volatile int32_t* forwarded) {
+    for (DWORD i = 0; i < size; i++) {
+        if (direction->length < sizeof(direction->frame)) {
+            direction->frame[direction->length++] = data[i];
+        }
+        if (data[i] != FRAME_DELIMITER) {
+            continue;
+        }
+        if (rand() % 100 < lossPercent) {
+            AtomicIncrement32(dropped);
+        }
+        else {
+            WriteAll(outFd, direction->frame, direction->length);
+            AtomicIncrement32(forwarded);
+        }
+        direction->length = 0;
+    }
+}
+
+static DWORD WINAPI BenchRelayThread(LPVOID param) {
+    (void)param;
+    static RelayDirection directions[2];
+    BYTE buffer[4096];
+    while (AtomicLoadAcquire32(&arqBench.running)) {
+        struct pollfd pfds[2] = { { arqBench.masters[0], POLLIN, 0 }, { arqBench.masters[1], POLLIN, 0 } };
+        if (poll(pfds, 2, 100) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (pfds[i].revents & POLLIN) {
+                ssize_t n = read(arqBench.masters[i], buffer, sizeof(buffer));
+                if (n > 0) {
+                    RelayBytes(&directions[i], buffer, (DWORD)n, arqBench.masters[1 - i], arqBench.lossPercent, &arqBench.dropped,
+                        &arqBench.forwarded);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static void BenchArqFrame(ModemConfig* modem, const FrameHeader* header, const BYTE* data, DWORD size) {
+    ArqHandleFrame(modem, header, data, size);
+}
+
+static void BenchArqDelivered(ModemConfig* modem, BYTE kind, const BYTE* data, DWORD length) {
+    (void)modem;
+    (void)kind;
+    bool match = length == arqBench.expectedLength && memcmp(data, arqBench.expected, length) == 0;
+    AtomicStoreRelease32(&arqBench.delivered, match ? 1 : -1);
+}
+
+static void BenchArqDone(ModemConfig* modem, uint16_t transferId, bool success) {
+    (void)modem;
+    (void)transferId;
+    AtomicStoreRelease32(&arqBench.finished, success ? 1 : -1);
+}
+
+int RunArqLossBench(int argc, TCHAR* argv[]) {
+    int kilobytes = argc >= 1 ? _ttoi(argv[0]) : BENCH_ARQ_DEFAULT_KB;
+    int loss = argc >= 2 ? _ttoi(argv[1]) : BENCH_ARQ_DEFAULT_LOSS;
+    int fecData = 0;
+    int fecTotal = 0;
+    if (argc >= 3) {
+        _stscanf(argv[2], TEXT("%d/%d"), &fecData, &fecTotal);
+    }
+    if (fecData <= 0 || fecTotal <= fecData || fecTotal > FEC_MAX_SHARDS) {
+        fecData = 0;
+        fecTotal = 0;
+    }
+    if (kilobytes <= 0 || kilobytes > ARQ_MAX_TRANSFER / 1024) {
+        kilobytes = BENCH_ARQ_DEFAULT_KB;
+    }
+    if (loss < 0 || loss > 90) {
+        loss = BENCH_ARQ_DEFAULT_LOSS;
+    }
+
+    memset(&arqBench, 0, sizeof(arqBench));
+    memset(&modemRegistry, 0, sizeof(modemRegistry));
+    arqBench.lossPercent = loss;
+    for (int i = 0; i < 2; i++) {
+        modemRegistry.modems[i].fecData = fecData;
+        modemRegistry.modems[i].fecParity = fecTotal - fecData;
+        if (!OpenPtyModem(i, &arqBench.masters[i])) {
+            return 1;
+        }
+    }
+    modemRegistry.count = 2;
+
+    arqBench.expectedLength = (DWORD)kilobytes * 1024;
+    arqBench.expected = (BYTE*)malloc(arqBench.expectedLength);
+    if (arqBench.expected == NULL) {
+        return 1;
+    }
+    for (DWORD i = 0; i < arqBench.expectedLength; i++) {
+        arqBench.expected[i] = (BYTE)rand();
+    }
+
+    CrcInit();
+    FecInit();
+    AtomicStoreRelease32(&arqBench.running, 1);
+    PlatformThread relay;
+    if (!PlatformThreadStart(&relay, BenchRelayThread, NULL) || !ReceiverStart(BenchArqFrame) || !ReactorStart(ReceiverPush, NULL) ||
+        !TransmitterStart(NULL) || !ArqStart(BenchArqDelivered, BenchArqDone)) {
+        _ftprintf(stderr, TEXT("Failed to start threads.\n"));
+        return 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        ReactorAdd(&modemRegistry.modems[i]);
+    }
+
+    _tprintf(TEXT("ARQ benchmark: %d KB, %d%% frame loss, window %d, timeout %d ms, fec %d/%d\n"),
+        kilobytes, loss, ARQ_DEFAULT_WINDOW, BENCH_ARQ_TIMEOUT_MS, fecData, fecTotal);
+    uint64_t startNs = PlatformNowNs();
+    ArqSend(&modemRegistry.modems[0], ARQ_KIND_MESSAGE, arqBench.expected, arqBench.expectedLength);
+    while (AtomicLoadAcquire32(&arqBench.finished) == 0) {
+        PlatformSleepMs(10);
+    }
+    double seconds = (PlatformNowNs() - startNs) / 1e9;
+
+    ArqStats stats;
+    ArqQueryStats(&modemRegistry.modems[0], &stats);
+    int32_t delivered = AtomicLoadAcquire32(&arqBench.delivered);
+    _tprintf(TEXT("result     %s\n"), AtomicLoadAcquire32(&arqBench.finished) > 0 && delivered > 0 ? TEXT("ok") :
+        delivered < 0 ? TEXT("data mismatch") : TEXT("failed"));
+    _tprintf(TEXT("time       %.2f s (%.1f KB/s)\n"), seconds, kilobytes / seconds);
+    _tprintf(TEXT("fragments  %ld sent, %ld retransmitted, %ld parity\n"), (long)stats.fragmentsSent, (long)stats.retransmissions, (long)stats.paritySent);
+    ArqQueryStats(&modemRegistry.modems[1], &stats);
+    _tprintf(TEXT("recovered  %ld fragments by FEC\n"), (long)stats.fecRecovered);
+    _tprintf(TEXT("relay      %ld frames forwarded, %ld dropped\n"), (long)arqBench.forwarded, (long)arqBench.dropped);
+
+    ReactorStop();
+    ReceiverStop();
+    TransmitterStop();
+    ArqStop();
+    AtomicStoreRelease32(&arqBench.running, 0);
+    PlatformThreadJoin(relay);
+    CloseBenchModems(arqBench.masters, 2);
+    free(arqBench.expected);
+    return AtomicLoadAcquire32(&arqBench.finished) > 0 && delivered > 0 ? 0 : 1;
+}
+
+// 링크 전환 시험: 모뎀 0/2 = 빛 링크, 1/3 = 음향 링크 (0, 1 이 보내는 쪽)
+// 빛 링크는 중간 구간에서 끊었다가 다시 잇고, 음향 링크는 BENCH_LINK_ACOUSTIC_RATE 로 속도를 제한한다.
+typedef struct {
+    int masters[4];
+    volatile int32_t running;
+    volatile int32_t lightCut;
+    volatile int32_t phase;          // 0 = 빛 연결, 1 = 빛 끊김, 2 = 복구
+    volatile int32_t delivered;
+    volatile int32_t duplicates;
+    volatile int32_t finished;       // 완료 통지 수 (확인 + 실패)
+    volatile int32_t failed;
+    volatile int32_t viaLink[2];
+    volatile int64_t phaseBytes[3];
+    BYTE* seen;
+    uint32_t* latencyUs;
+    int messages;
+} LinkBench;
+
+static LinkBench linkBench;
+
+// 한 링크의 양방향을 중계한다. rate > 0 이면 bps 로 제한 (반이중 음향 매체처럼 양방향이 나눠 씀)
+// lossPercent > 0 이면 프레임 단위로 그 확률만큼 버림
+typedef struct {
+    volatile int a;         // 장치를 뺐다 꽂는 시험에서는 바뀜 (-1 = 빠짐)
+    int b;
+    int rate;
+    volatile int32_t* cut;
+    volatile int32_t* running;
+    int lossPercent;
+    RelayDirection directions[2];
+    volatile int32_t dropped;
+    volatile int32_t forwarded;
+} LinkRelay;
+
+static DWORD WINAPI BenchLinkRelayThread(LPVOID param) {
+    LinkRelay* relay = (LinkRelay*)param;
+    BYTE buffer[256];
+    uint64_t busyUntilNs = 0; // 속도 제한: 지금까지 건넨 바이트를 rate 로 다 보내는 시각
+    while (AtomicLoadAcquire32(relay->running)) {
+        struct pollfd pfds[2] = { { relay->a, POLLIN, 0 }, { relay->b, POLLIN, 0 } };
+        if (poll(pfds, 2, 100) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (!(pfds[i].revents & POLLIN)) {
+                continue;
+            }
+            // 속도 제한이 있으면 조금씩 읽어서 보내는 쪽 pty 가 차도록 함 (송신 큐에 대기가 쌓임)
+            ssize_t n = read(pfds[i].fd, buffer, relay->rate > 0 ? 64 : sizeof(buffer));
+            if (n <= 0) {
+                continue;
+            }
+            // 매체에 싣는 시간이 지난 뒤에 건넴 (작은 명령도 전송 시간만큼 늦게 도착)
+            if (relay->rate > 0) {
+                uint64_t now = PlatformNowNs();
+                busyUntilNs = (busyUntilNs > now ? busyUntilNs : now) + (uint64_t)n * 10 * 1000000000ULL / relay->rate;
+                if (busyUntilNs > now + 1000000) {
+                    PlatformSleepMs((DWORD)((busyUntilNs - now) / 1000000));
+                }
+            }
+            if (relay->cut != NULL && AtomicLoadAcquire32(relay->cut)) {
+                // 끊긴 동안은 모두 버림
+            }
+            else if (relay->lossPercent > 0) {
+                RelayBytes(&relay->directions[i], buffer, (DWORD)n, i == 0 ? relay->b : relay->a, relay->lossPercent, &relay->dropped,
+                    &relay->forwarded);
+            }
+            else {
+                WriteAll(i == 0 ? relay->b : relay->a, buffer, (DWORD)n);
+            }
+        }
+    }
+    return 0;
+}
+
+static void BenchLinkFrame(ModemConfig* modem, const FrameHeader* header, const BYTE* data, DWORD size) {
+    SchedulerHandleFrame(modem, header, data, size);
+}
+
+static void BenchLinkDelivered(ModemConfig* modem, const BYTE* data, DWORD length) {
+    if (length < 12) {
+        return;
+    }
+    uint32_t index;
+    uint64_t sentNs;
+    memcpy(&index, data, sizeof(index));
+    memcpy(&sentNs, data + 4, sizeof(sentNs));
+    if ((int)index >= linkBench.messages) {
+        return;
+    }
+    if (linkBench.seen[index]) {
+        AtomicIncrement32(&linkBench.duplicates);
+        return;
+    }
+    linkBench.seen[index] = 1;
+    linkBench.latencyUs[index] = (uint32_t)((PlatformNowNs() - sentNs) / 1000);
+    AtomicIncrement32(&linkBench.delivered);
+    AtomicIncrement32(&linkBench.viaLink[modem == &modemRegistry.modems[2] ? 0 : 1]);
+    int32_t phase = AtomicLoadAcquire32(&linkBench.phase);
+    linkBench.phaseBytes[phase] += length; // 수신 처리 스레드만 갱신
+}
+
+static void BenchLinkDone(ModemConfig* modem, uint32_t messageId, bool success) {
+    (void)modem;
+    (void)messageId;
+    if (!success) {
+        AtomicIncrement32(&linkBench.failed);
+    }
+    AtomicIncrement32(&linkBench.finished);
+}
+
+static int CompareU32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// 링크가 up 이 될 때까지(up = true) 또는 down 이 될 때까지 기다린 시간 (ms). 시간 초과면 음수
+static double WaitLinkState(ModemConfig* modem, bool up, DWORD timeoutMs) {
+    uint64_t startNs = PlatformNowNs();
+    LinkStats stats;
+    while (PlatformNowNs() - startNs < (uint64_t)timeoutMs * 1000000ULL) {
+        if (SchedulerQueryLink(modem, &stats) && stats.up == up) {
+            return (PlatformNowNs() - startNs) / 1e6;
+        }
+        PlatformSleepMs(1);
+    }
+    return -1.0;
+}
+
+// path 를 master 의 pty 를 가리키는 심볼릭 링크로 바꾼다 (rename 이므로 감시 스레드는 완성된 링크만 봄)
+static bool LinkPtyPath(int master, const char* path) {
+    char temp[MAX_PORT_NAME + 8];
+    snprintf(temp, sizeof(temp), "%s.new", path);
+    unlink(temp);
+    return symlink(ptsname(master), temp) == 0 && rename(temp, path) == 0;
+}
+
+int RunLinkFailoverBench(int argc, TCHAR* argv[]) {
+    int phaseMs = argc >= 1 ? _ttoi(argv[0]) : BENCH_LINK_PHASE_MS;
+    if (phaseMs <= 0) {
+        phaseMs = BENCH_LINK_PHASE_MS;
+    }
+    // unplug: 빛 링크를 끊는 대신 보내는 쪽 pty 를 없앴다가 같은 경로에 새로 만듦 (USB 시리얼 어댑터 분리/재연결)
+    bool unplug = argc >= 2 && _tcsicmp(argv[1], TEXT("unplug")) == 0;
+    char lightDirectory[32];
+    char lightPath[MAX_PORT_NAME];
+    snprintf(lightDirectory, sizeof(lightDirectory), "/tmp/uhsdm-bench-%d", (int)getpid());
+    snprintf(lightPath, sizeof(lightPath), "%s/light", lightDirectory);
+
+    memset(&linkBench, 0, sizeof(linkBench));
+    memset(&modemRegistry, 0, sizeof(modemRegistry));
+    for (int i = 0; i < 4; i++) {
+        if (!OpenPtyModem(i, &linkBench.masters[i])) {
+            return 1;
+        }
+    }
+    modemRegistry.count = 4;
+    modemRegistry.modems[1].linkRate = BENCH_LINK_ACOUSTIC_RATE;
+    modemRegistry.modems[3].linkRate = BENCH_LINK_ACOUSTIC_RATE;
+    if (unplug) {
+        ModemConfig* light = &modemRegistry.modems[0];
+        CloseSerialPort(light);
+        if (mkdir(lightDirectory, 0700) != 0 || !LinkPtyPath(linkBench.masters[0], lightPath)) {
+            _ftprintf(stderr, TEXT("Failed to create %s.\n"), lightPath);
+            return 1;
+        }
+        size_t copied = _tcslen(lightPath) < MAX_PORT_NAME - 1 ? _tcslen(lightPath) : MAX_PORT_NAME - 1;
+        memcpy(light->portName, lightPath, copied * sizeof(TCHAR));
+        light->portName[copied] = TEXT('\0');
+        if (!OpenSerialPort(light)) {
+            return 1;
+        }
+    }
+    linkBench.messages = BENCH_LINK_MAX_MESSAGES;
+    linkBench.seen = (BYTE*)calloc(linkBench.messages, 1);
+    linkBench.latencyUs = (uint32_t*)calloc(linkBench.messages, sizeof(uint32_t));
+    if (linkBench.seen == NULL || linkBench.latencyUs == NULL) {
+        return 1;
+    }
+
+    CrcInit();
+    AtomicStoreRelease32(&linkBench.running, 1);
+    LinkRelay relays[2] = {
+        { linkBench.masters[0], linkBench.masters[2], 0, &linkBench.lightCut, &linkBench.running, 0, { { { 0 }, 0 }, { { 0 }, 0 } }, 0, 0 },
+        { linkBench.masters[1], linkBench.masters[3], BENCH_LINK_ACOUSTIC_RATE, NULL, &linkBench.running, 0, { { { 0 }, 0 }, { { 0 }, 0 } }, 0, 0 },
+    };
+    PlatformThread relayThreads[2];
+    ModemConfig* links[2] = { &modemRegistry.modems[0], &modemRegistry.modems[1] };
+    if (!PlatformThreadStart(&relayThreads[0], BenchLinkRelayThread, &relays[0]) || !PlatformThreadStart(&relayThreads[1], BenchLinkRelayThread, &relays[1]) ||
+        !ReceiverStart(BenchLinkFrame) || !ReactorStart(ReceiverPush, unplug ? HotplugPortFailed : NULL) || !TransmitterStart(NULL) ||
+        !SchedulerStart(links, 2, BenchLinkDelivered, BenchLinkDone)) {
+        _ftprintf(stderr, TEXT("Failed to start threads.\n"));
+        return 1;
+    }
+    for (int i = 0; i < 4; i++) {
+        ReactorAdd(&modemRegistry.modems[i]);
+    }
+    if (unplug && !HotplugStart(NULL)) {
+        _ftprintf(stderr, TEXT("Failed to start port watcher.\n"));
+        return 1;
+    }
+
+    _tprintf(TEXT("Link failover benchmark: light unthrottled%s, acoustic %d bps, %d ms per phase, %d byte messages\n"),
+        unplug ? TEXT(" and unplugged in the middle phase") : TEXT(""), BENCH_LINK_ACOUSTIC_RATE, phaseMs, BENCH_LINK_MESSAGE_SIZE);
+    double lightUpMs = WaitLinkState(links[0], true, 5000);
+    WaitLinkState(links[1], true, 5000);
+
+    // 단계마다 phaseMs 동안 창(BENCH_LINK_WINDOW) 이 허용하는 만큼 계속 보냄
+    BYTE message[BENCH_LINK_MESSAGE_SIZE];
+    memset(message, 'x', sizeof(message));
+    int sent = 0;
+    double downMs = -1.0;
+    double recoverMs = -1.0;
+    for (int phase = 0; phase < 3; phase++) {
+        AtomicStoreRelease32(&linkBench.phase, phase);
+        AtomicStoreRelease32(&linkBench.lightCut, phase == 1 ? 1 : 0);
+        if (unplug && phase == 1) {
+            // 장치 노드가 사라지고 열린 포트는 EIO 로 끝남
+            int master = linkBench.masters[0];
+            relays[0].a = -1;
+            linkBench.masters[0] = -1;
+            unlink(lightPath);
+            close(master);
+        }
+        else if (unplug && phase == 2) {
+            int master = posix_openpt(O_RDWR | O_NOCTTY);
+            if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 || !LinkPtyPath(master, lightPath)) {
+                _ftprintf(stderr, TEXT("Failed to replug %s.\n"), lightPath);
+            }
+            linkBench.masters[0] = master;
+            relays[0].a = master;
+        }
+        uint64_t phaseStartNs = PlatformNowNs();
+        bool stateSeen = phase == 0;
+        while (PlatformNowNs() - phaseStartNs < (uint64_t)phaseMs * 1000000ULL && sent < linkBench.messages) {
+            LinkStats light;
+            if (!stateSeen && SchedulerQueryLink(links[0], &light) && light.up == (phase == 2)) {
+                stateSeen = true;
+                double elapsedMs = (PlatformNowNs() - phaseStartNs) / 1e6;
+                if (phase == 1) {
+                    downMs = elapsedMs;
+                }
+                else {
+                    recoverMs = elapsedMs;
+                }
+            }
+            if (sent - AtomicLoadAcquire32(&linkBench.finished) >= BENCH_LINK_WINDOW) {
+                PlatformSleepMs(1);
+                continue;
+            }
+            uint32_t index = (uint32_t)sent;
+            uint64_t nowNs = PlatformNowNs();
+            memcpy(message, &index, sizeof(index));
+            memcpy(message + 4, &nowNs, sizeof(nowNs));
+            if (SchedulerSend(message, sizeof(message)) != 0) {
+                sent++;
+            }
+            else {
+                PlatformSleepMs(1);
+            }
+        }
+    }
+    // 남은 메시지의 확인을 기다림
+    uint64_t waitStartNs = PlatformNowNs();
+    while (AtomicLoadAcquire32(&linkBench.finished) < sent && PlatformNowNs() - waitStartNs < 30 * BENCH_TIMEOUT_NS) {
+        PlatformSleepMs(10);
+    }
+
+    SchedulerStats stats;
+    SchedulerQueryStats(&stats);
+    int delivered = AtomicLoadAcquire32(&linkBench.delivered);
+    uint32_t* latencies = (uint32_t*)malloc(sizeof(uint32_t) * (delivered > 0 ? delivered : 1));
+    int count = 0;
+    for (int i = 0; i < sent && latencies != NULL; i++) {
+        if (linkBench.seen[i]) {
+            latencies[count++] = linkBench.latencyUs[i];
+        }
+    }
+    if (latencies != NULL && count > 0) {
+        qsort(latencies, count, sizeof(uint32_t), CompareU32);
+    }
+
+    bool ok = delivered == sent && AtomicLoadAcquire32(&linkBench.duplicates) == 0;
+    _tprintf(TEXT("result     %s: %d of %d messages delivered once (%ld failed, %ld duplicates dropped by receiver)\n"), ok ? TEXT("ok") : TEXT("failed"),
+        delivered, sent, (long)AtomicLoadAcquire32(&linkBench.failed), (long)stats.duplicates);
+    _tprintf(TEXT("links      light %ld, acoustic %ld deliveries, %ld resent on another link\n"),
+        (long)linkBench.viaLink[0], (long)linkBench.viaLink[1], (long)stats.rerouted);
+    _tprintf(TEXT("startup    light up after %.0f ms\n"), lightUpMs);
+    _tprintf(TEXT("failover   light marked down %.0f ms after cut, longest rerouted delivery %.0f ms\n"), downMs, stats.maxFailoverMs);
+    _tprintf(TEXT("recovery   light up again %.0f ms after reconnect\n"), recoverMs);
+    if (unplug) {
+        LinkStats light;
+        SchedulerQueryLink(links[0], &light);
+        const ModemMetrics* metrics = &links[0]->metrics;
+        _tprintf(TEXT("hotplug    %ld disconnects, %ld reconnects, port offline %.0f ms; %ld failovers, first delivery on acoustic %.1f ms after unplug\n"),
+            (long)metrics->disconnects, (long)metrics->reconnects, AtomicLoadAcquire64(&metrics->lastReconnectUs) / 1000.0, (long)light.failovers,
+            light.lastFailoverMs);
+    }
+    if (count > 0) {
+        _tprintf(TEXT("latency    median %.1f ms, p99 %.1f ms, max %.1f ms\n"), latencies[count / 2] / 1000.0,
+            latencies[(count * 99) / 100] / 1000.0, latencies[count - 1] / 1000.0);
+    }
+    const TCHAR* phaseNames[3] = { TEXT("light up"), TEXT("light cut"), TEXT("restored") };
+    for (int phase = 0; phase < 3; phase++) {
+        _tprintf(TEXT("throughput %-9s %8.1f KB/s\n"), phaseNames[phase], linkBench.phaseBytes[phase] / (phaseMs / 1000.0) / 1024.0);
+    }
+    free(latencies);
+
+    HotplugStop();
+    ReactorStop();
+    ReceiverStop();
+    SchedulerStop();
+    TransmitterStop();
+    AtomicStoreRelease32(&linkBench.running, 0);
+    PlatformThreadJoin(relayThreads[0]);
+    PlatformThreadJoin(relayThreads[1]);
+    CloseBenchModems(linkBench.masters, 4);
+    if (unplug) {
+        unlink(lightPath);
+        rmdir(lightDirectory);
+    }
+    free(linkBench.seen);
+    free(linkBench.latencyUs);
+    return ok ? 0 : 1;
+}
+
+// 묶음 전송 시험: 모뎀 0/2 = 빛 링크, 1/3 = 음향 링크 (0, 1 이 보내는 쪽). 두 링크 모두 속도를 제한한다
+typedef struct {
+    int masters[4];
+    volatile int32_t running;
+    BYTE* expected;
+    DWORD expectedLength;
+    volatile int32_t delivered;  // 1 = 일치, -1 = 불일치
+    volatile int32_t finished;   // 1 = 성공, -1 = 실패
+    BondReport report;
+} BondBench;
+
+static BondBench bondBench;
+
+static void BenchBondDelivered(ModemConfig* modem, BYTE kind, const BYTE* data, DWORD length) {
+    (void)modem;
+    (void)kind;
+    bool match = length == bondBench.expectedLength && memcmp(data, bondBench.expected, length) == 0;
+    AtomicStoreRelease32(&bondBench.delivered, match ? 1 : -1);
+}
+
+static void BenchBondDone(uint16_t transferId, bool success, const BondReport* report) {
+    (void)transferId;
+    bondBench.report = *report;
+    AtomicStoreRelease32(&bondBench.finished, success ? 1 : -1);
+}
+
+// links 로 묶음 전송 하나를 보내고 처리량(KB/s)을 반환한다. 실패하면 음수
+static double MeasureBond(const TCHAR* name, ModemConfig* const* links, int count) {
+    AtomicStoreRelease32(&bondBench.delivered, 0);
+    AtomicStoreRelease32(&bondBench.finished, 0);
+    if (!SchedulerStart(links, count, NULL, NULL) || !BondStart(BenchBondDelivered, BenchBondDone)) {
+        _ftprintf(stderr, TEXT("Failed to start threads.\n"));
+        return -1.0;
+    }
+    // 시작 시간에 PROBE 로 링크를 확인하는 시간은 넣지 않음
+    for (int i = 0; i < count; i++) {
+        WaitLinkState(links[i], true, 5000);
+    }
+    BondSend(ARQ_KIND_MESSAGE, bondBench.expected, bondBench.expectedLength);
+    uint64_t startNs = PlatformNowNs();
+    while ((AtomicLoadAcquire32(&bondBench.finished) == 0 || AtomicLoadAcquire32(&bondBench.delivered) == 0) &&
+        PlatformNowNs() - startNs < 600 * BENCH_TIMEOUT_NS) {
+        PlatformSleepMs(10);
+    }
+    bool ok = AtomicLoadAcquire32(&bondBench.finished) > 0 && AtomicLoadAcquire32(&bondBench.delivered) > 0;
+    double seconds = bondBench.report.elapsedNs / 1e9;
+    double throughput = ok && seconds > 0.0 ? bondBench.expectedLength / seconds / 1024.0 : -1.0;
+
+    _tprintf(TEXT("%-9s %-13s %6.2f s %8.1f KB/s   chunks light %4ld, acoustic %4ld   rate"), name,
+        ok ? TEXT("ok") : AtomicLoadAcquire32(&bondBench.delivered) < 0 ? TEXT("data mismatch") : TEXT("failed"),
+        seconds, throughput > 0.0 ? throughput : 0.0, (long)bondBench.report.chunks[0], (long)bondBench.report.chunks[1]);
+    for (int i = 0; i < count; i++) {
+        LinkStats stats;
+        if (SchedulerQueryLink(links[i], &stats)) {
+            _tprintf(TEXT(" %s %d bps%s"), i == 0 ? TEXT("") : TEXT(","), stats.rateBps, stats.rateMeasured ? TEXT("") : TEXT(" (LinkRate)"));
+        }
+    }
+    _tprintf(TEXT("\n"));
+    SchedulerStop();
+    BondStop();
+    return throughput;
+}
+
+int RunBondBench(int argc, TCHAR* argv[]) {
+    int kilobytes = argc >= 1 ? _ttoi(argv[0]) : BENCH_BOND_DEFAULT_KB;
+    int lightRate = argc >= 2 ? _ttoi(argv[1]) : BENCH_BOND_LIGHT_RATE;
+    int acousticRate = argc >= 3 ? _ttoi(argv[2]) : BENCH_BOND_ACOUSTIC_RATE;
+    if (kilobytes <= 0 || kilobytes > BOND_MAX_TRANSFER / 1024) {
+        kilobytes = BENCH_BOND_DEFAULT_KB;
+    }
+    lightRate = lightRate > 0 ? lightRate : BENCH_BOND_LIGHT_RATE;
+    acousticRate = acousticRate > 0 ? acousticRate : BENCH_BOND_ACOUSTIC_RATE;
+
+    memset(&bondBench, 0, sizeof(bondBench));
+    memset(&modemRegistry, 0, sizeof(modemRegistry));
+    for (int i = 0; i < 4; i++) {
+        if (!OpenPtyModem(i, &bondBench.masters[i])) {
+            return 1;
+        }
+    }
+    modemRegistry.count = 4;
+    bondBench.expectedLength = (DWORD)kilobytes * 1024;
+    bondBench.expected = (BYTE*)malloc(bondBench.expectedLength);
+    if (bondBench.expected == NULL) {
+        return 1;
+    }
+    for (DWORD i = 0; i < bondBench.expectedLength; i++) {
+        bondBench.expected[i] = (BYTE)rand();
+    }
+
+    // LinkRate 는 두 링크 모두 기본값 그대로 두어 조각 배분이 측정한 속도를 따르는지 확인
+    CrcInit();
+    AtomicStoreRelease32(&bondBench.running, 1);
+    LinkRelay relays[2] = {
+        { bondBench.masters[0], bondBench.masters[2], lightRate, NULL, &bondBench.running, 0, { { { 0 }, 0 }, { { 0 }, 0 } }, 0, 0 },
+        { bondBench.masters[1], bondBench.masters[3], acousticRate, NULL, &bondBench.running, 0, { { { 0 }, 0 }, { { 0 }, 0 } }, 0, 0 },
+    };
+    PlatformThread relayThreads[2];
+    if (!PlatformThreadStart(&relayThreads[0], BenchLinkRelayThread, &relays[0]) || !PlatformThreadStart(&relayThreads[1], BenchLinkRelayThread, &relays[1]) ||
+        !ReceiverStart(BenchLinkFrame) || !ReactorStart(ReceiverPush, NULL) || !TransmitterStart(NULL)) {
+        _ftprintf(stderr, TEXT("Failed to start threads.\n"));
+        return 1;
+    }
+    for (int i = 0; i < 4; i++) {
+        ReactorAdd(&modemRegistry.modems[i]);
+    }
+
+    _tprintf(TEXT("Bonding benchmark: %d KB, light %d bps, acoustic %d bps, %d byte chunks\n"), kilobytes, lightRate, acousticRate, BOND_CHUNK_SIZE);
+    ModemConfig* light = &modemRegistry.modems[0];
+    ModemConfig* acoustic = &modemRegistry.modems[1];
+    ModemConfig* both[2] = { light, acoustic };
+    double lightOnly = MeasureBond(TEXT("light"), &light, 1);
+    double acousticOnly = MeasureBond(TEXT("acoustic"), &acoustic, 1);
+    double bonded = MeasureBond(TEXT("bonded"), both, 2);
+    bool ok = lightOnly > 0.0 && acousticOnly > 0.0 && bonded > 0.0;
+    if (ok) {
+        _tprintf(TEXT("bonded throughput is %.0f%% of light + acoustic (%.1f KB/s)\n"), 100.0 * bonded / (lightOnly + acousticOnly), lightOnly + acousticOnly);
+    }
+
+    ReactorStop();
+    ReceiverStop();
+    TransmitterStop();
+    AtomicStoreRelease32(&bondBench.running, 0);
+    PlatformThreadJoin(relayThreads[0]);
+    PlatformThreadJoin(relayThreads[1]);
+    CloseBenchModems(bondBench.masters, 4);
+    free(bondBench.expected);
+    return ok ? 0 : 1;
+}
+
+// 중복 전송 시험: 모뎀 0/2 = 손실이 있는 빛 링크, 1/3 = 음향 링크 (BENCH_LINK_ACOUSTIC_RATE, 손실 없음)
+// 작은 명령을 하나씩 보내 보낸 때부터 수신 측에 전달될 때까지의 지연을 모드별로 잰다.
+typedef struct {
+    int masters[4];
+    volatile int32_t running;
+    int commands;
+    BYTE run;                     // 모드마다 바뀜. 앞 모드에서 늦게 도착한 사본을 구별
+    BYTE* seen;
+    uint32_t* latencyUs;
+    volatile int32_t delivered;
+    volatile int32_t duplicates;  // 수신 측 중복 검사를 통과한 중복 (0 이어야 함)
+    volatile int32_t finished;
+    volatile int32_t failed;
+    volatile int32_t wins[2];     // 먼저 도착한 사본의 링크 (0 = 빛, 1 = 음향)
+} RedundantBench;
+
+static RedundantBench redundantBench;
+
+static void BenchRedundantDelivered(ModemConfig* modem, const BYTE* data, DWORD length) {
+    if (length < 13 || data[12] != redundantBench.run) {
+        return;
+    }
+    uint32_t index;
+    uint64_t sentNs;
+    memcpy(&index, data, sizeof(index));
+    memcpy(&sentNs, data + 4, sizeof(sentNs));
+    if ((int)index >= redundantBench.commands) {
+        return;
+    }
+    if (redundantBench.seen[index]) {
+        AtomicIncrement32(&redundantBench.duplicates);
+        return;
+    }
+    redundantBench.seen[index] = 1;
+    redundantBench.latencyUs[index] = (uint32_t)((PlatformNowNs() - sentNs) / 1000);
+    AtomicIncrement32(&redundantBench.wins[modem == &modemRegistry.modems[2] ? 0 : 1]);
+    AtomicIncrement32(&redundantBench.delivered);
+}
+
+static void BenchRedundantDone(ModemConfig* modem, uint32_t messageId, bool success) {
+    (void)modem;
+    (void)messageId;
+    if (!success) {
+        AtomicIncrement32(&redundantBench.failed);
+    }
+    AtomicIncrement32(&redundantBench.finished);
+}
+
+// links 로 명령을 BENCH_REDUNDANT_INTERVAL_MS 간격으로 보내고 지연 분포를 출력한다. 모두 한 번씩 전달되면 true
+static bool MeasureRedundant(const TCHAR* name, ModemConfig* const* links, int count, bool redundant) {
+    memset(redundantBench.seen, 0, redundantBench.commands);
+    redundantBench.run++;
+    AtomicStoreRelease32(&redundantBench.delivered, 0);
+    AtomicStoreRelease32(&redundantBench.duplicates, 0);
+    AtomicStoreRelease32(&redundantBench.finished, 0);
+    AtomicStoreRelease32(&redundantBench.failed, 0);
+    AtomicStoreRelease32(&redundantBench.wins[0], 0);
+    AtomicStoreRelease32(&redundantBench.wins[1], 0);
+    if (!SchedulerStart(links, count, BenchRedundantDelivered, BenchRedundantDone)) {
+        _ftprintf(stderr, TEXT("Failed to start link scheduler.\n"));
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        WaitLinkState(links[i], true, 5000);
+    }
+
+    BYTE command[BENCH_REDUNDANT_COMMAND_SIZE];
+    memset(command, 'c', sizeof(command));
+    command[12] = redundantBench.run;
+    int sent = 0;
+    while (sent < redundantBench.commands) {
+        uint32_t index = (uint32_t)sent;
+        uint64_t nowNs = PlatformNowNs();
+        memcpy(command, &index, sizeof(index));
+        memcpy(command + 4, &nowNs, sizeof(nowNs));
+        if ((redundant ? SchedulerSendRedundant(command, sizeof(command)) : SchedulerSend(command, sizeof(command))) != 0) {
+            sent++;
+        }
+        PlatformSleepMs(BENCH_REDUNDANT_INTERVAL_MS);
+    }
+    uint64_t waitStartNs = PlatformNowNs();
+    while (AtomicLoadAcquire32(&redundantBench.finished) < sent && PlatformNowNs() - waitStartNs < 30 * BENCH_TIMEOUT_NS) {
+        PlatformSleepMs(10);
+    }
+    SchedulerStats stats;
+    SchedulerQueryStats(&stats);
+    SchedulerStop();
+
+    int delivered = AtomicLoadAcquire32(&redundantBench.delivered);
+    int samples = 0;
+    for (int i = 0; i < sent; i++) {
+        if (redundantBench.seen[i]) {
+            redundantBench.latencyUs[samples++] = redundantBench.latencyUs[i];
+        }
+    }
+    bool ok = delivered == sent && AtomicLoadAcquire32(&redundantBench.duplicates) == 0;
+    _tprintf(TEXT("%-9s %-7s %3d/%-3d"), name, ok ? TEXT("ok") : TEXT("failed"), delivered, sent);
+    if (samples > 0) {
+        qsort(redundantBench.latencyUs, samples, sizeof(uint32_t), CompareU32);
+        _tprintf(TEXT("  p50 %7.1f ms  p99 %7.1f ms  max %7.1f ms"), redundantBench.latencyUs[samples / 2] / 1000.0,
+            redundantBench.latencyUs[(samples * 99) / 100] / 1000.0, redundantBench.latencyUs[samples - 1] / 1000.0);
+    }
+    _tprintf(TEXT("  first light %3ld, acoustic %3ld, %ld duplicates dropped\n"), (long)redundantBench.wins[0], (long)redundantBench.wins[1],
+        (long)stats.duplicates);
+    return ok;
+}
+
+int RunRedundantBench(int argc, TCHAR* argv[]) {
+    int commands = argc >= 1 ? _ttoi(argv[0]) : BENCH_REDUNDANT_COMMANDS;
+    int lossPercent = argc >= 2 ? _ttoi(argv[1]) : BENCH_REDUNDANT_LOSS;
+    if (commands <= 0) {
+        commands = BENCH_REDUNDANT_COMMANDS;
+    }
+    if (lossPercent < 0 || lossPercent > 100) {
+        lossPercent = BENCH_REDUNDANT_LOSS;
+    }
+
+    memset(&redundantBench, 0, sizeof(redundantBench));
+    memset(&modemRegistry, 0, sizeof(modemRegistry));
+    for (int i = 0; i < 4; i++) {
+        if (!OpenPtyModem(i, &redundantBench.masters[i])) {
+            return 1;
+        }
+    }
+    modemRegistry.count = 4;
+    modemRegistry.modems[1].linkRate = BENCH_LINK_ACOUSTIC_RATE;
+    modemRegistry.modems[3].linkRate = BENCH_LINK_ACOUSTIC_RATE;
+    redundantBench.commands = commands;
+    redundantBench.seen = (BYTE*)calloc(commands, 1);
+    redundantBench.latencyUs = (uint32_t*)calloc(commands, sizeof(uint32_t));
+    if (redundantBench.seen == NULL || redundantBench.latencyUs == NULL) {
+        return 1;
+    }
+
+    CrcInit();
+    AtomicStoreRelease32(&redundantBench.running, 1);
+    static LinkRelay relays[2];
+    relays[0] = (LinkRelay){ redundantBench.masters[0], redundantBench.masters[2], 0, NULL, &redundantBench.running, lossPercent,
+        { { { 0 }, 0 }, { { 0 }, 0 } }, 0, 0 };
+    relays[1] = (LinkRelay){ redundantBench.masters[1], redundantBench.masters[3], BENCH_LINK_ACOUSTIC_RATE, NULL, &redundantBench.running, 0,
+        { { { 0 }, 0 }, { { 0 }, 0 } }, 0, 0 };
+    PlatformThread relayThreads[2];
+    if (!PlatformThreadStart(&relayThreads[0], BenchLinkRelayThread, &relays[0]) || !PlatformThreadStart(&relayThreads[1], BenchLinkRelayThread, &relays[1]) ||
+        !ReceiverStart(BenchLinkFrame) || !ReactorStart(ReceiverPush, NULL) || !TransmitterStart(NULL)) {
+        _ftprintf(stderr, TEXT("Failed to start threads.\n"));
+        return 1;
+    }
+    for (int i = 0; i < 4; i++) {
+        ReactorAdd(&modemRegistry.modems[i]);
+    }
+
+    _tprintf(TEXT("Redundant send benchmark: %d commands of %d bytes every %d ms, light %d%% frame loss, acoustic %d bps\n"),
+        commands, BENCH_REDUNDANT_COMMAND_SIZE, BENCH_REDUNDANT_INTERVAL_MS, lossPercent, BENCH_LINK_ACOUSTIC_RATE);
+    ModemConfig* light = &modemRegistry.modems[0];
+    ModemConfig* acoustic = &modemRegistry.modems[1];
+    ModemConfig* both[2] = { light, acoustic };
+    bool ok = MeasureRedundant(TEXT("light"), &light, 1, false);
+    ok = MeasureRedundant(TEXT("acoustic"), &acoustic, 1, false) && ok;
+    ok = MeasureRedundant(TEXT("auto"), both, 2, false) && ok;
+    ok = MeasureRedundant(TEXT("all"), both, 2, true) && ok;
+    _tprintf(TEXT("relay     light %ld frames forwarded, %ld dropped\n"), (long)relays[0].forwarded, (long)relays[0].dropped);
+
+    ReactorStop();
+    ReceiverStop();
+    TransmitterStop();
+    AtomicStoreRelease32(&redundantBench.running, 0);
+    PlatformThreadJoin(relayThreads[0]);
+    PlatformThreadJoin(relayThreads[1]);
+    CloseBenchModems(redundantBench.masters, 4);
+    free(redundantBench.seen);
+    free(redundantBench.latencyUs);
+    return ok ? 0 : 1;
+}
+
+// 벤치마크 모음: 에뮬레이터 링크(EMU:bench-suite, Emulator=wire) 로 연결한 모뎀 0 -> 1 로
+// 속도 x 메시지 크기마다 프레임 메시지를 BENCH_SUITE_WINDOW 개씩 겹쳐 보내고 결과를 CSV/JSON 으로 출력한다.
+typedef struct {
+    int size;
+    volatile int32_t delivered;
+    volatile int32_t finished;
+    volatile int64_t lastNs;     // 마지막 전달 시각
+    uint32_t* latencyUs;         // 수신 처리 스레드만 씀
+} SuiteBench;
+
+static SuiteBench suiteBench;
+
+static void BenchSuiteFrame(ModemConfig* modem, const FrameHeader* header, const BYTE* data, DWORD size) {
+    if (modem != &modemRegistry.modems[1] || header == NULL || header->type != FRAME_TYPE_DATA || (int)size != suiteBench.size) {
+        return;
+    }
+    uint64_t sentNs;
+    memcpy(&sentNs, data, sizeof(sentNs));
+    uint64_t nowNs = PlatformNowNs();
+    int32_t index = AtomicLoadAcquire32(&suiteBench.delivered);
+    if (index < BENCH_SUITE_MAX_MESSAGES) {
+        suiteBench.latencyUs[index] = (uint32_t)((nowNs - sentNs) / 1000);
+    }
+    AtomicStoreRelease64(&suiteBench.lastNs, (int64_t)nowNs);
+    AtomicStoreRelease32(&suiteBench.delivered, index + 1);
+}
+
+static void BenchSuiteDone(ModemConfig* modem, uint32_t messageId, bool success) {
+    (void)modem;
+    (void)messageId;
+    (void)success;
+    AtomicIncrement32(&suiteBench.finished);
+}
+
+// 정렬된 latencies 의 permille/1000 백분위 (us)
+static uint32_t Percentile(const uint32_t* latencies, int count, int permille) {
+    int index = (int)((int64_t)count * permille / 1000);
+    return latencies[index < count ? index : count - 1];
+}
+
+// 에뮬레이터 링크 port (Emulator=profile. wire 는 baudRate 로 제한, 손실 없음) 로 연결한 프레임 모드 모뎀 0, 1 을 열고 스레드를 시작한다
+static bool OpenEmulatorPair(const TCHAR* port, const TCHAR* profile, int baudRate, ReceiverDeliverProc receive, TransmitDoneProc done) {
+    memset(&modemRegistry, 0, sizeof(modemRegistry));
+    for (int i = 0; i < 2; i++) {
+        ModemConfig* modem = &modemRegistry.modems[i];
+        _tcscpy(modem->portName, port);
+        _stprintf(modem->name, TEXT("bench%d"), i);
+        _tcscpy(modem->emulator, profile);
+        modem->baudRate = baudRate;
+        modem->byteSize = 8;
+        modem->stopBits = ONESTOPBIT;
+        modem->parity = NOPARITY;
+        modem->hSerial = INVALID_HANDLE_VALUE;
+        modem->framing = FRAMING_COBS;
+        modem->linkRate = baudRate;
+        if (!RingInit(&modem->rxRing, RING_DEFAULT_SIZE) || !FrameParserInit(&modem->rxFrame) || !OpenSerialPort(modem)) {
+            return false;
+        }
+    }
+    modemRegistry.count = 2;
+    ClockSyncInit();
+    if (!ReceiverStart(receive) || !ReactorStart(ReceiverPush, NULL) || !TransmitterStart(done)) {
+        _ftprintf(stderr, TEXT("Failed to start threads.\n"));
+        return false;
+    }
+    ReactorAdd(&modemRegistry.modems[0]);
+    ReactorAdd(&modemRegistry.modems[1]);
+    return true;
+}
+
+static void CloseEmulatorPair(void) {
+    ReactorStop();
+    ReceiverStop();
+    TransmitterStop();
+    for (int i = 0; i < 2; i++) {
+        CloseSerialPort(&modemRegistry.modems[i]);
+        RingFree(&modemRegistry.modems[i].rxRing);
+        FrameParserFree(&modemRegistry.modems[i].rxFrame);
+    }
+}
+
+// 속도 하나에 대해 에뮬레이터 링크를 열고 크기마다 측정해 한 줄씩 출력한다. 실패가 있으면 false
+static bool MeasureSuiteRate(FILE* out, bool json, bool* firstRow, int baudRate, const int* sizes, int sizeCount, int pointMs) {
+    if (!OpenEmulatorPair(TEXT("EMU:bench-suite"), TEXT("wire"), baudRate, BenchSuiteFrame, BenchSuiteDone)) {
+        return false;
+    }
+
+    ModemConfig* tx = &modemRegistry.modems[0];
+    BYTE message[FRAME_MAX_PAYLOAD];
+    memset(message, 'p', sizeof(message));
+    bool ok = true;
+    for (int s = 0; s < sizeCount; s++) {
+        suiteBench.size = sizes[s];
+        AtomicStoreRelease32(&suiteBench.delivered, 0);
+        AtomicStoreRelease32(&suiteBench.finished, 0);
+        uint64_t cpuStartNs = PlatformCpuTimeNs();
+        uint64_t startNs = PlatformNowNs();
+        AtomicStoreRelease64(&suiteBench.lastNs, (int64_t)startNs);
+
+        // pointMs 동안 (느린 속도에서도 최소 BENCH_SUITE_MIN_MESSAGES 개) 창이 허용하는 만큼 계속 보냄
+        int sent = 0;
+        while (sent < BENCH_SUITE_MAX_MESSAGES &&
+            (PlatformNowNs() - startNs < (uint64_t)pointMs * 1000000ULL || sent < BENCH_SUITE_MIN_MESSAGES)) {
+            if (sent - AtomicLoadAcquire32(&suiteBench.delivered) >= BENCH_SUITE_WINDOW) {
+                PlatformSleepMs(0);
+                if (PlatformNowNs() - (uint64_t)AtomicLoadAcquire64(&suiteBench.lastNs) > 10 * BENCH_TIMEOUT_NS) {
+                    break; // 전달이 멈춤
+                }
+                continue;
+            }
+            uint64_t nowNs = PlatformNowNs();
+            memcpy(message, &nowNs, sizeof(nowNs));
+            if (TransmitEnqueue(tx, FRAME_TYPE_DATA, message, (DWORD)sizes[s]) != 0) {
+                sent++;
+            }
+            else {
+                PlatformSleepMs(1);
+            }
+        }
+        uint64_t waitStartNs = PlatformNowNs();
+        while (AtomicLoadAcquire32(&suiteBench.delivered) < sent && PlatformNowNs() - waitStartNs < 10 * BENCH_TIMEOUT_NS) {
+            PlatformSleepMs(1);
+        }
+
+        int delivered = AtomicLoadAcquire32(&suiteBench.delivered);
+        uint64_t elapsedNs = (uint64_t)AtomicLoadAcquire64(&suiteBench.lastNs) - startNs;
+        uint64_t cpuNs = PlatformCpuTimeNs() - cpuStartNs;
+        int samples = delivered < BENCH_SUITE_MAX_MESSAGES ? delivered : BENCH_SUITE_MAX_MESSAGES;
+        double seconds = elapsedNs > 0 ? elapsedNs / 1e9 : 1e-9;
+        double bytes = (double)delivered * sizes[s];
+        uint32_t p50 = 0;
+        uint32_t p99 = 0;
+        uint32_t p999 = 0;
+        if (samples > 0) {
+            qsort(suiteBench.latencyUs, samples, sizeof(uint32_t), CompareU32);
+            p50 = Percentile(suiteBench.latencyUs, samples, 500);
+            p99 = Percentile(suiteBench.latencyUs, samples, 990);
+            p999 = Percentile(suiteBench.latencyUs, samples, 999);
+        }
+        bool pointOk = delivered == sent && sent > 0;
+        ok = ok && pointOk;
+        if (json) {
+            _ftprintf(out, TEXT("%s  {\"baud\": %d, \"payload\": %d, \"ok\": %s, \"sent\": %d, \"delivered\": %d, \"msg_per_s\": %.1f, ")
+                TEXT("\"goodput_bps\": %.0f, \"line_usage\": %.3f, \"p50_us\": %lu, \"p99_us\": %lu, \"p999_us\": %lu, \"cpu_ns_per_byte\": %.1f}"),
+                *firstRow ? TEXT("") : TEXT(",\n"), baudRate, sizes[s], pointOk ? TEXT("true") : TEXT("false"), sent, delivered, delivered / seconds,
+                bytes * 8.0 / seconds, bytes * 10.0 / seconds / baudRate, (unsigned long)p50, (unsigned long)p99, (unsigned long)p999,
+                bytes > 0.0 ? cpuNs / bytes : 0.0);
+        }
+        else {
+            _ftprintf(out, TEXT("%d,%d,%d,%d,%d,%.1f,%.0f,%.3f,%lu,%lu,%lu,%.1f\n"), baudRate, sizes[s], pointOk ? 1 : 0, sent, delivered,
+                delivered / seconds, bytes * 8.0 / seconds, bytes * 10.0 / seconds / baudRate, (unsigned long)p50, (unsigned long)p99,
+                (unsigned long)p999, bytes > 0.0 ? cpuNs / bytes : 0.0);
+        }
+        fflush(out);
+        *firstRow = false;
+        _ftprintf(stderr, TEXT("  %6d bps %5d bytes: %s, %.1f msg/s\n"), baudRate, sizes[s], pointOk ? TEXT("ok") : TEXT("failed"), delivered / seconds);
+    }
+
+    CloseEmulatorPair();
+    return ok;
+}
+
+int RunBenchSuite(int argc, TCHAR* argv[]) {
+    bool json = argc >= 1 && _tcsicmp(argv[0], TEXT("json")) == 0;
+    int pointMs = argc >= 2 ? _ttoi(argv[1]) : BENCH_SUITE_POINT_MS;
+    if (pointMs <= 0) {
+        pointMs = BENCH_SUITE_POINT_MS;
+    }
+    FILE* out = stdout;
+    if (argc >= 3 && (out = _tfopen(argv[2], TEXT("w"))) == NULL) {
+        _ftprintf(stderr, TEXT("Cannot open %s\n"), argv[2]);
+        return 1;
+    }
+
+    // 설정에서 받아들이는 속도만 측정. 250000 은 표준이 아닌 속도 (POSIX 는 termios2 BOTHER 경로)
+    static const int candidateRates[] = { 300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400, 250000, 460800, 921600,
+        1000000, 2000000, 3000000, 4000000 };
+    static const int sizes[] = { 16, 64, 256, 1024 };
+    suiteBench.latencyUs = (uint32_t*)malloc(sizeof(uint32_t) * BENCH_SUITE_MAX_MESSAGES);
+    if (suiteBench.latencyUs == NULL) {
+        return 1;
+    }
+
+    CrcInit();
+    _ftprintf(stderr, TEXT("Benchmark suite: emulated wire link, %d ms per point, window %d messages\n"), pointMs, BENCH_SUITE_WINDOW);
+    if (json) {
+        _ftprintf(out, TEXT("[\n"));
+    }
+    else {
+        _ftprintf(out, TEXT("baud,payload,ok,sent,delivered,msg_per_s,goodput_bps,line_usage,p50_us,p99_us,p999_us,cpu_ns_per_byte\n"));
+    }
+    bool ok = true;
+    bool firstRow = true;
+    for (size_t i = 0; i < sizeof(candidateRates) / sizeof(candidateRates[0]); i++) {
+        if (IsValidBaudRate(candidateRates[i])) {
+            ok = MeasureSuiteRate(out, json, &firstRow, candidateRates[i], sizes, sizeof(sizes) / sizeof(sizes[0]), pointMs) && ok;
+        }
+    }
+    if (json) {
+        _ftprintf(out, TEXT("\n]\n"));
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    EmulatorStop();
+    free(suiteBench.latencyUs);
+    return ok ? 0 : 1;
+}
+
+// 우선순위 시험: 느린 에뮬레이터 링크(EMU:bench-priority) 로 연결한 모뎀 0 -> 1 에 큰 BULK 메시지를 늘 쌓아 두고
+// 짧은 명령을 BENCH_PRIORITY_INTERVAL_MS 간격으로 넣어, 넣은 때부터 수신 측에 전달될 때까지의 지연을 모드별로 잰다.
+// 명령은 'C', run, 번호(4), 보낸 시각(8) 로 시작하고 BULK 데이터는 'b' 로 채우므로 조각 크기와 관계없이 구별된다.
+typedef struct {
+    BYTE run;                     // 모드마다 바뀜
+    int commands;
+    BYTE* seen;
+    uint32_t* latencyUs;          // 수신 처리 스레드만 씀
+    volatile int32_t delivered;
+    volatile int64_t bulkBytes;   // 전달된 BULK 바이트
+} PriorityBench;
+
+static PriorityBench priorityBench;
+
+static void BenchPriorityFrame(ModemConfig* modem, const FrameHeader* header, const BYTE* data, DWORD size) {
+    if (modem != &modemRegistry.modems[1] || header == NULL || header->type != FRAME_TYPE_DATA || size == 0) {
+        return;
+    }
+    if (data[0] != 'C') {
+        AtomicAddRelaxed64(&priorityBench.bulkBytes, size);
+        return;
+    }
+    uint32_t index;
+    uint64_t sentNs;
+    memcpy(&index, data + 2, sizeof(index));
+    memcpy(&sentNs, data + 6, sizeof(sentNs));
+    if (size != BENCH_PRIORITY_COMMAND_SIZE || data[1] != priorityBench.run || (int)index >= priorityBench.commands ||
+        priorityBench.seen[index]) {
+        return;
+    }
+    priorityBench.seen[index] = 1;
+    priorityBench.latencyUs[index] = (uint32_t)((PlatformNowNs() - sentNs) / 1000);
+    AtomicIncrement32(&priorityBench.delivered);
+}
+
+// 명령을 commandClass 로, BULK 를 TX_CLASS_BULK 로 보내고 결과를 한 줄 출력한다. 명령이 모두 전달되면 true
+static bool MeasurePriority(const TCHAR* name, BYTE commandClass, const int* weights, int baudRate) {
+    ModemConfig* tx = &modemRegistry.modems[0];
+    TxQueue* queue = &tx->txQueue;
+    for (int c = 0; c < TX_CLASSES; c++) {
+        tx->txWeights[c] = weights != NULL ? weights[c] : 0;
+    }
+    memset(priorityBench.seen, 0, priorityBench.commands);
+    priorityBench.run++;
+    AtomicStoreRelease32(&priorityBench.delivered, 0);
+    AtomicStoreRelease64(&priorityBench.bulkBytes, 0);
+    int32_t preemptions = queue->preemptions;
+
+    static BYTE bulk[BENCH_PRIORITY_BULK_SIZE];
+    memset(bulk, 'b', sizeof(bulk));
+    BYTE command[BENCH_PRIORITY_COMMAND_SIZE];
+    memset(command, 'c', sizeof(command));
+    command[0] = 'C';
+    command[1] = priorityBench.run;
+
+    // BULK 가 먼저 회선을 채우도록 하나 넣고 시작
+    TransmitEnqueueClass(tx, TX_CLASS_BULK, FRAME_TYPE_DATA, bulk, sizeof(bulk), NULL);
+    PlatformSleepMs(BENCH_PRIORITY_INTERVAL_MS);
+    uint64_t startNs = PlatformNowNs();
+    uint64_t nextNs = startNs;
+    int sent = 0;
+    while (sent < priorityBench.commands) {
+        // BULK 큐가 비지 않도록 채움
+        if (AtomicLoadAcquire32(&queue->classBytes[TX_CLASS_BULK]) < BENCH_PRIORITY_BULK_SIZE) {
+            TransmitEnqueueClass(tx, TX_CLASS_BULK, FRAME_TYPE_DATA, bulk, sizeof(bulk), NULL);
+        }
+        uint64_t nowNs = PlatformNowNs();
+        if (nowNs >= nextNs) {
+            uint32_t index = (uint32_t)sent;
+            memcpy(command + 2, &index, sizeof(index));
+            memcpy(command + 6, &nowNs, sizeof(nowNs));
+            if (TransmitEnqueueClass(tx, commandClass, FRAME_TYPE_DATA, command, sizeof(command), NULL) != 0) {
+                sent++;
+            }
+            nextNs += BENCH_PRIORITY_INTERVAL_MS * 1000000ULL;
+        }
+        PlatformSleepMs(5);
+    }
+    // 명령이 모두 도착하면 BULK 처리량을 재고, 다음 모드를 위해 큐가 빌 때까지 기다림
+    uint64_t waitStartNs = PlatformNowNs();
+    while (AtomicLoadAcquire32(&priorityBench.delivered) < sent && PlatformNowNs() - waitStartNs < 120 * BENCH_TIMEOUT_NS) {
+        PlatformSleepMs(10);
+    }
+    double seconds = (PlatformNowNs() - startNs) / 1e9;
+    int64_t bulkBytes = AtomicLoadAcquire64(&priorityBench.bulkBytes);
+    preemptions = queue->preemptions - preemptions;
+    waitStartNs = PlatformNowNs();
+    while ((AtomicLoadAcquire32(&queue->queuedBytes) > 0 || AtomicLoadAcquire32(&queue->writingBytes) > 0) &&
+        PlatformNowNs() - waitStartNs < 120 * BENCH_TIMEOUT_NS) {
+        PlatformSleepMs(10);
+    }
+    PlatformSleepMs(BENCH_PRIORITY_INTERVAL_MS); // 회선에 남은 바이트
+
+    int delivered = AtomicLoadAcquire32(&priorityBench.delivered);
+    int samples = 0;
+    for (int i = 0; i < sent; i++) {
+        if (priorityBench.seen[i]) {
+            priorityBench.latencyUs[samples++] = priorityBench.latencyUs[i];
+        }
+    }
+    bool ok = delivered == sent;
+    _tprintf(TEXT("%-9s %-7s %3d/%-3d"), name, ok ? TEXT("ok") : TEXT("failed"), delivered, sent);
+    if (samples > 0) {
+        qsort(priorityBench.latencyUs, samples, sizeof(uint32_t), CompareU32);
+        _tprintf(TEXT("  p50 %8.1f ms  p99 %8.1f ms  max %8.1f ms"), Percentile(priorityBench.latencyUs, samples, 500) / 1000.0,
+            Percentile(priorityBench.latencyUs, samples, 990) / 1000.0, priorityBench.latencyUs[samples - 1] / 1000.0);
+    }
+    _tprintf(TEXT("  bulk %7.0f bps (%4.1f%% of line)  %ld preemptions\n"), bulkBytes * 8.0 / seconds, bulkBytes * 1000.0 / seconds / baudRate,
+        (long)preemptions);
+    return ok;
+}
+
+int RunPriorityBench(int argc, TCHAR* argv[]) {
+    int commands = argc >= 1 ? _ttoi(argv[0]) : BENCH_PRIORITY_COMMANDS;
+    int baudRate = argc >= 2 ? _ttoi(argv[1]) : BENCH_PRIORITY_RATE;
+    if (commands <= 0) {
+        commands = BENCH_PRIORITY_COMMANDS;
+    }
+    if (baudRate <= 0) {
+        baudRate = BENCH_PRIORITY_RATE;
+    }
+
+    memset(&priorityBench, 0, sizeof(priorityBench));
+    priorityBench.commands = commands;
+    priorityBench.seen = (BYTE*)calloc(commands, 1);
+    priorityBench.latencyUs = (uint32_t*)calloc(commands, sizeof(uint32_t));
+    if (priorityBench.seen == NULL || priorityBench.latencyUs == NULL) {
+        return 1;
+    }
+
+    CrcInit();
+    TCHAR profile[MAX_EMULATOR_SPEC];
+    _stprintf(profile, TEXT("rate=%d"), baudRate);
+    if (!OpenEmulatorPair(TEXT("EMU:bench-priority"), profile, BENCH_PRIORITY_PORT_RATE, BenchPriorityFrame, NULL)) {
+        return 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        modemRegistry.modems[i].linkRate = baudRate;
+        modemRegistry.modems[i].linkRateSet = true;
+    }
+    _tprintf(TEXT("Priority benchmark: %d commands of %d bytes every %d ms behind %d-byte bulk messages, %d bps emulated link\n"),
+        commands, BENCH_PRIORITY_COMMAND_SIZE, BENCH_PRIORITY_INTERVAL_MS, BENCH_PRIORITY_BULK_SIZE, baudRate);
+    static const int weights[TX_CLASSES] = { 4, 2, 1 };
+    bool ok = MeasurePriority(TEXT("fifo"), TX_CLASS_BULK, NULL, baudRate);
+    ok = MeasurePriority(TEXT("strict"), TX_CLASS_CONTROL, NULL, baudRate) && ok;
+    ok = MeasurePriority(TEXT("weighted"), TX_CLASS_CONTROL, weights, baudRate) && ok;
+
+    CloseEmulatorPair();
+    EmulatorStop();
+    free(priorityBench.seen);
+    free(priorityBench.latencyUs);
+    return ok ? 0 : 1;
+}
+
+
+// 회선 설정 변경 시험: 에뮬레이터 링크(EMU:bench-reconfig) 로 연결한 모뎀 0 -> 1 로 번호를 붙인 메시지를 계속 보내다가
+// 양쪽 모뎀의 속도를 바꾸고, 송신이 멈춘 시간, 수신이 끊긴 가장 긴 시간, 잃은 메시지 수를 방식별로 잰다.
+//   reopen  : 포트를 닫고 새 설정으로 다시 연다 (기존 UpdateModemSettings)
+//   in-place: 송신을 멈추고 남은 바이트를 내보낸 뒤 열린 포트에 새 설정만 적용한다 (SerialReconfigure)
+typedef struct {
+    BYTE run;                     // 방식마다 바뀜
+    BYTE* seen;
+    volatile int32_t delivered;
+    volatile int64_t lastNs;      // 마지막 전달 시각
+    volatile int64_t maxGapNs;    // 전달 사이의 가장 긴 간격 (수신 처리 스레드만 씀)
+} ReconfigBench;
+
+static ReconfigBench reconfigBench;
+
+static void BenchReconfigFrame(ModemConfig* modem, const FrameHeader* header, const BYTE* data, DWORD size) {
+    if (modem != &modemRegistry.modems[1] || header == NULL || header->type != FRAME_TYPE_DATA || size != BENCH_RECONFIG_MESSAGE_SIZE ||
+        data[0] != 'R' || data[1] != reconfigBench.run) {
+        return;
+    }
+    uint32_t index;
+    memcpy(&index, data + 2, sizeof(index));
+    if (index >= BENCH_RECONFIG_MAX_MESSAGES || reconfigBench.seen[index]) {
+        return;
+    }
+    reconfigBench.seen[index] = 1;
+    int64_t nowNs = (int64_t)PlatformNowNs();
+    int64_t lastNs = AtomicLoadAcquire64(&reconfigBench.lastNs);
+    if (lastNs != 0 && nowNs - lastNs > reconfigBench.maxGapNs) {
+        AtomicStoreRelease64(&reconfigBench.maxGapNs, nowNs - lastNs);
+    }
+    AtomicStoreRelease64(&reconfigBench.lastNs, nowNs);
+    AtomicIncrement32(&reconfigBench.delivered);
+}
+
+// 모뎀 하나의 속도를 바꾸고 송신이 멈춘 시간(ns)을 반환한다. 실패하면 0
+static uint64_t SwitchRate(ModemConfig* modem, int baudRate, bool inPlace) {
+    uint64_t startNs = PlatformNowNs();
+    TransmitterLockPort(modem);
+    bool ok;
+    if (inPlace) {
+        SerialDrain(modem);
+        ok = SerialReconfigure(modem, baudRate, modem->byteSize, modem->stopBits, modem->parity);
+    }
+    else {
+        // 에뮬레이터 포트는 같은 링크에 세 번째 끝을 붙일 수 없으므로 먼저 닫고 연다
+        ReactorRemove(modem);
+        CloseSerialPort(modem);
+        modem->baudRate = baudRate;
+        ok = OpenSerialPort(modem) && ReactorAdd(modem);
+    }
+    if (ok) {
+        modem->baudRate = baudRate;
+        modem->linkRate = baudRate;
+    }
+    TransmitterUnlockPort(modem);
+    uint64_t pausedNs = PlatformNowNs() - startNs;
+    if (ok && inPlace) {
+        ReactorResize(modem);
+    }
+    return ok ? pausedNs : 0;
+}
+
+// 한 방식으로 from 속도에서 보내다 to 로 바꾸고 계속 보낸 뒤 결과를 한 줄 출력한다. 메시지를 잃지 않았으면 true
+static bool MeasureReconfig(const TCHAR* name, bool inPlace, int fromRate, int toRate) {
+    if (!OpenEmulatorPair(TEXT("EMU:bench-reconfig"), TEXT("wire"), fromRate, BenchReconfigFrame, NULL)) {
+        return false;
+    }
+    ModemConfig* tx = &modemRegistry.modems[0];
+    ModemConfig* rx = &modemRegistry.modems[1];
+    reconfigBench.run++;
+    memset(reconfigBench.seen, 0, BENCH_RECONFIG_MAX_MESSAGES);
+    AtomicStoreRelease32(&reconfigBench.delivered, 0);
+    AtomicStoreRelease64(&reconfigBench.lastNs, 0);
+    AtomicStoreRelease64(&reconfigBench.maxGapNs, 0);
+
+    BYTE message[BENCH_RECONFIG_MESSAGE_SIZE];
+    memset(message, 'r', sizeof(message));
+    message[0] = 'R';
+    message[1] = reconfigBench.run;
+    // 느린 쪽 속도를 거의 채우도록 일정하게 보냄 (회선에 늘 바이트가 있도록. 창을 쓰면 잃은 메시지에서 송신이 멈춤)
+    uint64_t intervalNs = 5ULL * BENCH_RECONFIG_MESSAGE_SIZE * 10 * 1000000000ULL / (4ULL * (uint64_t)(fromRate < toRate ? fromRate : toRate));
+    uint64_t startNs = PlatformNowNs();
+    uint64_t nextNs = startNs;
+    uint64_t pausedNs = 0;
+    bool switched = false;
+    bool ok = true;
+    int sent = 0;
+    while (sent < BENCH_RECONFIG_MAX_MESSAGES && PlatformNowNs() - startNs < 2 * BENCH_RECONFIG_PHASE_MS * 1000000ULL) {
+        if (!switched && PlatformNowNs() - startNs >= BENCH_RECONFIG_PHASE_MS * 1000000ULL) {
+            // 송신 쪽, 수신 쪽 순서로 바꿈 (실제 장비에서도 두 끝을 차례로 바꿈)
+            pausedNs = SwitchRate(tx, toRate, inPlace);
+            uint64_t rxPausedNs = SwitchRate(rx, toRate, inPlace);
+            ok = pausedNs != 0 && rxPausedNs != 0;
+            switched = true;
+        }
+        if (PlatformNowNs() < nextNs) {
+            PlatformSleepMs(1);
+            continue;
+        }
+        uint32_t index = (uint32_t)sent;
+        memcpy(message + 2, &index, sizeof(index));
+        if (TransmitEnqueue(tx, FRAME_TYPE_DATA, message, sizeof(message)) != 0) {
+            sent++;
+        }
+        nextNs += intervalNs;
+    }
+    // 잃은 메시지는 오지 않으므로 시간 제한까지만 기다림
+    uint64_t waitStartNs = PlatformNowNs();
+    while (AtomicLoadAcquire32(&reconfigBench.delivered) < sent && PlatformNowNs() - waitStartNs < BENCH_TIMEOUT_NS) {
+        PlatformSleepMs(10);
+    }
+    int delivered = AtomicLoadAcquire32(&reconfigBench.delivered);
+    CloseEmulatorPair();
+
+    ok = ok && delivered == sent;
+    _tprintf(TEXT("%-9s %-7s %4d/%-4d  transmit paused %7.2f ms  receive gap max %7.2f ms (sent every %.2f ms)  lost %d\n"), name,
+        ok ? TEXT("ok") : TEXT("failed"), delivered, sent, pausedNs / 1e6, AtomicLoadAcquire64(&reconfigBench.maxGapNs) / 1e6, intervalNs / 1e6,
+        sent - delivered);
+    return ok;
+}
+
+int RunReconfigBench(int argc, TCHAR* argv[]) {
+    int fromRate = argc >= 1 ? _ttoi(argv[0]) : BENCH_RECONFIG_FROM;
+    int toRate = argc >= 2 ? _ttoi(argv[1]) : BENCH_RECONFIG_TO;
+    if (!IsValidBaudRate(fromRate) || !IsValidBaudRate(toRate)) {
+        _ftprintf(stderr, TEXT("Unsupported baud rate.\n"));
+        return 1;
+    }
+
+    memset(&reconfigBench, 0, sizeof(reconfigBench));
+    reconfigBench.seen = (BYTE*)calloc(BENCH_RECONFIG_MAX_MESSAGES, 1);
+    if (reconfigBench.seen == NULL) {
+        return 1;
+    }
+
+    CrcInit();
+    _tprintf(TEXT("Reconfigure benchmark: %d-byte messages, %d bps -> %d bps after %d ms on an emulated link\n"),
+        BENCH_RECONFIG_MESSAGE_SIZE, fromRate, toRate, BENCH_RECONFIG_PHASE_MS);
+    // reopen 은 메시지를 잃을 수 있으므로 결과는 in-place 만으로 판단
+    MeasureReconfig(TEXT("reopen"), false, fromRate, toRate);
+    bool ok = MeasureReconfig(TEXT("in-place"), true, fromRate, toRate);
+
+    EmulatorStop();
+    free(reconfigBench.seen);
+    return ok ? 0 : 1;
+}
+
+// 버퍼 풀 시험: 속도 제한 없는 에뮬레이터 링크(EMU:bench-pool, Emulator=ideal) 로 연결한 모뎀 0 -> 1 로 같은 크기의 메시지를 창만큼 겹쳐 보내며
+// 메시지당 풀/힙 할당 수, CPU 시간, 캐시 미스(리눅스 성능 카운터), 페이지 폴트를 잰다.
+typedef struct {
+    volatile int64_t deliveredBytes;
+    volatile int64_t lastNs;
+} PoolBench;
+
+static PoolBench poolBench;
+
+static void BenchPoolReceive(ModemConfig* modem, const FrameHeader* header, const BYTE* data, DWORD size) {
+    (void)data;
+    if (modem != &modemRegistry.modems[1] || (header != NULL && header->type != FRAME_TYPE_DATA)) {
+        return;
+    }
+    AtomicAddRelaxed64(&poolBench.deliveredBytes, size);
+    AtomicStoreRelease64(&poolBench.lastNs, (int64_t)PlatformNowNs());
+}
+
+// 이 프로세스(이후에 만든 스레드 포함)의 성능 카운터. 커널이나 가상 머신이 주지 않으면 -1
+static int OpenPerfCounter(uint32_t type, uint64_t config) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void)type;
+    (void)config;
+    return -1;
+#endif
+}
+
+static void EnablePerfCounter(int fd) {
+#ifdef __linux__
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    (void)fd;
+#endif
+}
+
+// 읽지 못하면 -1. 읽은 뒤 닫음
+static int64_t ClosePerfCounter(int fd) {
+    if (fd < 0) {
+        return -1;
+    }
+    int64_t value = -1;
+    if (read(fd, &value, sizeof(value)) != (ssize_t)sizeof(value)) {
+        value = -1;
+    }
+    close(fd);
+    return value;
+}
+
+static void PrintPerMessage(int64_t value, int messages) {
+    if (value < 0) {
+        _tprintf(TEXT(" %12s"), TEXT("n/a"));
+    }
+    else {
+        _tprintf(TEXT(" %12.2f"), messages > 0 ? (double)value / messages : 0.0);
+    }
+}
+
+static bool MeasurePool(const TCHAR* name, int framing, int messages, int size) {
+#ifdef __linux__
+    int cacheFd = OpenPerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    int faultFd = OpenPerfCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+#else
+    int cacheFd = -1;
+    int faultFd = -1;
+#endif
+    // 카운터를 먼저 열어야 에뮬레이터와 송수신 스레드가 이어받음
+    if (!OpenEmulatorPair(TEXT("EMU:bench-pool"), TEXT("ideal"), BENCH_POOL_RATE, BenchPoolReceive, NULL)) {
+        ClosePerfCounter(cacheFd);
+        ClosePerfCounter(faultFd);
+        return false;
+    }
+    modemRegistry.modems[0].framing = framing;
+    modemRegistry.modems[1].framing = framing;
+    ModemConfig* tx = &modemRegistry.modems[0];
+    BYTE* message = (BYTE*)malloc(size);
+    if (message == NULL) {
+        CloseEmulatorPair();
+        return false;
+    }
+    memset(message, 'p', size);
+    AtomicStoreRelease64(&poolBench.deliveredBytes, 0);
+
+    PoolStats before;
+    PoolQueryStats(&before);
+    EnablePerfCounter(cacheFd);
+    EnablePerfCounter(faultFd);
+    uint64_t cpuStartNs = PlatformCpuTimeNs();
+    uint64_t startNs = PlatformNowNs();
+    AtomicStoreRelease64(&poolBench.lastNs, (int64_t)startNs);
+    int sent = 0;
+    while (sent < messages) {
+        int64_t inFlight = (int64_t)sent * size - AtomicLoadAcquire64(&poolBench.deliveredBytes);
+        if (inFlight > 0 && inFlight + size > BENCH_POOL_WINDOW) {
+            if (PlatformNowNs() - (uint64_t)AtomicLoadAcquire64(&poolBench.lastNs) > BENCH_TIMEOUT_NS) {
+                break; // 전달이 멈춤
+            }
+            PlatformSleepMs(0);
+            continue;
+        }
+        if (TransmitEnqueue(tx, FRAME_TYPE_DATA, message, (DWORD)size) != 0) {
+            sent++;
+        }
+    }
+    int64_t total = (int64_t)sent * size;
+    while (AtomicLoadAcquire64(&poolBench.deliveredBytes) < total &&
+        PlatformNowNs() - (uint64_t)AtomicLoadAcquire64(&poolBench.lastNs) < BENCH_TIMEOUT_NS) {
+        PlatformSleepMs(1);
+    }
+    uint64_t elapsedNs = (uint64_t)AtomicLoadAcquire64(&poolBench.lastNs) - startNs;
+    uint64_t cpuNs = PlatformCpuTimeNs() - cpuStartNs;
+    int64_t cacheMisses = ClosePerfCounter(cacheFd);
+    int64_t faults = ClosePerfCounter(faultFd);
+    PoolStats after;
+    PoolQueryStats(&after);
+    bool ok = sent == messages && AtomicLoadAcquire64(&poolBench.deliveredBytes) == total;
+    CloseEmulatorPair();
+    free(message);
+
+    _tprintf(TEXT("%-8s %-6s %10.0f"), name, ok ? TEXT("ok") : TEXT("failed"), elapsedNs > 0 ? sent / (elapsedNs / 1e9) : 0.0);
+    PrintPerMessage(after.allocs - before.allocs, sent);
+    PrintPerMessage(after.heapAllocs - before.heapAllocs, sent);
+    PrintPerMessage((int64_t)cpuNs, sent);
+    PrintPerMessage(cacheMisses, sent);
+    PrintPerMessage(faults, sent);
+    _tprintf(TEXT("\n"));
+    return ok;
+}
+
+int RunPoolBench(int argc, TCHAR* argv[]) {
+    int messages = argc >= 1 ? _ttoi(argv[0]) : BENCH_POOL_MESSAGES;
+    int size = argc >= 2 ? _ttoi(argv[1]) : BENCH_POOL_MESSAGE_SIZE;
+    if (messages <= 0 || size <= 0 || size > FRAME_MAX_PAYLOAD) {
+        _ftprintf(stderr, TEXT("Message size must be 1..%d bytes.\n"), FRAME_MAX_PAYLOAD);
+        return 1;
+    }
+    memset(&poolBench, 0, sizeof(poolBench));
+
+    CrcInit();
+    _tprintf(TEXT("Buffer pool benchmark: %d messages of %d bytes, window %d bytes, unthrottled emulated link\n"), messages, size,
+        BENCH_POOL_WINDOW);
+    _tprintf(TEXT("%-8s %-6s %10s %12s %12s %12s %12s %12s\n"), TEXT("framing"), TEXT("result"), TEXT("msg/s"), TEXT("pool/msg"),
+        TEXT("heap/msg"), TEXT("cpu ns/msg"), TEXT("llc miss/msg"), TEXT("faults/msg"));
+    bool ok = MeasurePool(TEXT("cobs"), FRAMING_COBS, messages, size);
+    ok = MeasurePool(TEXT("raw"), FRAMING_RAW, messages, size) && ok;
+    _tprintf(TEXT("(n/a: the kernel or hypervisor does not expose that hardware counter)\n"));
+
+    EmulatorStop();
+    return ok ? 0 : 1;
+}
+
+// 시계 동기화 시험: 에뮬레이터 링크(EMU:bench-clock) 로 연결한 두 모뎀에 Timestamps=1 을 켜고 offset 이 잡힐 때까지 기다린 뒤
+// 모뎀 0 -> 1 로 메시지를 하나씩 보내며 모뎀 1 이 잰 단방향 지연을 프로파일의 지연(delay + jitter 평균)과 비교한다.
+// 두 모뎀이 한 프로세스의 같은 시계를 쓰므로 참 offset 은 0 이고, 추정한 offset 이 곧 오차다.
+typedef struct {
+    volatile int32_t delivered;
+} ClockBench;
+
+static ClockBench clockBench;
+
+static void BenchClockReceive(ModemConfig* modem, const FrameHeader* header, const BYTE* data, DWORD size) {
+    (void)data;
+    (void)size;
+    if (modem == &modemRegistry.modems[1] && header != NULL && header->type == FRAME_TYPE_DATA) {
+        AtomicIncrement32(&clockBench.delivered);
+    }
+}
+
+static void BenchClockDone(ModemConfig* modem, uint32_t messageId, bool success) {
+    (void)modem;
+    (void)messageId;
+    (void)success;
+}
+
+// 두 모뎀이 모두 응답을 받아 offset 을 추정할 때까지 (timeoutNs 안에서)
+static bool WaitClockSync(uint64_t timeoutNs) {
+    uint64_t startNs = PlatformNowNs();
+    while (PlatformNowNs() - startNs < timeoutNs) {
+        if (AtomicLoadAcquire32(&modemRegistry.modems[0].clock.replies) >= CLOCK_SAMPLES &&
+            AtomicLoadAcquire32(&modemRegistry.modems[1].clock.replies) >= CLOCK_SAMPLES) {
+            return true;
+        }
+        PlatformSleepMs(10);
+    }
+    return false;
+}
+
+static bool MeasureClock(const TCHAR* profile, int messages) {
+    EmulatorProfile settings;
+    TCHAR spec[MAX_EMULATOR_SPEC];
+    _tcsncpy(spec, profile, MAX_EMULATOR_SPEC - 1);
+    spec[MAX_EMULATOR_SPEC - 1] = TEXT('\0');
+    if (!EmulatorParseProfile(spec, &settings)) {
+        _ftprintf(stderr, TEXT("Invalid emulator profile: %s\n"), profile);
+        return false;
+    }
+    memset(&clockBench, 0, sizeof(clockBench));
+    if (!OpenEmulatorPair(TEXT("EMU:bench-clock"), profile, BENCH_CLOCK_RATE, BenchClockReceive, BenchClockDone)) {
+        return false;
+    }
+    modemRegistry.modems[0].timestamps = 1;
+    modemRegistry.modems[1].timestamps = 1;
+    if (!ClockSyncStart()) {
+        CloseEmulatorPair();
+        return false;
+    }
+    // 한 메시지를 매체에 싣는 시간의 두 배 간격으로 보내 송신 큐 대기가 지연에 섞이지 않게 함
+    int rate = settings.rate > 0 ? settings.rate : BENCH_CLOCK_RATE;
+    int intervalMs = (int)((int64_t)2 * FRAME_ENCODED_SIZE(BENCH_CLOCK_MESSAGE_SIZE + FRAME_TIMESTAMP_SIZE) * 10 * 1000 / rate);
+    intervalMs = intervalMs > BENCH_CLOCK_MIN_INTERVAL_MS ? intervalMs : BENCH_CLOCK_MIN_INTERVAL_MS;
+    uint64_t waitNs = 20 * BENCH_TIMEOUT_NS + (uint64_t)(settings.delayMs + settings.jitterMs) * 2 * CLOCK_SAMPLES * 1000000ULL;
+    bool synced = WaitClockSync(waitNs);
+
+    BYTE message[BENCH_CLOCK_MESSAGE_SIZE];
+    memset(message, 'c', sizeof(message));
+    int sent = 0;
+    for (int i = 0; synced && i < messages; i++) {
+        if (TransmitEnqueue(&modemRegistry.modems[0], FRAME_TYPE_DATA, message, sizeof(message)) != 0) {
+            sent++;
+        }
+        PlatformSleepMs(intervalMs);
+    }
+    // 손실된 메시지는 오지 않으므로 지연 + 지터만큼 더 기다림
+    uint64_t drainStartNs = PlatformNowNs();
+    uint64_t drainNs = BENCH_TIMEOUT_NS + (uint64_t)(settings.delayMs + settings.jitterMs) * 2000000ULL;
+    while (AtomicLoadAcquire32(&clockBench.delivered) < sent && PlatformNowNs() - drainStartNs < drainNs) {
+        PlatformSleepMs(10);
+    }
+    ClockSyncStop();
+
+    const ClockSync* rx = &modemRegistry.modems[1].clock;
+    const ClockSync* tx = &modemRegistry.modems[0].clock;
+    LatencySummary oneWay;
+    HistogramSummarize(&modemRegistry.modems[1].metrics.oneWayLatency, &oneWay);
+    int delivered = AtomicLoadAcquire32(&clockBench.delivered);
+    int32_t forwardUs = AtomicLoadAcquire32(&tx->forwardUs);
+    _tprintf(TEXT("%-10s %6.1f %9.3f %8.2f %8.2f %8.2f %8.2f %8.2f %9.2f %5d/%-5d %s\n"), profile,
+        settings.delayMs + settings.jitterMs / 2.0, AtomicLoadAcquire64(&rx->offsetNs) / 1e6, AtomicLoadAcquire64(&rx->rttNs) / 1e6,
+        oneWay.p50Us / 1e3, oneWay.p99Us / 1e3, oneWay.maxUs / 1e3, AtomicLoadAcquire64(&rx->jitterNs) / 1e6,
+        forwardUs < 0 ? -1.0 : forwardUs / 1e3, delivered, sent, synced ? TEXT("") : TEXT("(not synced)"));
+    CloseEmulatorPair();
+    return synced && oneWay.count > 0;
+}
+
+int RunClockBench(int argc, TCHAR* argv[]) {
+    int messages = argc >= 1 ? _ttoi(argv[0]) : BENCH_CLOCK_MESSAGES;
+    if (messages <= 0) {
+        _ftprintf(stderr, TEXT("Message count must be positive.\n"));
+        return 1;
+    }
+    CrcInit();
+    _tprintf(TEXT("Clock sync benchmark: %d messages of %d bytes per profile, true clock offset 0 (one process)\n"), messages,
+        BENCH_CLOCK_MESSAGE_SIZE);
+    _tprintf(TEXT("%-10s %6s %9s %8s %8s %8s %8s %8s %9s %11s\n"), TEXT("profile"), TEXT("exp ms"), TEXT("offset ms"), TEXT("rtt ms"),
+        TEXT("p50 ms"), TEXT("p99 ms"), TEXT("max ms"), TEXT("jitter"), TEXT("fwd ms"), TEXT("delivered"));
+    bool ok = true;
+    if (argc >= 2) {
+        for (int i = 1; i < argc; i++) {
+            ok = MeasureClock(argv[i], messages) && ok;
+        }
+    }
+    else {
+        ok = MeasureClock(TEXT("light"), messages);
+        ok = MeasureClock(TEXT("acoustic"), messages) && ok;
+    }
+    _tprintf(TEXT("(exp: profile delay + mean jitter, without serialization; fwd: 0 -> 1 delay as reported back to modem 0)\n"));
+
+    EmulatorStop();
+    return ok ? 0 : 1;
+}
+
+// BaudRate=auto 시험: 시리얼 쪽 속도가 uart 로 고정된 에뮬레이트 모뎀 두 개(EMU:bench-baud) 가운데 모뎀 1 은 peerRate 로 열어
+// 수신 처리 스레드에서 HELLO 에 답하게 하고, 모뎀 0 을 BaudRate=auto 로 열어 탐색 스레드가 찾은 속도와 걸린 시간을 잰다.
+// 드라이버(pty)는 모든 속도를 받아들이므로 상대의 응답을 확인하지 않으면 늘 가장 빠른 속도를 고르게 된다.
+// delayMs 는 매체의 단방향 지연: 응답 대기 시간(AutoBaudMs)이 왕복 시간보다 길어야 찾는다
+static void BenchAutoBaudReceive(ModemConfig* modem, const FrameHeader* header, const BYTE* data, DWORD size) {
+    CompressHandleFrame(modem, header, data, size);
+}
+
+static bool MeasureAutoBaud(int uartRate, int delayMs, int waitMs, int peerRate, int expected) {
+    ModemConfig* probe = &modemRegistry.modems[0];
+    ModemConfig* peer = &modemRegistry.modems[1];
+    for (int i = 0; i < 2; i++) {
+        ModemConfig* modem = &modemRegistry.modems[i];
+        _stprintf(modem->emulator, TEXT("wire,uart=%d,delay=%d"), uartRate, delayMs);
+        modem->baudRate = i == 0 ? BENCH_AUTOBAUD_CONFIGURED : peerRate;
+        modem->autoBaud = i == 0;
+        modem->autoBaudMs = waitMs;
+        modem->linkRate = modem->baudRate;
+    }
+    if (!OpenSerialPort(peer)) {
+        return false;
+    }
+    ReactorAdd(peer);
+    bool opened = OpenSerialPort(probe);
+    int state = AUTOBAUD_FAILED;
+    uint64_t startNs = PlatformNowNs();
+    if (opened) {
+        ReactorAdd(probe);
+        AutoBaudRequest(probe);
+        uint64_t deadlineNs = startNs + (AUTOBAUD_MAX_SEARCH_MS + AUTOBAUD_MAX_WAIT_MS) * 1000000ULL;
+        while ((state = AutoBaudState(probe)) == AUTOBAUD_SEARCHING && PlatformNowNs() < deadlineNs) {
+            PlatformSleepMs(AUTOBAUD_POLL_MS);
+        }
+    }
+    uint64_t elapsedNs = PlatformNowNs() - startNs;
+    int found = probe->baudRate;
+    if (opened) {
+        AutoBaudCancel(probe);
+        ReactorRemove(probe);
+        CloseSerialPort(probe);
+    }
+    ReactorRemove(peer);
+    CloseSerialPort(peer);
+
+    bool ok = opened && found == expected && state == (expected == BENCH_AUTOBAUD_CONFIGURED ? AUTOBAUD_FAILED : AUTOBAUD_FOUND);
+    _tprintf(TEXT("%10d %8d %8d %10d %10d %10d %10.0f  %s\n"), uartRate, delayMs, waitMs, peerRate, expected, found, elapsedNs / 1e6,
+        ok ? TEXT("ok") : TEXT("failed"));
+    return ok;
+}
+
+int RunAutoBaudBench(int argc, TCHAR* argv[]) {
+    (void)argc;
+    (void)argv;
+    CrcInit();
+    CompressInit(NULL);
+    memset(&modemRegistry, 0, sizeof(modemRegistry));
+    for (int i = 0; i < 2; i++) {
+        ModemConfig* modem = &modemRegistry.modems[i];
+        _tcscpy(modem->portName, TEXT("EMU:bench-baud"));
+        _stprintf(modem->name, TEXT("bench%d"), i);
+        modem->byteSize = 8;
+        modem->stopBits = ONESTOPBIT;
+        modem->parity = NOPARITY;
+        modem->hSerial = INVALID_HANDLE_VALUE;
+        modem->framing = FRAMING_COBS;
+        if (!RingInit(&modem->rxRing, RING_DEFAULT_SIZE) || !FrameParserInit(&modem->rxFrame)) {
+            return 1;
+        }
+    }
+    modemRegistry.count = 2;
+    if (!ReceiverStart(BenchAutoBaudReceive) || !ReactorStart(ReceiverPush, NULL) || !TransmitterStart(NULL) || !AutoBaudStart()) {
+        _ftprintf(stderr, TEXT("Failed to start threads.\n"));
+        return 1;
+    }
+
+    _tprintf(TEXT("Auto baud benchmark: modems with a fixed serial rate, peer answers HELLO, configured %d bps\n"), BENCH_AUTOBAUD_CONFIGURED);
+    _tprintf(TEXT("%10s %8s %8s %10s %10s %10s %10s  %s\n"), TEXT("modem bps"), TEXT("delay ms"), TEXT("wait ms"), TEXT("peer bps"),
+        TEXT("expected"), TEXT("found"), TEXT("search ms"), TEXT("result"));
+    bool ok = MeasureAutoBaud(921600, 0, AUTOBAUD_DEFAULT_WAIT_MS, 921600, 921600);
+    ok = MeasureAutoBaud(115200, 0, AUTOBAUD_DEFAULT_WAIT_MS, 115200, 115200) && ok;
+    ok = MeasureAutoBaud(9600, 0, AUTOBAUD_DEFAULT_WAIT_MS, 9600, 9600) && ok;
+    // 왕복 시간이 기본 대기 시간보다 긴 링크: AutoBaudMs 를 늘려야 찾음
+    ok = MeasureAutoBaud(921600, BENCH_AUTOBAUD_DELAY_MS, BENCH_AUTOBAUD_DELAY_WAIT_MS, 921600, 921600) && ok;
+    // 상대 포트가 모뎀과 맞지 않아 답이 없음: 설정된 속도로 돌아감
+    ok = MeasureAutoBaud(115200, 0, AUTOBAUD_DEFAULT_WAIT_MS, 57600, BENCH_AUTOBAUD_CONFIGURED) && ok;
+
+    AutoBaudStop();
+    ReactorStop();
+    ReceiverStop();
+    TransmitterStop();
+    for (int i = 0; i < 2; i++) {
+        RingFree(&modemRegistry.modems[i].rxRing);
+        FrameParserFree(&modemRegistry.modems[i].rxFrame);
+    }
+    EmulatorStop();
+    return ok ? 0 : 1;
+}
+#endif
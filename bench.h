@@ -0,0 +1,84 @@
+﻿#pragma once
+#include "platform.h"
+
+// 수신 지연 벤치마크: 바이트 도착부터 수신 스레드 전달까지의 시간을
+// 기존 30ms 폴링 방식과 이벤트 방식으로 각각 측정해 중앙값/p99 를 출력한다.
+//   Windows: UHSDM --bench-rx <송신 포트> <수신 포트> [횟수]   (널 모뎀으로 연결된 포트 쌍)
+//   POSIX  : UHSDM --bench-rx [횟수]                           (pty 쌍을 자동으로 생성)
+int RunRxLatencyBench(int argc, TCHAR* argv[]);
+
+// 송신 처리량 벤치마크: 작은 메시지를 연속으로 보낼 때 메시지마다 SerialWrite 하는 기존 방식과
+// 송신 큐로 묶어서 쓰는 방식의 처리량을 비교한다.
+//   Windows: UHSDM --bench-tx <송신 포트> <수신 포트> [메시지 수]
+//   POSIX  : UHSDM --bench-tx [메시지 수]
+int RunTxBurstBench(int argc, TCHAR* argv[]);
+
+// ARQ 전송 시험: pty 쌍 두 개 사이에 프레임을 일정 확률로 버리는 중계 스레드를 두고
+// 한 모뎀에서 다른 모뎀으로 데이터를 보내 손실 없이 재조립되는지와 걸린 시간을 확인한다.
+//   POSIX  : UHSDM --bench-arq [크기(KB)] [프레임 손실률(%)] [FEC 부호율 K/N]
+int RunArqLossBench(int argc, TCHAR* argv[]);
+
+// FEC 부호화/복구 처리량 (MB/s) 을 표 기반 스칼라 경로와 SIMD 경로로 각각 측정한다.
+//   UHSDM --bench-fec [K/N]
+int RunFecBench(int argc, TCHAR* argv[]);
+
+// 압축 벤치마크: 텔레메트리 형태의 메시지를 크기별로 압축해 사전 유무에 따른 압축률과
+// 메시지당 압축/해제 시간을 출력한다. 파일을 주면 한 줄을 메시지 하나로 사용한다.
+//   UHSDM --bench-compress [메시지 파일]
+int RunCompressBench(int argc, TCHAR* argv[]);
+
+// 수신 로그 시험: 바이너리 데이터의 HEX 덤프 처리량(MB/s)을 표 방식과 SIMD 경로로 각각 측정하고, 같은 메시지를
+// 수신 처리 스레드에서 바로 출력할 때와 로그 큐(rxlog.h)에 넣을 때 호출한 쪽이 쓰는 시간과 전체 시간,
+// 마지막 세그먼트에 담은 레코드와 버린 레코드 수를 비교한다. 세그먼트 수의 기본값은 64.
+//   UHSDM --bench-log [메시지 수] [크기] [세그먼트 수]
+int RunLogBench(int argc, TCHAR* argv[]);
+
+// 링크 전환 시험: 빛/음향 링크 두 개(pty 쌍)를 두고 스케줄러로 메시지를 계속 보내면서 빛 링크를
+// 끊었다가 다시 이어, 전환에 걸린 시간과 단계별 처리량, 손실/중복 없이 전달되는지 확인한다.
+// unplug 를 주면 빛 링크를 끊는 대신 보내는 쪽 pty 를 없앴다가 같은 경로에 다시 만들어, 포트 감시 스레드가
+// 포트를 닫고 메시지를 음향 링크로 옮긴 뒤 다시 여는 데 걸린 시간을 함께 출력한다.
+//   POSIX  : UHSDM --bench-link [단계별 시간(ms)] [cut|unplug]
+int RunLinkFailoverBench(int argc, TCHAR* argv[]);
+
+// 묶음 전송 시험: 속도를 제한한 빛/음향 링크(pty 쌍)로 같은 데이터를 빛만, 음향만, 두 링크를 묶어서
+// 각각 보내 처리량을 비교한다. 조각이 링크 속도에 비례해 나뉘는지와 데이터가 그대로 도착하는지 확인한다.
+//   POSIX  : UHSDM --bench-bond [크기(KB)] [빛 bps] [음향 bps]
+int RunBondBench(int argc, TCHAR* argv[]);
+
+// 중복 전송 시험: 손실이 있는 빛 링크와 느린 음향 링크(pty 쌍)로 작은 명령을 빛만, 음향만, 스케줄러 선택,
+// 모든 링크 동시 전송으로 각각 보내 명령 지연(p50/p99/max)과 어느 링크의 사본이 먼저 도착했는지 비교한다.
+//   POSIX  : UHSDM --bench-redundant [명령 수] [빛 프레임 손실률(%)]
+int RunRedundantBench(int argc, TCHAR* argv[]);
+
+// 벤치마크 모음: 에뮬레이터로 속도를 제한한 링크에서 300 bps 부터 4 Mbps 까지의 속도(표준이 아닌 250000 포함)와
+// 여러 메시지 크기로 송신 큐 -> 프레임 -> 수신 처리 경로를 구동해 msg/s, goodput(bps), 지연 p50/p99/p999(us),
+// 바이트당 CPU 시간(ns, 에뮬레이터 스레드 포함)을 CSV 또는 JSON 으로 출력한다. 진행 상황은 stderr 로 나온다.
+//   POSIX  : UHSDM --bench-suite [csv|json] [측정점별 시간(ms)] [출력 파일]
+int RunBenchSuite(int argc, TCHAR* argv[]);
+
+// 우선순위 시험: 에뮬레이터로 매체 속도를 bps 로 제한한 링크(포트는 115200, LinkRate=bps)에 큰 BULK 메시지를 계속 쌓아 두고 짧은 명령을 일정 간격으로 보내
+// 명령을 BULK 와 같은 큐에 넣을 때(fifo), 엄격한 우선순위(strict), 가중 라운드 로빈 4,2,1(weighted) 의
+// 명령 지연(p50/p99/max)과 BULK 처리량, 끼어든 조각 수를 비교한다.
+//   POSIX  : UHSDM --bench-priority [명령 수] [bps]
+int RunPriorityBench(int argc, TCHAR* argv[]);
+
+// 회선 설정 변경 시험: 에뮬레이터 링크로 메시지를 계속 보내다가 양쪽 모뎀의 속도를 바꿔, 포트를 닫고 다시 여는 방식(reopen)과
+// 남은 송신을 비운 뒤 열린 포트에 설정만 적용하는 방식(in-place)의 송신 중단 시간, 가장 긴 수신 공백, 잃은 메시지 수를 비교한다.
+//   POSIX  : UHSDM --bench-reconfig [처음 bps] [바꿀 bps]
+int RunReconfigBench(int argc, TCHAR* argv[]);
+
+// 버퍼 풀 시험: 속도 제한 없는 에뮬레이터 링크로 같은 크기의 메시지를 COBS 프레임과 FRAMING_RAW 로 각각 보내며 메시지당 풀 할당,
+// 힙 할당(풀이 모자라 힙에서 잡은 것), CPU 시간, 마지막 단계 캐시 미스와 페이지 폴트(리눅스 성능 카운터)를 출력한다.
+//   POSIX  : UHSDM --bench-pool [메시지 수] [크기]
+int RunPoolBench(int argc, TCHAR* argv[]);
+
+// 시계 동기화 시험: 에뮬레이터 링크로 연결한 두 모뎀에 Timestamps=1 을 켜고, 추정한 offset(참값 0)과 왕복,
+// 타임스탬프로 잰 단방향 지연(p50/p99/max)과 지터를 프로파일의 지연과 비교한다. 프로파일을 주지 않으면 light 와 acoustic.
+//   POSIX  : UHSDM --bench-clock [메시지 수] [프로파일...]
+int RunClockBench(int argc, TCHAR* argv[]);
+
+// BaudRate=auto 시험: 시리얼 쪽 속도가 고정된 에뮬레이트 모뎀(Emulator=...,uart=bps) 에 BaudRate=auto 로 열어
+// 탐색 스레드가 상대가 답한 속도를 찾는지(왕복 시간이 기본 대기 시간보다 긴 링크 포함), 답이 없으면 설정된 속도로
+// 돌아가는지와 탐색에 걸린 시간을 출력한다.
+//   POSIX  : UHSDM --bench-autobaud
+int RunAutoBaudBench(int argc, TCHAR* argv[]);
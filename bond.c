@@ -0,0 +1,393 @@
+﻿#include "platform.h"
+#include "bond.h"
+#include "scheduler.h"
+
+#define BOND_TICK_MS 20 // 스케줄러 대기 목록이 가득 찼을 때 다시 시도하는 간격
+
+typedef struct BondSender {
+    struct BondSender* next;
+    uint16_t id;
+    BYTE kind;
+    bool failed;
+    BYTE* data;
+    DWORD length;
+    uint32_t count;
+    uint32_t base;          // 처음으로 확인되지 않은 조각
+    uint32_t nextChunk;     // 아직 보내지 않은 첫 조각
+    uint32_t inFlight;
+    uint32_t* messageIds;   // 조각별 스케줄러 메시지 id (0 = 확인됨 또는 아직 보내지 않음)
+    uint64_t startNs;
+    BondReport report;
+} BondSender;
+
+typedef struct BondReceiver {
+    struct BondReceiver* next;
+    uint16_t id;
+    BYTE kind;
+    BYTE* data;
+    DWORD length;
+    uint32_t count;
+    BYTE* received;
+    uint32_t receivedCount;
+    uint64_t lastNs;
+} BondReceiver;
+
+static struct {
+    BondDeliverProc deliver;
+    BondDoneProc done;
+    PlatformMutex lock;
+    PlatformEvent wake;
+    PlatformThread thread;
+    volatile int32_t running;
+    BondSender* senders;
+    int senderCount;
+    BondReceiver* receivers;
+    int receiverCount;
+    uint32_t inFlight;      // 모든 전송에서 보냈지만 확인되지 않은 조각 수
+    uint16_t nextId;
+    BondStats stats;
+} bond;
+
+static void PutU16(BYTE* p, uint32_t value) {
+    p[0] = (BYTE)value;
+    p[1] = (BYTE)(value >> 8);
+}
+
+static void PutU32(BYTE* p, uint32_t value) {
+    p[0] = (BYTE)value;
+    p[1] = (BYTE)(value >> 8);
+    p[2] = (BYTE)(value >> 16);
+    p[3] = (BYTE)(value >> 24);
+}
+
+static uint32_t GetU16(const BYTE* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+static uint32_t GetU32(const BYTE* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void FreeSender(BondSender* sender) {
+    free(sender->data);
+    free(sender->messageIds);
+    free(sender);
+}
+
+static void FreeReceiver(BondReceiver* receiver) {
+    free(receiver->data);
+    free(receiver->received);
+    free(receiver);
+}
+
+// 한 번에 보내 둘 조각 수: 살아 있는 링크마다 BOND_QUEUE_MS 동안 보낼 수 있는 양 (측정한 송신 속도 기준)
+static uint32_t ChunkWindow(void) {
+    uint32_t window = 0;
+    ModemConfig* modem;
+    for (int i = 0; (modem = SchedulerLink(i)) != NULL; i++) {
+        LinkStats stats;
+        if (!SchedulerQueryLink(modem, &stats) || !stats.up) {
+            continue;
+        }
+        double chunks = stats.rateBps / 10.0 * BOND_QUEUE_MS / 1000.0 / BOND_CHUNK_SIZE;
+        window += chunks > BOND_MIN_LINK_CHUNKS ? (chunks < BOND_MAX_IN_FLIGHT ? (uint32_t)chunks : BOND_MAX_IN_FLIGHT) : BOND_MIN_LINK_CHUNKS;
+    }
+    // 살아 있는 링크가 없으면 하나씩 보내 봄 (스케줄러가 포트가 열린 링크로 보냄)
+    if (window == 0) {
+        window = 1;
+    }
+    return window < BOND_MAX_IN_FLIGHT ? window : BOND_MAX_IN_FLIGHT;
+}
+
+// 창이 허용하는 만큼 조각을 스케줄러에 넘긴다 (lock 을 잡은 상태). 먼저 시작한 전송부터
+static void SendChunks(void) {
+    uint32_t window = ChunkWindow();
+    BYTE buffer[BOND_HEADER_SIZE + BOND_CHUNK_SIZE];
+    for (BondSender* sender = bond.senders; sender != NULL && bond.inFlight < window; sender = sender->next) {
+        while (!sender->failed && sender->nextChunk < sender->count && bond.inFlight < window) {
+            uint32_t index = sender->nextChunk;
+            DWORD offset = index * BOND_CHUNK_SIZE;
+            DWORD size = sender->length - offset < BOND_CHUNK_SIZE ? sender->length - offset : BOND_CHUNK_SIZE;
+            PutU16(buffer, sender->id);
+            buffer[2] = sender->kind;
+            PutU32(buffer + 3, index);
+            PutU32(buffer + 7, sender->length);
+            memcpy(buffer + BOND_HEADER_SIZE, sender->data + offset, size);
+            uint32_t messageId = SchedulerSendOn(SCHED_CHANNEL_BOND, buffer, BOND_HEADER_SIZE + size);
+            if (messageId == 0) {
+                return; // 스케줄러 대기 목록이 가득 참. 다음 틱에 다시
+            }
+            sender->messageIds[index] = messageId;
+            sender->nextChunk++;
+            sender->inFlight++;
+            bond.inFlight++;
+            bond.stats.chunksSent++;
+        }
+    }
+}
+
+// 스케줄러가 조각의 확인 또는 포기를 통지
+static void OnChunkDone(ModemConfig* modem, uint32_t messageId, bool success) {
+    PlatformMutexLock(&bond.lock);
+    for (BondSender* sender = bond.senders; sender != NULL; sender = sender->next) {
+        uint32_t index = sender->base;
+        while (index < sender->nextChunk && sender->messageIds[index] != messageId) {
+            index++;
+        }
+        if (index == sender->nextChunk) {
+            continue;
+        }
+        sender->messageIds[index] = 0;
+        sender->inFlight--;
+        bond.inFlight--;
+        if (success) {
+            int modemIndex = ModemIndex(modem);
+            sender->report.chunks[modemIndex]++;
+            bond.stats.chunksAcked[modemIndex]++;
+        }
+        else {
+            sender->failed = true; // 스케줄러가 모든 링크로 다시 보내 보고 포기함
+        }
+        while (sender->base < sender->nextChunk && sender->messageIds[sender->base] == 0) {
+            sender->base++;
+        }
+        break;
+    }
+    PlatformMutexUnlock(&bond.lock);
+    PlatformEventSet(&bond.wake);
+}
+
+static DWORD WINAPI BondThread(LPVOID param) {
+    (void)param;
+    while (AtomicLoadAcquire32(&bond.running)) {
+        BondSender* finished = NULL;
+
+        PlatformMutexLock(&bond.lock);
+        uint64_t now = PlatformNowNs();
+        SendChunks();
+        // 모두 확인되었거나, 실패한 뒤 보낸 조각의 통지가 모두 온 전송을 정리
+        BondSender** link = &bond.senders;
+        while (*link != NULL) {
+            BondSender* sender = *link;
+            if (sender->inFlight > 0 || (!sender->failed && sender->base < sender->count)) {
+                link = &sender->next;
+                continue;
+            }
+            sender->report.elapsedNs = now - sender->startNs;
+            if (sender->failed) {
+                bond.stats.transfersFailed++;
+            }
+            else {
+                bond.stats.transfersSent++;
+                bond.stats.lastThroughput = sender->length / (sender->report.elapsedNs / 1e9);
+            }
+            bond.senderCount--;
+            *link = sender->next;
+            sender->next = finished;
+            finished = sender;
+        }
+
+        // 송신 측이 포기한 수신 전송 정리
+        BondReceiver** receiverLink = &bond.receivers;
+        while (*receiverLink != NULL) {
+            BondReceiver* receiver = *receiverLink;
+            if (now - receiver->lastNs >= BOND_RECEIVE_TIMEOUT_MS * 1000000ULL) {
+                *receiverLink = receiver->next;
+                bond.receiverCount--;
+                FreeReceiver(receiver);
+                continue;
+            }
+            receiverLink = &receiver->next;
+        }
+        PlatformMutexUnlock(&bond.lock);
+
+        while (finished != NULL) {
+            BondSender* next = finished->next;
+            if (bond.done != NULL) {
+                bond.done(finished->id, !finished->failed, &finished->report);
+            }
+            FreeSender(finished);
+            finished = next;
+        }
+        PlatformEventWait(&bond.wake, BOND_TICK_MS);
+    }
+    return 0;
+}
+
+// 수신 처리 스레드에서 호출: 스케줄러가 중복을 걸러 전달한 조각
+static void OnChunk(ModemConfig* modem, const BYTE* payload, DWORD length) {
+    if (length <= BOND_HEADER_SIZE) {
+        return;
+    }
+    uint16_t id = (uint16_t)GetU16(payload);
+    BYTE kind = payload[2];
+    uint32_t index = GetU32(payload + 3);
+    DWORD total = GetU32(payload + 7);
+    if (total == 0 || total > BOND_MAX_TRANSFER) {
+        return;
+    }
+    uint32_t count = (total + BOND_CHUNK_SIZE - 1) / BOND_CHUNK_SIZE;
+    DWORD offset = index * BOND_CHUNK_SIZE;
+    DWORD size = length - BOND_HEADER_SIZE;
+    if (index >= count || size != (total - offset < BOND_CHUNK_SIZE ? total - offset : BOND_CHUNK_SIZE)) {
+        return;
+    }
+
+    BondReceiver* complete = NULL;
+    PlatformMutexLock(&bond.lock);
+    BondReceiver** receiverLink = &bond.receivers;
+    while (*receiverLink != NULL && (*receiverLink)->id != id) {
+        receiverLink = &(*receiverLink)->next;
+    }
+    BondReceiver* receiver = *receiverLink;
+    if (receiver != NULL && (receiver->length != total || receiver->kind != kind)) {
+        // 상대가 다시 시작해 같은 id 를 다른 전송에 씀
+        *receiverLink = receiver->next;
+        bond.receiverCount--;
+        FreeReceiver(receiver);
+        receiver = NULL;
+    }
+    if (receiver == NULL) {
+        receiver = bond.receiverCount < BOND_MAX_RECEIVES ? (BondReceiver*)calloc(1, sizeof(BondReceiver)) : NULL;
+        if (receiver == NULL) {
+            PlatformMutexUnlock(&bond.lock);
+            return; // 조각은 확인되었으므로 이 전송은 송신 측에서 끝나지만 전달되지 않음
+        }
+        receiver->id = id;
+        receiver->kind = kind;
+        receiver->length = total;
+        receiver->count = count;
+        receiver->data = (BYTE*)malloc(total);
+        receiver->received = (BYTE*)calloc(count, 1);
+        if (receiver->data == NULL || receiver->received == NULL) {
+            FreeReceiver(receiver);
+            PlatformMutexUnlock(&bond.lock);
+            return;
+        }
+        receiver->next = bond.receivers;
+        bond.receivers = receiver;
+        bond.receiverCount++;
+        receiverLink = &bond.receivers;
+    }
+    receiver->lastNs = PlatformNowNs();
+    if (!receiver->received[index]) {
+        memcpy(receiver->data + offset, payload + BOND_HEADER_SIZE, size);
+        receiver->received[index] = 1;
+        receiver->receivedCount++;
+    }
+    if (receiver->receivedCount == count) {
+        *receiverLink = receiver->next;
+        bond.receiverCount--;
+        bond.stats.transfersReceived++;
+        complete = receiver;
+    }
+    PlatformMutexUnlock(&bond.lock);
+
+    if (complete != NULL) {
+        if (bond.deliver != NULL) {
+            bond.deliver(modem, complete->kind, complete->data, complete->length);
+        }
+        FreeReceiver(complete);
+    }
+}
+
+bool BondStart(BondDeliverProc deliver, BondDoneProc done) {
+    memset(&bond, 0, sizeof(bond));
+    bond.deliver = deliver;
+    bond.done = done;
+    // 재시작한 상대가 받다 만 전송과 같은 id 를 받지 않도록 임의의 값에서 시작
+    bond.nextId = (uint16_t)(PlatformNowNs() >> 10);
+    PlatformMutexInit(&bond.lock);
+    if (!PlatformEventInit(&bond.wake)) {
+        return false;
+    }
+    SchedulerSetChannel(SCHED_CHANNEL_BOND, OnChunk, OnChunkDone);
+    AtomicStoreRelease32(&bond.running, 1);
+    if (!PlatformThreadStart(&bond.thread, BondThread, NULL)) {
+        AtomicStoreRelease32(&bond.running, 0);
+        PlatformEventDestroy(&bond.wake);
+        return false;
+    }
+    return true;
+}
+
+void BondStop(void) {
+    if (!AtomicLoadAcquire32(&bond.running)) {
+        return;
+    }
+    AtomicStoreRelease32(&bond.running, 0);
+    PlatformEventSet(&bond.wake);
+    PlatformThreadJoin(bond.thread);
+
+    while (bond.senders != NULL) {
+        BondSender* sender = bond.senders;
+        bond.senders = sender->next;
+        sender->report.elapsedNs = PlatformNowNs() - sender->startNs;
+        if (bond.done != NULL) {
+            bond.done(sender->id, false, &sender->report);
+        }
+        FreeSender(sender);
+    }
+    while (bond.receivers != NULL) {
+        BondReceiver* receiver = bond.receivers;
+        bond.receivers = receiver->next;
+        FreeReceiver(receiver);
+    }
+    PlatformEventDestroy(&bond.wake);
+    PlatformMutexDestroy(&bond.lock);
+}
+
+uint16_t BondSend(BYTE kind, const BYTE* data, DWORD length) {
+    if (!AtomicLoadAcquire32(&bond.running) || length == 0 || length > BOND_MAX_TRANSFER) {
+        return 0;
+    }
+    BondSender* sender = (BondSender*)calloc(1, sizeof(BondSender));
+    if (sender == NULL) {
+        return 0;
+    }
+    sender->kind = kind;
+    sender->length = length;
+    sender->count = (length + BOND_CHUNK_SIZE - 1) / BOND_CHUNK_SIZE;
+    sender->data = (BYTE*)malloc(length);
+    sender->messageIds = (uint32_t*)calloc(sender->count, sizeof(uint32_t));
+    if (sender->data == NULL || sender->messageIds == NULL) {
+        FreeSender(sender);
+        return 0;
+    }
+    memcpy(sender->data, data, length);
+    sender->report.length = length;
+    sender->startNs = PlatformNowNs();
+
+    PlatformMutexLock(&bond.lock);
+    if (bond.senderCount >= BOND_MAX_SENDS) {
+        PlatformMutexUnlock(&bond.lock);
+        FreeSender(sender);
+        return 0;
+    }
+    if (++bond.nextId == 0) {
+        bond.nextId = 1; // 0 은 실패를 뜻함
+    }
+    sender->id = bond.nextId;
+    // 먼저 시작한 전송이 먼저 창을 채우도록 목록 끝에 추가
+    BondSender** link = &bond.senders;
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+    *link = sender;
+    bond.senderCount++;
+    uint16_t id = sender->id;
+    PlatformMutexUnlock(&bond.lock);
+
+    PlatformEventSet(&bond.wake);
+    return id;
+}
+
+void BondQueryStats(BondStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!AtomicLoadAcquire32(&bond.running)) {
+        return;
+    }
+    PlatformMutexLock(&bond.lock);
+    *stats = bond.stats;
+    PlatformMutexUnlock(&bond.lock);
+}
@@ -0,0 +1,52 @@
+﻿#pragma once
+#include "platform.h"
+#include "modem.h"
+#include "arq.h"
+
+// 링크 묶음(bonding) 전송
+// 큰 데이터를 BOND_CHUNK_SIZE 조각으로 나누어 스케줄러의 모든 링크로 동시에 보낸다.
+// 조각마다 스케줄러가 예상 완료 시간(측정한 송신 속도와 송신 큐 대기분 기준)이 가장 이른 링크를 고르므로
+// 조각은 링크 속도에 비례해 나뉘고, 전체 처리량은 링크 속도의 합에 가까워진다.
+// 한 번에 보내 두는 조각은 살아 있는 링크마다 BOND_QUEUE_MS 동안 보낼 수 있는 양으로 제한한다.
+// 미리 많이 나눠 두면 속도 추정이 틀렸을 때 느린 링크에 몰린 조각 때문에 전송 끝이 늦어진다.
+// 확인되지 않은 조각은 스케줄러가 다른 링크로 다시 보내고, 수신 측은 조각을 번호 순서대로 모아
+// 모두 도착하면 한 번에 전달한다. 조각은 스케줄러의 SCHED_CHANNEL_BOND 채널로 오간다.
+
+#define BOND_CHUNK_SIZE 1024
+#define BOND_HEADER_SIZE 11      // 전송 id(2) | 종류(1, ARQ_KIND_*) | 조각 번호(4) | 전체 길이(4)
+#define BOND_MAX_TRANSFER ARQ_MAX_TRANSFER
+#define BOND_QUEUE_MS 1000
+#define BOND_MIN_LINK_CHUNKS 2   // 느린 링크에도 이만큼은 보내 둠
+#define BOND_MAX_IN_FLIGHT 192   // 스케줄러 대기 목록(SCHED_MAX_PENDING)을 사용자 메시지와 나눠 씀
+#define BOND_MAX_SENDS 4         // 동시에 보내는 전송 수
+#define BOND_MAX_RECEIVES 4      // 동시에 받는 전송 수
+#define BOND_RECEIVE_TIMEOUT_MS 60000
+
+typedef struct {
+    DWORD length;
+    uint64_t elapsedNs;
+    int32_t chunks[MAX_MODEMS];  // 모뎀 목록 순서(ModemIndex)별로 확인된 조각 수
+} BondReport;
+
+typedef struct {
+    int32_t transfersSent;
+    int32_t transfersFailed;
+    int32_t transfersReceived;
+    int32_t chunksSent;
+    int32_t chunksAcked[MAX_MODEMS]; // 모뎀 목록 순서별
+    double lastThroughput;           // 마지막으로 끝난 전송의 바이트/초
+} BondStats;
+
+// 수신 처리 스레드에서 호출: 묶음 전송 하나가 모두 도착함
+typedef void (*BondDeliverProc)(ModemConfig* modem, BYTE kind, const BYTE* data, DWORD length);
+// 묶음 전송이 모두 확인되었거나(success) 포기됨
+typedef void (*BondDoneProc)(uint16_t transferId, bool success, const BondReport* report);
+
+// SchedulerStart 뒤에 시작하고 SchedulerStop 뒤에 종료한다. 끝나지 않은 전송은 실패로 통지
+bool BondStart(BondDeliverProc deliver, BondDoneProc done);
+void BondStop(void);
+
+// 전송을 시작하고 전송 id 를 반환한다 (실패하면 0). data 는 복사된다
+uint16_t BondSend(BYTE kind, const BYTE* data, DWORD length);
+
+void BondQueryStats(BondStats* stats);
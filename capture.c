@@ -0,0 +1,346 @@
+﻿#include "platform.h"
+#include "capture.h"
+
+#define CAPTURE_MAGIC "UHSDMCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_RECORD_HEADER 12
+#define CAPTURE_MODEM_ENTRY 40
+
+typedef struct {
+    BYTE* data;
+    DWORD length;
+} CaptureSegment;
+
+static struct {
+    FILE* file;
+    volatile int32_t active;
+    uint64_t startNs;
+    PlatformMutex lock;        // 세그먼트 목록과 현재 세그먼트 (복사하는 동안만 잡음)
+    PlatformEvent ready;
+    PlatformThread thread;
+    volatile int32_t running;
+    CaptureSegment segments[CAPTURE_SEGMENTS];
+    int current;               // 기록 중인 세그먼트 (-1 = 빈 세그먼트 없음)
+    int full[CAPTURE_SEGMENTS]; // 파일에 쓸 세그먼트 (FIFO)
+    int fullHead;
+    int fullCount;
+    int free[CAPTURE_SEGMENTS];
+    int freeCount;
+    CaptureStats stats;
+} capture;
+
+static void PutU16(BYTE* p, uint32_t value) {
+    p[0] = (BYTE)value;
+    p[1] = (BYTE)(value >> 8);
+}
+
+static void PutU32(BYTE* p, uint32_t value) {
+    p[0] = (BYTE)value;
+    p[1] = (BYTE)(value >> 8);
+    p[2] = (BYTE)(value >> 16);
+    p[3] = (BYTE)(value >> 24);
+}
+
+static void PutU64(BYTE* p, uint64_t value) {
+    PutU32(p, (uint32_t)value);
+    PutU32(p + 4, (uint32_t)(value >> 32));
+}
+
+static uint32_t GetU16(const BYTE* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static uint32_t GetU32(const BYTE* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t GetU64(const BYTE* p) {
+    return (uint64_t)GetU32(p) | ((uint64_t)GetU32(p + 4) << 32);
+}
+
+// 현재 세그먼트를 쓰기 목록으로 넘기고 빈 세그먼트를 꺼낸다 (lock 을 잡은 상태)
+static void RotateSegment(void) {
+    if (capture.current >= 0) {
+        capture.full[(capture.fullHead + capture.fullCount) % CAPTURE_SEGMENTS] = capture.current;
+        capture.fullCount++;
+    }
+    capture.current = capture.freeCount > 0 ? capture.free[--capture.freeCount] : -1;
+}
+
+static DWORD WINAPI CaptureThread(LPVOID param) {
+    (void)param;
+    for (;;) {
+        bool running = AtomicLoadAcquire32(&capture.running) != 0;
+        if (running) {
+            PlatformEventWait(&capture.ready, CAPTURE_FLUSH_MS);
+        }
+        PlatformMutexLock(&capture.lock);
+        // 덜 찬 세그먼트도 주기적으로 (종료할 때는 모두) 내보냄
+        if (capture.current >= 0 && capture.segments[capture.current].length > 0 && (capture.freeCount > 0 || !running)) {
+            RotateSegment();
+        }
+        PlatformMutexUnlock(&capture.lock);
+
+        for (;;) {
+            PlatformMutexLock(&capture.lock);
+            int index = -1;
+            if (capture.fullCount > 0) {
+                index = capture.full[capture.fullHead];
+                capture.fullHead = (capture.fullHead + 1) % CAPTURE_SEGMENTS;
+                capture.fullCount--;
+            }
+            PlatformMutexUnlock(&capture.lock);
+            if (index < 0) {
+                break;
+            }
+            CaptureSegment* segment = &capture.segments[index];
+            size_t written = fwrite(segment->data, 1, segment->length, capture.file);
+            fflush(capture.file);
+
+            PlatformMutexLock(&capture.lock);
+            capture.stats.fileBytes += (int64_t)written;
+            segment->length = 0;
+            if (capture.current < 0) {
+                capture.current = index;
+            }
+            else {
+                capture.free[capture.freeCount++] = index;
+            }
+            PlatformMutexUnlock(&capture.lock);
+        }
+        if (!running) {
+            break;
+        }
+    }
+    return 0;
+}
+
+static void FreeSegments(void) {
+    for (int i = 0; i < CAPTURE_SEGMENTS; i++) {
+        free(capture.segments[i].data);
+        capture.segments[i].data = NULL;
+    }
+}
+
+bool CaptureStart(const TCHAR* path) {
+    if (AtomicLoadAcquire32(&capture.active)) {
+        return false;
+    }
+    memset(&capture.stats, 0, sizeof(capture.stats));
+    for (int i = 0; i < CAPTURE_SEGMENTS; i++) {
+        capture.segments[i].data = (BYTE*)malloc(CAPTURE_SEGMENT_SIZE);
+        capture.segments[i].length = 0;
+        if (capture.segments[i].data == NULL) {
+            FreeSegments();
+            return false;
+        }
+    }
+    capture.file = _tfopen(path, TEXT("wb"));
+    if (capture.file == NULL) {
+        _ftprintf(stderr, TEXT("Cannot open capture file %s\n"), path);
+        FreeSegments();
+        return false;
+    }
+
+    BYTE header[12 + MAX_MODEMS * CAPTURE_MODEM_ENTRY];
+    memset(header, 0, sizeof(header));
+    memcpy(header, CAPTURE_MAGIC, 8);
+    PutU16(header + 8, CAPTURE_VERSION);
+    PutU16(header + 10, (uint32_t)modemRegistry.count);
+    for (int i = 0; i < modemRegistry.count; i++) {
+        const ModemConfig* modem = &modemRegistry.modems[i];
+        BYTE* entry = header + 12 + i * CAPTURE_MODEM_ENTRY;
+        for (int c = 0; c < MAX_MODEM_NAME - 1 && modem->name[c] != TEXT('\0'); c++) {
+            entry[c] = (BYTE)modem->name[c]; // 섹션 이름은 ASCII
+        }
+        entry[32] = (BYTE)modem->framing;
+        PutU32(entry + 36, (uint32_t)modem->baudRate);
+    }
+    size_t headerSize = 12 + (size_t)modemRegistry.count * CAPTURE_MODEM_ENTRY;
+    if (fwrite(header, 1, headerSize, capture.file) != headerSize) {
+        fclose(capture.file);
+        FreeSegments();
+        return false;
+    }
+    capture.stats.fileBytes = (int64_t)headerSize;
+
+    capture.current = 0;
+    capture.fullHead = 0;
+    capture.fullCount = 0;
+    capture.freeCount = 0;
+    for (int i = CAPTURE_SEGMENTS - 1; i > 0; i--) {
+        capture.free[capture.freeCount++] = i;
+    }
+    PlatformMutexInit(&capture.lock);
+    if (!PlatformEventInit(&capture.ready)) {
+        fclose(capture.file);
+        FreeSegments();
+        return false;
+    }
+    capture.startNs = PlatformNowNs();
+    AtomicStoreRelease32(&capture.running, 1);
+    if (!PlatformThreadStart(&capture.thread, CaptureThread, NULL)) {
+        AtomicStoreRelease32(&capture.running, 0);
+        PlatformEventDestroy(&capture.ready);
+        fclose(capture.file);
+        FreeSegments();
+        return false;
+    }
+    AtomicStoreRelease32(&capture.active, 1);
+    return true;
+}
+
+void CaptureStop(void) {
+    if (!AtomicLoadAcquire32(&capture.active)) {
+        return;
+    }
+    AtomicStoreRelease32(&capture.active, 0);
+    AtomicStoreRelease32(&capture.running, 0);
+    PlatformEventSet(&capture.ready);
+    PlatformThreadJoin(capture.thread);
+    PlatformEventDestroy(&capture.ready);
+    PlatformMutexDestroy(&capture.lock);
+    fclose(capture.file);
+    capture.file = NULL;
+    FreeSegments();
+}
+
+bool CaptureActive(void) {
+    return AtomicLoadAcquire32(&capture.active) != 0;
+}
+
+void CaptureRecord(const ModemConfig* modem, BYTE direction, const BYTE* data, DWORD size) {
+    if (!AtomicLoadAcquire32(&capture.active)) {
+        return;
+    }
+    uint64_t nowNs = PlatformNowNs() - capture.startNs;
+    BYTE index = (BYTE)ModemIndex(modem);
+    PlatformMutexLock(&capture.lock);
+    while (size > 0) {
+        DWORD length = size < CAPTURE_MAX_RECORD ? size : CAPTURE_MAX_RECORD;
+        if (capture.current >= 0 && capture.segments[capture.current].length + CAPTURE_RECORD_HEADER + length > CAPTURE_SEGMENT_SIZE) {
+            RotateSegment();
+            PlatformEventSet(&capture.ready);
+        }
+        if (capture.current < 0) {
+            capture.stats.droppedRecords++;
+        }
+        else {
+            CaptureSegment* segment = &capture.segments[capture.current];
+            BYTE* p = segment->data + segment->length;
+            PutU64(p, nowNs);
+            p[8] = index;
+            p[9] = direction;
+            PutU16(p + 10, length);
+            memcpy(p + CAPTURE_RECORD_HEADER, data, length);
+            segment->length += CAPTURE_RECORD_HEADER + length;
+            capture.stats.records++;
+            capture.stats.bytes[direction == CAPTURE_TX ? CAPTURE_TX : CAPTURE_RX] += length;
+        }
+        data += length;
+        size -= length;
+    }
+    PlatformMutexUnlock(&capture.lock);
+}
+
+void CaptureQueryStats(CaptureStats* stats) {
+    if (!AtomicLoadAcquire32(&capture.active)) {
+        *stats = capture.stats;
+        return;
+    }
+    PlatformMutexLock(&capture.lock);
+    *stats = capture.stats;
+    PlatformMutexUnlock(&capture.lock);
+}
+
+bool CaptureReplayOpen(CaptureReplay* replay, const TCHAR* path) {
+    memset(replay, 0, sizeof(*replay));
+    replay->file = _tfopen(path, TEXT("rb"));
+    if (replay->file == NULL) {
+        _ftprintf(stderr, TEXT("Cannot open capture file %s\n"), path);
+        return false;
+    }
+    BYTE header[12];
+    if (fread(header, 1, sizeof(header), replay->file) != sizeof(header) || memcmp(header, CAPTURE_MAGIC, 8) != 0 ||
+        GetU16(header + 8) != CAPTURE_VERSION || GetU16(header + 10) > MAX_MODEMS) {
+        _ftprintf(stderr, TEXT("%s is not a capture file.\n"), path);
+        CaptureReplayClose(replay);
+        return false;
+    }
+    replay->modemCount = (int)GetU16(header + 10);
+
+    memset(&modemRegistry, 0, sizeof(modemRegistry));
+    for (int i = 0; i < replay->modemCount; i++) {
+        BYTE entry[CAPTURE_MODEM_ENTRY];
+        ModemConfig* modem = &modemRegistry.modems[i];
+        if (fread(entry, 1, sizeof(entry), replay->file) != sizeof(entry)) {
+            CaptureReplayClose(replay);
+            return false;
+        }
+        for (int c = 0; c < MAX_MODEM_NAME - 1 && entry[c] != 0; c++) {
+            modem->name[c] = (TCHAR)entry[c];
+        }
+        _stprintf(modem->portName, TEXT("capture:%d"), i);
+        modem->hSerial = INVALID_HANDLE_VALUE;
+        modem->framing = entry[32] == FRAMING_COBS ? FRAMING_COBS : FRAMING_RAW;
+        modem->baudRate = (int)GetU32(entry + 36);
+        modem->linkRate = modem->baudRate;
+        modem->compression = COMPRESS_LZ;
+        if (!RingInit(&modem->rxRing, RING_DEFAULT_SIZE) || !FrameParserInit(&modem->rxFrame)) {
+            CaptureReplayClose(replay);
+            return false;
+        }
+        modemRegistry.count = i + 1;
+    }
+    return true;
+}
+
+bool CaptureReplayRun(CaptureReplay* replay, double speed, ReactorReceiveProc onReceive) {
+    static BYTE data[CAPTURE_MAX_RECORD];
+    BYTE header[CAPTURE_RECORD_HEADER];
+    uint64_t startNs = PlatformNowNs();
+    bool ok = true;
+    while (fread(header, 1, sizeof(header), replay->file) == sizeof(header)) {
+        uint64_t timeNs = GetU64(header);
+        int index = header[8];
+        BYTE direction = header[9];
+        DWORD length = GetU16(header + 10);
+        if (fread(data, 1, length, replay->file) != length) {
+            ok = false; // 기록 중에 끊긴 파일
+            break;
+        }
+        replay->records++;
+        replay->bytes[direction == CAPTURE_TX ? CAPTURE_TX : CAPTURE_RX] += length;
+        replay->durationNs = timeNs;
+        if (direction != CAPTURE_RX || index >= replay->modemCount) {
+            continue;
+        }
+        ModemConfig* modem = &modemRegistry.modems[index];
+        if (speed > 0.0) {
+            uint64_t dueNs = startNs + (uint64_t)(timeNs / speed);
+            uint64_t nowNs = PlatformNowNs();
+            if (dueNs > nowNs + 1000000) {
+                PlatformSleepMs((DWORD)((dueNs - nowNs) / 1000000));
+            }
+        }
+        // 실제 리액터와 달리 재생은 수신 처리 스레드를 기다릴 수 있으므로 링이 넘치지 않게 함
+        while (RingUsed(&modem->rxRing) + length > modem->rxRing.capacity) {
+            PlatformSleepMs(0);
+        }
+        onReceive(modem, data, length);
+    }
+    replay->elapsedNs = PlatformNowNs() - startNs;
+    return ok;
+}
+
+void CaptureReplayClose(CaptureReplay* replay) {
+    if (replay->file != NULL) {
+        fclose(replay->file);
+        replay->file = NULL;
+    }
+    for (int i = 0; i < modemRegistry.count; i++) {
+        RingFree(&modemRegistry.modems[i].rxRing);
+        FrameParserFree(&modemRegistry.modems[i].rxFrame);
+    }
+    modemRegistry.count = 0;
+}
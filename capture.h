@@ -0,0 +1,53 @@
+﻿#pragma once
+#include "platform.h"
+#include "modem.h"
+#include "reactor.h"
+
+// 송수신 캡처와 재생
+// 포트에 쓴 배치(TX)와 리액터가 읽은 조각(RX)을 단조 시계 타임스탬프(ns)와 모뎀 번호를 붙여
+// 추가 전용 바이너리 파일에 남긴다. 파일 형식 (모두 리틀 엔디언):
+//   헤더  "UHSDMCAP" | 버전(2) | 모뎀 수(2) | 모뎀마다 이름(32) framing(1) 예약(3) BaudRate(4)
+//   레코드 시각(8, 캡처 시작부터 ns) | 모뎀 번호(1) | 방향(1) | 길이(2) | 데이터
+// 기록하는 스레드(리액터, 송신 스레드)는 미리 할당한 세그먼트에 복사만 하고, 파일 쓰기는 캡처 스레드가
+// 가득 찬 세그먼트 단위로 한다. 빈 세그먼트가 없으면 레코드를 버리고 세므로 I/O 경로는 파일을 기다리지 않는다.
+//   UHSDM --capture <파일>           평소처럼 실행하면서 모든 모뎀의 송수신을 기록
+//   UHSDM --replay <파일> [배속]     RX 레코드를 수신 처리 경로로 다시 흘려 보냄 (0 = 최대 속도, 기본 1)
+
+#define CAPTURE_RX 0
+#define CAPTURE_TX 1
+
+#define CAPTURE_SEGMENT_SIZE (1024 * 1024)
+#define CAPTURE_SEGMENTS 8
+#define CAPTURE_FLUSH_MS 500   // 덜 찬 세그먼트라도 이 간격으로 파일에 씀
+#define CAPTURE_MAX_RECORD 65535
+
+typedef struct {
+    int64_t records;
+    int64_t bytes[2];          // CAPTURE_RX / CAPTURE_TX 데이터 바이트
+    int64_t droppedRecords;    // 빈 세그먼트가 없어 버린 레코드
+    int64_t fileBytes;
+} CaptureStats;
+
+// 모뎀 목록을 만든 뒤 호출 (헤더에 모뎀 이름과 framing 을 남김)
+bool CaptureStart(const TCHAR* path);
+// 남은 세그먼트를 모두 쓰고 파일을 닫는다 (송수신 스레드를 멈춘 뒤)
+void CaptureStop(void);
+bool CaptureActive(void);
+// 리액터/송신 스레드에서 호출. 캡처 중이 아니면 바로 반환
+void CaptureRecord(const ModemConfig* modem, BYTE direction, const BYTE* data, DWORD size);
+void CaptureQueryStats(CaptureStats* stats);
+
+typedef struct {
+    FILE* file;
+    int modemCount;
+    int64_t records;
+    int64_t bytes[2];
+    uint64_t durationNs;       // 마지막 레코드의 시각
+    uint64_t elapsedNs;        // 재생에 걸린 시간
+} CaptureReplay;
+
+// 헤더를 읽고 modemRegistry 를 캡처한 모뎀(이름, framing, 수신 링/파서)으로 채운다
+bool CaptureReplayOpen(CaptureReplay* replay, const TCHAR* path);
+// RX 레코드를 speed 배속(0 = 기다리지 않음)으로 onReceive 에 넘긴다. 수신 링이 차면 빌 때까지 기다림
+bool CaptureReplayRun(CaptureReplay* replay, double speed, ReactorReceiveProc onReceive);
+void CaptureReplayClose(CaptureReplay* replay);
@@ -0,0 +1,197 @@
+﻿#include "platform.h"
+#include "clocksync.h"
+#include "modem.h"
+
+#define CLOCK_TICK_MS 50
+
+static struct {
+    PlatformThread thread;
+    PlatformEvent wake;
+    volatile int32_t running;
+} clockSync;
+
+static void PutU32(BYTE* p, uint32_t value) {
+    p[0] = (BYTE)value;
+    p[1] = (BYTE)(value >> 8);
+    p[2] = (BYTE)(value >> 16);
+    p[3] = (BYTE)(value >> 24);
+}
+
+static void PutU64(BYTE* p, uint64_t value) {
+    PutU32(p, (uint32_t)value);
+    PutU32(p + 4, (uint32_t)(value >> 32));
+}
+
+static uint32_t GetU32(const BYTE* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t GetU64(const BYTE* p) {
+    return (uint64_t)GetU32(p) | ((uint64_t)GetU32(p + 4) << 32);
+}
+
+static void OnSyncWritten(ModemConfig* modem, uint32_t messageId, bool success) {
+    (void)modem;
+    (void)messageId;
+    (void)success; // 잃은 SYNC 는 다음 주기에 다시 보냄
+}
+
+static bool Syncing(const ModemConfig* modem) {
+    return modem->framing == FRAMING_COBS && (modem->timestamps || AtomicLoadAcquire32(&modem->clock.peerMeasuring));
+}
+
+static DWORD WINAPI ClockSyncThread(LPVOID param) {
+    (void)param;
+    while (AtomicLoadAcquire32(&clockSync.running)) {
+        uint64_t now = PlatformNowNs();
+        for (int i = 0; i < modemRegistry.count; i++) {
+            ModemConfig* modem = &modemRegistry.modems[i];
+            ClockSync* clock = &modem->clock;
+            // 다시 연결한 뒤(초기화 요청이 남아 있음)에도 표본을 빨리 모음
+            bool collecting = clock->sampleCount < CLOCK_SAMPLES || AtomicLoadAcquire32(&clock->resetRequested);
+            DWORD intervalMs = collecting ? CLOCK_SYNC_FAST_MS : CLOCK_SYNC_MS;
+            if (!Syncing(modem) || modem->hSerial == INVALID_HANDLE_VALUE || now - clock->lastSyncNs < intervalMs * 1000000ULL) {
+                continue;
+            }
+            // t1 은 송신 스레드가 프레임에 붙이는 타임스탬프
+            if (TransmitEnqueueClass(modem, TX_CLASS_CONTROL, FRAME_TYPE_CLOCK_SYNC, NULL, 0, OnSyncWritten) != 0) {
+                AtomicAddRelaxed32(&clock->syncsSent, 1);
+            }
+            clock->lastSyncNs = now;
+        }
+        PlatformEventWait(&clockSync.wake, CLOCK_TICK_MS);
+    }
+    return 0;
+}
+
+// 수신 처리 스레드가 갱신하는 상태를 처음 값으로 (수신 처리 스레드에서, 또는 그 스레드가 돌기 전에)
+static void ResetState(ClockSync* clock) {
+    AtomicStoreRelease32(&clock->peerStamps, 0);
+    AtomicStoreRelease32(&clock->peerMeasuring, 0);
+    AtomicStoreRelease32(&clock->synced, 0);
+    clock->sampleCount = 0;
+    clock->sampleNext = 0;
+    clock->haveTransit = false;
+    AtomicStoreRelease64(&clock->oneWayNs, -1);
+    AtomicStoreRelease32(&clock->forwardUs, -1);
+}
+
+void ClockSyncInit(void) {
+    for (int i = 0; i < modemRegistry.count; i++) {
+        memset(&modemRegistry.modems[i].clock, 0, sizeof(ClockSync));
+        ResetState(&modemRegistry.modems[i].clock);
+    }
+}
+
+void ClockSyncReset(ModemConfig* modem) {
+    // 송신 스레드는 바로 타임스탬프를 멈추고, 나머지 상태는 수신 처리 스레드가 다음 타임스탬프 프레임에서 지움
+    AtomicStoreRelease32(&modem->clock.peerStamps, 0);
+    AtomicStoreRelease32(&modem->clock.resetRequested, 1);
+}
+
+bool ClockSyncStart(void) {
+    if (!PlatformEventInit(&clockSync.wake)) {
+        return false;
+    }
+    AtomicStoreRelease32(&clockSync.running, 1);
+    if (!PlatformThreadStart(&clockSync.thread, ClockSyncThread, NULL)) {
+        AtomicStoreRelease32(&clockSync.running, 0);
+        PlatformEventDestroy(&clockSync.wake);
+        return false;
+    }
+    return true;
+}
+
+void ClockSyncStop(void) {
+    if (!AtomicLoadAcquire32(&clockSync.running)) {
+        return;
+    }
+    AtomicStoreRelease32(&clockSync.running, 0);
+    PlatformEventSet(&clockSync.wake);
+    PlatformThreadJoin(clockSync.thread);
+    PlatformEventDestroy(&clockSync.wake);
+}
+
+bool ClockSyncStamps(const ModemConfig* modem, BYTE type) {
+    if (type == FRAME_TYPE_CLOCK_SYNC || type == FRAME_TYPE_CLOCK_REPLY) {
+        return true;
+    }
+    return modem->timestamps && AtomicLoadAcquire32(&modem->clock.peerStamps);
+}
+
+// 응답 하나로 얻은 표본을 넣고 왕복이 가장 짧은 표본의 offset 을 고른다
+static void AddSample(ClockSync* clock, int64_t offsetNs, int64_t rttNs) {
+    clock->sampleOffsetNs[clock->sampleNext] = offsetNs;
+    clock->sampleRttNs[clock->sampleNext] = rttNs;
+    clock->sampleNext = (clock->sampleNext + 1) % CLOCK_SAMPLES;
+    if (clock->sampleCount < CLOCK_SAMPLES) {
+        clock->sampleCount++;
+    }
+    int best = 0;
+    for (int i = 1; i < clock->sampleCount; i++) {
+        if (clock->sampleRttNs[i] < clock->sampleRttNs[best]) {
+            best = i;
+        }
+    }
+    AtomicStoreRelease64(&clock->offsetNs, clock->sampleOffsetNs[best]);
+    AtomicStoreRelease64(&clock->rttNs, clock->sampleRttNs[best]);
+    AtomicStoreRelease32(&clock->synced, 1);
+}
+
+// 타임스탬프 프레임 하나의 단방향 지연과 지터
+static void RecordTransit(ModemConfig* modem, uint64_t sentNs, uint64_t arrivalNs) {
+    ClockSync* clock = &modem->clock;
+    int64_t transitNs = (int64_t)(arrivalNs - sentNs);
+    if (clock->haveTransit) {
+        int64_t delta = transitNs - clock->lastTransitNs;
+        int64_t jitterNs = clock->jitterNs;
+        AtomicStoreRelease64(&clock->jitterNs, jitterNs + ((delta < 0 ? -delta : delta) - jitterNs) / 16);
+    }
+    clock->lastTransitNs = transitNs;
+    clock->haveTransit = true;
+    AtomicAddRelaxed32(&clock->stampedFrames, 1);
+
+    if (!AtomicLoadAcquire32(&clock->synced)) {
+        AtomicAddRelaxed32(&clock->unsyncedFrames, 1);
+        return;
+    }
+    int64_t oneWayNs = transitNs + clock->offsetNs;
+    oneWayNs = oneWayNs > 0 ? oneWayNs : 0; // offset 추정 오차
+    HistogramRecord(&modem->metrics.oneWayLatency, (uint64_t)oneWayNs);
+    int64_t smoothedNs = clock->oneWayNs;
+    AtomicStoreRelease64(&clock->oneWayNs, smoothedNs < 0 ? oneWayNs : smoothedNs + (oneWayNs - smoothedNs) / 8);
+}
+
+bool ClockSyncReceive(ModemConfig* modem, const FrameHeader* header, uint64_t sentNs, uint64_t arrivalNs,
+    const BYTE* payload, DWORD length) {
+    ClockSync* clock = &modem->clock;
+    if (AtomicLoadAcquire32(&clock->resetRequested)) {
+        AtomicStoreRelease32(&clock->resetRequested, 0);
+        ResetState(clock);
+    }
+    if (!AtomicLoadAcquire32(&clock->peerMeasuring)) {
+        AtomicStoreRelease32(&clock->peerMeasuring, 1);
+    }
+    if (header->type == FRAME_TYPE_CLOCK_REPLY && length >= CLOCK_REPLY_SIZE) {
+        // t1 은 이쪽 시계, t2/t3 는 상대 시계
+        uint64_t t1 = GetU64(payload);
+        uint64_t t2 = GetU64(payload + 8);
+        int64_t rttNs = (int64_t)(arrivalNs - t1) - (int64_t)(sentNs - t2);
+        if (t1 <= arrivalNs && rttNs >= 0) {
+            AddSample(clock, ((int64_t)(t2 - t1) + (int64_t)(sentNs - arrivalNs)) / 2, rttNs);
+        }
+        AtomicStoreRelease32(&clock->forwardUs, (int32_t)GetU32(payload + 16));
+        AtomicAddRelaxed32(&clock->replies, 1);
+        AtomicStoreRelease32(&clock->peerStamps, 1);
+    }
+    RecordTransit(modem, sentNs, arrivalNs);
+    if (header->type == FRAME_TYPE_CLOCK_SYNC) {
+        BYTE reply[CLOCK_REPLY_SIZE];
+        int64_t oneWayNs = clock->oneWayNs;
+        PutU64(reply, sentNs);
+        PutU64(reply + 8, arrivalNs);
+        PutU32(reply + 16, (uint32_t)(oneWayNs < 0 ? -1 : (int32_t)(oneWayNs / 1000)));
+        TransmitEnqueueClass(modem, TX_CLASS_CONTROL, FRAME_TYPE_CLOCK_REPLY, reply, sizeof(reply), OnSyncWritten);
+    }
+    return header->type == FRAME_TYPE_CLOCK_SYNC || header->type == FRAME_TYPE_CLOCK_REPLY;
+}
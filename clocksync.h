@@ -0,0 +1,63 @@
+﻿#pragma once
+#include "platform.h"
+#include "frame.h"
+
+// 링크 시계 동기화와 단방향 지연
+// 두 노드의 단조 시계는 서로 관계가 없으므로, 프레임 모드 링크마다 양방향 시간 전송(NTP 방식)으로
+// 상대 시계와의 차이(offset = 상대 시계 - 내 시계)를 추정한다. 시각은 송신 스레드가 프레임을 인코딩할 때
+// 프레임 앞에 붙이는 타임스탬프(FRAME_FLAG_TIMESTAMP)와 리액터가 읽은 시각을 쓰므로 송신 큐 대기는 들어가지 않는다.
+//   SYNC       : (타임스탬프 t1)
+//   SYNC_REPLY : t1(8) | t2(8, SYNC 가 도착한 시각) | 상대가 잰 이쪽 -> 상대 방향 지연(4, us, 모르면 -1) (타임스탬프 t3)
+//   응답이 도착한 시각 t4 에서 offset = ((t2 - t1) + (t3 - t4)) / 2, 왕복 = (t4 - t1) - (t3 - t2)
+// 왕복이 짧은 표본일수록 경로 비대칭과 큐 대기의 오차가 작으므로 최근 CLOCK_SAMPLES 개 가운데 왕복이 가장 짧은 표본을 쓴다.
+// Timestamps=1 인 모뎀은 CLOCK_SYNC_MS 마다 SYNC 를 보내고, 상대의 응답을 받은 뒤(상대가 형식을 안다는 뜻)부터는
+// 보내는 모든 프레임에 타임스탬프를 붙인다. 타임스탬프가 붙은 프레임을 받은 모뎀은 설정과 상관없이 동기화를 시작한다.
+// 받는 쪽은 타임스탬프를 떼어 내고 도착 시각 - 보낸 시각 + offset 을 단방향 지연 히스토그램(metrics.h)에 넣고,
+// 전송 시간의 변화로 지터(RFC 3550 방식, 1/16 평활)를 계산한다. 상대가 잰 반대 방향 지연은 응답에 실려 온다.
+
+#define CLOCK_SYNC_MS 2000
+#define CLOCK_SYNC_FAST_MS 200  // 표본이 CLOCK_SAMPLES 개 모이기 전의 간격
+#define CLOCK_SAMPLES 8
+#define CLOCK_REPLY_SIZE 20
+
+struct ModemConfig;
+
+typedef struct {
+    // 수신 처리 스레드만 갱신 (표시하는 쪽은 그대로 읽음)
+    int64_t sampleOffsetNs[CLOCK_SAMPLES];
+    int64_t sampleRttNs[CLOCK_SAMPLES];
+    int sampleCount;
+    int sampleNext;
+    volatile int64_t offsetNs;      // 상대 시계 - 내 시계
+    volatile int64_t rttNs;         // offset 을 얻은 표본의 왕복 (상대의 처리 시간 제외)
+    volatile int32_t synced;        // 표본이 하나 이상 있음
+    volatile int32_t peerStamps;    // 상대가 타임스탬프를 이해함 (응답을 받음)
+    volatile int32_t peerMeasuring; // 상대가 타임스탬프를 붙여 보냄 (이쪽도 동기화해야 지연을 잴 수 있음)
+    int64_t lastTransitNs;
+    bool haveTransit;
+    volatile int64_t jitterNs;
+    volatile int64_t oneWayNs;      // 상대 -> 이쪽 단방향 지연 (1/8 평활, 모르면 -1)
+    volatile int32_t forwardUs;     // 상대가 잰 이쪽 -> 상대 방향 지연 (모르면 -1)
+    volatile int32_t stampedFrames;
+    volatile int32_t unsyncedFrames; // offset 을 몰라 지연을 재지 못한 타임스탬프 프레임
+    volatile int32_t syncsSent;
+    volatile int32_t replies;
+    volatile int32_t resetRequested; // ClockSyncReset 이 요청하고 수신 처리 스레드가 지움
+    // 동기화 스레드만 사용
+    uint64_t lastSyncNs;
+} ClockSync;
+
+// 모든 모뎀의 동기화 상태를 처음 값으로 (수신 처리 스레드와 리액터를 시작하기 전에)
+void ClockSyncInit(void);
+// SYNC 를 보내는 스레드를 시작 (송신 스레드를 시작한 뒤)
+bool ClockSyncStart(void);
+void ClockSyncStop(void);
+// 포트를 다시 열었을 때, 어느 스레드에서나 (상대가 바뀌었을 수 있으므로 응답을 다시 받을 때까지 타임스탬프를 붙이지 않음).
+// 표본과 지연은 수신 처리 스레드가 다음 타임스탬프 프레임을 받을 때 지운다
+void ClockSyncReset(struct ModemConfig* modem);
+
+// 송신 스레드: 이 프레임에 타임스탬프를 붙일지
+bool ClockSyncStamps(const struct ModemConfig* modem, BYTE type);
+// 수신 처리 스레드: 타임스탬프를 떼어 낸 프레임마다 호출. SYNC/SYNC_REPLY 면 처리하고 true
+bool ClockSyncReceive(struct ModemConfig* modem, const FrameHeader* header, uint64_t sentNs, uint64_t arrivalNs,
+    const BYTE* payload, DWORD length);
@@ -0,0 +1,312 @@
+﻿#include "platform.h"
+#include "compress.h"
+#include "modem.h"
+#include "crc.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_HASH_SIZE (1 << LZ_HASH_BITS)
+#define LZ_RUN_MASK 15  // 토큰의 각 4비트 길이가 이 값이면 뒤에 길이 바이트가 이어짐
+
+// HELLO: 버전(1) | 지원 코덱(1) | flags(1) | 사전 id(4, LE)
+#define HELLO_VERSION 1
+#define HELLO_SIZE 7
+#define HELLO_FLAG_REPLY 0x01 // 받은 쪽도 자신의 HELLO 를 보내야 함
+
+// 내장 사전: 모뎀 텔레메트리와 제어 메시지에 자주 나오는 문자열.
+// 자주 쓰이는 것일수록 뒤에 둔다 (같은 해시 슬롯에서는 뒤에 있는 위치가 남음)
+static const char builtinDictionary[] =
+    "ERROR,TIMEOUT,RETRY,RESET,ACK,NAK,PING,PONG,SYNC,WAIT,READY,BUSY,IDLE,FAULT,WARN,INFO,"
+    "\"error\":\"\",\"code\":0,\"message\":\"\",\"version\":\"1.0\",\"uptime\":,\"seq\":,"
+    "$GPGGA,000000.00,0000.0000,N,00000.0000,E,1,08,0.9,0.0,M,0.0,M,,*00\r\n"
+    "$GPRMC,000000.00,A,0000.0000,N,00000.0000,E,0.0,0.0,010100,,,A*00\r\n"
+    "$GPZDA,$HCHDT,$SDDBT,$YXMTW,$IIXDR,"
+    "\"lat\":37.00000,\"lon\":127.00000,\"alt\":0.0,\"speed\":0.00,\"course\":0.0,"
+    "\"roll\":0.00,\"pitch\":0.00,\"yaw\":0.00,\"accel\":[0.000,0.000,9.810],\"gyro\":[0.000,0.000,0.000],"
+    "\"rssi\":-00,\"snr\":00.0,\"ber\":0.000000,\"baud\":115200,\"link\":\"acoustic\",\"link\":\"light\","
+    "\"modem\":\"AcousticModem\",\"modem\":\"LightModem\",\"port\":\"COM4\",\"port\":\"COM6\","
+    "\"battery\":12.00,\"voltage\":12.00,\"current\":0.000,\"power\":0.00,\"charge\":100,"
+    "\"salinity\":35.00,\"conductivity\":0.000,\"turbidity\":0.00,\"oxygen\":0.00,\"ph\":7.00,"
+    "\"status\":\"OK\",\"state\":\"RUN\",\"mode\":\"AUTO\",\"alarm\":0,\"leak\":0,"
+    "\"temperature\":00.00,\"pressure\":0000.0,\"depth\":000.00,\"heading\":000.0,"
+    "{\"type\":\"telemetry\",\"id\":0,\"ts\":0000000000,\"time\":\"2024-01-01T00:00:00.000Z\","
+    "id=,ts=,seq=,time=,lat=,lon=,alt=,roll=,pitch=,yaw=,rssi=,snr=,battery=,voltage=,current=,"
+    "status=OK,state=RUN,mode=AUTO,alarm=0,leak=0,salinity=,oxygen=,"
+    "temp=00.00,pressure=0000.0,depth=000.00,heading=000.0,"
+    "0.000,0.001,0.002,0.005,0.010,0.100,0.250,0.500,1.000,10.00,100.0,"
+    "00,01,02,03,04,05,06,07,08,09,10,11,12,13,14,15,16,17,18,19,20,25,30,40,50,60,70,80,90,"
+    "$UHSDM,TLM,$UHSDM,CMD,$UHSDM,ACK,";
+
+static BYTE dictionary[COMPRESS_MAX_DICTIONARY];
+static DWORD dictionarySize;
+static uint32_t dictionaryId;
+static uint16_t dictionaryTable[LZ_HASH_SIZE]; // 사전 위치 + 1 (0 = 비어 있음)
+static bool useDictionary = true;
+
+static uint32_t Hash4(const BYTE* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+void CompressInit(const TCHAR* dictionaryPath) {
+    dictionarySize = 0;
+    FILE* file = dictionaryPath != NULL ? _tfopen(dictionaryPath, TEXT("rb")) : NULL;
+    if (file != NULL) {
+        dictionarySize = (DWORD)fread(dictionary, 1, sizeof(dictionary), file);
+        fclose(file);
+    }
+    if (dictionarySize < LZ_MIN_MATCH) {
+        dictionarySize = sizeof(builtinDictionary) - 1;
+        memcpy(dictionary, builtinDictionary, dictionarySize);
+    }
+    dictionaryId = Crc32Update(0, dictionary, dictionarySize);
+
+    memset(dictionaryTable, 0, sizeof(dictionaryTable));
+    for (DWORD i = 0; i + LZ_MIN_MATCH <= dictionarySize; i++) {
+        dictionaryTable[Hash4(dictionary + i)] = (uint16_t)(i + 1);
+    }
+}
+
+uint32_t CompressDictionaryId(void) {
+    return dictionaryId;
+}
+
+void CompressUseDictionary(bool enable) {
+    useDictionary = enable;
+}
+
+// 길이가 LZ_RUN_MASK 이상이면 나머지를 255 단위 바이트로 이어서 씀
+static bool WriteLength(BYTE* out, DWORD outSize, DWORD* position, DWORD length) {
+    for (; length >= 255; length -= 255) {
+        if (*position >= outSize) {
+            return false;
+        }
+        out[(*position)++] = 255;
+    }
+    if (*position >= outSize) {
+        return false;
+    }
+    out[(*position)++] = (BYTE)length;
+    return true;
+}
+
+// 시퀀스 = 토큰(리터럴 길이 4비트 | 일치 길이-4 4비트) | 리터럴 | 거리(2, LE) | 일치 길이 연장
+// 마지막 시퀀스는 리터럴만 있고 거리가 없다 (matchLength == 0)
+static bool WriteSequence(BYTE* out, DWORD outSize, DWORD* position, const BYTE* literals, DWORD literalLength, DWORD offset, DWORD matchLength) {
+    DWORD matchCode = matchLength > 0 ? matchLength - LZ_MIN_MATCH : 0;
+    if (*position >= outSize) {
+        return false;
+    }
+    out[(*position)++] = (BYTE)(((literalLength < LZ_RUN_MASK ? literalLength : LZ_RUN_MASK) << 4) | (matchCode < LZ_RUN_MASK ? matchCode : LZ_RUN_MASK));
+    if (literalLength >= LZ_RUN_MASK && !WriteLength(out, outSize, position, literalLength - LZ_RUN_MASK)) {
+        return false;
+    }
+    if (literalLength > outSize - *position) {
+        return false;
+    }
+    memcpy(out + *position, literals, literalLength);
+    *position += literalLength;
+    if (matchLength == 0) {
+        return true;
+    }
+    if (outSize - *position < 2) {
+        return false;
+    }
+    out[(*position)++] = (BYTE)offset;
+    out[(*position)++] = (BYTE)(offset >> 8);
+    return matchCode < LZ_RUN_MASK || WriteLength(out, outSize, position, matchCode - LZ_RUN_MASK);
+}
+
+DWORD CompressBlock(const BYTE* data, DWORD length, BYTE* out, DWORD outSize) {
+    if (length > COMPRESS_MAX_INPUT || length < LZ_MIN_MATCH) {
+        return 0;
+    }
+    // 사전 바로 뒤에 입력을 이어 붙인 창에서 일치를 찾는다
+    BYTE window[COMPRESS_MAX_DICTIONARY + COMPRESS_MAX_INPUT];
+    uint16_t table[LZ_HASH_SIZE];
+    DWORD start = useDictionary ? dictionarySize : 0;
+    if (useDictionary) {
+        memcpy(window, dictionary, dictionarySize);
+        memcpy(table, dictionaryTable, sizeof(table));
+    }
+    else {
+        memset(table, 0, sizeof(table));
+    }
+    memcpy(window + start, data, length);
+
+    // 원래보다 작아지지 않으면 의미가 없으므로 출력은 length - 1 까지만 허용
+    DWORD limit = outSize < length - 1 ? outSize : length - 1;
+    DWORD end = start + length;
+    DWORD anchor = start;
+    DWORD position = start;
+    DWORD written = 0;
+    while (position + LZ_MIN_MATCH <= end) {
+        uint32_t hash = Hash4(window + position);
+        DWORD candidate = table[hash];
+        table[hash] = (uint16_t)(position + 1);
+        if (candidate == 0 || memcmp(window + candidate - 1, window + position, LZ_MIN_MATCH) != 0) {
+            position++;
+            continue;
+        }
+        candidate--;
+        DWORD matchLength = LZ_MIN_MATCH;
+        while (position + matchLength < end && window[candidate + matchLength] == window[position + matchLength]) {
+            matchLength++;
+        }
+        if (!WriteSequence(out, limit, &written, window + anchor, position - anchor, position - candidate, matchLength)) {
+            return 0;
+        }
+        position += matchLength;
+        anchor = position;
+        // 일치 끝 부분도 등록해 두면 이어지는 반복을 더 잘 찾음
+        if (position + 2 <= end) {
+            table[Hash4(window + position - 2)] = (uint16_t)(position - 2 + 1);
+        }
+    }
+    if (!WriteSequence(out, limit, &written, window + anchor, end - anchor, 0, 0)) {
+        return 0;
+    }
+    return written;
+}
+
+// 토큰 뒤에 이어지는 길이 바이트를 읽음
+static bool ReadLength(const BYTE* data, DWORD length, DWORD* position, DWORD* value) {
+    BYTE next;
+    do {
+        if (*position >= length) {
+            return false;
+        }
+        next = data[(*position)++];
+        *value += next;
+    } while (next == 255);
+    return true;
+}
+
+bool CompressExpand(const BYTE* data, DWORD length, BYTE* out, DWORD outSize, DWORD* outLength) {
+    BYTE window[COMPRESS_MAX_DICTIONARY + COMPRESS_MAX_INPUT];
+    DWORD start = useDictionary ? dictionarySize : 0;
+    DWORD limit = start + (outSize < COMPRESS_MAX_INPUT ? outSize : COMPRESS_MAX_INPUT);
+    DWORD position = 0;
+    DWORD written = start;
+    if (useDictionary) {
+        memcpy(window, dictionary, dictionarySize);
+    }
+    while (position < length) {
+        BYTE token = data[position++];
+        DWORD literalLength = token >> 4;
+        if (literalLength == LZ_RUN_MASK && !ReadLength(data, length, &position, &literalLength)) {
+            return false;
+        }
+        if (literalLength > length - position || literalLength > limit - written) {
+            return false;
+        }
+        memcpy(window + written, data + position, literalLength);
+        position += literalLength;
+        written += literalLength;
+        if (position == length) {
+            break; // 마지막 시퀀스
+        }
+
+        if (length - position < 2) {
+            return false;
+        }
+        DWORD offset = data[position] | ((DWORD)data[position + 1] << 8);
+        position += 2;
+        DWORD matchLength = token & LZ_RUN_MASK;
+        if (matchLength == LZ_RUN_MASK && !ReadLength(data, length, &position, &matchLength)) {
+            return false;
+        }
+        matchLength += LZ_MIN_MATCH;
+        if (offset == 0 || offset > written || matchLength > limit - written) {
+            return false;
+        }
+        // 겹치는 일치(offset < matchLength)는 반복 패턴이므로 바이트 단위로 복사
+        const BYTE* source = window + written - offset;
+        for (DWORD i = 0; i < matchLength; i++) {
+            window[written + i] = source[i];
+        }
+        written += matchLength;
+    }
+    *outLength = written - start;
+    memcpy(out, window + start, *outLength);
+    return true;
+}
+
+static void OnHelloWritten(ModemConfig* modem, uint32_t messageId, bool success) {
+    (void)modem;
+    (void)messageId;
+    (void)success;
+}
+
+static void BuildHello(const ModemConfig* modem, BYTE flags, BYTE hello[HELLO_SIZE]) {
+    hello[0] = HELLO_VERSION;
+    hello[1] = modem->compression == COMPRESS_LZ ? COMPRESS_LZ : COMPRESS_NONE;
+    hello[2] = flags;
+    hello[3] = (BYTE)dictionaryId;
+    hello[4] = (BYTE)(dictionaryId >> 8);
+    hello[5] = (BYTE)(dictionaryId >> 16);
+    hello[6] = (BYTE)(dictionaryId >> 24);
+}
+
+static void SendHello(ModemConfig* modem, BYTE flags) {
+    BYTE hello[HELLO_SIZE];
+    BuildHello(modem, flags, hello);
+    TransmitEnqueueNotify(modem, FRAME_TYPE_HELLO, hello, sizeof(hello), OnHelloWritten);
+}
+
+DWORD CompressEncodeHello(const ModemConfig* modem, BYTE* out, DWORD outSize) {
+    BYTE hello[HELLO_SIZE];
+    BuildHello(modem, HELLO_FLAG_REPLY, hello);
+    return FrameEncode(FRAME_TYPE_HELLO, hello, sizeof(hello), out, outSize);
+}
+
+void CompressNegotiate(ModemConfig* modem) {
+    AtomicStoreRelease32(&modem->peerCompression, COMPRESS_NONE);
+    if (modem->framing == FRAMING_COBS) {
+        SendHello(modem, HELLO_FLAG_REPLY);
+    }
+}
+
+bool CompressHandleFrame(ModemConfig* modem, const FrameHeader* header, const BYTE* payload, DWORD length) {
+    if (header == NULL || header->type != FRAME_TYPE_HELLO) {
+        return false;
+    }
+    if (length < HELLO_SIZE || payload[0] != HELLO_VERSION) {
+        return true;
+    }
+    uint32_t peerDictionary = payload[3] | ((uint32_t)payload[4] << 8) | ((uint32_t)payload[5] << 16) | ((uint32_t)payload[6] << 24);
+    // 양쪽 모두 켜져 있고 같은 사전을 가졌을 때만 압축
+    bool agreed = (payload[1] & COMPRESS_LZ) != 0 && modem->compression == COMPRESS_LZ && peerDictionary == dictionaryId;
+    AtomicStoreRelease32(&modem->peerCompression, agreed ? COMPRESS_LZ : COMPRESS_NONE);
+    if (payload[2] & HELLO_FLAG_REPLY) {
+        SendHello(modem, 0);
+    }
+    return true;
+}
+
+uint32_t CompressEnqueue(ModemConfig* modem, const BYTE* data, DWORD length, CompressReport* report) {
+    report->compressed = false;
+    report->originalBytes = length;
+    report->sentBytes = length;
+    report->elapsedNs = 0;
+    if (modem->framing != FRAMING_COBS || AtomicLoadAcquire32(&modem->peerCompression) != COMPRESS_LZ || length > COMPRESS_MAX_INPUT) {
+        return TransmitEnqueue(modem, FRAME_TYPE_DATA, data, length);
+    }
+
+    BYTE packed[COMPRESS_MAX_INPUT];
+    uint64_t startNs = PlatformNowNs();
+    DWORD packedLength = CompressBlock(data, length, packed, sizeof(packed));
+    report->elapsedNs = PlatformNowNs() - startNs;
+    modem->compress.compressNs += report->elapsedNs;
+    if (packedLength == 0) {
+        modem->compress.messagesStored++;
+        return TransmitEnqueue(modem, FRAME_TYPE_DATA, data, length);
+    }
+    modem->compress.messagesCompressed++;
+    modem->compress.bytesIn += length;
+    modem->compress.bytesOut += packedLength;
+    report->compressed = true;
+    report->sentBytes = packedLength;
+    return TransmitEnqueue(modem, FRAME_TYPE_DATA_LZ, packed, packedLength);
+}
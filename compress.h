@@ -0,0 +1,63 @@
+﻿#pragma once
+#include "platform.h"
+#include "frame.h"
+
+// 메시지 압축 계층
+// LZ77 계열(LZ4 와 같은 토큰 형식) 압축을 메시지마다 독립적으로 적용한다. 프레임이 유실되어도
+// 다음 메시지를 풀 수 있도록 메시지 사이에 상태를 공유하지 않는 대신, 양쪽이 같은 사전을
+// 앞에 붙인 것으로 보고 압축하므로 수십 바이트짜리 짧은 텔레메트리도 줄어든다.
+// 사전은 내장 사전을 쓰고, INI 파일과 같은 폴더에 COMPRESS_DICTIONARY_FILE 이 있으면 그것을 쓴다.
+// 압축 사용 여부는 모뎀마다 FRAME_TYPE_HELLO 로 협상한다. 상대가 같은 사전(CRC-32 로 식별)으로
+// 풀 수 있다고 알려온 뒤에만 FRAME_TYPE_DATA_LZ 로 보내고, 그 전에는 압축하지 않고 보낸다.
+// 작업 메모리는 해시 테이블 8KB 와 창 버퍼뿐이며 모두 호출한 스레드의 스택을 쓴다.
+
+#define COMPRESS_MAX_INPUT FRAME_MAX_PAYLOAD
+#define COMPRESS_MAX_DICTIONARY 4096
+#define COMPRESS_DICTIONARY_FILE TEXT("UHSDM.DICT")
+
+// Compression 설정값 / HELLO 의 지원 코덱 비트
+#define COMPRESS_NONE 0
+#define COMPRESS_LZ 1
+
+struct ModemConfig;
+
+typedef struct {
+    // 송신 (메시지를 넣는 스레드)
+    volatile int32_t messagesCompressed;
+    volatile int32_t messagesStored;    // 압축해도 줄지 않아 그대로 보냄
+    volatile int64_t bytesIn;           // 압축한 메시지의 원래 크기 합
+    volatile int64_t bytesOut;          // 압축 결과 크기 합
+    volatile int64_t compressNs;
+    // 수신 (수신 처리 스레드)
+    volatile int32_t messagesExpanded;
+    volatile int32_t expandErrors;
+    volatile int64_t expandNs;
+} CompressStats;
+
+// 메시지 하나의 압축 결과 (SendMessageToModem 출력용)
+typedef struct {
+    bool compressed;
+    DWORD originalBytes;
+    DWORD sentBytes;
+    uint64_t elapsedNs;
+} CompressReport;
+
+// 사전을 읽고 사전 해시 테이블을 만든다. CrcInit 뒤에 한 번 호출
+void CompressInit(const TCHAR* dictionaryPath);
+uint32_t CompressDictionaryId(void);
+// 사전 없이 압축하도록 바꾼다 (벤치마크 비교용)
+void CompressUseDictionary(bool enable);
+
+// 압축해서 크기를 반환한다. 원래보다 작아지지 않으면 0
+DWORD CompressBlock(const BYTE* data, DWORD length, BYTE* out, DWORD outSize);
+// 압축을 푼다. 형식이 잘못되었거나 outSize 를 넘으면 false
+bool CompressExpand(const BYTE* data, DWORD length, BYTE* out, DWORD outSize, DWORD* outLength);
+
+// 상대에게 지원 코덱과 사전을 알리고 응답을 요청한다 (포트를 연 뒤 호출)
+void CompressNegotiate(struct ModemConfig* modem);
+// 같은 HELLO(응답 요청) 를 송신 큐를 거치지 않고 쓸 프레임으로 인코딩한다 (BaudRate=auto 의 속도 확인용). 실패하면 0
+DWORD CompressEncodeHello(const struct ModemConfig* modem, BYTE* out, DWORD outSize);
+// 수신 처리 스레드에서 프레임마다 호출. HELLO 프레임이면 처리하고 true 를 반환
+bool CompressHandleFrame(struct ModemConfig* modem, const FrameHeader* header, const BYTE* payload, DWORD length);
+// 협상이 끝났으면 압축해서, 아니면 그대로 송신 큐에 넣는다. 반환값은 TransmitEnqueue 와 같음
+uint32_t CompressEnqueue(struct ModemConfig* modem, const BYTE* data, DWORD length, CompressReport* report);
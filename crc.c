@@ -0,0 +1,57 @@
+﻿#include "platform.h"
+#include "crc.h"
+
+static uint32_t crc32Table[8][256];
+static uint16_t crc16Table[256];
+
+void CrcInit(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+        crc32Table[0][i] = crc;
+    }
+    // slice-by-8: table[k][i] 는 바이트 i 뒤에 0 바이트 k 개가 더 붙었을 때의 CRC
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = crc32Table[k - 1][i];
+            crc32Table[k][i] = (prev >> 8) ^ crc32Table[0][prev & 0xFF];
+        }
+    }
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint16_t crc = (uint16_t)(i << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (uint16_t)((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+        }
+        crc16Table[i] = crc;
+    }
+}
+
+uint32_t Crc32Update(uint32_t crc, const BYTE* data, size_t length) {
+    crc = ~crc;
+
+    // 8바이트 단위로 테이블 8개를 동시에 조회 (리틀 엔디언 가정 없이 바이트로 조립)
+    while (length >= 8) {
+        uint32_t low = crc ^ ((uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24);
+        uint32_t high = (uint32_t)data[4] | (uint32_t)data[5] << 8 | (uint32_t)data[6] << 16 | (uint32_t)data[7] << 24;
+        crc = crc32Table[7][low & 0xFF] ^ crc32Table[6][(low >> 8) & 0xFF] ^
+              crc32Table[5][(low >> 16) & 0xFF] ^ crc32Table[4][low >> 24] ^
+              crc32Table[3][high & 0xFF] ^ crc32Table[2][(high >> 8) & 0xFF] ^
+              crc32Table[1][(high >> 16) & 0xFF] ^ crc32Table[0][high >> 24];
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = (crc >> 8) ^ crc32Table[0][(crc ^ *data++) & 0xFF];
+    }
+    return ~crc;
+}
+
+uint16_t Crc16Update(uint16_t crc, const BYTE* data, size_t length) {
+    while (length-- > 0) {
+        crc = (uint16_t)((crc << 8) ^ crc16Table[((crc >> 8) ^ *data++) & 0xFF]);
+    }
+    return crc;
+}
@@ -0,0 +1,15 @@
+﻿#pragma once
+#include "platform.h"
+
+// CRC-32 (IEEE 802.3, 반사형, 다항식 0xEDB88320) : slice-by-8
+// CRC-16/CCITT-FALSE (다항식 0x1021, 초기값 0xFFFF) : 바이트 단위 테이블
+// 사용 전에 CrcInit 을 한 번 호출해야 한다.
+
+void CrcInit(void);
+
+// crc 에 이전 결과를 넘기면 여러 조각에 걸쳐 이어서 계산할 수 있다 (처음에는 0)
+uint32_t Crc32Update(uint32_t crc, const BYTE* data, size_t length);
+// 처음에는 CRC16_INIT 을 넘긴다
+uint16_t Crc16Update(uint16_t crc, const BYTE* data, size_t length);
+
+#define CRC16_INIT 0xFFFF
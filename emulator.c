@@ -0,0 +1,535 @@
+﻿#include "platform.h"
+#include "modem.h"
+#include "emulator.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#endif
+
+typedef struct {
+    const TCHAR* name;
+    EmulatorProfile profile;
+} NamedProfile;
+
+// 기본 프로파일. light 는 혼탁/정렬 불량으로 잠깐씩 끊기는 광 링크, acoustic 은 약 1 km 수중 음향 링크
+static const NamedProfile namedProfiles[] = {
+    { TEXT("wire"), { -1, 0, 0, 0.0, 0, 0, 0 } },
+    { TEXT("ideal"), { 0, 0, 0, 0.0, 0, 0, 0 } },
+    { TEXT("light"), { -1, 1, 1, 1e-7, 1, 50, 0 } },
+    { TEXT("acoustic"), { 9600, 700, 50, 1e-5, 2, 300, 0 } },
+};
+
+bool EmulatorIsPort(const TCHAR* portName) {
+    return _tcsncmp(portName, EMULATOR_PORT_PREFIX, _tcslen(EMULATOR_PORT_PREFIX)) == 0;
+}
+
+// "key=value" 항목 하나를 profile 에 반영
+static bool ParseProfileField(TCHAR* field, EmulatorProfile* profile) {
+    TCHAR* value = _tcschr(field, TEXT('='));
+    if (value == NULL) {
+        return false;
+    }
+    *value++ = TEXT('\0');
+    TCHAR* end = NULL;
+    if (_tcscmp(field, TEXT("ber")) == 0) {
+        profile->ber = _tcstod(value, &end);
+        return *end == TEXT('\0') && profile->ber >= 0.0 && profile->ber < 0.1;
+    }
+    long number = _tcstol(value, &end, 10);
+    if (*end != TEXT('\0') || number < 0 || number > 100000000) {
+        return false;
+    }
+    if (_tcscmp(field, TEXT("rate")) == 0) {
+        profile->rate = (int)number;
+    }
+    else if (_tcscmp(field, TEXT("delay")) == 0) {
+        profile->delayMs = (int)number;
+    }
+    else if (_tcscmp(field, TEXT("jitter")) == 0) {
+        profile->jitterMs = (int)number;
+    }
+    else if (_tcscmp(field, TEXT("loss")) == 0 && number <= 100) {
+        profile->lossPercent = (int)number;
+    }
+    else if (_tcscmp(field, TEXT("burst")) == 0) {
+        profile->burstMs = (int)number;
+    }
+    else if (_tcscmp(field, TEXT("uart")) == 0) {
+        profile->uartRate = (int)number;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+bool EmulatorParseProfile(const TCHAR* spec, EmulatorProfile* profile) {
+    *profile = namedProfiles[0].profile;
+    if (spec == NULL || spec[0] == TEXT('\0')) {
+        return true;
+    }
+    TCHAR buffer[MAX_EMULATOR_SPEC];
+    if (_tcslen(spec) >= MAX_EMULATOR_SPEC) {
+        return false;
+    }
+    _tcscpy(buffer, spec);
+
+    TCHAR* field = buffer;
+    bool first = true;
+    while (field != NULL) {
+        TCHAR* next = _tcschr(field, TEXT(','));
+        if (next != NULL) {
+            *next++ = TEXT('\0');
+        }
+        // 첫 항목은 프로파일 이름일 수 있음
+        if (first && _tcschr(field, TEXT('=')) == NULL) {
+            size_t i = 0;
+            while (i < sizeof(namedProfiles) / sizeof(namedProfiles[0]) && _tcscmp(namedProfiles[i].name, field) != 0) {
+                i++;
+            }
+            if (i == sizeof(namedProfiles) / sizeof(namedProfiles[0])) {
+                return false;
+            }
+            *profile = namedProfiles[i].profile;
+        }
+        else if (!ParseProfileField(field, profile)) {
+            return false;
+        }
+        first = false;
+        field = next;
+    }
+    return true;
+}
+
+#ifdef _WIN32
+
+bool EmulatorAttach(ModemConfig* modem, TCHAR* slavePath, size_t slavePathSize) {
+    (void)slavePath;
+    (void)slavePathSize;
+    _ftprintf(stderr, TEXT("Emulated port %s is only available on POSIX builds.\n"), modem->portName);
+    return false;
+}
+
+void EmulatorDetach(ModemConfig* modem) {
+    (void)modem;
+}
+
+void EmulatorSetBaudRate(ModemConfig* modem, int baudRate) {
+    (void)modem;
+    (void)baudRate;
+}
+
+bool EmulatorQueryStats(const ModemConfig* modem, EmulatorStats* stats) {
+    (void)modem;
+    (void)stats;
+    return false;
+}
+
+void EmulatorStop(void) {
+}
+
+#else
+
+#define EMULATOR_QUEUE_SIZE 65536        // 매체 위에 있을 수 있는 바이트 (2의 거듭제곱)
+#define EMULATOR_READ_CHUNK 64           // 속도 제한이 있을 때 한 번에 싣는 바이트
+#define EMULATOR_SLACK_NS 1000000ULL     // 매체가 이만큼 안에 비면 다음 바이트를 미리 읽음
+#define EMULATOR_IDLE_MS 100
+
+// 링크에 연결된 모뎀 하나. 이 모뎀이 보내는 방향의 매체 상태를 가진다
+typedef struct EmulatorEnd {
+    bool inUse;
+    TCHAR link[MAX_PORT_NAME];
+    int master;
+    int slave;                  // 모뎀이 포트를 다시 여는 동안에도 pty 가 끊기지 않도록 열어 둠
+    EmulatorProfile profile;
+    bool rateFromBaud;          // 프로파일에 rate 가 없어 BaudRate 를 따름
+    int baudRate;               // 모뎀이 포트에 적용한 BaudRate (profile.uartRate 와 비교)
+    uint64_t busyUntilNs;       // 지금까지 읽은 바이트를 모두 매체에 싣는 시각
+    uint64_t lastDueNs;         // 마지막 바이트의 도착 시각 (지터가 있어도 순서 유지)
+    bool burst;                 // 버스트 손실 상태
+    uint64_t stateUntilNs;      // 현재 손실 상태가 끝나는 시각
+    uint32_t errorThreshold;    // 바이트마다 난수가 이 값보다 작으면 비트 하나를 뒤집음
+    // 매체 위의 바이트와 도착 시각 (원형 큐)
+    BYTE* bytes;
+    uint64_t* dueNs;
+    uint32_t head;
+    uint32_t count;
+    EmulatorStats stats;
+} EmulatorEnd;
+
+static struct {
+    EmulatorEnd ends[MAX_MODEMS];
+    bool started;
+    PlatformMutex lock;
+    PlatformThread thread;
+    volatile int32_t running;
+    int wakeFds[2];             // 연결/해제를 에뮬레이터 스레드에 알림
+    uint32_t random;
+} emulator;
+
+// xorshift32 (lock 을 잡은 상태)
+static uint32_t NextRandom(void) {
+    uint32_t x = emulator.random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    emulator.random = x;
+    return x;
+}
+
+// t 시각에 버스트 손실 상태인지. 상태 길이는 평균이 burstMs(손실) / 그에 맞춘 값(정상)인 균등 분포
+static bool InBurst(EmulatorEnd* end, uint64_t t) {
+    const EmulatorProfile* profile = &end->profile;
+    if (profile->lossPercent <= 0 || profile->burstMs <= 0) {
+        return false;
+    }
+    if (profile->lossPercent >= 100) {
+        return true;
+    }
+    // 오래 쉬었으면 지금부터 다시 시작
+    if (end->stateUntilNs + 10 * 1000000000ULL < t) {
+        end->stateUntilNs = t;
+        end->burst = true;
+    }
+    while (t >= end->stateUntilNs) {
+        end->burst = !end->burst;
+        double meanMs = end->burst ? profile->burstMs : (double)profile->burstMs * (100 - profile->lossPercent) / profile->lossPercent;
+        end->stateUntilNs += (uint64_t)(meanMs * 2.0 * (NextRandom() >> 8) / 16777216.0 * 1e6) + 1;
+    }
+    return end->burst;
+}
+
+// 포트의 BaudRate 가 모뎀의 시리얼 쪽 속도와 허용 오차 밖으로 다른지
+static bool UartMismatch(const EmulatorEnd* end) {
+    int64_t uart = end->profile.uartRate;
+    int64_t error = end->baudRate - uart;
+    return uart > 0 && (error < 0 ? -error : error) * 100 > uart * SERIAL_BAUD_TOLERANCE_PERCENT;
+}
+
+// 읽은 바이트를 매체에 싣는다: 전송 시간, 손실, 비트 오류, 지연 (lock 을 잡은 상태)
+static void SendBytes(EmulatorEnd* end, const BYTE* data, DWORD size, uint64_t now) {
+    const EmulatorProfile* profile = &end->profile;
+    uint64_t byteNs = profile->rate > 0 ? 10 * 1000000000ULL / (uint64_t)profile->rate : 0;
+    bool garble = UartMismatch(end);
+    for (DWORD i = 0; i < size; i++) {
+        uint64_t sentNs = (end->busyUntilNs > now ? end->busyUntilNs : now) + byteNs;
+        end->busyUntilNs = sentNs;
+        end->stats.bytesSent++;
+        if (InBurst(end, sentNs)) {
+            end->stats.burstDropped++;
+            continue;
+        }
+        BYTE value = data[i];
+        if (garble) {
+            value = (BYTE)NextRandom();
+            end->stats.garbled++;
+        }
+        if (end->errorThreshold > 0 && NextRandom() < end->errorThreshold) {
+            value ^= (BYTE)(1 << (NextRandom() % 8));
+            end->stats.bitErrors++;
+        }
+        uint64_t dueNs = sentNs + (uint64_t)profile->delayMs * 1000000ULL;
+        if (profile->jitterMs > 0) {
+            dueNs += (uint64_t)NextRandom() % ((uint64_t)profile->jitterMs * 1000000ULL + 1);
+        }
+        dueNs = dueNs > end->lastDueNs ? dueNs : end->lastDueNs;
+        end->lastDueNs = dueNs;
+        uint32_t tail = (end->head + end->count) & (EMULATOR_QUEUE_SIZE - 1);
+        end->bytes[tail] = value;
+        end->dueNs[tail] = dueNs;
+        end->count++;
+    }
+}
+
+// 받는 모뎀의 시리얼 속도가 포트와 달라 size 바이트가 모두 깨져 도착 (lock 을 잡은 상태)
+static DWORD WriteGarbled(EmulatorEnd* peer, DWORD size) {
+    BYTE garbled[EMULATOR_READ_CHUNK];
+    DWORD written = 0;
+    while (written < size) {
+        DWORD chunk = size - written < sizeof(garbled) ? size - written : sizeof(garbled);
+        for (DWORD i = 0; i < chunk; i++) {
+            garbled[i] = (BYTE)NextRandom();
+        }
+        ssize_t n = write(peer->master, garbled, chunk);
+        if (n <= 0) {
+            break;
+        }
+        written += (DWORD)n;
+        peer->stats.garbled += (int32_t)n;
+    }
+    return written;
+}
+
+// 같은 링크의 다른 모뎀들에 건넴. 혼자면 자신에게 (lock 을 잡은 상태)
+static void WriteToPeers(EmulatorEnd* end, const BYTE* data, DWORD size) {
+    bool delivered = false;
+    for (int pass = 0; pass < 2 && !delivered; pass++) {
+        for (int i = 0; i < MAX_MODEMS; i++) {
+            EmulatorEnd* peer = &emulator.ends[i];
+            if (!peer->inUse || _tcscmp(peer->link, end->link) != 0 || (pass == 0 && peer == end) || (pass == 1 && peer != end)) {
+                continue;
+            }
+            DWORD written;
+            if (UartMismatch(peer)) {
+                written = WriteGarbled(peer, size);
+            }
+            else {
+                ssize_t n = write(peer->master, data, size);
+                written = n > 0 ? (DWORD)n : 0;
+            }
+            end->stats.bytesDelivered += written;
+            end->stats.overflowDropped += (int32_t)(size - written);
+            delivered = true;
+        }
+    }
+}
+
+// 도착 시각이 지난 바이트를 건넴 (lock 을 잡은 상태)
+static void DeliverDue(EmulatorEnd* end, uint64_t now) {
+    while (end->count > 0 && end->dueNs[end->head] <= now) {
+        uint32_t limit = EMULATOR_QUEUE_SIZE - end->head;
+        limit = end->count < limit ? end->count : limit;
+        uint32_t run = 0;
+        while (run < limit && end->dueNs[end->head + run] <= now) {
+            run++;
+        }
+        WriteToPeers(end, end->bytes + end->head, run);
+        end->head = (end->head + run) & (EMULATOR_QUEUE_SIZE - 1);
+        end->count -= run;
+    }
+}
+
+// 모뎀이 보낸 바이트를 지금 읽어도 되는지 (속도 제한: 매체가 곧 비어야 함)
+static bool CanSend(const EmulatorEnd* end, uint64_t now) {
+    if (end->count + EMULATOR_READ_CHUNK > EMULATOR_QUEUE_SIZE) {
+        return false;
+    }
+    return end->profile.rate == 0 || end->busyUntilNs <= now + EMULATOR_SLACK_NS;
+}
+
+static DWORD WINAPI EmulatorThread(LPVOID param) {
+    (void)param;
+    struct pollfd pfds[MAX_MODEMS + 1];
+    EmulatorEnd* polled[MAX_MODEMS + 1];
+    BYTE buffer[EMULATOR_QUEUE_SIZE / 16];
+
+    while (AtomicLoadAcquire32(&emulator.running)) {
+        PlatformMutexLock(&emulator.lock);
+        uint64_t now = PlatformNowNs();
+        uint64_t wakeNs = now + EMULATOR_IDLE_MS * 1000000ULL;
+        int count = 0;
+        pfds[count].fd = emulator.wakeFds[0];
+        pfds[count].events = POLLIN;
+        polled[count++] = NULL;
+        for (int i = 0; i < MAX_MODEMS; i++) {
+            EmulatorEnd* end = &emulator.ends[i];
+            if (!end->inUse) {
+                continue;
+            }
+            DeliverDue(end, now);
+            if (end->count > 0 && end->dueNs[end->head] < wakeNs) {
+                wakeNs = end->dueNs[end->head];
+            }
+            if (CanSend(end, now)) {
+                pfds[count].fd = end->master;
+                pfds[count].events = POLLIN;
+                polled[count++] = end;
+            }
+            else if (end->profile.rate > 0 && end->busyUntilNs > now + EMULATOR_SLACK_NS && end->busyUntilNs - EMULATOR_SLACK_NS < wakeNs) {
+                wakeNs = end->busyUntilNs - EMULATOR_SLACK_NS;
+            }
+        }
+        PlatformMutexUnlock(&emulator.lock);
+
+        int timeoutMs = wakeNs > now ? (int)((wakeNs - now + 999999) / 1000000) : 0;
+        if (poll(pfds, count, timeoutMs) <= 0) {
+            continue;
+        }
+        if (pfds[0].revents & POLLIN) {
+            ssize_t unused = read(emulator.wakeFds[0], buffer, sizeof(buffer));
+            (void)unused;
+        }
+
+        PlatformMutexLock(&emulator.lock);
+        now = PlatformNowNs();
+        for (int i = 1; i < count; i++) {
+            EmulatorEnd* end = polled[i];
+            // 폴링하는 동안 해제되었을 수 있음
+            if (!(pfds[i].revents & POLLIN) || !end->inUse || end->master != pfds[i].fd) {
+                continue;
+            }
+            DWORD space = EMULATOR_QUEUE_SIZE - end->count;
+            DWORD toRead = end->profile.rate > 0 ? EMULATOR_READ_CHUNK : sizeof(buffer);
+            ssize_t n = read(end->master, buffer, toRead < space ? toRead : space);
+            if (n > 0) {
+                SendBytes(end, buffer, (DWORD)n, now);
+            }
+        }
+        PlatformMutexUnlock(&emulator.lock);
+    }
+    return 0;
+}
+
+static void WakeEmulator(void) {
+    BYTE value = 1;
+    ssize_t unused = write(emulator.wakeFds[1], &value, 1);
+    (void)unused;
+}
+
+// 처음 연결할 때 스레드 시작. 포트는 메인 스레드에서만 여므로 따로 동기화하지 않음
+static bool StartEmulator(void) {
+    if (emulator.started) {
+        return true;
+    }
+    if (pipe2(emulator.wakeFds, O_NONBLOCK | O_CLOEXEC) != 0) {
+        return false;
+    }
+    PlatformMutexInit(&emulator.lock);
+    emulator.random = (uint32_t)PlatformNowNs() | 1;
+    AtomicStoreRelease32(&emulator.running, 1);
+    if (!PlatformThreadStart(&emulator.thread, EmulatorThread, NULL)) {
+        close(emulator.wakeFds[0]);
+        close(emulator.wakeFds[1]);
+        return false;
+    }
+    emulator.started = true;
+    return true;
+}
+
+static void FreeEnd(EmulatorEnd* end) {
+    if (end->slave >= 0) {
+        close(end->slave);
+    }
+    if (end->master >= 0) {
+        close(end->master);
+    }
+    free(end->bytes);
+    free(end->dueNs);
+    memset(end, 0, sizeof(*end));
+}
+
+bool EmulatorAttach(ModemConfig* modem, TCHAR* slavePath, size_t slavePathSize) {
+    EmulatorProfile profile;
+    if (!EmulatorParseProfile(modem->emulator, &profile)) {
+        _ftprintf(stderr, TEXT("Invalid emulator profile for %s: %s\n"), modem->portName, modem->emulator);
+        return false;
+    }
+    bool rateFromBaud = profile.rate < 0;
+    if (rateFromBaud) {
+        profile.rate = modem->baudRate;
+    }
+    if (!StartEmulator()) {
+        _ftprintf(stderr, TEXT("Failed to start modem emulator.\n"));
+        return false;
+    }
+
+    PlatformMutexLock(&emulator.lock);
+    EmulatorEnd* end = NULL;
+    for (int i = 0; i < MAX_MODEMS && end == NULL; i++) {
+        end = emulator.ends[i].inUse ? NULL : &emulator.ends[i];
+    }
+    PlatformMutexUnlock(&emulator.lock);
+    if (end == NULL) {
+        _ftprintf(stderr, TEXT("Too many emulated ports.\n"));
+        return false;
+    }
+
+    // 스레드는 inUse 가 설정되기 전에는 이 자리를 보지 않음
+    memset(end, 0, sizeof(*end));
+    end->master = -1;
+    end->slave = -1;
+    end->profile = profile;
+    end->rateFromBaud = rateFromBaud;
+    end->baudRate = modem->baudRate;
+    _tcscpy(end->link, modem->portName + _tcslen(EMULATOR_PORT_PREFIX));
+    end->errorThreshold = (uint32_t)(profile.ber * 8.0 * 4294967295.0 < 4294967295.0 ? profile.ber * 8.0 * 4294967295.0 : 4294967295.0);
+    end->bytes = (BYTE*)malloc(EMULATOR_QUEUE_SIZE);
+    end->dueNs = (uint64_t*)malloc(EMULATOR_QUEUE_SIZE * sizeof(uint64_t));
+    end->master = posix_openpt(O_RDWR | O_NOCTTY);
+    bool ok = end->bytes != NULL && end->dueNs != NULL && end->master >= 0 && grantpt(end->master) == 0 && unlockpt(end->master) == 0 &&
+        fcntl(end->master, F_SETFL, O_NONBLOCK) == 0 && fcntl(end->master, F_SETFD, FD_CLOEXEC) == 0 &&
+        ptsname_r(end->master, slavePath, slavePathSize) == 0;
+    if (ok) {
+        end->slave = open(slavePath, O_RDWR | O_NOCTTY | O_CLOEXEC);
+        ok = end->slave >= 0;
+    }
+    if (ok) {
+        // 포트를 열기 전에 에코 등이 일어나지 않도록 바로 raw 모드로
+        struct termios tio;
+        ok = tcgetattr(end->slave, &tio) == 0;
+        cfmakeraw(&tio);
+        ok = ok && tcsetattr(end->slave, TCSANOW, &tio) == 0;
+    }
+    if (!ok) {
+        _ftprintf(stderr, TEXT("Failed to create emulated port %s\n"), modem->portName);
+        FreeEnd(end);
+        return false;
+    }
+
+    PlatformMutexLock(&emulator.lock);
+    end->inUse = true;
+    PlatformMutexUnlock(&emulator.lock);
+    modem->io.emulator = end;
+    WakeEmulator();
+    return true;
+}
+
+void EmulatorDetach(ModemConfig* modem) {
+    EmulatorEnd* end = modem->io.emulator;
+    if (end == NULL) {
+        return;
+    }
+    modem->io.emulator = NULL;
+    PlatformMutexLock(&emulator.lock);
+    FreeEnd(end);
+    PlatformMutexUnlock(&emulator.lock);
+    WakeEmulator();
+}
+
+void EmulatorSetBaudRate(ModemConfig* modem, int baudRate) {
+    EmulatorEnd* end = modem->io.emulator;
+    if (end == NULL) {
+        return;
+    }
+    // 이미 매체에 실린 바이트는 이전 속도로 나간다
+    PlatformMutexLock(&emulator.lock);
+    if (end->rateFromBaud) {
+        end->profile.rate = baudRate;
+    }
+    end->baudRate = baudRate;
+    PlatformMutexUnlock(&emulator.lock);
+    WakeEmulator();
+}
+
+bool EmulatorQueryStats(const ModemConfig* modem, EmulatorStats* stats) {
+    EmulatorEnd* end = modem->io.emulator;
+    if (end == NULL) {
+        return false;
+    }
+    PlatformMutexLock(&emulator.lock);
+    *stats = end->stats;
+    PlatformMutexUnlock(&emulator.lock);
+    return true;
+}
+
+void EmulatorStop(void) {
+    if (!emulator.started) {
+        return;
+    }
+    AtomicStoreRelease32(&emulator.running, 0);
+    WakeEmulator();
+    PlatformThreadJoin(emulator.thread);
+    for (int i = 0; i < MAX_MODEMS; i++) {
+        if (emulator.ends[i].inUse) {
+            FreeEnd(&emulator.ends[i]);
+        }
+    }
+    close(emulator.wakeFds[0]);
+    close(emulator.wakeFds[1]);
+    PlatformMutexDestroy(&emulator.lock);
+    emulator.started = false;
+}
+
+#endif
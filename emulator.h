@@ -0,0 +1,58 @@
+﻿#pragma once
+#include "platform.h"
+
+// 모뎀 에뮬레이터
+// Port=EMU:<링크 이름> 으로 설정한 모뎀은 실제 포트 대신 pty 를 열고, 에뮬레이터 스레드가 pty 반대쪽에서
+// 같은 링크 이름을 쓰는 다른 모뎀으로 바이트를 건넨다. 링크에 모뎀이 하나뿐이면 보낸 바이트가 자신에게 돌아온다.
+// 리액터/송신 스레드는 실제 시리얼 포트와 똑같이 동작하므로 물리 모뎀 없이 전체 경로를 시험할 수 있다.
+// 보내는 쪽 모뎀의 Emulator= 프로파일이 그 방향의 매체를 정한다:
+//   rate    전송 속도 bps (바이트당 10비트, 0 이면 제한 없음, 없으면 BaudRate)
+//   delay   전파 지연 ms
+//   jitter  추가 지연 0..jitter ms (바이트 순서는 유지)
+//   ber     비트 오류율 (예: 1e-5)
+//   loss    버스트 손실 상태에 있는 시간 비율 %
+//   burst   버스트 손실 한 번의 평균 길이 ms
+//   uart    모뎀의 시리얼 쪽 속도 bps (없으면 0: 포트의 BaudRate 와 늘 맞음). 포트의 BaudRate 가 이 속도와 다르면
+//           이 모뎀이 보내고 받는 바이트가 모두 깨진다 (BaudRate=auto 시험용)
+// 기본 프로파일(wire, light, acoustic, ideal) 이름 뒤에 항목을 덧붙여 바꿀 수 있다.
+//   예: Emulator=acoustic,delay=1300,loss=5   Emulator=rate=9600,ber=1e-6
+// pty 가 필요하므로 POSIX 빌드에서만 사용할 수 있다.
+
+#define EMULATOR_PORT_PREFIX TEXT("EMU:")
+#define MAX_EMULATOR_SPEC 64
+#define EMULATOR_DEFAULT_PROFILE TEXT("wire")
+
+typedef struct {
+    int rate;           // bps, 0 = 제한 없음, -1 = BaudRate
+    int delayMs;
+    int jitterMs;
+    double ber;
+    int lossPercent;
+    int burstMs;
+    int uartRate;       // 0 = BaudRate 를 따름
+} EmulatorProfile;
+
+typedef struct {
+    int64_t bytesSent;       // 매체에 실은 바이트
+    int64_t bytesDelivered;  // 상대 모뎀에 건넨 바이트
+    int32_t burstDropped;    // 버스트 손실로 버린 바이트
+    int32_t bitErrors;       // 뒤집은 비트
+    int32_t overflowDropped; // 상대 pty 가 가득 차서 버린 바이트
+    int32_t garbled;         // 시리얼 속도가 맞지 않아 깨진 바이트 (보낸 것과 받은 것)
+} EmulatorStats;
+
+struct ModemConfig;
+
+bool EmulatorIsPort(const TCHAR* portName);
+// 프로파일 문자열 해석. 모르는 프로파일/항목이 있으면 false
+bool EmulatorParseProfile(const TCHAR* spec, EmulatorProfile* profile);
+
+// OpenSerialPort 에서 호출: 링크에 모뎀을 연결하고 모뎀이 열 pty 경로를 slavePath 에 돌려준다
+bool EmulatorAttach(struct ModemConfig* modem, TCHAR* slavePath, size_t slavePathSize);
+// CloseSerialPort 에서 호출 (포트를 닫은 뒤)
+void EmulatorDetach(struct ModemConfig* modem);
+// SerialReconfigure 에서 호출: 프로파일에 rate 가 없으면 새 BaudRate 를 매체 속도로 쓴다
+void EmulatorSetBaudRate(struct ModemConfig* modem, int baudRate);
+bool EmulatorQueryStats(const struct ModemConfig* modem, EmulatorStats* stats);
+// 에뮬레이터 스레드 종료 (모든 포트를 닫은 뒤)
+void EmulatorStop(void);
@@ -0,0 +1,203 @@
+﻿#include "platform.h"
+#include "fec.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <tmmintrin.h>
+#define FEC_X86
+#define FEC_TARGET_SSSE3
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define FEC_X86
+#define FEC_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+#define GF_POLYNOMIAL 0x11D // x^8 + x^4 + x^3 + x^2 + 1
+
+static BYTE gfExp[512];
+static BYTE gfLog[256];
+static BYTE gfMul[256][256];
+static bool useSimd;
+static bool hasSimd;
+
+static BYTE GfInverse(BYTE value) {
+    return gfExp[255 - gfLog[value]];
+}
+
+void FecInit(void) {
+    int x = 1;
+    for (int i = 0; i < 255; i++) {
+        gfExp[i] = (BYTE)x;
+        gfLog[x] = (BYTE)i;
+        x <<= 1;
+        if (x & 0x100) {
+            x ^= GF_POLYNOMIAL;
+        }
+    }
+    // 로그 합이 255 를 넘어도 나머지 연산 없이 조회할 수 있도록 두 번 반복
+    for (int i = 255; i < 512; i++) {
+        gfExp[i] = gfExp[i - 255];
+    }
+    for (int a = 0; a < 256; a++) {
+        for (int b = 0; b < 256; b++) {
+            gfMul[a][b] = (a == 0 || b == 0) ? 0 : gfExp[gfLog[a] + gfLog[b]];
+        }
+    }
+
+#if defined(FEC_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    hasSimd = (info[2] & (1 << 9)) != 0;
+#elif defined(FEC_X86)
+    __builtin_cpu_init();
+    hasSimd = __builtin_cpu_supports("ssse3") != 0;
+#endif
+    useSimd = hasSimd;
+}
+
+bool FecUsesSimd(void) {
+    return useSimd;
+}
+
+void FecEnableSimd(bool enable) {
+    useSimd = enable && hasSimd;
+}
+
+#ifdef FEC_X86
+// c * x = c * (x 의 하위 4비트) ^ c * (x 의 상위 4비트 << 4) 이므로 16개짜리 표 두 개를 PSHUFB 로 조회
+FEC_TARGET_SSSE3 static DWORD MulAddSsse3(BYTE* dst, const BYTE* src, BYTE c, DWORD size) {
+    BYTE low[16];
+    BYTE high[16];
+    for (int i = 0; i < 16; i++) {
+        low[i] = gfMul[c][i];
+        high[i] = gfMul[c][i << 4];
+    }
+    __m128i lowTable = _mm_loadu_si128((const __m128i*)low);
+    __m128i highTable = _mm_loadu_si128((const __m128i*)high);
+    __m128i mask = _mm_set1_epi8(0x0F);
+    DWORD i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lowPart = _mm_shuffle_epi8(lowTable, _mm_and_si128(in, mask));
+        __m128i highPart = _mm_shuffle_epi8(highTable, _mm_and_si128(_mm_srli_epi64(in, 4), mask));
+        __m128i out = _mm_loadu_si128((const __m128i*)(dst + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(out, _mm_xor_si128(lowPart, highPart)));
+    }
+    return i;
+}
+#endif
+
+void FecMulAdd(BYTE* dst, const BYTE* src, BYTE c, DWORD size) {
+    if (c == 0) {
+        return;
+    }
+    DWORD i = 0;
+    if (c == 1) {
+        for (; i < size; i++) {
+            dst[i] ^= src[i];
+        }
+        return;
+    }
+#ifdef FEC_X86
+    if (useSimd) {
+        i = MulAddSsse3(dst, src, c, size);
+    }
+#endif
+    const BYTE* row = gfMul[c];
+    for (; i < size; i++) {
+        dst[i] ^= row[src[i]];
+    }
+}
+
+// 패리티 행 row, 데이터 열 column 의 Cauchy 계수 1 / (x_row ^ y_column), x = dataCount + row, y = column
+static BYTE CauchyCoefficient(int dataCount, int row, int column) {
+    return GfInverse((BYTE)((dataCount + row) ^ column));
+}
+
+void FecEncode(int dataCount, int parityCount, const BYTE* const* data, BYTE* const* parity, DWORD size) {
+    for (int row = 0; row < parityCount; row++) {
+        memset(parity[row], 0, size);
+        for (int column = 0; column < dataCount; column++) {
+            FecMulAdd(parity[row], data[column], CauchyCoefficient(dataCount, row, column), size);
+        }
+    }
+}
+
+// GF(256) 에서 가우스-조르당 소거로 n x n 행렬의 역행렬을 구한다
+static bool InvertMatrix(BYTE* matrix, BYTE* inverse, int n) {
+    memset(inverse, 0, (size_t)n * n);
+    for (int i = 0; i < n; i++) {
+        inverse[i * n + i] = 1;
+    }
+    for (int column = 0; column < n; column++) {
+        int pivot = column;
+        while (pivot < n && matrix[pivot * n + column] == 0) {
+            pivot++;
+        }
+        if (pivot == n) {
+            return false;
+        }
+        if (pivot != column) {
+            for (int k = 0; k < n; k++) {
+                BYTE t = matrix[pivot * n + k];
+                matrix[pivot * n + k] = matrix[column * n + k];
+                matrix[column * n + k] = t;
+                t = inverse[pivot * n + k];
+                inverse[pivot * n + k] = inverse[column * n + k];
+                inverse[column * n + k] = t;
+            }
+        }
+        BYTE scale = GfInverse(matrix[column * n + column]);
+        for (int k = 0; k < n; k++) {
+            matrix[column * n + k] = gfMul[scale][matrix[column * n + k]];
+            inverse[column * n + k] = gfMul[scale][inverse[column * n + k]];
+        }
+        for (int row = 0; row < n; row++) {
+            BYTE factor = matrix[row * n + column];
+            if (row == column || factor == 0) {
+                continue;
+            }
+            for (int k = 0; k < n; k++) {
+                matrix[row * n + k] ^= gfMul[factor][matrix[column * n + k]];
+                inverse[row * n + k] ^= gfMul[factor][inverse[column * n + k]];
+            }
+        }
+    }
+    return true;
+}
+
+bool FecDecode(int dataCount, const int* indexes, const BYTE* const* shards,
+               int missingCount, const int* missing, BYTE* const* output, DWORD size) {
+    BYTE matrix[FEC_MAX_SHARDS * FEC_MAX_SHARDS];
+    BYTE inverse[FEC_MAX_SHARDS * FEC_MAX_SHARDS];
+    if (dataCount <= 0 || dataCount > FEC_MAX_SHARDS) {
+        return false;
+    }
+
+    // 받은 조각들의 부호 행렬 행을 모음
+    for (int i = 0; i < dataCount; i++) {
+        BYTE* row = matrix + i * dataCount;
+        if (indexes[i] < dataCount) {
+            memset(row, 0, dataCount);
+            row[indexes[i]] = 1;
+        }
+        else {
+            for (int column = 0; column < dataCount; column++) {
+                row[column] = CauchyCoefficient(dataCount, indexes[i] - dataCount, column);
+            }
+        }
+    }
+    if (!InvertMatrix(matrix, inverse, dataCount)) {
+        return false;
+    }
+
+    // 데이터 = 역행렬 * 받은 조각. 필요한 행만 계산
+    for (int m = 0; m < missingCount; m++) {
+        const BYTE* row = inverse + missing[m] * dataCount;
+        memset(output[m], 0, size);
+        for (int i = 0; i < dataCount; i++) {
+            FecMulAdd(output[m], shards[i], row[i], size);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+﻿#pragma once
+#include "platform.h"
+
+// GF(256) Reed-Solomon 소거(erasure) 부호
+// 데이터 조각 K 개마다 패리티 조각 M 개를 만들고, 받은 조각이 어떤 것이든 K 개 이상이면
+// 잃어버린 데이터 조각을 복구한다. 부호 행렬은 [I; Cauchy] 형태라 어떤 K 개의 행도 역행렬이 있다.
+// 곱셈은 표를 쓰며, x86 에서 SSSE3 를 지원하면 PSHUFB 로 16바이트씩 처리한다.
+// 사용 전에 FecInit 을 한 번 호출해야 한다.
+
+#define FEC_MAX_SHARDS 32 // K + M 의 최대값
+
+void FecInit(void);
+
+// SSSE3 경로를 쓰고 있으면 true (벤치마크 출력용)
+bool FecUsesSimd(void);
+// false 로 하면 표 기반 스칼라 경로만 사용 (벤치마크 비교용)
+void FecEnableSimd(bool enable);
+
+// dst ^= c * src (size 바이트)
+void FecMulAdd(BYTE* dst, const BYTE* src, BYTE c, DWORD size);
+
+// 데이터 조각 dataCount 개로 패리티 조각 parityCount 개를 만든다. 모든 조각의 길이는 size
+void FecEncode(int dataCount, int parityCount, const BYTE* const* data, BYTE* const* parity, DWORD size);
+
+// 받은 조각 dataCount 개로 잃어버린 데이터 조각을 복구한다.
+// indexes[i] 는 shards[i] 의 번호 (dataCount 미만은 데이터, 이상은 패리티 행 + dataCount)
+// missing[i] 번 데이터 조각을 output[i] 에 쓴다. 받은 조각 번호가 겹치면 false
+bool FecDecode(int dataCount, const int* indexes, const BYTE* const* shards,
+               int missingCount, const int* missing, BYTE* const* output, DWORD size);
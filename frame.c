@@ -0,0 +1,216 @@
+﻿#include "platform.h"
+#include "frame.h"
+#include "crc.h"
+
+// 디코딩된 프레임의 최대 크기 (헤더 + payload + CRC-32)
+#define FRAME_MAX_DECODED (FRAME_HEADER_SIZE + FRAME_MAX_PAYLOAD + 4)
+
+// 여러 번에 나눠 넣어도 한 번에 넣은 것과 같은 결과를 내는 COBS 인코더
+typedef struct {
+    BYTE* out;
+    DWORD write;
+    DWORD codeIndex;
+    BYTE code;
+} CobsWriter;
+
+static void CobsPut(CobsWriter* writer, const BYTE* in, DWORD length) {
+    BYTE* out = writer->out;
+    DWORD write = writer->write;
+    DWORD codeIndex = writer->codeIndex;
+    BYTE code = writer->code;
+    for (DWORD i = 0; i < length; i++) {
+        if (in[i] == 0) {
+            out[codeIndex] = code;
+            codeIndex = write++;
+            code = 1;
+            continue;
+        }
+        out[write++] = in[i];
+        if (++code == 0xFF) {
+            // 0 없이 254 바이트가 이어지면 블록을 끊음
+            out[codeIndex] = code;
+            codeIndex = write++;
+            code = 1;
+        }
+    }
+    writer->write = write;
+    writer->codeIndex = codeIndex;
+    writer->code = code;
+}
+
+DWORD FrameEncode(BYTE type, const BYTE* payload, DWORD length, BYTE* out, DWORD outSize) {
+    FrameSegment segment = { payload, length };
+    return FrameEncodeGather(type, 0, &segment, 1, out, outSize);
+}
+
+DWORD FrameEncodeGather(BYTE type, BYTE flags, const FrameSegment* segments, int count, BYTE* out, DWORD outSize) {
+    DWORD length = 0;
+    for (int i = 0; i < count; i++) {
+        length += segments[i].size;
+    }
+    if (length > FRAME_MAX_PAYLOAD || outSize < FRAME_ENCODED_SIZE(length)) {
+        return 0;
+    }
+
+    // 헤더, 조각들, CRC 를 차례로 CRC 에 넣고 바로 COBS 로 인코딩 (payload 를 한 번만 읽음)
+    flags = (BYTE)((flags & ~FRAME_FLAG_CRC16) | (length <= FRAME_SMALL_PAYLOAD ? FRAME_FLAG_CRC16 : 0));
+    BYTE header[FRAME_HEADER_SIZE] = { type, flags, (BYTE)(length & 0xFF), (BYTE)(length >> 8) };
+    CobsWriter writer = { out, 1, 0, 1 };
+    CobsPut(&writer, header, FRAME_HEADER_SIZE);
+    BYTE trailer[4];
+    DWORD trailerLength;
+    if (flags & FRAME_FLAG_CRC16) {
+        uint16_t crc = Crc16Update(CRC16_INIT, header, FRAME_HEADER_SIZE);
+        for (int i = 0; i < count; i++) {
+            crc = Crc16Update(crc, segments[i].data, segments[i].size);
+            CobsPut(&writer, segments[i].data, segments[i].size);
+        }
+        trailer[0] = (BYTE)(crc & 0xFF);
+        trailer[1] = (BYTE)(crc >> 8);
+        trailerLength = 2;
+    }
+    else {
+        uint32_t crc = Crc32Update(0, header, FRAME_HEADER_SIZE);
+        for (int i = 0; i < count; i++) {
+            crc = Crc32Update(crc, segments[i].data, segments[i].size);
+            CobsPut(&writer, segments[i].data, segments[i].size);
+        }
+        for (int i = 0; i < 4; i++) {
+            trailer[i] = (BYTE)(crc >> (8 * i));
+        }
+        trailerLength = 4;
+    }
+    CobsPut(&writer, trailer, trailerLength);
+
+    out[writer.codeIndex] = writer.code;
+    out[writer.write++] = FRAME_DELIMITER;
+    return writer.write;
+}
+
+bool FrameParserInit(FrameParser* parser) {
+    memset(parser, 0, sizeof(*parser));
+    parser->buffer = (BYTE*)malloc(FRAME_MAX_DECODED);
+    return parser->buffer != NULL;
+}
+
+void FrameParserFree(FrameParser* parser) {
+    free(parser->buffer);
+    parser->buffer = NULL;
+}
+
+void FrameParserReset(FrameParser* parser) {
+    parser->length = 0;
+    parser->code = 0;
+    parser->remaining = 0;
+    parser->pendingZero = false;
+    parser->discarding = false;
+}
+
+// 최대 크기를 넘으면 다음 구분자까지 버림
+static bool Append(FrameParser* parser, const BYTE* data, DWORD size) {
+    if (parser->length + size > FRAME_MAX_DECODED) {
+        AtomicIncrement32(&parser->formatErrors);
+        parser->discarding = true;
+        return false;
+    }
+    memcpy(parser->buffer + parser->length, data, size);
+    parser->length += size;
+    return true;
+}
+
+// 구분자를 만났을 때 모인 프레임을 검사하고 전달
+static void FinishFrame(FrameParser* parser, FrameHandler handler, void* context) {
+    const BYTE* raw = parser->buffer;
+    DWORD rawLength = parser->length;
+    FrameParserReset(parser);
+    if (rawLength == 0) {
+        return; // 연속된 구분자
+    }
+
+    if (rawLength < FRAME_HEADER_SIZE + 2) {
+        AtomicIncrement32(&parser->formatErrors);
+        return;
+    }
+    FrameHeader header;
+    header.type = raw[0];
+    header.flags = raw[1];
+    header.length = (uint16_t)(raw[2] | raw[3] << 8);
+    DWORD crcSize = (header.flags & FRAME_FLAG_CRC16) ? 2 : 4;
+    if (header.length > FRAME_MAX_PAYLOAD || rawLength != FRAME_HEADER_SIZE + header.length + crcSize) {
+        AtomicIncrement32(&parser->formatErrors);
+        return;
+    }
+
+    DWORD covered = FRAME_HEADER_SIZE + header.length;
+    bool valid;
+    if (crcSize == 2) {
+        uint16_t crc = Crc16Update(CRC16_INIT, raw, covered);
+        valid = raw[covered] == (BYTE)(crc & 0xFF) && raw[covered + 1] == (BYTE)(crc >> 8);
+    }
+    else {
+        uint32_t crc = Crc32Update(0, raw, covered);
+        uint32_t received = (uint32_t)raw[covered] | (uint32_t)raw[covered + 1] << 8 |
+                            (uint32_t)raw[covered + 2] << 16 | (uint32_t)raw[covered + 3] << 24;
+        valid = crc == received;
+    }
+    if (!valid) {
+        AtomicIncrement32(&parser->crcErrors);
+        return;
+    }
+
+    AtomicIncrement32(&parser->frames);
+    handler(context, &header, raw + FRAME_HEADER_SIZE, header.length);
+}
+
+void FrameParserFeed(FrameParser* parser, const BYTE* data, DWORD size, FrameHandler handler, void* context) {
+    static const BYTE zero = 0;
+    DWORD i = 0;
+    while (i < size) {
+        if (parser->discarding) {
+            // 재동기화: 다음 구분자까지 건너뜀
+            const BYTE* delimiter = (const BYTE*)memchr(data + i, FRAME_DELIMITER, size - i);
+            if (delimiter == NULL) {
+                return;
+            }
+            i = (DWORD)(delimiter - data) + 1;
+            FrameParserReset(parser);
+            continue;
+        }
+
+        if (parser->remaining == 0) {
+            // COBS 블록 코드 또는 프레임 끝
+            BYTE code = data[i++];
+            if (code == FRAME_DELIMITER) {
+                FinishFrame(parser, handler, context);
+                continue;
+            }
+            if (parser->pendingZero && !Append(parser, &zero, 1)) {
+                continue;
+            }
+            parser->code = code;
+            parser->remaining = (BYTE)(code - 1);
+            parser->pendingZero = parser->remaining == 0 && code != 0xFF;
+            continue;
+        }
+
+        // 블록 데이터는 한 번에 복사
+        DWORD count = size - i < parser->remaining ? size - i : parser->remaining;
+        const BYTE* delimiter = (const BYTE*)memchr(data + i, FRAME_DELIMITER, count);
+        if (delimiter != NULL) {
+            // 블록 도중에 구분자: 잘린 프레임. 구분자 다음부터 새 프레임
+            AtomicIncrement32(&parser->formatErrors);
+            FrameParserReset(parser);
+            i = (DWORD)(delimiter - data) + 1;
+            continue;
+        }
+        if (!Append(parser, data + i, count)) {
+            i += count;
+            continue;
+        }
+        i += count;
+        parser->remaining = (BYTE)(parser->remaining - count);
+        if (parser->remaining == 0) {
+            parser->pendingZero = parser->code != 0xFF;
+        }
+    }
+}
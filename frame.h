@@ -0,0 +1,82 @@
+﻿#pragma once
+#include "platform.h"
+
+// 바이너리 프레임 계층
+// 프레임 = COBS( type | flags | length(2, LE) | payload | CRC ) + 0x00
+// COBS 로 인코딩하므로 프레임 안에는 0x00 이 나오지 않고, 0x00 이 프레임 경계가 된다.
+// CRC 는 헤더와 payload 에 대해 계산한다. 짧은 프레임은 CRC-16, 그 외는 CRC-32 (flags 로 구분).
+
+#define FRAME_HEADER_SIZE 4
+#define FRAME_MAX_PAYLOAD 4096
+#define FRAME_SMALL_PAYLOAD 64   // 이 크기 이하는 CRC-16 사용 (느린 음향 모뎀에서 2바이트 절약)
+#define FRAME_DELIMITER 0x00
+
+// COBS 오버헤드(254 바이트마다 1) + 구분자 포함 최대 인코딩 크기
+#define FRAME_ENCODED_SIZE(n) ((n) + FRAME_HEADER_SIZE + 4 + ((n) + FRAME_HEADER_SIZE + 4) / 254 + 2)
+#define FRAME_MAX_ENCODED FRAME_ENCODED_SIZE(FRAME_MAX_PAYLOAD)
+
+// 프레임 종류
+#define FRAME_TYPE_DATA 0x01     // 사용자 메시지
+#define FRAME_TYPE_ARQ_DATA 0x02 // ARQ 조각 (arq.h)
+#define FRAME_TYPE_ARQ_ACK 0x03  // ARQ 확인 응답
+#define FRAME_TYPE_ARQ_PARITY 0x04 // ARQ FEC 패리티 조각 (fec.h)
+#define FRAME_TYPE_HELLO 0x05    // 압축 협상 (compress.h)
+#define FRAME_TYPE_DATA_LZ 0x06  // 압축된 사용자 메시지
+#define FRAME_TYPE_LINK_PROBE 0x07     // 링크 RTT/생존 확인 (scheduler.h)
+#define FRAME_TYPE_LINK_PROBE_ACK 0x08
+#define FRAME_TYPE_LINK_DATA 0x09      // 스케줄러가 고른 링크로 보낸 메시지
+#define FRAME_TYPE_LINK_ACK 0x0A
+#define FRAME_TYPE_CLOCK_SYNC 0x0B     // 시계 동기화 요청과 응답 (clocksync.h)
+#define FRAME_TYPE_CLOCK_REPLY 0x0C
+
+// flags
+#define FRAME_FLAG_CRC16 0x01
+#define FRAME_FLAG_TIMESTAMP 0x02 // payload 앞 FRAME_TIMESTAMP_SIZE 바이트가 보낸 쪽 단조 시계의 보낸 시각(ns, LE)
+
+#define FRAME_TIMESTAMP_SIZE 8
+
+// Framing 설정값
+#define FRAMING_RAW 0  // 기존 방식 (바이트 스트림 그대로)
+#define FRAMING_COBS 1 // COBS 프레임
+
+typedef struct {
+    BYTE type;
+    BYTE flags;
+    uint16_t length;
+} FrameHeader;
+
+// 프레임 하나를 인코딩한다. 성공하면 구분자를 포함한 바이트 수, 실패하면 0
+DWORD FrameEncode(BYTE type, const BYTE* payload, DWORD length, BYTE* out, DWORD outSize);
+
+// payload 를 여러 조각에서 이어 붙인 것으로 보고 인코딩한다 (조각 머리와 본문을 한 버퍼로 모으지 않음)
+// flags 에는 FRAME_FLAG_TIMESTAMP 처럼 payload 형식을 알리는 비트만 준다 (CRC 비트는 길이로 정함)
+typedef struct {
+    const BYTE* data;
+    DWORD size;
+} FrameSegment;
+
+DWORD FrameEncodeGather(BYTE type, BYTE flags, const FrameSegment* segments, int count, BYTE* out, DWORD outSize);
+
+typedef void (*FrameHandler)(void* context, const FrameHeader* header, const BYTE* payload, DWORD length);
+
+// 여러 번의 수신에 걸쳐 나뉘어 들어오는 스트림을 이어서 해석하는 파서
+// 손상된 프레임은 버리고 다음 구분자에서 다시 동기화한다.
+typedef struct {
+    BYTE* buffer;           // COBS 디코딩된 프레임 (헤더 + payload + CRC)
+    DWORD length;
+    BYTE code;              // 현재 COBS 블록 코드
+    BYTE remaining;         // 현재 블록에 남은 데이터 바이트 수
+    bool pendingZero;       // 다음 블록이 시작되면 0x00 을 추가해야 함
+    bool discarding;        // 손상 이후 다음 구분자까지 버리는 중
+
+    // 통계 (파서 스레드만 갱신)
+    volatile int32_t frames;
+    volatile int32_t crcErrors;
+    volatile int32_t formatErrors;  // 길이 불일치, 너무 긴 프레임, 잘린 COBS 블록
+} FrameParser;
+
+bool FrameParserInit(FrameParser* parser);
+void FrameParserFree(FrameParser* parser);
+void FrameParserReset(FrameParser* parser);
+// 수신한 바이트를 넣으면 완성된 프레임마다 handler 를 호출한다
+void FrameParserFeed(FrameParser* parser, const BYTE* data, DWORD size, FrameHandler handler, void* context);
@@ -0,0 +1,327 @@
+﻿#include "platform.h"
+#include "hotplug.h"
+#include "reactor.h"
+#include "scheduler.h"
+#include "autobaud.h"
+#ifdef _WIN32
+#include <setupapi.h>
+#include <devguid.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+typedef struct {
+    volatile int32_t failed;    // 포트 오류가 보고됨 (감시 스레드가 처리)
+    bool lost;                  // 포트를 닫고 다시 열기를 기다리는 중
+    bool present;               // 마지막 확인에서 장치가 있었음
+    bool listed;                // 장치 목록에서 본 적이 있음 (목록에 없는 가상 포트는 다시 열어 보는 것으로만 확인)
+    uint64_t lostNs;            // 포트가 빠진 시각 (시작할 때부터 없던 포트는 0)
+    uint64_t nextAttemptNs;
+    DWORD backoffMs;
+} HotplugPort;
+
+static struct {
+    HotplugPort ports[MAX_MODEMS];
+    HotplugNotifyProc notify;
+    PlatformThread thread;
+    volatile int32_t running;
+#ifdef _WIN32
+    PlatformEvent wake;
+#else
+    int wakePipe[2];
+    int inotifyFd;
+#endif
+} hotplug;
+
+static bool IsEmulated(const ModemConfig* modem) {
+    return _tcsncmp(modem->portName, EMULATOR_PORT_PREFIX, _tcslen(EMULATOR_PORT_PREFIX)) == 0;
+}
+
+#ifdef _WIN32
+
+static void WakeWatcher(void) {
+    PlatformEventSet(&hotplug.wake);
+}
+
+// SetupAPI 의 포트 목록에 modem 의 COM 포트가 있는지 ("\\.\COM10" 같은 이름도 COM10 으로 비교)
+static bool PortPresent(const ModemConfig* modem) {
+    if (IsEmulated(modem)) {
+        return true;
+    }
+    const TCHAR* name = _tcsrchr(modem->portName, TEXT('\\'));
+    name = name != NULL ? name + 1 : modem->portName;
+    HDEVINFO deviceInfoSet = SetupDiGetClassDevs(&GUID_DEVCLASS_PORTS, NULL, NULL, DIGCF_PRESENT);
+    if (deviceInfoSet == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    SP_DEVINFO_DATA deviceInfoData;
+    deviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
+    bool found = false;
+    for (DWORD i = 0; !found && SetupDiEnumDeviceInfo(deviceInfoSet, i, &deviceInfoData); i++) {
+        HKEY key = SetupDiOpenDevRegKey(deviceInfoSet, &deviceInfoData, DICS_FLAG_GLOBAL, 0, DIREG_DEV, KEY_READ);
+        if (key == INVALID_HANDLE_VALUE) {
+            continue;
+        }
+        TCHAR portName[MAX_PORT_NAME];
+        DWORD size = sizeof(portName) - sizeof(TCHAR);
+        DWORD type = 0;
+        if (RegQueryValueEx(key, TEXT("PortName"), NULL, &type, (LPBYTE)portName, &size) == ERROR_SUCCESS && type == REG_SZ) {
+            portName[size / sizeof(TCHAR)] = TEXT('\0');
+            found = _tcsicmp(portName, name) == 0;
+        }
+        RegCloseKey(key);
+    }
+    SetupDiDestroyDeviceInfoList(deviceInfoSet);
+    return found;
+}
+
+// timeoutMs 동안 기다린다. 장치가 바뀐 것을 알았으면 true (Windows 는 주기적인 확인만 함)
+static bool WaitForChange(DWORD timeoutMs) {
+    PlatformEventWait(&hotplug.wake, timeoutMs);
+    return false;
+}
+
+static bool InitWatcher(void) {
+    return PlatformEventInit(&hotplug.wake);
+}
+
+static void FreeWatcher(void) {
+    PlatformEventDestroy(&hotplug.wake);
+}
+
+#else
+
+static void WakeWatcher(void) {
+    BYTE value = 1;
+    ssize_t unused = write(hotplug.wakePipe[1], &value, 1);
+    (void)unused;
+}
+
+static bool PortPresent(const ModemConfig* modem) {
+    return IsEmulated(modem) || access(modem->portName, F_OK) == 0; // 심볼릭 링크(/dev/serial/by-id)는 대상까지 확인
+}
+
+// 모뎀 장치가 들어 있는 디렉터리를 지켜본다. /dev/serial/by-id 처럼 장치가 없으면 사라지는 디렉터리도 있으므로 /dev 도 함께
+static void WatchDevices(void) {
+    hotplug.inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (hotplug.inotifyFd < 0) {
+        return; // 주기적인 확인만 함
+    }
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM | IN_ATTRIB;
+    inotify_add_watch(hotplug.inotifyFd, "/dev", mask);
+    for (int i = 0; i < modemRegistry.count; i++) {
+        const ModemConfig* modem = &modemRegistry.modems[i];
+        char directory[MAX_PORT_NAME];
+        const char* slash = strrchr(modem->portName, '/');
+        if (IsEmulated(modem) || slash == NULL || slash == modem->portName) {
+            continue;
+        }
+        size_t length = (size_t)(slash - modem->portName);
+        memcpy(directory, modem->portName, length);
+        directory[length] = '\0';
+        inotify_add_watch(hotplug.inotifyFd, directory, mask); // 같은 디렉터리는 한 번만 등록됨
+    }
+}
+
+static bool WaitForChange(DWORD timeoutMs) {
+    struct pollfd pfds[2] = { { hotplug.wakePipe[0], POLLIN, 0 }, { hotplug.inotifyFd, POLLIN, 0 } };
+    if (poll(pfds, hotplug.inotifyFd >= 0 ? 2 : 1, timeoutMs == INFINITE ? -1 : (int)timeoutMs) <= 0) {
+        return false;
+    }
+    BYTE buffer[4096];
+    if (pfds[0].revents & POLLIN) {
+        while (read(hotplug.wakePipe[0], buffer, sizeof(buffer)) > 0) {
+        }
+    }
+    if (hotplug.inotifyFd >= 0 && (pfds[1].revents & POLLIN)) {
+        // 어느 포트의 장치인지는 다음 확인에서 경로로 봄
+        while (read(hotplug.inotifyFd, buffer, sizeof(buffer)) > 0) {
+        }
+        return true;
+    }
+    return false;
+}
+
+static bool InitWatcher(void) {
+    hotplug.inotifyFd = -1;
+    if (pipe2(hotplug.wakePipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        return false;
+    }
+    WatchDevices();
+    return true;
+}
+
+static void FreeWatcher(void) {
+    close(hotplug.wakePipe[0]);
+    close(hotplug.wakePipe[1]);
+    if (hotplug.inotifyFd >= 0) {
+        close(hotplug.inotifyFd);
+    }
+}
+
+#endif
+
+// 포트를 리액터에서 빼고 닫은 뒤 다시 열기를 기다리는 상태로 둔다
+static void DropPort(ModemConfig* modem, HotplugPort* port, uint64_t now) {
+    TransmitterLockPort(modem);
+    ReactorRemove(modem);
+    CloseSerialPort(modem);
+    TransmitterUnlockPort(modem);
+    port->lost = true;
+    port->present = false;
+    port->lostNs = now;
+    port->backoffMs = HOTPLUG_MIN_BACKOFF_MS;
+    port->nextAttemptNs = now;
+    AtomicAddRelaxed32(&modem->metrics.disconnects, 1);
+    // 확인을 기다리던 메시지를 바로 다른 링크로
+    SchedulerLinkFailed(modem);
+    if (hotplug.notify != NULL) {
+        hotplug.notify(modem, false);
+    }
+}
+
+// 같은 설정으로 다시 연다. 그 사이에 메뉴에서 다시 설정해 이미 열렸으면 그대로 쓴다
+static bool ReopenPort(ModemConfig* modem, HotplugPort* port, uint64_t now) {
+    TransmitterLockPort(modem);
+    bool reopened = modem->hSerial == INVALID_HANDLE_VALUE && OpenSerialPort(modem);
+    if (reopened) {
+        ReactorAdd(modem);
+    }
+    bool open = modem->hSerial != INVALID_HANDLE_VALUE;
+    TransmitterUnlockPort(modem);
+    if (!open) {
+        port->nextAttemptNs = now + (uint64_t)port->backoffMs * 1000000ULL;
+        port->backoffMs = port->backoffMs * 2 < HOTPLUG_MAX_BACKOFF_MS ? port->backoffMs * 2 : HOTPLUG_MAX_BACKOFF_MS;
+        return false;
+    }
+    port->lost = false;
+    if (reopened) {
+        AtomicAddRelaxed32(&modem->metrics.reconnects, 1);
+        if (modem->autoBaud) {
+            AutoBaudRequest(modem); // 다른 장치가 꽂혔을 수 있으므로 다시 찾음 (포트 잠금 밖에서, 탐색 스레드가)
+        }
+    }
+    if (port->lostNs != 0) {
+        int64_t elapsedUs = (int64_t)((now - port->lostNs) / 1000);
+        AtomicStoreRelease64(&modem->metrics.lastReconnectUs, elapsedUs);
+        if (elapsedUs > AtomicLoadAcquire64(&modem->metrics.maxReconnectUs)) {
+            AtomicStoreRelease64(&modem->metrics.maxReconnectUs, elapsedUs);
+        }
+    }
+    SchedulerLinkRestored(modem);
+    if (hotplug.notify != NULL) {
+        hotplug.notify(modem, true);
+    }
+    return true;
+}
+
+// 포트마다 오류/분리를 처리하고 끊긴 포트를 다시 열어 본다. 다음에 다시 볼 때까지의 시간 (ms) 을 반환
+static DWORD ServicePorts(bool scan) {
+    uint64_t now = PlatformNowNs();
+    uint64_t wakeNs = now + HOTPLUG_SCAN_MS * 1000000ULL;
+    for (int i = 0; i < modemRegistry.count; i++) {
+        ModemConfig* modem = &modemRegistry.modems[i];
+        HotplugPort* port = &hotplug.ports[i];
+        if (!port->lost) {
+            bool failed = AtomicExchange32(&port->failed, 0) != 0;
+            if (!failed && scan && modem->hSerial != INVALID_HANDLE_VALUE) {
+                // 오류 없이 장치만 사라지는 드라이버도 있음 (목록에서 본 적이 있는 포트만)
+                bool present = PortPresent(modem);
+                port->listed = port->listed || present;
+                failed = port->listed && !present;
+            }
+            if (!failed) {
+                continue;
+            }
+            DropPort(modem, port, now);
+        }
+        if (scan || now >= port->nextAttemptNs) {
+            bool present = PortPresent(modem);
+            bool arrived = present && !port->present;
+            port->listed = port->listed || present;
+            port->present = present;
+            // 목록에 있던 장치는 다시 나타날 때까지 기다리고, 나타나면 물러서던 중이라도 바로 연다
+            if ((present || !port->listed) && (arrived || now >= port->nextAttemptNs)) {
+                if (arrived) {
+                    port->backoffMs = HOTPLUG_MIN_BACKOFF_MS;
+                }
+                if (ReopenPort(modem, port, now)) {
+                    continue;
+                }
+            }
+        }
+        if (port->lost && (port->present || !port->listed) && port->nextAttemptNs < wakeNs) {
+            wakeNs = port->nextAttemptNs;
+        }
+    }
+    now = PlatformNowNs();
+    return wakeNs > now ? (DWORD)((wakeNs - now) / 1000000ULL) + 1 : 0;
+}
+
+static DWORD WINAPI HotplugThread(LPVOID param) {
+    (void)param;
+    uint64_t nextScanNs = 0;
+    bool changed = false;
+    while (AtomicLoadAcquire32(&hotplug.running)) {
+        uint64_t now = PlatformNowNs();
+        bool scan = changed || now >= nextScanNs;
+        if (scan) {
+            nextScanNs = now + HOTPLUG_SCAN_MS * 1000000ULL;
+        }
+        DWORD waitMs = ServicePorts(scan);
+        changed = WaitForChange(waitMs);
+    }
+    return 0;
+}
+
+bool HotplugStart(HotplugNotifyProc notify) {
+    memset(&hotplug, 0, sizeof(hotplug));
+    hotplug.notify = notify;
+    uint64_t now = PlatformNowNs();
+    for (int i = 0; i < modemRegistry.count; i++) {
+        const ModemConfig* modem = &modemRegistry.modems[i];
+        HotplugPort* port = &hotplug.ports[i];
+        port->present = PortPresent(modem);
+        port->listed = port->present;
+        // 시작할 때 열지 못한 포트는 장치가 나타날 때만 열어 봄 (잘못 설정한 포트를 계속 열지 않도록)
+        if (modem->hSerial == INVALID_HANDLE_VALUE && !IsEmulated(modem)) {
+            port->lost = true;
+            port->listed = true;
+            port->present = false;
+            port->backoffMs = HOTPLUG_MIN_BACKOFF_MS;
+            port->nextAttemptNs = now;
+        }
+    }
+    if (!InitWatcher()) {
+        return false;
+    }
+    AtomicStoreRelease32(&hotplug.running, 1);
+    if (!PlatformThreadStart(&hotplug.thread, HotplugThread, NULL)) {
+        AtomicStoreRelease32(&hotplug.running, 0);
+        FreeWatcher();
+        return false;
+    }
+    return true;
+}
+
+void HotplugStop(void) {
+    if (!AtomicLoadAcquire32(&hotplug.running)) {
+        return;
+    }
+    AtomicStoreRelease32(&hotplug.running, 0);
+    WakeWatcher();
+    PlatformThreadJoin(hotplug.thread);
+    FreeWatcher();
+}
+
+void HotplugPortFailed(ModemConfig* modem, DWORD errorCode) {
+    (void)errorCode;
+    int index = ModemIndex(modem);
+    if (!AtomicLoadAcquire32(&hotplug.running) || index < 0) {
+        return;
+    }
+    AtomicStoreRelease32(&hotplug.ports[index].failed, 1);
+    WakeWatcher();
+}
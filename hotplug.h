@@ -0,0 +1,27 @@
+﻿#pragma once
+#include "platform.h"
+#include "modem.h"
+
+// 포트 분리 감지와 자동 재연결
+// 리액터가 포트 오류(USB 시리얼 어댑터 분리, 드라이버 오류)를 보고하거나, HOTPLUG_SCAN_MS 마다 하는 장치 확인에서
+// 열린 포트의 장치가 사라지면 감시 스레드가 그 포트를 리액터에서 빼고 닫은 뒤 같은 설정으로 다시 연다.
+// 장치 확인은 Windows 는 ListSerialPorts 와 같은 SetupAPI 포트 열거(PortName), Linux 는 장치 경로로 하고,
+// Linux 는 장치 디렉터리를 inotify 로 지켜보므로 udev 가 장치 노드를 만들거나 지우면 바로 확인한다.
+// 장치가 다시 나타나면 기다리지 않고 열고, 있는데도 열리지 않으면 HOTPLUG_MIN_BACKOFF_MS 부터 실패할 때마다
+// 두 배씩 HOTPLUG_MAX_BACKOFF_MS 까지 물러서며 다시 시도한다.
+// 스케줄러 링크는 포트가 빠지는 즉시 끊긴 것으로 표시해 확인을 기다리던 메시지를 RTO 를 기다리지 않고 다른 링크로
+// 다시 보내고, 다시 열리면 바로 PROBE 를 보내 링크에 복귀시킨다.
+// 분리 횟수와 다시 열릴 때까지 걸린 시간은 모뎀 지표에, 다른 링크로 전환된 시간은 스케줄러 링크 통계에 남는다.
+
+#define HOTPLUG_SCAN_MS 1000
+#define HOTPLUG_MIN_BACKOFF_MS 250
+#define HOTPLUG_MAX_BACKOFF_MS 8000
+
+// 포트가 빠졌을 때(up = false)와 다시 열렸을 때 감시 스레드에서 호출된다
+typedef void (*HotplugNotifyProc)(ModemConfig* modem, bool up);
+
+// 시작할 때 열리지 않은 포트(에뮬레이터 제외)도 장치가 나타나면 연다
+bool HotplugStart(HotplugNotifyProc notify);
+void HotplugStop(void);
+// 포트 오류를 알린다 (ReactorErrorProc 과 같은 모양, 어느 스레드에서든). 감시 스레드가 닫고 다시 연다
+void HotplugPortFailed(ModemConfig* modem, DWORD errorCode);
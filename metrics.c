@@ -0,0 +1,299 @@
+﻿#include "platform.h"
+#include "metrics.h"
+#include "modem.h"
+#include "scheduler.h"
+#include "pool.h"
+#include "rxlog.h"
+
+static const TCHAR* const classNames[TX_CLASSES] = { TEXT("control"), TEXT("normal"), TEXT("bulk") };
+
+static struct {
+    FILE* file;
+    DWORD intervalMs;
+    uint64_t startNs;
+    PlatformThread thread;
+    PlatformEvent wake;
+    volatile int32_t running;
+} snapshots;
+
+static int HighestBit(uint32_t value) {
+#ifdef _WIN32
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return (int)index;
+#else
+    return 31 - __builtin_clz(value);
+#endif
+}
+
+static int BucketIndex(uint32_t us) {
+    if (us < METRICS_SUB_BUCKETS) {
+        return (int)us;
+    }
+    int shift = HighestBit(us) - METRICS_SUB_BITS;
+    return shift * METRICS_SUB_BUCKETS + (int)(us >> shift);
+}
+
+// 버킷에 들어가는 가장 큰 값 (us)
+static uint32_t BucketUpperBound(int index) {
+    int shift = index < 2 * METRICS_SUB_BUCKETS ? 0 : index / METRICS_SUB_BUCKETS - 1;
+    uint64_t sub = (uint64_t)(index - shift * METRICS_SUB_BUCKETS);
+    return (uint32_t)(((sub + 1) << shift) - 1);
+}
+
+void HistogramRecord(LatencyHistogram* histogram, uint64_t elapsedNs) {
+    uint64_t us = elapsedNs / 1000;
+    uint32_t clamped = us < 0xFFFFFFFFULL ? (uint32_t)us : 0xFFFFFFFFU;
+    AtomicAddRelaxed32(&histogram->buckets[BucketIndex(clamped)], 1);
+    AtomicAddRelaxed64(&histogram->count, 1);
+    AtomicAddRelaxed64(&histogram->sumUs, (int64_t)clamped);
+    int64_t max = AtomicLoadAcquire64(&histogram->maxUs);
+    while ((int64_t)clamped > max && !AtomicCompareExchange64(&histogram->maxUs, max, (int64_t)clamped)) {
+        max = AtomicLoadAcquire64(&histogram->maxUs);
+    }
+}
+
+void HistogramSummarize(const LatencyHistogram* histogram, LatencySummary* summary) {
+    // 버킷을 먼저 복사해 읽는 동안 늘어난 값과 섞이지 않게 함
+    static const int permille[4] = { 500, 900, 990, 999 };
+    uint32_t* targets[4] = { &summary->p50Us, &summary->p90Us, &summary->p99Us, &summary->p999Us };
+    int32_t buckets[METRICS_BUCKETS];
+    int64_t count = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        buckets[i] = AtomicLoadAcquire32(&histogram->buckets[i]);
+        count += buckets[i];
+    }
+    summary->count = count;
+    summary->meanUs = count > 0 ? (double)AtomicLoadAcquire64(&histogram->sumUs) / count : 0.0;
+    summary->maxUs = AtomicLoadAcquire64(&histogram->maxUs);
+    int64_t seen = 0;
+    int next = 0;
+    for (int i = 0; i < 4; i++) {
+        *targets[i] = 0;
+    }
+    for (int i = 0; i < METRICS_BUCKETS && next < 4 && count > 0; i++) {
+        seen += buckets[i];
+        while (next < 4 && seen * 1000 >= count * permille[next]) {
+            // 버킷 상한이 실제 최댓값보다 크게 나오지 않도록
+            uint32_t bound = BucketUpperBound(i);
+            *targets[next++] = (int64_t)bound < summary->maxUs ? bound : (uint32_t)summary->maxUs;
+        }
+    }
+}
+
+void MetricsRecordArrival(ModemMetrics* metrics, DWORD size) {
+    metrics->pushedBytes += size;
+    uint32_t head = metrics->arrivalHead;
+    // 가득 차면 기록하지 않음 (꺼내는 쪽은 다음 조각의 시각을 쓰므로 지연이 조금 작게 잡힘)
+    if (head - AtomicLoadAcquire32(&metrics->arrivalTail) >= METRICS_ARRIVALS) {
+        return;
+    }
+    metrics->arrivalEnd[head & (METRICS_ARRIVALS - 1)] = metrics->pushedBytes;
+    metrics->arrivalNs[head & (METRICS_ARRIVALS - 1)] = PlatformNowNs();
+    AtomicStoreRelease32(&metrics->arrivalHead, head + 1);
+}
+
+uint64_t MetricsTakeArrival(ModemMetrics* metrics, DWORD size) {
+    metrics->consumedBytes += size;
+    uint32_t head = AtomicLoadAcquire32(&metrics->arrivalHead);
+    uint32_t tail = metrics->arrivalTail;
+    uint64_t arrivalNs = 0;
+    while (tail != head) {
+        uint32_t slot = tail & (METRICS_ARRIVALS - 1);
+        arrivalNs = metrics->arrivalNs[slot];
+        if (metrics->arrivalEnd[slot] > metrics->consumedBytes) {
+            break; // 꺼낸 마지막 바이트가 이 조각 안에 있음 (나머지는 아직 링에)
+        }
+        tail++;
+    }
+    AtomicStoreRelease32(&metrics->arrivalTail, tail);
+    return arrivalNs;
+}
+
+void MetricsRecordReconfigure(ModemMetrics* metrics, uint64_t outageNs) {
+    int64_t outageUs = (int64_t)(outageNs / 1000);
+    AtomicAddRelaxed32(&metrics->reconfigures, 1);
+    AtomicStoreRelease64(&metrics->lastReconfigureUs, outageUs);
+    if (outageUs > AtomicLoadAcquire64(&metrics->maxReconfigureUs)) {
+        AtomicStoreRelease64(&metrics->maxReconfigureUs, outageUs);
+    }
+}
+
+static void PrintLatency(const TCHAR* name, const LatencyHistogram* histogram) {
+    LatencySummary summary;
+    HistogramSummarize(histogram, &summary);
+    _tprintf(TEXT("    %-8s latency n=%lld mean %.2f ms, p50 %.2f, p90 %.2f, p99 %.2f, p99.9 %.2f, max %.2f ms\n"), name,
+        (long long)summary.count, summary.meanUs / 1000.0, summary.p50Us / 1000.0, summary.p90Us / 1000.0, summary.p99Us / 1000.0,
+        summary.p999Us / 1000.0, summary.maxUs / 1000.0);
+}
+
+void MetricsPrint(void) {
+    _tprintf(TEXT("\n=== Metrics ===\n"));
+    for (int i = 0; i < modemRegistry.count; i++) {
+        ModemConfig* modem = &modemRegistry.modems[i];
+        const ModemMetrics* metrics = &modem->metrics;
+        _tprintf(TEXT("[%d] %s (%s) : %s\n"), i, modem->name, modem->portName, modem->hSerial != INVALID_HANDLE_VALUE ? TEXT("ON") : TEXT("OFF"));
+        _tprintf(TEXT("    in  %lld bytes, %ld messages\n"), (long long)AtomicLoadAcquire64(&metrics->bytesIn), (long)AtomicLoadAcquire32(&metrics->messagesIn));
+        _tprintf(TEXT("    out %lld bytes, %ld messages (%ld failed) in %ld writes\n"), (long long)modem->txQueue.bytesWritten,
+            (long)modem->txQueue.messagesSent, (long)modem->txQueue.messagesFailed, (long)modem->txQueue.writes);
+        _tprintf(TEXT("    errors: crc %ld, format %ld, driver %lu, overruns %lu, port %ld, rx dropped %lld bytes; reconnects %ld\n"),
+            (long)modem->rxFrame.crcErrors, (long)modem->rxFrame.formatErrors, (unsigned long)SerialQueryDriverErrors(modem),
+            (unsigned long)SerialQueryOverruns(modem), (long)metrics->portErrors, (long long)modem->rxRing.droppedBytes, (long)metrics->reconnects);
+        _tprintf(TEXT("    queues: rx %lu/%lu (peak %ld), tx %ld bytes queued, %ld writing\n"), (unsigned long)RingUsed(&modem->rxRing),
+            (unsigned long)modem->rxRing.capacity, (long)modem->rxRing.highWater, (long)modem->txQueue.queuedBytes, (long)modem->txQueue.writingBytes);
+        // 포트 분리와 자동 재연결, 스케줄러 링크면 다른 링크로 전환된 시간
+        LinkStats link;
+        bool isLink = SchedulerQueryLink(modem, &link);
+        _tprintf(TEXT("    hotplug: %ld disconnects, reconnect last %.1f ms (max %.1f ms)"), (long)metrics->disconnects,
+            AtomicLoadAcquire64(&metrics->lastReconnectUs) / 1000.0, AtomicLoadAcquire64(&metrics->maxReconnectUs) / 1000.0);
+        if (isLink) {
+            _tprintf(TEXT(", %ld failovers, last %.1f ms (max %.1f ms)"), (long)link.failovers, link.lastFailoverMs, link.maxFailoverMs);
+        }
+        _tprintf(TEXT("\n"));
+        _tprintf(TEXT("    reconfig: %ld in place, transmit paused last %.2f ms (max %.2f ms)\n"), (long)metrics->reconfigures,
+            AtomicLoadAcquire64(&metrics->lastReconfigureUs) / 1000.0, AtomicLoadAcquire64(&metrics->maxReconfigureUs) / 1000.0);
+        PrintLatency(TEXT("send"), &metrics->sendLatency);
+        PrintLatency(TEXT("receive"), &metrics->receiveLatency);
+        // 상대 -> 이쪽 단방향 지연 (out 은 상대가 잰 반대 방향). 타임스탬프를 주고받는 링크만
+        const ClockSync* clock = &modem->clock;
+        if (modem->framing == FRAMING_COBS && (modem->timestamps || clock->stampedFrames > 0)) {
+            PrintLatency(TEXT("one-way"), &metrics->oneWayLatency);
+            int64_t oneWayNs = AtomicLoadAcquire64(&clock->oneWayNs);
+            int32_t forwardUs = AtomicLoadAcquire32(&clock->forwardUs);
+            _tprintf(TEXT("    clock: %s, offset %+.3f ms (rtt %.3f ms), jitter %.3f ms, one-way in %.3f ms / out %.3f ms, ")
+                TEXT("%ld stamped frames (%ld before sync), %ld syncs, %ld replies\n"),
+                AtomicLoadAcquire32(&clock->synced) ? TEXT("synced") : TEXT("not synced"), AtomicLoadAcquire64(&clock->offsetNs) / 1e6,
+                AtomicLoadAcquire64(&clock->rttNs) / 1e6, AtomicLoadAcquire64(&clock->jitterNs) / 1e6, oneWayNs >= 0 ? oneWayNs / 1e6 : -1.0,
+                forwardUs >= 0 ? forwardUs / 1e3 : -1.0, (long)clock->stampedFrames, (long)clock->unsyncedFrames, (long)clock->syncsSent,
+                (long)clock->replies);
+        }
+        // 송신 등급별 (부하가 걸려도 control 의 지연이 묶여 있는지 확인용)
+        _tprintf(TEXT("    tx classes: control %ld, normal %ld, bulk %ld bytes queued, %ld fragments preempted bulk data\n"),
+            (long)modem->txQueue.classBytes[TX_CLASS_CONTROL], (long)modem->txQueue.classBytes[TX_CLASS_NORMAL],
+            (long)modem->txQueue.classBytes[TX_CLASS_BULK], (long)modem->txQueue.preemptions);
+        for (int c = 0; c < TX_CLASSES; c++) {
+            PrintLatency(classNames[c], &modem->txQueue.classLatency[c]);
+        }
+    }
+    // 버퍼 풀은 모든 모뎀이 함께 씀. 한 프레임보다 큰 ARQ 전송 버퍼 말고도 힙 할당이 늘면 풀 크기(pool.h)가 부하에 모자람
+    PoolStats pool;
+    PoolQueryStats(&pool);
+    _tprintf(TEXT("buffer pool: %lld allocations, %lld from heap, %ld in use, peak blocks small %ld/%d, medium %ld/%d, large %ld/%d\n"),
+        (long long)pool.allocs, (long long)pool.heapAllocs, (long)pool.inUse, (long)pool.classUsed[0], POOL_SMALL_COUNT,
+        (long)pool.classUsed[1], POOL_MEDIUM_COUNT, (long)pool.classUsed[2], POOL_LARGE_COUNT);
+    // waited 가 늘면 출력(콘솔, 파일)이 수신 속도를 겨우 따라가고, 버린 레코드가 생기면 따라가지 못함 (--rx-log 세그먼트 수를 늘림)
+    RxLogStats rxLog;
+    RxLogQueryStats(&rxLog);
+    _tprintf(TEXT("receive log: %lld messages (%lld bytes, %lld truncated), %lld bytes written in %lld writes, %lld rotations, %lld waited, %lld dropped\n"),
+        (long long)rxLog.records, (long long)rxLog.bytes, (long long)rxLog.truncatedRecords, (long long)rxLog.outputBytes,
+        (long long)rxLog.writes, (long long)rxLog.rotations, (long long)rxLog.waitedRecords, (long long)rxLog.droppedRecords);
+}
+
+static void WriteLatency(FILE* file, const TCHAR* name, const LatencyHistogram* histogram) {
+    LatencySummary summary;
+    HistogramSummarize(histogram, &summary);
+    _ftprintf(file, TEXT("\"%s\": {\"count\": %lld, \"mean_us\": %.1f, \"p50_us\": %lu, \"p90_us\": %lu, \"p99_us\": %lu, \"p999_us\": %lu, \"max_us\": %lld}"),
+        name, (long long)summary.count, summary.meanUs, (unsigned long)summary.p50Us, (unsigned long)summary.p90Us, (unsigned long)summary.p99Us,
+        (unsigned long)summary.p999Us, (long long)summary.maxUs);
+}
+
+static void WriteSnapshot(void) {
+    FILE* file = snapshots.file;
+    _ftprintf(file, TEXT("{\"time_ms\": %llu, \"modems\": ["), (unsigned long long)((PlatformNowNs() - snapshots.startNs) / 1000000));
+    for (int i = 0; i < modemRegistry.count; i++) {
+        ModemConfig* modem = &modemRegistry.modems[i];
+        const ModemMetrics* metrics = &modem->metrics;
+        _ftprintf(file, TEXT("%s{\"id\": %d, \"name\": \"%s\", \"open\": %s, \"bytes_in\": %lld, \"messages_in\": %ld, \"bytes_out\": %lld, ")
+            TEXT("\"messages_out\": %ld, \"messages_failed\": %ld, \"crc_errors\": %ld, \"format_errors\": %ld, \"driver_errors\": %lu, ")
+            TEXT("\"driver_overruns\": %lu, \"port_errors\": %ld, \"rx_dropped_bytes\": %lld, \"reconnects\": %ld, \"rx_queue\": %lu, ")
+            TEXT("\"rx_queue_peak\": %ld, \"rx_queue_size\": %lu, \"tx_queue\": %ld, "),
+            i > 0 ? TEXT(", ") : TEXT(""), i, modem->name, modem->hSerial != INVALID_HANDLE_VALUE ? TEXT("true") : TEXT("false"),
+            (long long)AtomicLoadAcquire64(&metrics->bytesIn), (long)AtomicLoadAcquire32(&metrics->messagesIn), (long long)modem->txQueue.bytesWritten,
+            (long)modem->txQueue.messagesSent, (long)modem->txQueue.messagesFailed, (long)modem->rxFrame.crcErrors, (long)modem->rxFrame.formatErrors,
+            (unsigned long)SerialQueryDriverErrors(modem), (unsigned long)SerialQueryOverruns(modem), (long)metrics->portErrors,
+            (long long)modem->rxRing.droppedBytes, (long)metrics->reconnects, (unsigned long)RingUsed(&modem->rxRing), (long)modem->rxRing.highWater,
+            (unsigned long)modem->rxRing.capacity, (long)modem->txQueue.queuedBytes);
+        LinkStats link;
+        if (!SchedulerQueryLink(modem, &link)) {
+            memset(&link, 0, sizeof(link));
+        }
+        _ftprintf(file, TEXT("\"disconnects\": %ld, \"reconnect_last_ms\": %.1f, \"reconnect_max_ms\": %.1f, \"failovers\": %ld, ")
+            TEXT("\"failover_last_ms\": %.1f, \"failover_max_ms\": %.1f, "), (long)metrics->disconnects,
+            AtomicLoadAcquire64(&metrics->lastReconnectUs) / 1000.0, AtomicLoadAcquire64(&metrics->maxReconnectUs) / 1000.0,
+            (long)link.failovers, link.lastFailoverMs, link.maxFailoverMs);
+        _ftprintf(file, TEXT("\"reconfigures\": %ld, \"reconfig_outage_last_ms\": %.2f, \"reconfig_outage_max_ms\": %.2f, "), (long)metrics->reconfigures,
+            AtomicLoadAcquire64(&metrics->lastReconfigureUs) / 1000.0, AtomicLoadAcquire64(&metrics->maxReconfigureUs) / 1000.0);
+        WriteLatency(file, TEXT("send_latency"), &metrics->sendLatency);
+        _ftprintf(file, TEXT(", "));
+        WriteLatency(file, TEXT("receive_latency"), &metrics->receiveLatency);
+        _ftprintf(file, TEXT(", "));
+        WriteLatency(file, TEXT("one_way_latency"), &metrics->oneWayLatency);
+        const ClockSync* clock = &modem->clock;
+        int64_t oneWayNs = AtomicLoadAcquire64(&clock->oneWayNs);
+        int32_t forwardUs = AtomicLoadAcquire32(&clock->forwardUs);
+        _ftprintf(file, TEXT(", \"clock\": {\"synced\": %s, \"offset_ms\": %.3f, \"rtt_ms\": %.3f, \"jitter_ms\": %.3f, ")
+            TEXT("\"one_way_in_ms\": %.3f, \"one_way_out_ms\": %.3f, \"stamped_frames\": %ld}"),
+            AtomicLoadAcquire32(&clock->synced) ? TEXT("true") : TEXT("false"), AtomicLoadAcquire64(&clock->offsetNs) / 1e6,
+            AtomicLoadAcquire64(&clock->rttNs) / 1e6, AtomicLoadAcquire64(&clock->jitterNs) / 1e6, oneWayNs >= 0 ? oneWayNs / 1e6 : -1.0,
+            forwardUs >= 0 ? forwardUs / 1e3 : -1.0, (long)clock->stampedFrames);
+        _ftprintf(file, TEXT(", \"preemptions\": %ld, \"class_latency\": {"), (long)modem->txQueue.preemptions);
+        for (int c = 0; c < TX_CLASSES; c++) {
+            _ftprintf(file, TEXT("%s"), c > 0 ? TEXT(", ") : TEXT(""));
+            WriteLatency(file, classNames[c], &modem->txQueue.classLatency[c]);
+        }
+        _ftprintf(file, TEXT("}}"));
+    }
+    PoolStats pool;
+    PoolQueryStats(&pool);
+    _ftprintf(file, TEXT("], \"pool\": {\"allocs\": %lld, \"heap_allocs\": %lld, \"in_use\": %ld}, "), (long long)pool.allocs,
+        (long long)pool.heapAllocs, (long)pool.inUse);
+    RxLogStats rxLog;
+    RxLogQueryStats(&rxLog);
+    _ftprintf(file, TEXT("\"rx_log\": {\"records\": %lld, \"waited\": %lld, \"dropped\": %lld}}\n"), (long long)rxLog.records,
+        (long long)rxLog.waitedRecords, (long long)rxLog.droppedRecords);
+    fflush(file);
+}
+
+static DWORD WINAPI SnapshotThread(LPVOID param) {
+    (void)param;
+    while (AtomicLoadAcquire32(&snapshots.running)) {
+        PlatformEventWait(&snapshots.wake, snapshots.intervalMs);
+        WriteSnapshot();
+    }
+    return 0;
+}
+
+bool MetricsStartSnapshots(const TCHAR* path, DWORD intervalMs) {
+    snapshots.file = _tfopen(path, TEXT("a"));
+    if (snapshots.file == NULL) {
+        _ftprintf(stderr, TEXT("Cannot open metrics file %s\n"), path);
+        return false;
+    }
+    snapshots.intervalMs = intervalMs > 0 ? intervalMs : METRICS_SNAPSHOT_MS;
+    snapshots.startNs = PlatformNowNs();
+    if (!PlatformEventInit(&snapshots.wake)) {
+        fclose(snapshots.file);
+        return false;
+    }
+    AtomicStoreRelease32(&snapshots.running, 1);
+    if (!PlatformThreadStart(&snapshots.thread, SnapshotThread, NULL)) {
+        AtomicStoreRelease32(&snapshots.running, 0);
+        PlatformEventDestroy(&snapshots.wake);
+        fclose(snapshots.file);
+        return false;
+    }
+    return true;
+}
+
+// 마지막 스냅숏을 남기고 종료
+void MetricsStopSnapshots(void) {
+    if (!AtomicLoadAcquire32(&snapshots.running)) {
+        return;
+    }
+    AtomicStoreRelease32(&snapshots.running, 0);
+    PlatformEventSet(&snapshots.wake);
+    PlatformThreadJoin(snapshots.thread);
+    PlatformEventDestroy(&snapshots.wake);
+    fclose(snapshots.file);
+    snapshots.file = NULL;
+}
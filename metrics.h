@@ -0,0 +1,79 @@
+﻿#pragma once
+#include "platform.h"
+
+// 모뎀별 런타임 지표
+// 송수신 경로는 카운터와 히스토그램을 relaxed 원자적 덧셈으로만 갱신하고, 읽는 쪽(메뉴, 스냅숏 스레드)은
+// 값을 그대로 읽는다. 이미 다른 계층에 있는 카운터(송신 큐, 수신 링, 프레임 파서)는 스냅숏에서 함께 읽는다.
+// 지연 히스토그램은 HDR 방식의 로그-선형 버킷이다: 2의 거듭제곱 구간마다 METRICS_SUB_BUCKETS 개로 나누므로
+// 어느 값이든 상대 오차가 1/METRICS_SUB_BUCKETS 이하이고, 1us 부터 약 71분까지 고정 크기 배열로 담는다.
+//   송신 지연: TransmitEnqueue 부터 그 메시지를 담은 배치의 쓰기 완료까지
+//   수신 지연: 리액터가 읽은 때부터 수신 처리 스레드가 메시지(프레임 또는 바이트 조각)를 전달할 때까지
+//   단방향 지연: 상대의 송신 스레드가 프레임에 붙인 보낸 시각부터 리액터가 읽을 때까지 (시계 차이를 보정, clocksync.h)
+// UHSDM --metrics <파일> [간격 ms] 로 실행하면 간격마다 모든 모뎀의 스냅숏을 JSON 한 줄로 파일에 덧붙인다.
+
+#define METRICS_SUB_BITS 4
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BITS)
+#define METRICS_MAX_SHIFT 28    // 2^32 us 까지
+#define METRICS_BUCKETS ((METRICS_MAX_SHIFT + 1) * METRICS_SUB_BUCKETS + METRICS_SUB_BUCKETS)
+#define METRICS_ARRIVALS 64     // 수신 링에 들어 있는 조각의 도착 시각 (2의 거듭제곱)
+#define METRICS_SNAPSHOT_MS 1000
+
+typedef struct {
+    volatile int32_t buckets[METRICS_BUCKETS]; // 마이크로초
+    volatile int64_t count;
+    volatile int64_t sumUs;
+    volatile int64_t maxUs;
+} LatencyHistogram;
+
+typedef struct {
+    volatile int64_t bytesIn;       // 리액터가 읽은 바이트
+    volatile int32_t messagesIn;    // 전달한 프레임 (FRAMING_RAW 는 바이트 조각)
+    volatile int32_t driverErrors;  // 드라이버가 보고한 회선 오류 (Windows EV_ERR 의 CE_FRAME/CE_RXPARITY/CE_BREAK 등)
+    volatile int32_t portErrors;    // 리액터가 포트를 오류로 뺀 횟수
+    volatile int32_t reconnects;    // 포트를 다시 연 횟수
+    volatile int32_t disconnects;   // 포트가 빠진 횟수 (장치 분리, 포트 오류. hotplug.h)
+    volatile int64_t lastReconnectUs; // 포트가 빠진 때부터 자동으로 다시 열릴 때까지
+    volatile int64_t maxReconnectUs;
+    volatile int32_t reconfigures;  // 포트를 닫지 않고 회선 설정을 바꾼 횟수
+    volatile int64_t lastReconfigureUs; // 그동안 송신이 멈춘 시간 (남은 송신 비우기 + 설정 적용)
+    volatile int64_t maxReconfigureUs;
+    LatencyHistogram sendLatency;
+    LatencyHistogram receiveLatency;
+    LatencyHistogram oneWayLatency;
+
+    // 수신 링의 바이트가 도착한 시각 (리액터 -> 수신 처리 스레드, 단일 생산자/소비자)
+    uint64_t arrivalEnd[METRICS_ARRIVALS]; // 이 조각까지 링에 넣은 누적 바이트
+    uint64_t arrivalNs[METRICS_ARRIVALS];
+    volatile uint32_t arrivalHead;  // 리액터만 씀
+    volatile uint32_t arrivalTail;  // 수신 처리 스레드만 씀
+    uint64_t pushedBytes;           // 리액터만 씀
+    uint64_t consumedBytes;         // 수신 처리 스레드만 씀
+} ModemMetrics;
+
+typedef struct {
+    int64_t count;
+    double meanUs;
+    uint32_t p50Us;
+    uint32_t p90Us;
+    uint32_t p99Us;
+    uint32_t p999Us;
+    int64_t maxUs;
+} LatencySummary;
+
+struct ModemConfig;
+
+void HistogramRecord(LatencyHistogram* histogram, uint64_t elapsedNs);
+void HistogramSummarize(const LatencyHistogram* histogram, LatencySummary* summary);
+
+// 리액터 스레드: size 바이트를 수신 링에 넣은 직후
+void MetricsRecordArrival(ModemMetrics* metrics, DWORD size);
+// 수신 처리 스레드: 링에서 size 바이트를 꺼낸 직후. 꺼낸 마지막 바이트의 도착 시각을 반환 (모르면 0)
+uint64_t MetricsTakeArrival(ModemMetrics* metrics, DWORD size);
+// 메뉴 스레드: 회선 설정을 제자리에서 바꾼 뒤
+void MetricsRecordReconfigure(ModemMetrics* metrics, uint64_t outageNs);
+
+// 메뉴 출력
+void MetricsPrint(void);
+// path 에 intervalMs 마다 스냅숏을 덧붙이는 스레드
+bool MetricsStartSnapshots(const TCHAR* path, DWORD intervalMs);
+void MetricsStopSnapshots(void);
@@ -0,0 +1,35 @@
+﻿#include "platform.h"
+#include "modem.h"
+
+ModemRegistry modemRegistry;
+
+ModemConfig* FindModem(const TCHAR* id) {
+    if (id == NULL || id[0] == TEXT('\0')) {
+        return NULL;
+    }
+
+    // 숫자로만 이루어져 있으면 목록 번호로 해석
+    TCHAR* end = NULL;
+    long index = _tcstol(id, &end, 10);
+    if (end != NULL && *end == TEXT('\0')) {
+        return index >= 0 && index < modemRegistry.count ? &modemRegistry.modems[index] : NULL;
+    }
+
+    for (int i = 0; i < modemRegistry.count; i++) {
+        if (_tcsicmp(modemRegistry.modems[i].name, id) == 0) {
+            return &modemRegistry.modems[i];
+        }
+    }
+    return NULL;
+}
+
+int ModemIndex(const ModemConfig* modem) {
+    return (int)(modem - modemRegistry.modems);
+}
+
+bool IsValidBaudRate(int baudRate) {
+    // 유효한 보레이트 값들을 확인하는 함수
+    // 표준 속도(9600, 115200, 921600 등)가 아니어도 범위 안이면 받아들인다.
+    // 드라이버가 그 속도를 낼 수 있는지는 포트를 열거나 설정을 바꿀 때 확인한다 (serial.h)
+    return baudRate >= SERIAL_MIN_BAUD_RATE && baudRate <= SERIAL_MAX_BAUD_RATE;
+}
@@ -0,0 +1,61 @@
+﻿#pragma once
+#include "platform.h"
+#include "serial.h"
+#include "ring.h"
+#include "frame.h"
+#include "transmitter.h"
+#include "compress.h"
+#include "emulator.h"
+#include "metrics.h"
+#include "clocksync.h"
+
+#define MAX_PORT_NAME 64
+#define MAX_MODEM_NAME 32
+#define MAX_MODEMS 16
+
+typedef struct ModemConfig {
+    TCHAR portName[MAX_PORT_NAME];
+    int baudRate;
+    int byteSize;
+    int stopBits;
+    int parity;
+    HANDLE hSerial;
+    SerialIo io;
+    TCHAR name[MAX_MODEM_NAME]; // INI 섹션 이름 (모뎀 id)
+    int rxRingSize;             // 수신 링 버퍼 크기 (RxRingSize)
+    SpscRing rxRing;            // 리액터 -> 수신 처리 스레드
+    volatile int32_t driverOverruns; // 드라이버가 보고한 수신 오버런 (CE_OVERRUN/CE_RXOVER)
+    int framing;                // FRAMING_RAW / FRAMING_COBS (Framing)
+    FrameParser rxFrame;        // 수신 처리 스레드만 사용
+    TxQueue txQueue;            // 송신 큐와 송신 스레드
+    int arqWindow;              // ARQ 창 크기 (ArqWindow)
+    int arqTimeoutMs;           // ARQ 재전송 타이머 (ArqTimeoutMs)
+    int fecData;                // FEC 블록당 데이터 조각 수 K (FecRate=K/N, 0 이면 사용 안 함)
+    int fecParity;              // FEC 블록당 패리티 조각 수 N-K
+    int compression;            // COMPRESS_NONE / COMPRESS_LZ (Compression)
+    volatile int32_t peerCompression; // 상대와 협상된 압축 (HELLO 를 받기 전에는 COMPRESS_NONE)
+    CompressStats compress;
+    int linkRate;               // 매체의 실제 전송 속도 bps (LinkRate, 링크 선택용. 기본값은 BaudRate)
+    bool linkRateSet;           // LinkRate 를 직접 지정함. 아니면(LinkRate=0) BaudRate 가 바뀔 때 따라감
+    bool autoBaud;              // BaudRate=auto: 열 때마다 탐색 스레드(autobaud.c)가 상대가 답하는 속도를 찾음
+    int autoBaudMs;             // BaudRate=auto 에서 한 속도마다 응답을 기다리는 시간 (AutoBaudMs)
+    TCHAR emulator[MAX_EMULATOR_SPEC]; // Port=EMU:... 일 때 보내는 방향의 매체 프로파일 (Emulator)
+    int txWeights[TX_CLASSES];  // 송신 등급별 라운드당 조각 수 (TxWeights, 모두 0 이면 엄격한 우선순위)
+    int timestamps;             // 1 이면 시계를 동기화하고 보내는 프레임에 보낸 시각을 붙임 (Timestamps)
+    ClockSync clock;            // 상대 시계와의 차이, 단방향 지연과 지터
+    ModemMetrics metrics;       // 송수신 카운터와 지연 히스토그램
+} ModemConfig;
+
+// INI 파일의 섹션마다 하나씩 만들어지는 모뎀 목록
+typedef struct {
+    ModemConfig modems[MAX_MODEMS];
+    int count;
+} ModemRegistry;
+
+extern ModemRegistry modemRegistry;
+
+// 번호("0") 또는 섹션 이름("LightModem")으로 모뎀을 찾는다
+ModemConfig* FindModem(const TCHAR* id);
+int ModemIndex(const ModemConfig* modem);
+// BaudRate 로 쓸 수 있는 속도인지 (설정 검증, 벤치마크 속도 목록)
+bool IsValidBaudRate(int baudRate);
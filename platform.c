@@ -0,0 +1,242 @@
+﻿#include "platform.h"
+
+#ifdef _WIN32
+
+uint64_t PlatformNowNs(void) {
+    static LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    // 오버플로를 피하기 위해 초 단위와 나머지를 나눠서 변환
+    uint64_t seconds = (uint64_t)(counter.QuadPart / frequency.QuadPart);
+    uint64_t remainder = (uint64_t)(counter.QuadPart % frequency.QuadPart);
+    return seconds * 1000000000ULL + remainder * 1000000000ULL / (uint64_t)frequency.QuadPart;
+}
+
+uint64_t PlatformCpuTimeNs(void) {
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    // FILETIME 은 100ns 단위
+    uint64_t kernelTicks = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    uint64_t userTicks = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (kernelTicks + userTicks) * 100ULL;
+}
+
+void PlatformSleepMs(DWORD milliseconds) {
+    Sleep(milliseconds);
+}
+
+bool PlatformThreadStart(PlatformThread* thread, PlatformThreadProc proc, LPVOID param) {
+    *thread = CreateThread(NULL, 0, proc, param, 0, NULL);
+    return *thread != NULL;
+}
+
+void PlatformThreadJoin(PlatformThread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+void PlatformMutexInit(PlatformMutex* mutex) {
+    InitializeSRWLock(mutex);
+}
+
+void PlatformMutexDestroy(PlatformMutex* mutex) {
+    (void)mutex; // SRWLOCK 는 해제할 자원이 없음
+}
+
+void PlatformMutexLock(PlatformMutex* mutex) {
+    AcquireSRWLockExclusive(mutex);
+}
+
+void PlatformMutexUnlock(PlatformMutex* mutex) {
+    ReleaseSRWLockExclusive(mutex);
+}
+
+void PlatformCondInit(PlatformCond* cond) {
+    InitializeConditionVariable(cond);
+}
+
+void PlatformCondDestroy(PlatformCond* cond) {
+    (void)cond;
+}
+
+bool PlatformCondWait(PlatformCond* cond, PlatformMutex* mutex, DWORD timeoutMs) {
+    return SleepConditionVariableSRW(cond, mutex, timeoutMs, 0) != FALSE;
+}
+
+void PlatformCondSignal(PlatformCond* cond) {
+    WakeConditionVariable(cond);
+}
+
+void PlatformCondBroadcast(PlatformCond* cond) {
+    WakeAllConditionVariable(cond);
+}
+
+bool PlatformEventInit(PlatformEvent* event) {
+    *event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    return *event != NULL;
+}
+
+void PlatformEventDestroy(PlatformEvent* event) {
+    if (*event != NULL) {
+        CloseHandle(*event);
+        *event = NULL;
+    }
+}
+
+void PlatformEventSet(PlatformEvent* event) {
+    SetEvent(*event);
+}
+
+bool PlatformEventWait(PlatformEvent* event, DWORD timeoutMs) {
+    return WaitForSingleObject(*event, timeoutMs) == WAIT_OBJECT_0;
+}
+
+#else
+
+uint64_t PlatformNowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t PlatformCpuTimeNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void PlatformSleepMs(DWORD milliseconds) {
+    struct timespec ts;
+    ts.tv_sec = milliseconds / 1000;
+    ts.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+typedef struct {
+    PlatformThreadProc proc;
+    LPVOID param;
+} ThreadStart;
+
+static void* ThreadTrampoline(void* arg) {
+    ThreadStart start = *(ThreadStart*)arg;
+    free(arg);
+    start.proc(start.param);
+    return NULL;
+}
+
+bool PlatformThreadStart(PlatformThread* thread, PlatformThreadProc proc, LPVOID param) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (start == NULL) {
+        return false;
+    }
+    start->proc = proc;
+    start->param = param;
+    if (pthread_create(thread, NULL, ThreadTrampoline, start) != 0) {
+        free(start);
+        return false;
+    }
+    return true;
+}
+
+void PlatformThreadJoin(PlatformThread thread) {
+    pthread_join(thread, NULL);
+}
+
+void PlatformMutexInit(PlatformMutex* mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+void PlatformMutexDestroy(PlatformMutex* mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+void PlatformMutexLock(PlatformMutex* mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void PlatformMutexUnlock(PlatformMutex* mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void PlatformCondInit(PlatformCond* cond) {
+    // 시간 초과 대기가 시스템 시각 변경의 영향을 받지 않도록 단조 시계 사용
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+void PlatformCondDestroy(PlatformCond* cond) {
+    pthread_cond_destroy(cond);
+}
+
+bool PlatformCondWait(PlatformCond* cond, PlatformMutex* mutex, DWORD timeoutMs) {
+    if (timeoutMs == INFINITE) {
+        return pthread_cond_wait(cond, mutex) == 0;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(cond, mutex, &deadline) == 0;
+}
+
+void PlatformCondSignal(PlatformCond* cond) {
+    pthread_cond_signal(cond);
+}
+
+void PlatformCondBroadcast(PlatformCond* cond) {
+    pthread_cond_broadcast(cond);
+}
+
+bool PlatformEventInit(PlatformEvent* event) {
+    PlatformMutexInit(&event->mutex);
+    PlatformCondInit(&event->cond);
+    event->signaled = false;
+    return true;
+}
+
+void PlatformEventDestroy(PlatformEvent* event) {
+    PlatformCondDestroy(&event->cond);
+    PlatformMutexDestroy(&event->mutex);
+}
+
+void PlatformEventSet(PlatformEvent* event) {
+    PlatformMutexLock(&event->mutex);
+    event->signaled = true;
+    PlatformCondSignal(&event->cond);
+    PlatformMutexUnlock(&event->mutex);
+}
+
+bool PlatformEventWait(PlatformEvent* event, DWORD timeoutMs) {
+    PlatformMutexLock(&event->mutex);
+    uint64_t deadline = PlatformNowNs() + (uint64_t)timeoutMs * 1000000ULL;
+    while (!event->signaled) {
+        if (timeoutMs == INFINITE) {
+            PlatformCondWait(&event->cond, &event->mutex, INFINITE);
+            continue;
+        }
+        uint64_t now = PlatformNowNs();
+        if (now >= deadline) {
+            break;
+        }
+        PlatformCondWait(&event->cond, &event->mutex, (DWORD)((deadline - now + 999999) / 1000000));
+    }
+    bool signaled = event->signaled;
+    event->signaled = false;
+    PlatformMutexUnlock(&event->mutex);
+    return signaled;
+}
+
+#endif
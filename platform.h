@@ -0,0 +1,190 @@
+﻿#pragma once
+// 플랫폼 추상화 계층
+// Windows 빌드는 Win32 API를 그대로 사용하고, POSIX(리눅스) 빌드에서는 기존 코드가 쓰는
+// TCHAR 매크로와 Win32 타입을 최소한으로 흉내 낸다.
+// POSIX 빌드 예: cc -O2 -o uhsdm *.c -lpthread
+
+#ifdef _WIN32
+
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+#include <windows.h>
+#include <tchar.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATH_SEPARATOR TEXT('\\')
+#define SERIAL_PORT_PREFIX TEXT("COM")
+#define DEFAULT_ACOUSTIC_PORT TEXT("COM4")
+#define DEFAULT_LIGHT_PORT TEXT("COM6")
+
+#else
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef char TCHAR;
+#define TEXT(x) x
+#define _T(x) x
+#define _tmain main
+
+#define _tprintf printf
+#define _ftprintf fprintf
+#define _stprintf sprintf
+#define _sntprintf snprintf
+#define _stscanf sscanf
+#define _tscanf scanf
+#define _tfopen fopen
+#define _tremove remove
+#define _trename rename
+#define _fgetts fgets
+#define _gettchar getchar
+#define _tcslen strlen
+#define _tcscpy strcpy
+#define _tcsncpy strncpy
+#define _tcscat strcat
+#define _tcscmp strcmp
+#define _tcsicmp strcasecmp
+#define _tcsncmp strncmp
+#define _tcsstr strstr
+#define _tcschr strchr
+#define _tcsrchr strrchr
+#define _tcstoul strtoul
+#define _tcstol strtol
+#define _tcstod strtod
+#define _ttoi atoi
+
+typedef uint8_t BYTE;
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef void* LPVOID;
+typedef intptr_t HANDLE; // POSIX 빌드에서는 파일 디스크립터를 담는다
+#define WINAPI
+#define INFINITE 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)-1)
+#ifndef MAX_PATH
+#define MAX_PATH 4096
+#endif
+
+#define CBR_9600 9600
+#define CBR_19200 19200
+#define CBR_38400 38400
+#define CBR_57600 57600
+#define CBR_115200 115200
+
+#define NOPARITY 0
+#define ODDPARITY 1
+#define EVENPARITY 2
+#define ONESTOPBIT 0
+#define TWOSTOPBITS 2
+
+#define PATH_SEPARATOR '/'
+#define SERIAL_PORT_PREFIX "/dev/"
+#define DEFAULT_ACOUSTIC_PORT "/dev/ttyUSB0"
+#define DEFAULT_LIGHT_PORT "/dev/ttyUSB1"
+
+#endif
+
+#include <stdbool.h>
+
+// 정적 변수를 n 바이트 경계에 둔다 (선언 앞에 씀)
+#ifdef _WIN32
+#define PLATFORM_ALIGN(n) __declspec(align(n))
+#else
+#define PLATFORM_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+// 단조 증가 시계 (나노초). 지연 시간 측정용
+uint64_t PlatformNowNs(void);
+// 프로세스 전체(모든 스레드)가 사용한 CPU 시간 (나노초, user + kernel). 벤치마크용
+uint64_t PlatformCpuTimeNs(void);
+void PlatformSleepMs(DWORD milliseconds);
+
+// 스레드
+#ifdef _WIN32
+typedef HANDLE PlatformThread;
+#else
+typedef pthread_t PlatformThread;
+#endif
+typedef DWORD (WINAPI* PlatformThreadProc)(LPVOID param);
+bool PlatformThreadStart(PlatformThread* thread, PlatformThreadProc proc, LPVOID param);
+void PlatformThreadJoin(PlatformThread thread);
+
+// 뮤텍스 / 조건 변수
+#ifdef _WIN32
+typedef SRWLOCK PlatformMutex;
+typedef CONDITION_VARIABLE PlatformCond;
+#else
+typedef pthread_mutex_t PlatformMutex;
+typedef pthread_cond_t PlatformCond;
+#endif
+void PlatformMutexInit(PlatformMutex* mutex);
+void PlatformMutexDestroy(PlatformMutex* mutex);
+void PlatformMutexLock(PlatformMutex* mutex);
+void PlatformMutexUnlock(PlatformMutex* mutex);
+void PlatformCondInit(PlatformCond* cond);
+void PlatformCondDestroy(PlatformCond* cond);
+// timeoutMs 가 INFINITE 가 아니면 시간 초과 시 false 를 반환
+bool PlatformCondWait(PlatformCond* cond, PlatformMutex* mutex, DWORD timeoutMs);
+void PlatformCondSignal(PlatformCond* cond);
+void PlatformCondBroadcast(PlatformCond* cond);
+
+// 자동 리셋 이벤트 (Set 은 블록하지 않음)
+#ifdef _WIN32
+typedef HANDLE PlatformEvent;
+#else
+typedef struct {
+    PlatformMutex mutex;
+    PlatformCond cond;
+    bool signaled;
+} PlatformEvent;
+#endif
+bool PlatformEventInit(PlatformEvent* event);
+void PlatformEventDestroy(PlatformEvent* event);
+void PlatformEventSet(PlatformEvent* event);
+// 신호를 받으면 true, 시간 초과면 false
+bool PlatformEventWait(PlatformEvent* event, DWORD timeoutMs);
+
+// 스레드 간에 공유하는 카운터/플래그용 원자적 연산
+#ifdef _WIN32
+#define AtomicLoadAcquire32(p) ((int32_t)ReadAcquire((volatile LONG*)(p)))
+#define AtomicStoreRelease32(p, v) WriteRelease((volatile LONG*)(p), (LONG)(v))
+#define AtomicIncrement32(p) ((int32_t)InterlockedIncrement((volatile LONG*)(p)))
+#define AtomicDecrement32(p) ((int32_t)InterlockedDecrement((volatile LONG*)(p)))
+#define AtomicExchange32(p, v) ((int32_t)InterlockedExchange((volatile LONG*)(p), (LONG)(v)))
+#define AtomicLoadAcquire64(p) ((int64_t)ReadAcquire64((volatile LONG64*)(p)))
+#define AtomicStoreRelease64(p, v) WriteRelease64((volatile LONG64*)(p), (LONG64)(v))
+#define AtomicCompareExchange32(p, expected, desired) \
+    (InterlockedCompareExchange((volatile LONG*)(p), (LONG)(desired), (LONG)(expected)) == (LONG)(expected))
+#define AtomicCompareExchange64(p, expected, desired) \
+    (InterlockedCompareExchange64((volatile LONG64*)(p), (LONG64)(desired), (LONG64)(expected)) == (LONG64)(expected))
+// 통계 카운터용 (순서 보장 없음)
+#define AtomicAddRelaxed32(p, v) ((void)InterlockedExchangeAddNoFence((volatile LONG*)(p), (LONG)(v)))
+#define AtomicAddRelaxed64(p, v) ((void)InterlockedExchangeAddNoFence64((volatile LONG64*)(p), (LONG64)(v)))
+#else
+#define AtomicLoadAcquire32(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define AtomicStoreRelease32(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define AtomicIncrement32(p) __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define AtomicDecrement32(p) __atomic_sub_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define AtomicExchange32(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define AtomicLoadAcquire64(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define AtomicStoreRelease64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define AtomicCompareExchange32(p, expected, desired) __sync_bool_compare_and_swap((p), (expected), (desired))
+#define AtomicCompareExchange64(p, expected, desired) __sync_bool_compare_and_swap((p), (expected), (desired))
+#define AtomicAddRelaxed32(p, v) ((void)__atomic_fetch_add((p), (v), __ATOMIC_RELAXED))
+#define AtomicAddRelaxed64(p, v) ((void)__atomic_fetch_add((p), (v), __ATOMIC_RELAXED))
+#endif
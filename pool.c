@@ -0,0 +1,149 @@
+﻿#include "platform.h"
+#include "pool.h"
+
+#define POOL_HEAP_CLASS 0xFF
+
+// 블록 머리. 데이터가 16 바이트 경계에 오도록 16 바이트
+typedef struct {
+    volatile int32_t refs;
+    volatile uint32_t next;     // 자유 목록에서 다음 블록 번호 + 1 (0 = 끝)
+    uint32_t index;             // 등급 안에서의 번호
+    uint32_t sizeClass;         // 0..POOL_CLASSES-1, 힙이면 POOL_HEAP_CLASS
+} PoolBlock;
+
+#define POOL_STRIDE(size) (sizeof(PoolBlock) + (size))
+
+// 블록 머리와 크기가 모두 16 의 배수이므로 영역이 16 바이트 경계에서 시작하면 모든 블록의 데이터도 16 바이트 경계
+static PLATFORM_ALIGN(16) uint64_t smallArena[POOL_SMALL_COUNT * POOL_STRIDE(POOL_SMALL_SIZE) / 8];
+static PLATFORM_ALIGN(16) uint64_t mediumArena[POOL_MEDIUM_COUNT * POOL_STRIDE(POOL_MEDIUM_SIZE) / 8];
+static PLATFORM_ALIGN(16) uint64_t largeArena[POOL_LARGE_COUNT * POOL_STRIDE(POOL_LARGE_SIZE) / 8];
+
+typedef struct {
+    BYTE* arena;
+    DWORD size;
+    uint32_t count;
+} PoolClass;
+
+static const PoolClass poolClasses[POOL_CLASSES] = {
+    { (BYTE*)smallArena, POOL_SMALL_SIZE, POOL_SMALL_COUNT },
+    { (BYTE*)mediumArena, POOL_MEDIUM_SIZE, POOL_MEDIUM_COUNT },
+    { (BYTE*)largeArena, POOL_LARGE_SIZE, POOL_LARGE_COUNT },
+};
+
+// 자유 목록은 등급마다 락 없는 스택. 하위 32 비트가 맨 위 블록 번호 + 1, 상위 32 비트는 ABA 를 막는 세대
+// 영역은 정적이라 다른 스레드가 막 꺼낸 블록의 next 를 읽어도 안전하고, 그 경우 세대가 달라 교환이 실패한다.
+// 아직 한 번도 나눠 주지 않은 블록은 자유 목록 대신 fresh 로 순서대로 꺼낸다 (초기화 불필요)
+// 생산자와 송신 스레드가 서로 다른 캐시 라인을 두고 갱신하도록 등급과 카운터를 떼어 둔다
+typedef struct {
+    volatile int64_t freeHead;
+    volatile int32_t used;      // fresh 로 꺼낸 블록 수 (동시에 가장 많이 쓴 수와 같음)
+    BYTE pad[52];
+} PoolFreeList;
+
+static struct {
+    PoolFreeList lists[POOL_CLASSES];
+    volatile int64_t allocs;
+    BYTE padAllocs[56];
+    volatile int64_t releases;
+    BYTE padReleases[56];
+    volatile int64_t heapAllocs;
+} pool;
+
+static PoolBlock* BlockAt(int sizeClass, uint32_t index) {
+    const PoolClass* c = &poolClasses[sizeClass];
+    return (PoolBlock*)(c->arena + (size_t)index * POOL_STRIDE(c->size));
+}
+
+static PoolBlock* PopFree(int sizeClass) {
+    volatile int64_t* head = &pool.lists[sizeClass].freeHead;
+    for (;;) {
+        int64_t top = AtomicLoadAcquire64(head);
+        uint32_t slot = (uint32_t)top;
+        if (slot == 0) {
+            break;
+        }
+        PoolBlock* block = BlockAt(sizeClass, slot - 1);
+        int64_t next = (int64_t)((((uint64_t)top >> 32) + 1) << 32 | block->next);
+        if (AtomicCompareExchange64(head, top, next)) {
+            return block;
+        }
+    }
+    // 자유 목록이 비었으면 아직 쓰지 않은 블록
+    volatile int32_t* used = &pool.lists[sizeClass].used;
+    for (;;) {
+        int32_t index = AtomicLoadAcquire32(used);
+        if ((uint32_t)index >= poolClasses[sizeClass].count) {
+            return NULL;
+        }
+        if (AtomicCompareExchange32(used, index, index + 1)) {
+            PoolBlock* block = BlockAt(sizeClass, (uint32_t)index);
+            block->index = (uint32_t)index;
+            block->sizeClass = (uint32_t)sizeClass;
+            return block;
+        }
+    }
+}
+
+static void PushFree(PoolBlock* block) {
+    volatile int64_t* head = &pool.lists[block->sizeClass].freeHead;
+    for (;;) {
+        int64_t top = AtomicLoadAcquire64(head);
+        block->next = (uint32_t)top;
+        int64_t next = (int64_t)((((uint64_t)top >> 32) + 1) << 32 | (block->index + 1));
+        if (AtomicCompareExchange64(head, top, next)) {
+            return;
+        }
+    }
+}
+
+BYTE* PoolAlloc(DWORD size) {
+    // 맞는 가장 작은 등급에서만 꺼냄 (작은 메시지가 큰 블록을 차지하지 않도록)
+    PoolBlock* block = NULL;
+    for (int c = 0; c < POOL_CLASSES; c++) {
+        if (size <= poolClasses[c].size) {
+            block = PopFree(c);
+            break;
+        }
+    }
+    if (block == NULL) {
+        block = (PoolBlock*)malloc(sizeof(PoolBlock) + size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->sizeClass = POOL_HEAP_CLASS;
+        AtomicAddRelaxed64(&pool.heapAllocs, 1);
+    }
+    block->refs = 1;
+    AtomicAddRelaxed64(&pool.allocs, 1);
+    return (BYTE*)(block + 1);
+}
+
+void PoolRetain(BYTE* data) {
+    AtomicIncrement32(&((PoolBlock*)data - 1)->refs);
+}
+
+void PoolRelease(BYTE* data) {
+    if (data == NULL) {
+        return;
+    }
+    PoolBlock* block = (PoolBlock*)data - 1;
+    if (AtomicDecrement32(&block->refs) != 0) {
+        return;
+    }
+    AtomicAddRelaxed64(&pool.releases, 1);
+    if (block->sizeClass == POOL_HEAP_CLASS) {
+        free(block);
+    }
+    else {
+        PushFree(block);
+    }
+}
+
+void PoolQueryStats(PoolStats* stats) {
+    stats->allocs = AtomicLoadAcquire64(&pool.allocs);
+    stats->heapAllocs = AtomicLoadAcquire64(&pool.heapAllocs);
+    stats->inUse = (int32_t)(stats->allocs - AtomicLoadAcquire64(&pool.releases));
+    for (int c = 0; c < POOL_CLASSES; c++) {
+        stats->classUsed[c] = AtomicLoadAcquire32(&pool.lists[c].used);
+    }
+}
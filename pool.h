@@ -0,0 +1,31 @@
+﻿#pragma once
+#include "platform.h"
+
+// 참조 계수가 붙은 고정 크기 버퍼 풀
+// 송수신 경로가 메시지마다 malloc/free 하지 않도록 크기 등급별로 미리 잡아 둔 정적 영역에서 블록을 나눠 준다.
+// 블록은 PoolAlloc 으로 참조 1 개를 가진 채 받고, 다른 계층이 같은 데이터를 붙잡아야 하면 PoolRetain 으로
+// 참조를 더한다. 마지막 PoolRelease 에서 등급의 자유 목록으로 돌아간다 (락 없음, 어느 스레드에서나 호출).
+// 맞는 등급이 바닥나거나 가장 큰 등급보다 크면 같은 머리를 붙여 힙에서 잡고 heapAllocs 로 센다.
+// 그래서 호출하는 쪽은 블록이 어디서 왔는지 몰라도 되고, 풀이 모자란지는 통계로 알 수 있다.
+
+#define POOL_SMALL_SIZE 256
+#define POOL_MEDIUM_SIZE 1280                   // ARQ 조각 (머리 + 1 KB)
+#define POOL_LARGE_SIZE (4096 + 256)            // 프레임 하나 (FRAME_MAX_PAYLOAD) + 송신 메시지 머리
+#define POOL_SMALL_COUNT 2048
+#define POOL_MEDIUM_COUNT 1024
+#define POOL_LARGE_COUNT 512
+#define POOL_CLASSES 3
+
+typedef struct {
+    int64_t allocs;         // PoolAlloc 호출 수
+    int64_t heapAllocs;     // 풀에서 주지 못해 힙에서 잡은 수
+    int32_t inUse;          // 놓이지 않은 블록 (힙 포함)
+    int32_t classUsed[POOL_CLASSES]; // 등급별로 동시에 가장 많이 쓴 블록 수 (최대 *_COUNT)
+} PoolStats;
+
+// size 바이트 이상을 담는 블록의 데이터 주소. 참조 1 개를 가진다. 힙도 모자라면 NULL
+BYTE* PoolAlloc(DWORD size);
+void PoolRetain(BYTE* data);
+// NULL 이면 아무것도 하지 않음
+void PoolRelease(BYTE* data);
+void PoolQueryStats(PoolStats* stats);
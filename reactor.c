@@ -0,0 +1,513 @@
+﻿#include "platform.h"
+#include "reactor.h"
+
+#ifndef _WIN32
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#define REACTOR_MAX_EVENTS 16
+
+#define REACTOR_CMD_NONE 0
+#define REACTOR_CMD_ADD 1
+#define REACTOR_CMD_REMOVE 2
+#define REACTOR_CMD_STOP 3
+#define REACTOR_CMD_RESIZE 4
+
+typedef struct {
+    ModemConfig* modem;
+    bool inUse;
+    bool removing;
+    bool failed;
+#ifdef _WIN32
+    OVERLAPPED ovWait; // WaitCommEvent (EV_RXCHAR | EV_ERR)
+    OVERLAPPED ovRead; // 큐에 쌓인 바이트 읽기
+    DWORD waitMask;
+    int pending;       // 완료되지 않은 중첩 I/O 수
+#endif
+    BYTE* buffer;      // 보레이트에 맞춘 크기 (ReadSize). 자리를 다시 쓰거나 속도가 바뀌어 모자라면 늘림
+    DWORD bufferSize;
+    DWORD readSize;    // 한 번에 읽는 크기. bufferSize 보다 크면 다음 읽기 전에 버퍼를 늘림
+} ReactorPort;
+
+static struct {
+    ReactorPort ports[MAX_MODEMS];
+    ReactorReceiveProc onReceive;
+    ReactorErrorProc onError;
+    PlatformThread thread;
+    bool running;
+    bool stopping;
+
+    // 다른 스레드의 요청(추가/해제/종료)은 리액터 스레드에서 실행하고 완료를 기다린다
+    PlatformMutex callLock;
+    PlatformMutex lock;
+    PlatformCond done;
+    int command;
+    ModemConfig* commandModem;
+    bool commandResult;
+    bool commandDone;
+
+#ifdef _WIN32
+    HANDLE iocp;
+#else
+    int epollFd;
+    int commandFd;
+#endif
+} reactor;
+
+static ReactorPort* FindPort(const ModemConfig* modem) {
+    for (int i = 0; i < MAX_MODEMS; i++) {
+        if (reactor.ports[i].inUse && reactor.ports[i].modem == modem) {
+            return &reactor.ports[i];
+        }
+    }
+    return NULL;
+}
+
+// 읽기 한 번의 크기: 보레이트로 SERIAL_QUEUE_MS 동안 받는 양이되 수신 링보다 크게 읽지 않음
+// (한 번의 읽기가 링을 넘쳐 버려지지 않도록)
+static DWORD ReadSize(const ModemConfig* modem) {
+    DWORD size = SerialBufferSize(modem->baudRate);
+    DWORD ring = modem->rxRing.capacity;
+    return ring > 0 && ring < size ? ring : size;
+}
+
+// readSize 에 맞게 버퍼를 늘림 (리액터 스레드, 이 버퍼로 진행 중인 읽기가 없을 때). 실패하면 지금 버퍼를 그대로 씀
+static void GrowBuffer(ReactorPort* port) {
+    BYTE* buffer = (BYTE*)malloc(port->readSize);
+    if (buffer == NULL) {
+        port->readSize = port->bufferSize;
+        return;
+    }
+    free(port->buffer);
+    port->buffer = buffer;
+    port->bufferSize = port->readSize;
+}
+
+static ReactorPort* AllocPort(ModemConfig* modem) {
+    for (int i = 0; i < MAX_MODEMS; i++) {
+        if (!reactor.ports[i].inUse) {
+            ReactorPort* port = &reactor.ports[i];
+            BYTE* buffer = port->buffer;
+            DWORD bufferSize = port->bufferSize;
+            DWORD needed = ReadSize(modem);
+            if (bufferSize < needed) {
+                free(buffer);
+                buffer = (BYTE*)malloc(needed);
+                bufferSize = buffer != NULL ? needed : 0;
+            }
+            memset(port, 0, sizeof(*port));
+            port->buffer = buffer;
+            port->bufferSize = bufferSize;
+            port->readSize = needed;
+            if (buffer == NULL) {
+                return NULL;
+            }
+            port->modem = modem;
+            port->inUse = true;
+            return port;
+        }
+    }
+    return NULL;
+}
+
+// 리액터 스레드가 끝난 뒤 읽기 버퍼 해제
+static void FreeBuffers(void) {
+    for (int i = 0; i < MAX_MODEMS; i++) {
+        free(reactor.ports[i].buffer);
+        reactor.ports[i].buffer = NULL;
+        reactor.ports[i].bufferSize = 0;
+    }
+}
+
+static void CompleteCommand(bool result) {
+    PlatformMutexLock(&reactor.lock);
+    reactor.command = REACTOR_CMD_NONE;
+    reactor.commandResult = result;
+    reactor.commandDone = true;
+    PlatformCondBroadcast(&reactor.done);
+    PlatformMutexUnlock(&reactor.lock);
+}
+
+static void WakeReactor(void);
+
+static bool SubmitCommand(int command, ModemConfig* modem) {
+    PlatformMutexLock(&reactor.callLock);
+    PlatformMutexLock(&reactor.lock);
+    reactor.command = command;
+    reactor.commandModem = modem;
+    reactor.commandDone = false;
+    PlatformMutexUnlock(&reactor.lock);
+
+    WakeReactor();
+
+    PlatformMutexLock(&reactor.lock);
+    while (!reactor.commandDone) {
+        PlatformCondWait(&reactor.done, &reactor.lock, INFINITE);
+    }
+    bool result = reactor.commandResult;
+    PlatformMutexUnlock(&reactor.lock);
+    PlatformMutexUnlock(&reactor.callLock);
+    return result;
+}
+
+static void FailPort(ReactorPort* port, DWORD errorCode);
+static bool AttachPort(ReactorPort* port);
+static bool DetachPort(ReactorPort* port);
+
+// 리액터 스레드에서 요청 실행
+static void HandleCommand(void) {
+    PlatformMutexLock(&reactor.lock);
+    int command = reactor.command;
+    ModemConfig* modem = reactor.commandModem;
+    PlatformMutexUnlock(&reactor.lock);
+
+    switch (command) {
+    case REACTOR_CMD_ADD: {
+        ReactorPort* port = FindPort(modem) ? NULL : AllocPort(modem);
+        if (port == NULL) {
+            CompleteCommand(false);
+        }
+        else if (!AttachPort(port)) {
+            port->inUse = false;
+            CompleteCommand(false);
+        }
+        else {
+            CompleteCommand(true);
+        }
+        break;
+    }
+    case REACTOR_CMD_REMOVE: {
+        ReactorPort* port = FindPort(modem);
+        if (port == NULL || DetachPort(port)) {
+            CompleteCommand(true);
+        }
+        // 그 외에는 진행 중인 I/O가 모두 끝난 뒤 완료 (Windows)
+        break;
+    }
+    case REACTOR_CMD_RESIZE: {
+        // 버퍼는 다음 읽기 전에 늘림 (Windows 는 진행 중인 읽기가 지금 버퍼를 쓰고 있을 수 있음)
+        ReactorPort* port = FindPort(modem);
+        if (port != NULL) {
+            port->readSize = ReadSize(modem);
+        }
+        CompleteCommand(true);
+        break;
+    }
+    case REACTOR_CMD_STOP: {
+        reactor.stopping = true;
+        bool idle = true;
+        for (int i = 0; i < MAX_MODEMS; i++) {
+            if (reactor.ports[i].inUse && !DetachPort(&reactor.ports[i])) {
+                idle = false;
+            }
+        }
+        if (idle) {
+            reactor.running = false;
+            CompleteCommand(true);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+#ifdef _WIN32
+
+static void WakeReactor(void) {
+    PostQueuedCompletionStatus(reactor.iocp, 0, 0, NULL);
+}
+
+// 큐에 데이터가 있으면 읽기, 없으면 EV_RXCHAR/EV_ERR 대기를 건다
+static void ArmPort(ReactorPort* port) {
+    HANDLE hSerial = port->modem->hSerial;
+    DWORD errors = 0;
+    COMSTAT status = { 0 };
+    if (!ClearCommError(hSerial, &errors, &status)) {
+        FailPort(port, GetLastError());
+        return;
+    }
+    if (errors & (CE_OVERRUN | CE_RXOVER)) {
+        AtomicIncrement32(&port->modem->driverOverruns);
+    }
+    if (errors & (CE_FRAME | CE_RXPARITY | CE_BREAK)) {
+        AtomicAddRelaxed32(&port->modem->metrics.driverErrors, 1);
+    }
+
+    if (status.cbInQue > 0) {
+        if (port->readSize > port->bufferSize) {
+            GrowBuffer(port);
+        }
+        DWORD readSize = port->readSize < port->bufferSize ? port->readSize : port->bufferSize;
+        DWORD toRead = status.cbInQue < readSize ? status.cbInQue : readSize;
+        ZeroMemory(&port->ovRead, sizeof(port->ovRead));
+        if (!ReadFile(hSerial, port->buffer, toRead, NULL, &port->ovRead) && GetLastError() != ERROR_IO_PENDING) {
+            FailPort(port, GetLastError());
+            return;
+        }
+    }
+    else {
+        port->waitMask = 0;
+        ZeroMemory(&port->ovWait, sizeof(port->ovWait));
+        if (!WaitCommEvent(hSerial, &port->waitMask, &port->ovWait) && GetLastError() != ERROR_IO_PENDING) {
+            FailPort(port, GetLastError());
+            return;
+        }
+    }
+    // 즉시 완료되어도 IOCP 로 완료 패킷이 온다
+    port->pending++;
+}
+
+static bool AttachPort(ReactorPort* port) {
+    if (CreateIoCompletionPort(port->modem->hSerial, reactor.iocp, (ULONG_PTR)port, 0) == NULL) {
+        return false;
+    }
+    ArmPort(port);
+    return true;
+}
+
+// 진행 중인 I/O를 취소. 즉시 해제할 수 있으면 true
+static bool DetachPort(ReactorPort* port) {
+    port->removing = true;
+    if (port->pending > 0) {
+        CancelIoEx(port->modem->hSerial, &port->ovWait);
+        CancelIoEx(port->modem->hSerial, &port->ovRead);
+        return false;
+    }
+    port->inUse = false;
+    return true;
+}
+
+static void FailPort(ReactorPort* port, DWORD errorCode) {
+    port->failed = true;
+    AtomicAddRelaxed32(&port->modem->metrics.portErrors, 1);
+    if (reactor.onError) {
+        reactor.onError(port->modem, errorCode);
+    }
+}
+
+static void OnCompletion(ReactorPort* port, OVERLAPPED* overlapped) {
+    DWORD transferred = 0;
+    BOOL ok = GetOverlappedResult(port->modem->hSerial, overlapped, &transferred, FALSE);
+    DWORD errorCode = ok ? ERROR_SUCCESS : GetLastError();
+    port->pending--;
+
+    if (port->removing) {
+        if (port->pending == 0) {
+            port->inUse = false;
+            if (reactor.stopping) {
+                // 모든 포트가 정리되면 종료
+                bool idle = true;
+                for (int i = 0; i < MAX_MODEMS; i++) {
+                    idle = idle && !reactor.ports[i].inUse;
+                }
+                if (idle) {
+                    reactor.running = false;
+                    CompleteCommand(true);
+                }
+            }
+            else {
+                CompleteCommand(true);
+            }
+        }
+        return;
+    }
+
+    if (!ok) {
+        FailPort(port, errorCode);
+        return;
+    }
+    if (overlapped == &port->ovRead && transferred > 0 && reactor.onReceive) {
+        reactor.onReceive(port->modem, port->buffer, transferred);
+    }
+    ArmPort(port);
+}
+
+static DWORD WINAPI ReactorThread(LPVOID param) {
+    (void)param;
+    OVERLAPPED_ENTRY entries[REACTOR_MAX_EVENTS];
+
+    while (reactor.running) {
+        ULONG count = 0;
+        if (!GetQueuedCompletionStatusEx(reactor.iocp, entries, REACTOR_MAX_EVENTS, &count, INFINITE, FALSE)) {
+            break;
+        }
+        for (ULONG i = 0; i < count; i++) {
+            if (entries[i].lpOverlapped == NULL) {
+                HandleCommand();
+            }
+            else {
+                OnCompletion((ReactorPort*)entries[i].lpCompletionKey, entries[i].lpOverlapped);
+            }
+        }
+    }
+    return 0;
+}
+
+bool ReactorStart(ReactorReceiveProc onReceive, ReactorErrorProc onError) {
+    memset(&reactor, 0, sizeof(reactor));
+    reactor.onReceive = onReceive;
+    reactor.onError = onError;
+    reactor.iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (reactor.iocp == NULL) {
+        return false;
+    }
+    PlatformMutexInit(&reactor.callLock);
+    PlatformMutexInit(&reactor.lock);
+    PlatformCondInit(&reactor.done);
+    reactor.running = true;
+    if (!PlatformThreadStart(&reactor.thread, ReactorThread, NULL)) {
+        CloseHandle(reactor.iocp);
+        reactor.running = false;
+        return false;
+    }
+    return true;
+}
+
+void ReactorStop(void) {
+    if (!reactor.running) {
+        return;
+    }
+    SubmitCommand(REACTOR_CMD_STOP, NULL);
+    PlatformThreadJoin(reactor.thread);
+    CloseHandle(reactor.iocp);
+    FreeBuffers();
+}
+
+#else
+
+static void WakeReactor(void) {
+    uint64_t value = 1;
+    ssize_t unused = write(reactor.commandFd, &value, sizeof(value));
+    (void)unused;
+}
+
+static bool AttachPort(ReactorPort* port) {
+    struct epoll_event event = { 0 };
+    event.events = EPOLLIN;
+    event.data.ptr = port;
+    return epoll_ctl(reactor.epollFd, EPOLL_CTL_ADD, (int)port->modem->hSerial, &event) == 0;
+}
+
+static bool DetachPort(ReactorPort* port) {
+    if (!port->failed) {
+        epoll_ctl(reactor.epollFd, EPOLL_CTL_DEL, (int)port->modem->hSerial, NULL);
+    }
+    port->inUse = false;
+    return true;
+}
+
+static void FailPort(ReactorPort* port, DWORD errorCode) {
+    epoll_ctl(reactor.epollFd, EPOLL_CTL_DEL, (int)port->modem->hSerial, NULL);
+    port->failed = true;
+    AtomicAddRelaxed32(&port->modem->metrics.portErrors, 1);
+    if (reactor.onError) {
+        reactor.onError(port->modem, errorCode);
+    }
+}
+
+static void OnReadable(ReactorPort* port, uint32_t events) {
+    int fd = (int)port->modem->hSerial;
+
+    // 한 번에 한 버퍼만 읽어 다른 포트가 굶지 않도록 함 (레벨 트리거이므로 남은 데이터는 다음 차례에)
+    if (port->readSize > port->bufferSize) {
+        GrowBuffer(port);
+    }
+    ssize_t n = read(fd, port->buffer, port->readSize < port->bufferSize ? port->readSize : port->bufferSize);
+    if (n > 0) {
+        if (reactor.onReceive) {
+            reactor.onReceive(port->modem, port->buffer, (DWORD)n);
+        }
+        return;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            FailPort(port, EIO);
+        }
+        return;
+    }
+    FailPort(port, n == 0 ? EPIPE : (DWORD)errno);
+}
+
+static DWORD WINAPI ReactorThread(LPVOID param) {
+    (void)param;
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+
+    while (reactor.running) {
+        int count = epoll_wait(reactor.epollFd, events, REACTOR_MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            ReactorPort* port = (ReactorPort*)events[i].data.ptr;
+            if (port == NULL) {
+                uint64_t value;
+                ssize_t unused = read(reactor.commandFd, &value, sizeof(value));
+                (void)unused;
+                HandleCommand();
+            }
+            else if (port->inUse && !port->failed) {
+                OnReadable(port, events[i].events);
+            }
+        }
+    }
+    return 0;
+}
+
+bool ReactorStart(ReactorReceiveProc onReceive, ReactorErrorProc onError) {
+    memset(&reactor, 0, sizeof(reactor));
+    reactor.onReceive = onReceive;
+    reactor.onError = onError;
+    reactor.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    reactor.commandFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (reactor.epollFd < 0 || reactor.commandFd < 0) {
+        return false;
+    }
+    struct epoll_event event = { 0 };
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (epoll_ctl(reactor.epollFd, EPOLL_CTL_ADD, reactor.commandFd, &event) != 0) {
+        return false;
+    }
+    PlatformMutexInit(&reactor.callLock);
+    PlatformMutexInit(&reactor.lock);
+    PlatformCondInit(&reactor.done);
+    reactor.running = true;
+    if (!PlatformThreadStart(&reactor.thread, ReactorThread, NULL)) {
+        reactor.running = false;
+        return false;
+    }
+    return true;
+}
+
+void ReactorStop(void) {
+    if (!reactor.running) {
+        return;
+    }
+    SubmitCommand(REACTOR_CMD_STOP, NULL);
+    PlatformThreadJoin(reactor.thread);
+    close(reactor.epollFd);
+    close(reactor.commandFd);
+    FreeBuffers();
+}
+
+#endif
+
+bool ReactorAdd(ModemConfig* modem) {
+    if (modem->hSerial == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    return SubmitCommand(REACTOR_CMD_ADD, modem);
+}
+
+void ReactorRemove(ModemConfig* modem) {
+    SubmitCommand(REACTOR_CMD_REMOVE, modem);
+}
+
+void ReactorResize(ModemConfig* modem) {
+    SubmitCommand(REACTOR_CMD_RESIZE, modem);
+}
@@ -0,0 +1,21 @@
+﻿#pragma once
+#include "platform.h"
+#include "modem.h"
+
+// 모든 모뎀 포트를 하나의 스레드에서 다중화하는 I/O 리액터
+// Windows 는 IOCP, POSIX 는 epoll 을 사용한다.
+
+// 수신 데이터 전달 콜백 (리액터 스레드에서 호출됨)
+typedef void (*ReactorReceiveProc)(ModemConfig* modem, const BYTE* data, DWORD size);
+// 포트 오류(분리, 드라이버 오류 등) 통지 콜백. 해당 포트는 리액터에서 빠진다
+typedef void (*ReactorErrorProc)(ModemConfig* modem, DWORD errorCode);
+
+bool ReactorStart(ReactorReceiveProc onReceive, ReactorErrorProc onError);
+void ReactorStop(void);
+
+// 열린 포트를 등록/해제한다. 해제는 리액터 스레드가 포트 사용을 마칠 때까지 기다린 뒤 반환하므로
+// 반환 후에는 CloseSerialPort 로 안전하게 닫을 수 있다.
+bool ReactorAdd(ModemConfig* modem);
+void ReactorRemove(ModemConfig* modem);
+// 열린 포트의 보레이트를 제자리에서 바꾼 뒤: 읽기 크기를 새 속도에 맞춘다 (수신 링 크기를 넘지 않음)
+void ReactorResize(ModemConfig* modem);
@@ -0,0 +1,138 @@
+﻿#include "platform.h"
+#include "receiver.h"
+#include "capture.h"
+
+#define RECEIVER_CHUNK_SIZE 2048
+
+static struct {
+    ReceiverDeliverProc deliver;
+    uint64_t chunkArrivalNs;    // 지금 해석 중인 조각의 마지막 바이트가 도착한 시각
+    PlatformThread thread;
+    PlatformEvent dataReady;
+    volatile int32_t running;
+} receiver;
+
+void ReceiverPush(ModemConfig* modem, const BYTE* data, DWORD size) {
+    CaptureRecord(modem, CAPTURE_RX, data, size);
+    AtomicAddRelaxed64(&modem->metrics.bytesIn, size);
+    MetricsRecordArrival(&modem->metrics, RingWrite(&modem->rxRing, data, size));
+    PlatformEventSet(&receiver.dataReady);
+}
+
+// 전달한 메시지 수와 도착부터 전달까지의 지연
+static void CountDelivery(ModemConfig* modem) {
+    AtomicAddRelaxed32(&modem->metrics.messagesIn, 1);
+    if (receiver.chunkArrivalNs != 0) {
+        HistogramRecord(&modem->metrics.receiveLatency, PlatformNowNs() - receiver.chunkArrivalNs);
+    }
+}
+
+static void DeliverFrame(void* context, const FrameHeader* header, const BYTE* payload, DWORD length) {
+    ModemConfig* modem = (ModemConfig*)context;
+    FrameHeader unstamped;
+    if (header->flags & FRAME_FLAG_TIMESTAMP) {
+        // 보낸 시각을 떼어 내고 단방향 지연을 잼. 시계 동기화 프레임은 여기서 끝남
+        if (length < FRAME_TIMESTAMP_SIZE) {
+            AtomicIncrement32(&modem->rxFrame.formatErrors);
+            return;
+        }
+        uint64_t sentNs = 0;
+        for (int i = FRAME_TIMESTAMP_SIZE - 1; i >= 0; i--) {
+            sentNs = sentNs << 8 | payload[i];
+        }
+        payload += FRAME_TIMESTAMP_SIZE;
+        length -= FRAME_TIMESTAMP_SIZE;
+        unstamped.type = header->type;
+        unstamped.flags = (BYTE)(header->flags & ~FRAME_FLAG_TIMESTAMP);
+        unstamped.length = (uint16_t)length;
+        header = &unstamped;
+        uint64_t arrivalNs = receiver.chunkArrivalNs != 0 ? receiver.chunkArrivalNs : PlatformNowNs();
+        if (ClockSyncReceive(modem, header, sentNs, arrivalNs, payload, length)) {
+            return;
+        }
+    }
+    CountDelivery(modem); // 시계 동기화 프레임은 메시지로 세지 않음
+    if (header->type != FRAME_TYPE_DATA_LZ) {
+        receiver.deliver(modem, header, payload, length);
+        return;
+    }
+    // 압축된 메시지는 풀어서 일반 메시지로 전달
+    static BYTE expanded[COMPRESS_MAX_INPUT]; // 수신 처리 스레드만 사용
+    DWORD expandedLength = 0;
+    uint64_t startNs = PlatformNowNs();
+    if (!CompressExpand(payload, length, expanded, sizeof(expanded), &expandedLength)) {
+        modem->compress.expandErrors++;
+        return;
+    }
+    modem->compress.expandNs += PlatformNowNs() - startNs;
+    modem->compress.messagesExpanded++;
+    FrameHeader plain = { FRAME_TYPE_DATA, header->flags, (uint16_t)expandedLength };
+    receiver.deliver(modem, &plain, expanded, expandedLength);
+}
+
+// 모든 모뎀의 링을 한 바퀴 비운다. 꺼낸 데이터가 있었으면 true
+// 링 안의 연속 구간을 그대로 파서와 deliver 에 넘기고, 다 쓴 뒤에 꺼낸 것으로 한다
+static bool DrainRings(void) {
+    bool any = false;
+    for (int i = 0; i < modemRegistry.count; i++) {
+        ModemConfig* modem = &modemRegistry.modems[i];
+        if (modem->rxRing.data == NULL) {
+            continue;
+        }
+        const BYTE* chunk;
+        DWORD count = RingPeek(&modem->rxRing, &chunk);
+        if (count > RECEIVER_CHUNK_SIZE) {
+            count = RECEIVER_CHUNK_SIZE;
+        }
+        if (count > 0) {
+            receiver.chunkArrivalNs = MetricsTakeArrival(&modem->metrics, count);
+            if (modem->framing == FRAMING_COBS && modem->rxFrame.buffer != NULL) {
+                FrameParserFeed(&modem->rxFrame, chunk, count, DeliverFrame, modem);
+            }
+            else {
+                CountDelivery(modem);
+                receiver.deliver(modem, NULL, chunk, count);
+            }
+            RingConsume(&modem->rxRing, count);
+            any = true;
+        }
+    }
+    return any;
+}
+
+static DWORD WINAPI ReceiverThread(LPVOID param) {
+    (void)param;
+    while (AtomicLoadAcquire32(&receiver.running)) {
+        // 한 모뎀이 다른 모뎀을 굶기지 않도록 청크 단위로 돌아가며 비움
+        while (DrainRings()) {
+        }
+        PlatformEventWait(&receiver.dataReady, INFINITE);
+    }
+    while (DrainRings()) {
+    }
+    return 0;
+}
+
+bool ReceiverStart(ReceiverDeliverProc deliver) {
+    receiver.deliver = deliver;
+    if (!PlatformEventInit(&receiver.dataReady)) {
+        return false;
+    }
+    AtomicStoreRelease32(&receiver.running, 1);
+    if (!PlatformThreadStart(&receiver.thread, ReceiverThread, NULL)) {
+        AtomicStoreRelease32(&receiver.running, 0);
+        PlatformEventDestroy(&receiver.dataReady);
+        return false;
+    }
+    return true;
+}
+
+void ReceiverStop(void) {
+    if (!AtomicLoadAcquire32(&receiver.running)) {
+        return;
+    }
+    AtomicStoreRelease32(&receiver.running, 0);
+    PlatformEventSet(&receiver.dataReady);
+    PlatformThreadJoin(receiver.thread);
+    PlatformEventDestroy(&receiver.dataReady);
+}
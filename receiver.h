@@ -0,0 +1,21 @@
+﻿#pragma once
+#include "platform.h"
+#include "modem.h"
+
+// 수신 처리 스레드
+// 리액터는 ReceiverPush 로 바이트를 모뎀별 링 버퍼에 복사만 하고,
+// 해석과 화면 출력은 이 스레드가 링에서 꺼내어 deliver 콜백으로 처리한다.
+// 프레임 모드 모뎀은 완성된 프레임 단위로, 그 외에는 header 가 NULL 인 바이트 조각으로 전달된다.
+// 링의 바이트는 따로 꺼내 두지 않고 링 안에서 바로 해석한다. 바이트 조각은 링 안을 가리키므로
+// deliver 가 돌아온 뒤에는 쓰지 말 것 (필요하면 복사).
+// 압축된 메시지(FRAME_TYPE_DATA_LZ)는 이 스레드에서 풀어 FRAME_TYPE_DATA 로 전달한다.
+// 보낸 시각이 붙은 프레임(FRAME_FLAG_TIMESTAMP)은 시각을 떼어 clocksync.h 로 넘기고 나머지만 전달한다.
+
+typedef void (*ReceiverDeliverProc)(ModemConfig* modem, const FrameHeader* header, const BYTE* data, DWORD size);
+
+bool ReceiverStart(ReceiverDeliverProc deliver);
+// 링에 남은 데이터를 모두 전달한 뒤 종료
+void ReceiverStop(void);
+
+// 리액터 스레드에서 호출 (ReactorReceiveProc 형식)
+void ReceiverPush(ModemConfig* modem, const BYTE* data, DWORD size);
@@ -0,0 +1,79 @@
+﻿#include "platform.h"
+#include "ring.h"
+
+bool RingInit(SpscRing* ring, uint32_t capacity) {
+    memset(ring, 0, sizeof(*ring));
+    uint32_t size = RING_MIN_SIZE;
+    while (size < capacity && size < RING_MAX_SIZE) {
+        size <<= 1;
+    }
+    ring->data = (BYTE*)malloc(size);
+    if (ring->data == NULL) {
+        return false;
+    }
+    ring->capacity = size;
+    ring->mask = size - 1;
+    return true;
+}
+
+void RingFree(SpscRing* ring) {
+    free(ring->data);
+    ring->data = NULL;
+    ring->capacity = 0;
+}
+
+DWORD RingWrite(SpscRing* ring, const BYTE* data, DWORD size) {
+    uint32_t head = ring->head;
+    uint32_t tail = (uint32_t)AtomicLoadAcquire32(&ring->tail);
+    uint32_t space = ring->capacity - (head - tail);
+    DWORD count = size < space ? size : space;
+
+    // 끝에서 한 번 꺾일 수 있으므로 최대 두 번에 나눠 복사
+    uint32_t offset = head & ring->mask;
+    DWORD first = count < ring->capacity - offset ? count : ring->capacity - offset;
+    memcpy(ring->data + offset, data, first);
+    memcpy(ring->data, data + first, count - first);
+    AtomicStoreRelease32(&ring->head, head + count);
+
+    // 통계는 생산자만 갱신하므로 읽고 쓰기를 따로 해도 된다
+    if (count < size) {
+        AtomicStoreRelease64(&ring->droppedBytes, ring->droppedBytes + (int64_t)(size - count));
+        AtomicStoreRelease32(&ring->overrunCount, ring->overrunCount + 1);
+    }
+    int32_t used = (int32_t)(head + count - tail);
+    if (used > ring->highWater) {
+        AtomicStoreRelease32(&ring->highWater, used);
+    }
+    return count;
+}
+
+DWORD RingRead(SpscRing* ring, BYTE* buffer, DWORD size) {
+    uint32_t tail = ring->tail;
+    uint32_t head = (uint32_t)AtomicLoadAcquire32(&ring->head);
+    uint32_t available = head - tail;
+    DWORD count = size < available ? size : available;
+
+    uint32_t offset = tail & ring->mask;
+    DWORD first = count < ring->capacity - offset ? count : ring->capacity - offset;
+    memcpy(buffer, ring->data + offset, first);
+    memcpy(buffer + first, ring->data, count - first);
+    AtomicStoreRelease32(&ring->tail, tail + count);
+    return count;
+}
+
+DWORD RingPeek(const SpscRing* ring, const BYTE** data) {
+    uint32_t tail = ring->tail;
+    uint32_t head = (uint32_t)AtomicLoadAcquire32(&ring->head);
+    uint32_t offset = tail & ring->mask;
+    uint32_t available = head - tail;
+    *data = ring->data + offset;
+    return available < ring->capacity - offset ? available : ring->capacity - offset;
+}
+
+void RingConsume(SpscRing* ring, DWORD size) {
+    AtomicStoreRelease32(&ring->tail, ring->tail + size);
+}
+
+DWORD RingUsed(const SpscRing* ring) {
+    return (uint32_t)AtomicLoadAcquire32(&ring->head) - (uint32_t)AtomicLoadAcquire32(&ring->tail);
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+#include "platform.h"
+
+// 단일 생산자/단일 소비자 바이트 링 버퍼 (락 없음)
+// 생산자(리액터 스레드)는 RingWrite 만, 소비자(수신 처리 스레드)는 RingRead 또는 RingPeek/RingConsume 만 호출한다.
+// head/tail 은 계속 증가하는 인덱스이며 capacity 는 2의 거듭제곱이다.
+
+#define RING_MIN_SIZE 4096
+#define RING_MAX_SIZE (16 * 1024 * 1024)
+#define RING_DEFAULT_SIZE 65536
+
+typedef struct {
+    BYTE* data;
+    uint32_t capacity;
+    uint32_t mask;
+
+    // 생산자와 소비자가 같은 캐시 라인을 두고 경쟁하지 않도록 분리
+    BYTE padHead[64];
+    volatile uint32_t head; // 생산자만 쓴다
+    volatile int64_t droppedBytes;  // 링이 가득 차서 버린 바이트 수
+    volatile int32_t overrunCount;  // 버린 횟수
+    volatile int32_t highWater;     // 최대 사용량
+    BYTE padTail[64];
+    volatile uint32_t tail; // 소비자만 쓴다
+    BYTE padEnd[64];
+} SpscRing;
+
+// capacity 는 RING_MIN_SIZE..RING_MAX_SIZE 범위의 2의 거듭제곱으로 올림
+bool RingInit(SpscRing* ring, uint32_t capacity);
+void RingFree(SpscRing* ring);
+
+// 기록한 바이트 수를 반환. 공간이 모자라면 나머지는 버리고 오버런으로 센다
+DWORD RingWrite(SpscRing* ring, const BYTE* data, DWORD size);
+// 최대 size 바이트를 꺼내고 꺼낸 바이트 수를 반환
+DWORD RingRead(SpscRing* ring, BYTE* buffer, DWORD size);
+// 복사하지 않고 링 안의 데이터를 본다: 꺼낼 수 있는 연속 구간(끝에서 꺾이면 앞부분만)의 주소와 길이.
+// RingConsume 으로 꺼낸 것으로 하기 전까지 생산자가 그 자리를 덮어쓰지 않는다
+DWORD RingPeek(const SpscRing* ring, const BYTE** data);
+void RingConsume(SpscRing* ring, DWORD size);
+DWORD RingUsed(const SpscRing* ring);
@@ -0,0 +1,484 @@
+﻿#include "platform.h"
+#include "rxlog.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <tmmintrin.h>
+#define RXLOG_X86
+#define RXLOG_TARGET_SSSE3
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define RXLOG_X86
+#define RXLOG_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+#define RXLOG_RECORD_HEADER 12
+#define RXLOG_TITLE_SIZE 128   // "Received Message(이름) [N bytes] >> " 와 잘림 안내 줄
+#define RXLOG_HEX_COLUMN 8     // 줄 안의 위치: "  0000  " | HEX 8개 | 공백 | HEX 8개 | "|" | ASCII 16 | "|\n"
+#define RXLOG_ASCII_COLUMN 58
+
+typedef struct {
+    BYTE* data;
+    DWORD length;
+} RxLogSegment;
+
+static struct {
+    FILE* file;                // 표준 출력 또는 path
+    TCHAR path[MAX_PATH];
+    int64_t maxBytes;
+    int64_t fileBytes;
+    volatile int32_t active;
+    PlatformMutex lock;        // 세그먼트 목록과 현재 세그먼트 (복사하는 동안만 잡음)
+    PlatformEvent ready;
+    PlatformThread thread;
+    volatile int32_t running;
+    RxLogSegment segments[RXLOG_MAX_SEGMENTS];
+    int segmentCount;
+    int current;               // 기록 중인 세그먼트 (-1 = 빈 세그먼트 없음)
+    int full[RXLOG_MAX_SEGMENTS]; // 출력할 세그먼트 (FIFO)
+    int fullHead;
+    int fullCount;
+    int free[RXLOG_MAX_SEGMENTS];
+    int freeCount;
+    char* output;              // 로그 스레드만 사용
+    DWORD outputLength;
+    RxLogStats stats;
+} rxlog;
+
+static char hexPairs[256][2];
+static char asciiTable[256];
+static bool textTable[256];
+static bool useSimd;
+static bool hasSimd;
+
+void RxLogInit(void) {
+    static const char hexDigits[] = "0123456789ABCDEF";
+    for (int i = 0; i < 256; i++) {
+        hexPairs[i][0] = hexDigits[i >> 4];
+        hexPairs[i][1] = hexDigits[i & 0x0F];
+        asciiTable[i] = i >= 0x20 && i < 0x7F ? (char)i : '.';
+        textTable[i] = (i >= 0x20 && i < 0x7F) || i == '\r' || i == '\n' || i == '\t';
+    }
+
+#if defined(RXLOG_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    hasSimd = (info[2] & (1 << 9)) != 0;
+#elif defined(RXLOG_X86)
+    __builtin_cpu_init();
+    hasSimd = __builtin_cpu_supports("ssse3") != 0;
+#endif
+    useSimd = hasSimd;
+}
+
+bool RxLogUsesSimd(void) {
+    return useSimd;
+}
+
+void RxLogEnableSimd(bool enable) {
+    useSimd = enable && hasSimd;
+}
+
+// 16 바이트 한 줄의 HEX 와 ASCII 칸을 표로 채움
+static void FormatRow(const BYTE* row, DWORD count, char* line) {
+    char* hex = line + RXLOG_HEX_COLUMN;
+    for (DWORD i = 0; i < 16; i++) {
+        if (i == 8) {
+            *hex++ = ' ';
+        }
+        if (i < count) {
+            hex[0] = hexPairs[row[i]][0];
+            hex[1] = hexPairs[row[i]][1];
+        }
+        else {
+            hex[0] = ' ';
+            hex[1] = ' ';
+        }
+        hex[2] = ' ';
+        hex += 3;
+    }
+    for (DWORD i = 0; i < count; i++) {
+        line[RXLOG_ASCII_COLUMN + i] = asciiTable[row[i]];
+    }
+}
+
+#ifdef RXLOG_X86
+// 니블을 PSHUFB 로 HEX 글자로 바꾸고, 두 글자마다 공백 칸을 비워 둔 순서로 다시 섞은 뒤 공백을 채움
+RXLOG_TARGET_SSSE3 static void FormatRowSsse3(const BYTE* row, char* line) {
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i spread0 = _mm_setr_epi8(0, 1, -1, 2, 3, -1, 4, 5, -1, 6, 7, -1, 8, 9, -1, 10);
+    const __m128i spread1 = _mm_setr_epi8(11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i spaces0 = _mm_setr_epi8(0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0);
+    const __m128i spaces1 = _mm_setr_epi8(0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, 0, 0, 0, 0, 0, 0);
+
+    __m128i in = _mm_loadu_si128((const __m128i*)row);
+    __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(in, 4), mask));
+    __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(in, mask));
+    __m128i first = _mm_unpacklo_epi8(high, low);  // 앞 8 바이트의 HEX 16 글자
+    __m128i second = _mm_unpackhi_epi8(high, low);
+    char* hex = line + RXLOG_HEX_COLUMN;
+    _mm_storeu_si128((__m128i*)hex, _mm_or_si128(_mm_shuffle_epi8(first, spread0), spaces0));
+    _mm_storel_epi64((__m128i*)(hex + 16), _mm_or_si128(_mm_shuffle_epi8(first, spread1), spaces1));
+    hex[24] = ' ';
+    _mm_storeu_si128((__m128i*)(hex + 25), _mm_or_si128(_mm_shuffle_epi8(second, spread0), spaces0));
+    _mm_storel_epi64((__m128i*)(hex + 41), _mm_or_si128(_mm_shuffle_epi8(second, spread1), spaces1));
+
+    // 0x20..0x7E 만 그대로, 나머지는 '.' (0x80 이상은 부호 있는 비교에서 음수라 걸러짐)
+    __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8(0x1F)), _mm_cmplt_epi8(in, _mm_set1_epi8(0x7F)));
+    __m128i ascii = _mm_or_si128(_mm_and_si128(printable, in), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+    _mm_storeu_si128((__m128i*)(line + RXLOG_ASCII_COLUMN), ascii);
+}
+#endif
+
+// offset 부터 시작하는 덤프 줄들을 out 에 씀
+static DWORD DumpRows(const BYTE* data, DWORD size, DWORD offset, char* out) {
+    char* line = out;
+    for (DWORD i = 0; i < size; i += 16) {
+        DWORD count = size - i < 16 ? size - i : 16;
+        DWORD position = offset + i;
+        line[0] = ' ';
+        line[1] = ' ';
+        line[2] = hexPairs[(position >> 8) & 0xFF][0];
+        line[3] = hexPairs[(position >> 8) & 0xFF][1];
+        line[4] = hexPairs[position & 0xFF][0];
+        line[5] = hexPairs[position & 0xFF][1];
+        line[6] = ' ';
+        line[7] = ' ';
+#ifdef RXLOG_X86
+        if (useSimd && count == 16) {
+            FormatRowSsse3(data + i, line);
+        }
+        else {
+            FormatRow(data + i, count, line);
+        }
+#else
+        FormatRow(data + i, count, line);
+#endif
+        line[RXLOG_ASCII_COLUMN - 1] = '|';
+        line[RXLOG_ASCII_COLUMN + count] = '|';
+        line[RXLOG_ASCII_COLUMN + count + 1] = '\n';
+        line += RXLOG_ASCII_COLUMN + count + 2;
+    }
+    return (DWORD)(line - out);
+}
+
+DWORD RxLogDumpSize(DWORD size) {
+    return (size + 15) / 16 * RXLOG_LINE_SIZE;
+}
+
+DWORD RxLogDump(const BYTE* data, DWORD size, char* out) {
+    return DumpRows(data, size, 0, out);
+}
+
+// 출력 버퍼를 파일에 씀. 파일이 최대 크기를 넘게 되면 먼저 <파일>.1 .. 로 밀어냄 (로그 스레드)
+static void FlushOutput(void) {
+    if (rxlog.outputLength == 0) {
+        return;
+    }
+    int64_t rotations = 0;
+    if (rxlog.path[0] != TEXT('\0') && rxlog.maxBytes > 0 && rxlog.fileBytes > 0 &&
+        rxlog.fileBytes + rxlog.outputLength > rxlog.maxBytes) {
+        TCHAR from[MAX_PATH + 8];
+        TCHAR to[MAX_PATH + 8];
+        fclose(rxlog.file);
+        for (int i = RXLOG_FILES - 1; i > 0; i--) {
+            if (i == 1) {
+                _tcscpy(from, rxlog.path);
+            }
+            else {
+                _stprintf(from, TEXT("%s.%d"), rxlog.path, i - 1);
+            }
+            _stprintf(to, TEXT("%s.%d"), rxlog.path, i);
+            _tremove(to);
+            _trename(from, to);
+        }
+        rxlog.file = _tfopen(rxlog.path, TEXT("wb"));
+        rxlog.fileBytes = 0;
+        rotations = 1;
+    }
+    size_t written = rxlog.file != NULL ? fwrite(rxlog.output, 1, rxlog.outputLength, rxlog.file) : 0;
+    rxlog.fileBytes += (int64_t)written;
+    rxlog.outputLength = 0;
+
+    PlatformMutexLock(&rxlog.lock);
+    rxlog.stats.outputBytes += (int64_t)written;
+    rxlog.stats.writes++;
+    rxlog.stats.rotations += rotations;
+    PlatformMutexUnlock(&rxlog.lock);
+}
+
+// 출력 버퍼에 size 바이트 자리를 만듦
+static char* Reserve(DWORD size) {
+    if (rxlog.outputLength + size > RXLOG_OUTPUT_SIZE) {
+        FlushOutput();
+    }
+    return rxlog.output + rxlog.outputLength;
+}
+
+static void FormatRecord(const BYTE* record) {
+    int index = record[0];
+    bool framed = record[1] != 0;
+    DWORD stored = (DWORD)record[4] | ((DWORD)record[5] << 8) | ((DWORD)record[6] << 16) | ((DWORD)record[7] << 24);
+    DWORD size = (DWORD)record[8] | ((DWORD)record[9] << 8) | ((DWORD)record[10] << 16) | ((DWORD)record[11] << 24);
+    const BYTE* data = record + RXLOG_RECORD_HEADER;
+
+    char name[MAX_MODEM_NAME];
+    int nameLength = 0;
+    if (index < modemRegistry.count) {
+        const TCHAR* modemName = modemRegistry.modems[index].name;
+        for (; nameLength < MAX_MODEM_NAME - 1 && modemName[nameLength] != TEXT('\0'); nameLength++) {
+            name[nameLength] = (char)modemName[nameLength]; // 섹션 이름은 ASCII
+        }
+    }
+    name[nameLength] = '\0';
+
+    bool text = true;
+    for (DWORD i = 0; i < stored && text; i++) {
+        text = textTable[data[i]];
+    }
+    char* out = Reserve(RXLOG_TITLE_SIZE);
+    int length = framed ? sprintf(out, "Received Message(%s) [%lu bytes] >>", name, (unsigned long)size)
+                        : sprintf(out, "Received Message(%s) >>", name);
+    out[length++] = text ? ' ' : '\n'; // 바이너리는 다음 줄부터 덤프
+    rxlog.outputLength += (DWORD)length;
+
+    // 출력 버퍼보다 긴 레코드는 나누어 씀
+    const DWORD rowsPerPass = RXLOG_OUTPUT_SIZE / 2 / RXLOG_LINE_SIZE;
+    for (DWORD done = 0; done < stored;) {
+        if (text) {
+            DWORD count = stored - done < RXLOG_OUTPUT_SIZE / 2 ? stored - done : RXLOG_OUTPUT_SIZE / 2;
+            memcpy(Reserve(count), data + done, count);
+            rxlog.outputLength += count;
+            done += count;
+        }
+        else {
+            DWORD count = stored - done < rowsPerPass * 16 ? stored - done : rowsPerPass * 16;
+            rxlog.outputLength += DumpRows(data + done, count, done, Reserve(RxLogDumpSize(count)));
+            done += count;
+        }
+    }
+    out = Reserve(RXLOG_TITLE_SIZE);
+    length = text ? sprintf(out, "\n") : 0;
+    if (stored < size) {
+        length += sprintf(out + length, "  ... %lu more bytes\n", (unsigned long)(size - stored));
+    }
+    rxlog.outputLength += (DWORD)length;
+}
+
+// 현재 세그먼트를 출력 목록으로 넘기고 빈 세그먼트를 꺼낸다 (lock 을 잡은 상태)
+static void RotateSegment(void) {
+    if (rxlog.current >= 0) {
+        rxlog.full[(rxlog.fullHead + rxlog.fullCount) % rxlog.segmentCount] = rxlog.current;
+        rxlog.fullCount++;
+    }
+    rxlog.current = rxlog.freeCount > 0 ? rxlog.free[--rxlog.freeCount] : -1;
+}
+
+static DWORD WINAPI RxLogThread(LPVOID param) {
+    (void)param;
+    for (;;) {
+        bool running = AtomicLoadAcquire32(&rxlog.running) != 0;
+        if (running) {
+            PlatformEventWait(&rxlog.ready, RXLOG_FLUSH_MS);
+        }
+        PlatformMutexLock(&rxlog.lock);
+        // 덜 찬 세그먼트도 주기적으로 (종료할 때는 모두) 내보냄
+        if (rxlog.current >= 0 && rxlog.segments[rxlog.current].length > 0 && (rxlog.freeCount > 0 || !running)) {
+            RotateSegment();
+        }
+        PlatformMutexUnlock(&rxlog.lock);
+
+        bool wrote = false;
+        for (;;) {
+            PlatformMutexLock(&rxlog.lock);
+            int index = -1;
+            if (rxlog.fullCount > 0) {
+                index = rxlog.full[rxlog.fullHead];
+                rxlog.fullHead = (rxlog.fullHead + 1) % rxlog.segmentCount;
+                rxlog.fullCount--;
+            }
+            PlatformMutexUnlock(&rxlog.lock);
+            if (index < 0) {
+                break;
+            }
+            RxLogSegment* segment = &rxlog.segments[index];
+            for (DWORD position = 0; position < segment->length;) {
+                const BYTE* record = segment->data + position;
+                DWORD stored = (DWORD)record[4] | ((DWORD)record[5] << 8) | ((DWORD)record[6] << 16) | ((DWORD)record[7] << 24);
+                FormatRecord(record);
+                position += RXLOG_RECORD_HEADER + stored;
+            }
+            wrote = true;
+
+            PlatformMutexLock(&rxlog.lock);
+            segment->length = 0;
+            if (rxlog.current < 0) {
+                rxlog.current = index;
+            }
+            else {
+                rxlog.free[rxlog.freeCount++] = index;
+            }
+            PlatformMutexUnlock(&rxlog.lock);
+        }
+        if (wrote) {
+            FlushOutput();
+            if (rxlog.file != NULL) {
+                fflush(rxlog.file);
+            }
+        }
+        if (!running) {
+            break;
+        }
+    }
+    return 0;
+}
+
+static void FreeBuffers(void) {
+    for (int i = 0; i < RXLOG_MAX_SEGMENTS; i++) {
+        free(rxlog.segments[i].data);
+        rxlog.segments[i].data = NULL;
+    }
+    free(rxlog.output);
+    rxlog.output = NULL;
+}
+
+static void CloseOutput(void) {
+    if (rxlog.file != NULL && rxlog.file != stdout) {
+        fclose(rxlog.file);
+    }
+    rxlog.file = NULL;
+}
+
+bool RxLogStart(const TCHAR* path, int64_t maxBytes, int segments) {
+    if (AtomicLoadAcquire32(&rxlog.active)) {
+        return false;
+    }
+    if (segments == 0) {
+        segments = RXLOG_SEGMENTS;
+    }
+    if (segments < 2 || segments > RXLOG_MAX_SEGMENTS) {
+        _ftprintf(stderr, TEXT("Receive log needs 2 to %d segments.\n"), RXLOG_MAX_SEGMENTS);
+        return false;
+    }
+    memset(&rxlog.stats, 0, sizeof(rxlog.stats));
+    rxlog.segmentCount = segments;
+    rxlog.output = (char*)malloc(RXLOG_OUTPUT_SIZE);
+    rxlog.outputLength = 0;
+    for (int i = 0; i < segments; i++) {
+        rxlog.segments[i].data = (BYTE*)malloc(RXLOG_SEGMENT_SIZE);
+        rxlog.segments[i].length = 0;
+        if (rxlog.segments[i].data == NULL || rxlog.output == NULL) {
+            FreeBuffers();
+            return false;
+        }
+    }
+    rxlog.path[0] = TEXT('\0');
+    rxlog.maxBytes = maxBytes;
+    rxlog.fileBytes = 0;
+    if (path == NULL) {
+        rxlog.file = stdout;
+    }
+    else {
+        if (_tcslen(path) >= MAX_PATH) {
+            FreeBuffers();
+            return false;
+        }
+        _tcscpy(rxlog.path, path);
+        rxlog.file = _tfopen(path, TEXT("ab"));
+        if (rxlog.file == NULL) {
+            _ftprintf(stderr, TEXT("Cannot open receive log %s\n"), path);
+            FreeBuffers();
+            return false;
+        }
+        fseek(rxlog.file, 0, SEEK_END);
+        rxlog.fileBytes = (int64_t)ftell(rxlog.file);
+    }
+
+    rxlog.current = 0;
+    rxlog.fullHead = 0;
+    rxlog.fullCount = 0;
+    rxlog.freeCount = 0;
+    for (int i = segments - 1; i > 0; i--) {
+        rxlog.free[rxlog.freeCount++] = i;
+    }
+    PlatformMutexInit(&rxlog.lock);
+    if (!PlatformEventInit(&rxlog.ready)) {
+        CloseOutput();
+        FreeBuffers();
+        return false;
+    }
+    AtomicStoreRelease32(&rxlog.running, 1);
+    if (!PlatformThreadStart(&rxlog.thread, RxLogThread, NULL)) {
+        AtomicStoreRelease32(&rxlog.running, 0);
+        PlatformEventDestroy(&rxlog.ready);
+        CloseOutput();
+        FreeBuffers();
+        return false;
+    }
+    AtomicStoreRelease32(&rxlog.active, 1);
+    return true;
+}
+
+void RxLogStop(void) {
+    if (!AtomicLoadAcquire32(&rxlog.active)) {
+        return;
+    }
+    AtomicStoreRelease32(&rxlog.active, 0);
+    AtomicStoreRelease32(&rxlog.running, 0);
+    PlatformEventSet(&rxlog.ready);
+    PlatformThreadJoin(rxlog.thread);
+    PlatformEventDestroy(&rxlog.ready);
+    PlatformMutexDestroy(&rxlog.lock);
+    CloseOutput();
+    FreeBuffers();
+}
+
+bool RxLogActive(void) {
+    return AtomicLoadAcquire32(&rxlog.active) != 0;
+}
+
+void RxLogRecord(const ModemConfig* modem, bool framed, const BYTE* data, DWORD size) {
+    if (!AtomicLoadAcquire32(&rxlog.active)) {
+        return;
+    }
+    DWORD stored = size < RXLOG_MAX_RECORD ? size : RXLOG_MAX_RECORD;
+    int index = ModemIndex(modem);
+    PlatformMutexLock(&rxlog.lock);
+    if (rxlog.current >= 0 && rxlog.segments[rxlog.current].length + RXLOG_RECORD_HEADER + stored > RXLOG_SEGMENT_SIZE) {
+        RotateSegment();
+        PlatformEventSet(&rxlog.ready);
+    }
+    if (rxlog.current < 0) {
+        rxlog.stats.droppedRecords++;
+    }
+    else {
+        RxLogSegment* segment = &rxlog.segments[rxlog.current];
+        BYTE* p = segment->data + segment->length;
+        p[0] = (BYTE)(index >= 0 ? index : 0xFF);
+        p[1] = framed ? 1 : 0;
+        p[2] = 0;
+        p[3] = 0;
+        for (int i = 0; i < 4; i++) {
+            p[4 + i] = (BYTE)(stored >> (8 * i));
+            p[8 + i] = (BYTE)(size >> (8 * i));
+        }
+        memcpy(p + RXLOG_RECORD_HEADER, data, stored);
+        segment->length += RXLOG_RECORD_HEADER + stored;
+        rxlog.stats.records++;
+        rxlog.stats.waitedRecords += rxlog.freeCount == 0 ? 1 : 0;
+        rxlog.stats.bytes += stored;
+        rxlog.stats.truncatedRecords += stored < size ? 1 : 0;
+    }
+    PlatformMutexUnlock(&rxlog.lock);
+}
+
+void RxLogQueryStats(RxLogStats* stats) {
+    if (!AtomicLoadAcquire32(&rxlog.active)) {
+        *stats = rxlog.stats;
+        return;
+    }
+    PlatformMutexLock(&rxlog.lock);
+    *stats = rxlog.stats;
+    PlatformMutexUnlock(&rxlog.lock);
+}
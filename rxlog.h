@@ -0,0 +1,55 @@
+﻿#pragma once
+#include "platform.h"
+#include "modem.h"
+
+// 수신 로그
+// 수신 처리 스레드는 받은 메시지를 출력하지 않고 미리 할당한 세그먼트에 레코드(시각, 모뎀 번호, 길이, 데이터)로
+// 복사만 한다. 로그 스레드가 가득 찬 세그먼트(또는 RXLOG_FLUSH_MS 마다 덜 찬 세그먼트)를 꺼내 출력 버퍼에 모아
+// 한 번에 콘솔이나 파일로 쓴다. 빈 세그먼트가 없으면 레코드를 버리고 세므로 수신 경로는 출력을 기다리지 않는다.
+// 출력이 잠깐 밀리는 만큼은 세그먼트로 받아 두므로, 버린 레코드가 생기면 세그먼트 수(--rx-log 의 세 번째 값)를 늘린다.
+// 출력은 길이 기준이라 0x00 에서 잘리지 않는다:
+//   모두 출력할 수 있는 바이트면   Received Message(이름) [N bytes] >> 텍스트
+//   아니면 16 바이트씩 HEX 덤프    0000  48 65 6C 6C 6F 00 ...  |Hello.|
+// HEX 변환은 바이트 -> 두 글자 표로 하고, SSSE3 가 있으면 16 바이트 줄을 PSHUFB 로 한 번에 만든다.
+//   UHSDM --rx-log <파일> [최대 MB] [세그먼트 수]   콘솔 대신 파일에 기록. 최대 크기를 넘으면 <파일>.1 .. .3 으로 돌려 가며 보관
+
+#define RXLOG_SEGMENT_SIZE (256 * 1024)
+#define RXLOG_SEGMENTS 8       // 기본 세그먼트 수
+#define RXLOG_MAX_SEGMENTS 64
+#define RXLOG_FLUSH_MS 100     // 덜 찬 세그먼트라도 이 간격으로 출력
+#define RXLOG_OUTPUT_SIZE (256 * 1024) // 로그 스레드가 한 번에 쓰는 크기
+#define RXLOG_MAX_RECORD 65535 // 이보다 긴 메시지는 앞부분만 덤프
+#define RXLOG_FILES 4          // 돌려 가며 보관하는 파일 수 (<파일> 포함)
+#define RXLOG_DEFAULT_MB 16
+#define RXLOG_LINE_SIZE 76     // HEX 덤프 한 줄 (줄바꿈 포함)
+
+typedef struct {
+    int64_t records;
+    int64_t bytes;             // 레코드에 담은 데이터 바이트
+    int64_t waitedRecords;     // 남은 빈 세그먼트 없이 로그 스레드를 기다리며 마지막 세그먼트에 담은 레코드 (늘면 곧 버리기 시작함)
+    int64_t droppedRecords;    // 빈 세그먼트가 없어 버린 레코드
+    int64_t truncatedRecords;  // RXLOG_MAX_RECORD 보다 길어 앞부분만 담은 레코드
+    int64_t outputBytes;
+    int64_t writes;            // 출력 호출 수
+    int64_t rotations;
+} RxLogStats;
+
+// HEX 표를 만들고 SSSE3 지원 여부를 확인 (시작할 때 한 번)
+void RxLogInit(void);
+// path 가 NULL 이면 표준 출력. maxBytes 가 0 이면 파일을 돌리지 않음
+// segments 는 RXLOG_SEGMENT_SIZE 세그먼트 수 (0 이면 RXLOG_SEGMENTS, 2 .. RXLOG_MAX_SEGMENTS)
+bool RxLogStart(const TCHAR* path, int64_t maxBytes, int segments);
+// 남은 레코드를 모두 출력하고 파일을 닫는다 (수신 처리 스레드를 멈춘 뒤)
+void RxLogStop(void);
+bool RxLogActive(void);
+// 수신 처리 스레드에서 호출. framed 가 false 면 FRAMING_RAW 바이트 조각 (길이를 출력하지 않음)
+// 로그 중이 아니면 바로 반환
+void RxLogRecord(const ModemConfig* modem, bool framed, const BYTE* data, DWORD size);
+void RxLogQueryStats(RxLogStats* stats);
+
+// 줄 단위 HEX 덤프를 out 에 쓰고 길이를 반환. out 은 RxLogDumpSize(size) 바이트 이상
+DWORD RxLogDump(const BYTE* data, DWORD size, char* out);
+DWORD RxLogDumpSize(DWORD size);
+bool RxLogUsesSimd(void);
+// 벤치마크에서 표 방식과 비교할 때 사용
+void RxLogEnableSimd(bool enable);
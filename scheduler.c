@@ -0,0 +1,816 @@
+﻿#include "platform.h"
+#include "scheduler.h"
+#include "pool.h"
+
+// PROBE / PROBE_ACK: 보낸 시각(8, 보낸 쪽 시계). 받은 쪽은 그대로 돌려준다
+#define PROBE_SIZE 8
+// LINK_DATA: 세션(2) | id(4) | 채널(1) | 인코딩(1, COMPRESS_NONE / COMPRESS_LZ) | 메시지
+// 세션은 시작할 때마다 새로 정해지므로 상대가 다시 시작하면 이전 중복 검사 기록은 쓰이지 않는다
+// LINK_ACK: id(4)
+#define LINK_ACK_SIZE 4
+
+#define SCHED_TICK_MS 20
+#define SCHED_RETRY_MS 50       // 보낼 링크가 없거나 송신 큐가 가득 찼을 때 다시 시도하는 간격
+#define LINK_FRAME_OVERHEAD 12  // 헤더, CRC, COBS, 구분자 (전송 시간 추정용)
+#define LINK_RATE_MIN_INTERVAL_MS 5 // 이보다 짧은 구간의 전달 속도 표본은 버림 (확인이 몰려 온 경우)
+
+// 전달 속도 측정용 상태: 확인된 바이트 누계, 마지막 확인 시각, 그 확인된 메시지를 보낸 시각
+// 메시지는 보낼 때의 링크 상태를 복사해 두고, 확인되면 그 사이에 확인된 바이트 / 걸린 시간을 표본으로 쓴다.
+typedef struct {
+    int64_t bytes;
+    uint64_t ns;
+    uint64_t sentNs;
+} Delivery;
+
+typedef struct {
+    ModemConfig* modem;
+    LinkStats stats;
+    bool measured;          // RTT 표본이 있음
+    int consecutiveTimeouts;
+    volatile uint64_t lastHeardNs; // 상대로부터 마지막으로 프레임을 받은 시각 (수신 처리 스레드가 lock 없이 갱신)
+    uint64_t lastProbeNs;
+    int inFlight;           // 이 링크로 보내고 확인을 기다리는 메시지 수
+    Delivery delivery;
+    double rateBps;         // 최근 표본의 최댓값 (0 이면 아직 없음)
+    volatile int32_t rateBpsShared; // rateBps 를 송신 스레드가 lock 없이 읽도록 옮겨 둔 값
+    uint64_t rateNs;        // rateBps 표본을 얻은 시각
+    uint64_t failedNs;      // 포트가 빠져 메시지를 옮긴 시각 (다른 링크로 확인되면 0)
+} Link;
+
+typedef struct SchedMessage {
+    struct SchedMessage* next;
+    uint32_t id;
+    BYTE channel;
+    int link;               // 마지막으로 보낸 링크 (-1 이면 아직 못 보냄)
+    uint32_t linkMask;      // 확인을 기다리는 사본이 있는 링크 (비트 i = links[i])
+    int attempts;
+    bool redundant;         // 살아 있는 모든 링크로 같은 메시지를 보냄
+    bool rerouted;
+    uint64_t firstSentNs;
+    uint64_t sentNs;
+    uint64_t deadlineNs;
+    Delivery delivery;      // 보낼 때의 링크 전달 상태
+    DWORD length;
+    BYTE data[1];
+} SchedMessage;
+
+typedef struct {
+    SchedulerDeliverProc deliver;
+    SchedulerDoneProc done;
+} SchedChannel;
+
+static struct {
+    SchedChannel channels[SCHED_MAX_CHANNELS];
+    PlatformMutex lock;
+    PlatformEvent wake;
+    PlatformThread thread;
+    volatile int32_t running;
+    Link links[MAX_MODEMS];
+    int linkCount;
+    SchedMessage* pending;  // id 순서 (가장 오래된 것이 앞)
+    SchedMessage* pendingTail;
+    int pendingCount;
+    uint32_t nextId;
+    uint16_t session;
+    uint64_t firstSendNs;
+    SchedulerStats stats;
+    // 중복 검사 (lock 없이 사용): 자리 id % SCHED_DEDUP_WINDOW 마다 마지막으로 받은 (세션 << 32 | id)
+    volatile int64_t dedup[SCHED_DEDUP_WINDOW];
+    volatile int32_t duplicates;
+} sched;
+
+static void PutU32(BYTE* p, uint32_t value) {
+    p[0] = (BYTE)value;
+    p[1] = (BYTE)(value >> 8);
+    p[2] = (BYTE)(value >> 16);
+    p[3] = (BYTE)(value >> 24);
+}
+
+static uint32_t GetU32(const BYTE* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static Link* FindLink(const ModemConfig* modem) {
+    for (int i = 0; i < sched.linkCount; i++) {
+        if (sched.links[i].modem == modem) {
+            return &sched.links[i];
+        }
+    }
+    return NULL;
+}
+
+static bool PortOpen(const Link* link) {
+    return link->modem->hSerial != INVALID_HANDLE_VALUE;
+}
+
+// 확인 응답으로 잰 전달 속도가 있으면 그것을, 없으면 설정값
+static int LinkRateBps(const Link* link) {
+    if (link->rateBps > 0.0) {
+        return (int)link->rateBps;
+    }
+    return link->modem->linkRate > 0 ? link->modem->linkRate : link->modem->baudRate;
+}
+
+// 송신 큐에서 먼저 나갈 바이트(같거나 높은 등급, 쓰는 중인 배치 포함)와 메시지를 보내는 데 걸리는 시간 (ms)
+static double TransmitMs(const Link* link, DWORD length, BYTE priority) {
+    const TxQueue* queue = &link->modem->txQueue;
+    double bytes = (double)AtomicLoadAcquire32(&queue->writingBytes) + length + LINK_FRAME_OVERHEAD;
+    for (int c = 0; c <= priority; c++) {
+        bytes += AtomicLoadAcquire32(&queue->classBytes[c]);
+    }
+    return bytes * 10.0 * 1000.0 / LinkRateBps(link);
+}
+
+static double RttMs(const Link* link) {
+    return link->measured ? link->stats.rttMs : LINK_INITIAL_RTT_MS;
+}
+
+// 이쪽 -> 상대 방향 지연 (ms). 시계가 동기화된 링크(Timestamps=1)는 상대가 잰 이 방향 지연을, 아직 없으면
+// 이쪽이 잰 반대 방향 지연을 쓰고 지터만큼 늘려 잡는다. 동기화되지 않은 링크는 평활 RTT 의 절반
+static double OneWayMs(const Link* link) {
+    const ClockSync* clock = &link->modem->clock;
+    if (!AtomicLoadAcquire32(&clock->synced)) {
+        return RttMs(link) / 2.0;
+    }
+    int32_t forwardUs = AtomicLoadAcquire32(&clock->forwardUs);
+    int64_t oneWayNs = AtomicLoadAcquire64(&clock->oneWayNs);
+    double jitterMs = AtomicLoadAcquire64(&clock->jitterNs) / 1e6;
+    if (forwardUs >= 0) {
+        return forwardUs / 1000.0 + jitterMs;
+    }
+    if (oneWayNs >= 0) {
+        return oneWayNs / 1e6 + jitterMs;
+    }
+    return RttMs(link) / 2.0;
+}
+
+// 예상 전달 시간 (ms). 손실되면 다시 보내야 하므로 손실률만큼 늘려 잡음
+static double DeliveryCost(const Link* link, DWORD length, BYTE priority) {
+    double loss = link->stats.loss < 0.9 ? link->stats.loss : 0.9;
+    return (OneWayMs(link) + TransmitMs(link, length, priority)) / (1.0 - loss);
+}
+
+static uint64_t RtoNs(const Link* link, DWORD length, BYTE priority, int attempts) {
+    double rto = RttMs(link) + 4.0 * (link->measured ? link->stats.rttVarMs : LINK_INITIAL_RTT_MS / 2.0) + TransmitMs(link, length, priority);
+    for (int i = 1; i < attempts && i < 4; i++) {
+        rto *= 2.0; // 같은 메시지가 계속 손실되면 물러섬
+    }
+    rto = rto < LINK_MIN_RTO_MS ? LINK_MIN_RTO_MS : rto > LINK_MAX_RTO_MS ? LINK_MAX_RTO_MS : rto;
+    return (uint64_t)(rto * 1000000.0);
+}
+
+// 살아 있는 링크 중 가장 빠른 것. 살아 있는 링크가 없으면 포트가 열린 링크 중에서 고름
+static int PickLink(DWORD length, BYTE priority) {
+    int best = -1;
+    bool bestUp = false;
+    double bestCost = 0.0;
+    for (int i = 0; i < sched.linkCount; i++) {
+        const Link* link = &sched.links[i];
+        if (!PortOpen(link)) {
+            continue;
+        }
+        double cost = DeliveryCost(link, length, priority);
+        if (best < 0 || (link->stats.up && !bestUp) || (link->stats.up == bestUp && cost < bestCost)) {
+            best = i;
+            bestUp = link->stats.up;
+            bestCost = cost;
+        }
+    }
+    return best;
+}
+
+static void UpdateRtt(Link* link, double sampleMs) {
+    if (!link->measured) {
+        link->stats.rttMs = sampleMs;
+        link->stats.rttVarMs = sampleMs / 2.0;
+        link->measured = true;
+        return;
+    }
+    double error = sampleMs - link->stats.rttMs;
+    link->stats.rttVarMs += ((error < 0 ? -error : error) - link->stats.rttVarMs) / 4.0;
+    link->stats.rttMs += error / 8.0;
+}
+
+// 메시지를 보낸 뒤 확인된 바이트를 걸린 시간으로 나눈 값을 표본으로 삼는다.
+// 보내는 간격과 확인 간격 중 긴 쪽을 쓰므로 확인이 몰려 와도 속도가 부풀려지지 않는다.
+// 보낼 것이 적을 때의 표본은 실제 속도보다 작으므로 최근 LINK_RATE_WINDOW_MS 동안의 최댓값을 쓴다.
+static void UpdateRate(Link* link, const SchedMessage* message, uint64_t now) {
+    link->delivery.bytes += message->length + SCHED_HEADER_SIZE + LINK_FRAME_OVERHEAD;
+    link->delivery.ns = now;
+    link->delivery.sentNs = message->sentNs;
+    uint64_t sendElapsed = message->sentNs - message->delivery.sentNs;
+    uint64_t ackElapsed = now - message->delivery.ns;
+    uint64_t interval = sendElapsed > ackElapsed ? sendElapsed : ackElapsed;
+    if (interval < LINK_RATE_MIN_INTERVAL_MS * 1000000ULL) {
+        return;
+    }
+    double sample = (link->delivery.bytes - message->delivery.bytes) * 10.0 * 1e9 / interval;
+    if (sample >= link->rateBps || now - link->rateNs > LINK_RATE_WINDOW_MS * 1000000ULL) {
+        link->rateBps = sample;
+        link->rateNs = now;
+        AtomicStoreRelease32(&link->rateBpsShared, (int32_t)sample);
+    }
+}
+
+static void MarkDown(Link* link) {
+    if (link->stats.up) {
+        link->stats.up = false;
+        link->stats.downs++;
+    }
+}
+
+// 마지막으로 프레임을 받은 뒤 지난 시간. 수신 처리 스레드가 now 보다 늦게 갱신했으면 0
+static uint64_t SinceHeardNs(const Link* link, uint64_t now) {
+    uint64_t heard = (uint64_t)AtomicLoadAcquire64(&link->lastHeardNs);
+    return now > heard ? now - heard : 0;
+}
+
+// 확인 응답이나 PROBE 응답으로 링크가 살아 있음을 확인
+static void MarkAlive(Link* link, uint64_t now) {
+    AtomicStoreRelease64(&link->lastHeardNs, now);
+    link->consecutiveTimeouts = 0;
+    link->stats.up = true;
+}
+
+static void OnSchedWritten(ModemConfig* modem, uint32_t messageId, bool success) {
+    (void)modem;
+    (void)messageId;
+    (void)success; // 쓰기 실패도 RTO 만료로 처리
+}
+
+// 송신 큐 등급: 모든 링크로 보내는 긴급 메시지가 가장 먼저, 링크 묶음 조각은 대량 전송으로
+static BYTE MessageClass(const SchedMessage* message) {
+    if (message->redundant) {
+        return TX_CLASS_CONTROL;
+    }
+    return message->channel == SCHED_CHANNEL_BOND ? TX_CLASS_BULK : TX_CLASS_NORMAL;
+}
+
+// 메시지의 사본 하나를 index 번째 링크의 송신 큐에 넣는다 (lock 을 잡은 상태).
+// 상대와 압축이 협상된 링크면 압축해서 보냄. 송신 큐가 가득 차면 false
+// 사본은 머리만 새로 만들고 본문은 메시지 블록(압축했으면 압축한 블록)을 참조한다
+static bool SendCopy(SchedMessage* message, int index, uint64_t now) {
+    Link* link = &sched.links[index];
+    BYTE header[SCHED_HEADER_SIZE];
+    header[0] = (BYTE)sched.session;
+    header[1] = (BYTE)(sched.session >> 8);
+    PutU32(header + 2, message->id);
+    header[6] = message->channel;
+    header[7] = COMPRESS_NONE;
+    BYTE* block = (BYTE*)message;
+    const BYTE* body = message->data;
+    DWORD bodyLength = message->length;
+    BYTE* packed = NULL;
+    if (AtomicLoadAcquire32(&link->modem->peerCompression) == COMPRESS_LZ && (packed = PoolAlloc(SCHED_MAX_MESSAGE)) != NULL) {
+        DWORD packedLength = CompressBlock(message->data, message->length, packed, SCHED_MAX_MESSAGE);
+        if (packedLength > 0) {
+            header[7] = COMPRESS_LZ;
+            block = packed;
+            body = packed;
+            bodyLength = packedLength;
+        }
+    }
+    uint32_t txId = TransmitEnqueueGather(link->modem, MessageClass(message), FRAME_TYPE_LINK_DATA, header, sizeof(header), block, body, bodyLength,
+        OnSchedWritten);
+    PoolRelease(packed);
+    if (txId == 0) {
+        return false;
+    }
+    // 보내고 있는 메시지가 없던 링크는 지금부터 잼 (쉬던 시간이 표본에 섞이지 않도록)
+    if (link->inFlight++ == 0) {
+        link->delivery.ns = now;
+        link->delivery.sentNs = now;
+    }
+    message->delivery = link->delivery;
+    message->linkMask |= 1u << index;
+    link->stats.messagesSent++;
+    return true;
+}
+
+// 메시지를 지금 가장 좋은 링크로 보낸다. redundant 메시지는 살아 있는 모든 링크로 (lock 을 잡은 상태)
+// 확인 기한은 가장 늦게 도착할 사본의 RTO
+static void SendMessage(SchedMessage* message, uint64_t now) {
+    message->attempts++;
+    message->linkMask = 0;
+    bool anyUp = false;
+    bool anyOpen = false;
+    for (int i = 0; i < sched.linkCount; i++) {
+        anyOpen = anyOpen || PortOpen(&sched.links[i]);
+        anyUp = anyUp || (PortOpen(&sched.links[i]) && sched.links[i].stats.up);
+    }
+    int first = -1;
+    uint64_t rto = 0;
+    for (int i = 0; i < sched.linkCount; i++) {
+        int index = i;
+        if (!message->redundant) {
+            index = PickLink(message->length, MessageClass(message));
+            if (index < 0) {
+                break;
+            }
+            if (message->link >= 0 && message->link != index) {
+                message->rerouted = true;
+                sched.stats.rerouted++;
+            }
+        }
+        // 살아 있는 링크가 없으면 포트가 열린 모든 링크로
+        else if (!PortOpen(&sched.links[index]) || (anyUp && !sched.links[index].stats.up)) {
+            continue;
+        }
+        if (SendCopy(message, index, now)) {
+            uint64_t linkRto = RtoNs(&sched.links[index], message->length, MessageClass(message), message->attempts);
+            rto = linkRto > rto ? linkRto : rto;
+            first = first < 0 ? index : first;
+        }
+        if (!message->redundant) {
+            break;
+        }
+    }
+    message->link = first;
+    if (first < 0) {
+        if (anyOpen) {
+            message->attempts--; // 송신 큐가 가득 찬 것은 링크 손실이 아님
+        }
+        message->deadlineNs = now + SCHED_RETRY_MS * 1000000ULL;
+        return;
+    }
+    message->sentNs = now;
+    message->deadlineNs = now + rto;
+}
+
+static void SendProbe(Link* link, uint64_t now) {
+    BYTE probe[PROBE_SIZE];
+    PutU32(probe, (uint32_t)now);
+    PutU32(probe + 4, (uint32_t)(now >> 32));
+    TransmitEnqueueNotify(link->modem, FRAME_TYPE_LINK_PROBE, probe, sizeof(probe), OnSchedWritten);
+    link->lastProbeNs = now;
+}
+
+// 대기 목록에서 message 를 뺀다 (previous 는 앞 메시지, 맨 앞이면 NULL)
+static void RemovePending(SchedMessage* previous, SchedMessage* message) {
+    if (previous == NULL) {
+        sched.pending = message->next;
+    }
+    else {
+        previous->next = message->next;
+    }
+    if (sched.pendingTail == message) {
+        sched.pendingTail = previous;
+    }
+    sched.pendingCount--;
+}
+
+// RTO 가 지난 메시지를 다시 보내고 링크 상태를 갱신. 포기한 메시지는 failed 목록으로 옮김
+static void ServiceLinks(uint64_t now, SchedMessage** failed) {
+    SchedMessage* previous = NULL;
+    SchedMessage* next = sched.pending;
+    while (next != NULL) {
+        SchedMessage* message = next;
+        next = message->next;
+        if (now < message->deadlineNs) {
+            previous = message;
+            continue;
+        }
+        for (int i = 0; i < sched.linkCount; i++) {
+            if (!(message->linkMask & (1u << i))) {
+                continue;
+            }
+            Link* link = &sched.links[i];
+            link->stats.timeouts++;
+            link->inFlight--;
+            link->stats.loss += (1.0 - link->stats.loss) / 8.0;
+            if (++link->consecutiveTimeouts >= LINK_DOWN_TIMEOUTS) {
+                MarkDown(link);
+            }
+        }
+        message->linkMask = 0;
+        if (message->attempts >= SCHED_MAX_ATTEMPTS) {
+            RemovePending(previous, message);
+            sched.stats.failed++;
+            message->next = *failed;
+            *failed = message;
+            continue;
+        }
+        SendMessage(message, now);
+        previous = message;
+    }
+
+    for (int i = 0; i < sched.linkCount; i++) {
+        Link* link = &sched.links[i];
+        if (!PortOpen(link)) {
+            MarkDown(link);
+            continue;
+        }
+        uint64_t silentNs = SinceHeardNs(link, now);
+        if (silentNs > LINK_DOWN_MS * 1000000ULL) {
+            MarkDown(link);
+        }
+        // 최근에 아무것도 받지 못한 링크에만 PROBE (트래픽이 있으면 확인 응답으로 충분)
+        if (now - link->lastProbeNs >= LINK_PROBE_MS * 1000000ULL && (silentNs >= LINK_PROBE_MS * 1000000ULL || !link->stats.up)) {
+            SendProbe(link, now);
+        }
+    }
+}
+
+// 메시지를 보낸 채널에 결과를 통지 (lock 밖에서)
+static void NotifyDone(const SchedMessage* message, ModemConfig* modem, bool success) {
+    SchedulerDoneProc done = sched.channels[message->channel].done;
+    if (done != NULL) {
+        done(modem, message->id, success);
+    }
+}
+
+static DWORD WINAPI SchedulerThread(LPVOID param) {
+    (void)param;
+    while (AtomicLoadAcquire32(&sched.running)) {
+        SchedMessage* failed = NULL;
+        PlatformMutexLock(&sched.lock);
+        ServiceLinks(PlatformNowNs(), &failed);
+        PlatformMutexUnlock(&sched.lock);
+
+        // 콜백은 lock 밖에서
+        while (failed != NULL) {
+            SchedMessage* message = failed;
+            failed = message->next;
+            NotifyDone(message, message->link >= 0 ? sched.links[message->link].modem : NULL, false);
+            PoolRelease((BYTE*)message);
+        }
+        PlatformEventWait(&sched.wake, SCHED_TICK_MS);
+    }
+    return 0;
+}
+
+bool SchedulerStart(ModemConfig* const* links, int count, SchedulerDeliverProc deliver, SchedulerDoneProc done) {
+    memset(&sched, 0, sizeof(sched));
+    sched.channels[SCHED_CHANNEL_MESSAGE].deliver = deliver;
+    sched.channels[SCHED_CHANNEL_MESSAGE].done = done;
+    // 다시 시작하면 세션이 바뀌므로 상대는 이전 id 기록을 버림
+    sched.session = (uint16_t)(PlatformNowNs() >> 20);
+    for (int i = 0; i < count && i < MAX_MODEMS; i++) {
+        sched.links[i].modem = links[i];
+    }
+    sched.linkCount = count < MAX_MODEMS ? count : MAX_MODEMS;
+    PlatformMutexInit(&sched.lock);
+    if (!PlatformEventInit(&sched.wake)) {
+        return false;
+    }
+    AtomicStoreRelease32(&sched.running, 1);
+    if (!PlatformThreadStart(&sched.thread, SchedulerThread, NULL)) {
+        AtomicStoreRelease32(&sched.running, 0);
+        PlatformEventDestroy(&sched.wake);
+        return false;
+    }
+    return true;
+}
+
+void SchedulerStop(void) {
+    if (!AtomicLoadAcquire32(&sched.running)) {
+        return;
+    }
+    AtomicStoreRelease32(&sched.running, 0);
+    PlatformEventSet(&sched.wake);
+    PlatformThreadJoin(sched.thread);
+
+    while (sched.pending != NULL) {
+        SchedMessage* message = sched.pending;
+        sched.pending = message->next;
+        NotifyDone(message, message->link >= 0 ? sched.links[message->link].modem : NULL, false);
+        PoolRelease((BYTE*)message);
+    }
+    PlatformEventDestroy(&sched.wake);
+    PlatformMutexDestroy(&sched.lock);
+}
+
+void SchedulerSetChannel(BYTE channel, SchedulerDeliverProc deliver, SchedulerDoneProc done) {
+    if (channel < SCHED_MAX_CHANNELS) {
+        sched.channels[channel].deliver = deliver;
+        sched.channels[channel].done = done;
+    }
+}
+
+static uint32_t QueueMessage(BYTE channel, bool redundant, const BYTE* data, DWORD length) {
+    if (!AtomicLoadAcquire32(&sched.running) || channel >= SCHED_MAX_CHANNELS || length == 0 || length > SCHED_MAX_MESSAGE) {
+        return 0;
+    }
+    // 메시지는 풀 블록 하나에 담고, 링크로 보내는 사본은 본문을 복사하지 않고 이 블록을 참조한다
+    SchedMessage* message = (SchedMessage*)PoolAlloc(sizeof(SchedMessage) + length);
+    if (message == NULL) {
+        return 0;
+    }
+    memcpy(message->data, data, length);
+    message->length = length;
+    message->channel = channel;
+    message->link = -1;
+    message->linkMask = 0;
+    message->attempts = 0;
+    message->redundant = redundant;
+    message->rerouted = false;
+
+    PlatformMutexLock(&sched.lock);
+    // 수신 측 중복 검사 범위를 넘지 않도록 가장 오래된 미확인 메시지와의 id 차이를 제한
+    if (sched.pendingCount >= SCHED_MAX_PENDING || (sched.pending != NULL && sched.nextId + 1 - sched.pending->id >= SCHED_DEDUP_WINDOW)) {
+        PlatformMutexUnlock(&sched.lock);
+        PoolRelease((BYTE*)message);
+        return 0;
+    }
+    if (++sched.nextId == 0) {
+        sched.nextId = 1;
+    }
+    message->id = sched.nextId;
+    uint64_t now = PlatformNowNs();
+    if (sched.firstSendNs == 0) {
+        sched.firstSendNs = now;
+    }
+    message->firstSentNs = now;
+    message->next = NULL;
+    if (sched.pendingTail == NULL) {
+        sched.pending = message;
+    }
+    else {
+        sched.pendingTail->next = message;
+    }
+    sched.pendingTail = message;
+    sched.pendingCount++;
+    SendMessage(message, now);
+    sched.stats.routed++;
+    if (redundant) {
+        sched.stats.redundant++;
+    }
+    uint32_t id = message->id;
+    PlatformMutexUnlock(&sched.lock);
+    return id;
+}
+
+uint32_t SchedulerSend(const BYTE* data, DWORD length) {
+    return QueueMessage(SCHED_CHANNEL_MESSAGE, false, data, length);
+}
+
+uint32_t SchedulerSendOn(BYTE channel, const BYTE* data, DWORD length) {
+    return QueueMessage(channel, false, data, length);
+}
+
+uint32_t SchedulerSendRedundant(const BYTE* data, DWORD length) {
+    return QueueMessage(SCHED_CHANNEL_MESSAGE, true, data, length);
+}
+
+ModemConfig* SchedulerPick(DWORD length) {
+    if (!AtomicLoadAcquire32(&sched.running)) {
+        return NULL;
+    }
+    PlatformMutexLock(&sched.lock);
+    int index = PickLink(length, TX_CLASS_NORMAL);
+    ModemConfig* modem = index >= 0 ? sched.links[index].modem : NULL;
+    PlatformMutexUnlock(&sched.lock);
+    return modem;
+}
+
+static void HandleAck(Link* link, const BYTE* payload, DWORD length, uint64_t now) {
+    if (length != LINK_ACK_SIZE) {
+        return;
+    }
+    uint32_t id = GetU32(payload);
+    SchedMessage* acked = NULL;
+    PlatformMutexLock(&sched.lock);
+    MarkAlive(link, now);
+    SchedMessage* previous = NULL;
+    for (SchedMessage* message = sched.pending; message != NULL; previous = message, message = message->next) {
+        if (message->id != id) {
+            continue;
+        }
+        // 처음 보낸 것에 대한 확인일 때만 RTT 표본으로 사용 (재전송이면 어느 쪽의 확인인지 모름)
+        // 모든 링크로 보낸 메시지도 사본마다 그 링크로 확인이 오므로 확인이 온 링크의 RTT 가 됨
+        uint32_t linkBit = 1u << (link - sched.links);
+        if (message->attempts == 1 && (message->linkMask & linkBit)) {
+            UpdateRtt(link, (now - message->sentNs) / 1e6);
+        }
+        // 전달 속도는 한 링크로만 보낸 메시지로 잼 (보낼 때의 전달 상태가 그 링크의 것)
+        if (!message->redundant && (message->linkMask & linkBit)) {
+            UpdateRate(link, message, now);
+        }
+        for (int i = 0; i < sched.linkCount; i++) {
+            if (message->linkMask & (1u << i)) {
+                sched.links[i].inFlight--;
+            }
+        }
+        link->stats.messagesAcked++;
+        link->stats.bytesAcked += message->length;
+        link->stats.loss -= link->stats.loss / 8.0;
+        sched.stats.delivered++;
+        sched.stats.bytesDelivered += message->length;
+        // 포트가 빠진 링크가 있으면 다른 링크로 처음 확인된 때까지가 그 링크의 전환 시간
+        for (int i = 0; i < sched.linkCount; i++) {
+            Link* failed = &sched.links[i];
+            if (failed != link && failed->failedNs != 0) {
+                double failoverMs = (now - failed->failedNs) / 1e6;
+                failed->stats.failovers++;
+                failed->stats.lastFailoverMs = failoverMs;
+                if (failoverMs > failed->stats.maxFailoverMs) {
+                    failed->stats.maxFailoverMs = failoverMs;
+                }
+                failed->failedNs = 0;
+            }
+        }
+        if (message->rerouted) {
+            double failoverMs = (now - message->firstSentNs) / 1e6;
+            sched.stats.lastFailoverMs = failoverMs;
+            if (failoverMs > sched.stats.maxFailoverMs) {
+                sched.stats.maxFailoverMs = failoverMs;
+            }
+        }
+        RemovePending(previous, message);
+        acked = message;
+        break;
+    }
+    PlatformMutexUnlock(&sched.lock);
+
+    if (acked != NULL) {
+        NotifyDone(acked, link->modem, true);
+        PoolRelease((BYTE*)acked);
+    }
+}
+
+// 이미 전달한 메시지면 true, 아니면 받은 것으로 표시하고 false. lock 없이 여러 스레드에서 불러도 된다.
+// 송신 측은 가장 오래된 미확인 메시지로부터 SCHED_DEDUP_WINDOW 안의 id 만 쓰므로, 같은 자리에 같은
+// 세션의 더 새 id 가 있으면 이 id 는 이미 확인(수신)된 것이다. 자리는 비교 후 교환으로 앞으로만 바꾼다.
+static bool IsDuplicate(uint16_t session, uint32_t id) {
+    volatile int64_t* slot = &sched.dedup[id % SCHED_DEDUP_WINDOW];
+    int64_t mine = (int64_t)((uint64_t)session << 32 | id);
+    for (;;) {
+        int64_t seen = AtomicLoadAcquire64(slot);
+        if (seen == mine) {
+            return true;
+        }
+        // 다른 세션(상대가 다시 시작함)의 기록은 빈 자리로 봄
+        if (seen != 0 && (uint16_t)((uint64_t)seen >> 32) == session && (int32_t)((uint32_t)seen - id) > 0) {
+            return true; // 늦게 온 사본
+        }
+        if (AtomicCompareExchange64(slot, seen, mine)) {
+            return false;
+        }
+    }
+}
+
+static void HandleData(ModemConfig* modem, const BYTE* payload, DWORD length) {
+    if (length < SCHED_HEADER_SIZE) {
+        return;
+    }
+    uint16_t session = (uint16_t)(payload[0] | payload[1] << 8);
+    uint32_t id = GetU32(payload + 2);
+
+    // 풀 수 없는 메시지는 확인하지 않고 id 도 기록하지 않음 (보낸 쪽이 시간 초과로 다른 링크에 다시 보냄)
+    static BYTE expanded[SCHED_MAX_MESSAGE]; // 수신 처리 스레드만 사용
+    const BYTE* data = payload + SCHED_HEADER_SIZE;
+    DWORD dataLength = length - SCHED_HEADER_SIZE;
+    BYTE channel = payload[6];
+    if (channel >= SCHED_MAX_CHANNELS) {
+        return;
+    }
+    if (payload[7] == COMPRESS_LZ) {
+        if (!CompressExpand(data, dataLength, expanded, sizeof(expanded), &dataLength)) {
+            modem->compress.expandErrors++;
+            return;
+        }
+        data = expanded;
+    }
+    else if (payload[7] != COMPRESS_NONE) {
+        return;
+    }
+
+    BYTE ack[LINK_ACK_SIZE];
+    PutU32(ack, id);
+    TransmitEnqueueNotify(modem, FRAME_TYPE_LINK_ACK, ack, sizeof(ack), OnSchedWritten);
+    // 확인이 유실되어 다른 링크로 다시 온 메시지, 모든 링크로 보낸 메시지의 늦은 사본은 한 번만 전달
+    if (IsDuplicate(session, id)) {
+        AtomicIncrement32(&sched.duplicates);
+        return;
+    }
+    if (sched.channels[channel].deliver != NULL) {
+        sched.channels[channel].deliver(modem, data, dataLength);
+    }
+}
+
+bool SchedulerHandleFrame(ModemConfig* modem, const FrameHeader* header, const BYTE* payload, DWORD length) {
+    if (header == NULL || !AtomicLoadAcquire32(&sched.running)) {
+        return false;
+    }
+    uint64_t now = PlatformNowNs();
+    Link* link = FindLink(modem);
+    if (link != NULL) {
+        AtomicStoreRelease64(&link->lastHeardNs, now);
+    }
+
+    switch (header->type) {
+    case FRAME_TYPE_LINK_PROBE:
+        if (length == PROBE_SIZE) {
+            TransmitEnqueueNotify(modem, FRAME_TYPE_LINK_PROBE_ACK, payload, length, OnSchedWritten);
+        }
+        return true;
+    case FRAME_TYPE_LINK_PROBE_ACK:
+        if (link != NULL && length == PROBE_SIZE) {
+            uint64_t sentNs = (uint64_t)GetU32(payload) | (uint64_t)GetU32(payload + 4) << 32;
+            PlatformMutexLock(&sched.lock);
+            if (sentNs <= now) {
+                UpdateRtt(link, (now - sentNs) / 1e6);
+            }
+            MarkAlive(link, now);
+            PlatformMutexUnlock(&sched.lock);
+        }
+        return true;
+    case FRAME_TYPE_LINK_DATA:
+        HandleData(modem, payload, length);
+        return true;
+    case FRAME_TYPE_LINK_ACK:
+        if (link != NULL) {
+            HandleAck(link, payload, length, now);
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+void SchedulerLinkFailed(ModemConfig* modem) {
+    if (!AtomicLoadAcquire32(&sched.running)) {
+        return;
+    }
+    PlatformMutexLock(&sched.lock);
+    Link* link = FindLink(modem);
+    if (link != NULL) {
+        uint64_t now = PlatformNowNs();
+        uint32_t linkBit = 1u << (link - sched.links);
+        MarkDown(link);
+        link->failedNs = link->inFlight > 0 ? now : 0; // 옮길 메시지가 있을 때만 전환 시간을 잼
+        for (SchedMessage* message = sched.pending; message != NULL; message = message->next) {
+            if (!(message->linkMask & linkBit)) {
+                continue;
+            }
+            message->linkMask &= ~linkBit;
+            link->inFlight--;
+            // 다른 링크에 사본이 남은 메시지(모든 링크로 보낸 것)는 그 확인을 기다림
+            if (message->linkMask == 0) {
+                message->attempts--; // 손실이 아니므로 시도 횟수에 넣지 않음
+                SendMessage(message, now);
+            }
+        }
+    }
+    PlatformMutexUnlock(&sched.lock);
+}
+
+void SchedulerLinkRestored(ModemConfig* modem) {
+    if (!AtomicLoadAcquire32(&sched.running)) {
+        return;
+    }
+    PlatformMutexLock(&sched.lock);
+    Link* link = FindLink(modem);
+    if (link != NULL) {
+        link->consecutiveTimeouts = 0;
+        link->lastProbeNs = 0;
+    }
+    PlatformMutexUnlock(&sched.lock);
+    PlatformEventSet(&sched.wake);
+}
+
+bool SchedulerQueryLink(const ModemConfig* modem, LinkStats* stats) {
+    if (!AtomicLoadAcquire32(&sched.running)) {
+        return false;
+    }
+    PlatformMutexLock(&sched.lock);
+    Link* link = FindLink(modem);
+    if (link != NULL) {
+        *stats = link->stats;
+        stats->rateBps = LinkRateBps(link);
+        stats->rateMeasured = link->rateBps > 0.0;
+        if (!link->measured) {
+            stats->rttMs = 0.0;
+            stats->rttVarMs = 0.0;
+        }
+    }
+    PlatformMutexUnlock(&sched.lock);
+    return link != NULL;
+}
+
+int SchedulerMeasuredRate(const ModemConfig* modem) {
+    if (!AtomicLoadAcquire32(&sched.running)) {
+        return 0;
+    }
+    const Link* link = FindLink(modem);
+    return link != NULL ? AtomicLoadAcquire32(&link->rateBpsShared) : 0;
+}
+
+ModemConfig* SchedulerLink(int index) {
+    return index >= 0 && index < sched.linkCount ? sched.links[index].modem : NULL;
+}
+
+void SchedulerQueryStats(SchedulerStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!AtomicLoadAcquire32(&sched.running)) {
+        return;
+    }
+    PlatformMutexLock(&sched.lock);
+    *stats = sched.stats;
+    stats->duplicates = AtomicLoadAcquire32(&sched.duplicates);
+    if (sched.firstSendNs != 0) {
+        double seconds = (PlatformNowNs() - sched.firstSendNs) / 1e9;
+        stats->throughput = seconds > 0.0 ? stats->bytesDelivered / seconds : 0.0;
+    }
+    PlatformMutexUnlock(&sched.lock);
+}
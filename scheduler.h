@@ -0,0 +1,107 @@
+﻿#pragma once
+#include "platform.h"
+#include "modem.h"
+
+// 하이브리드 링크 스케줄러
+// 등록된 링크(모뎀) 가운데 메시지마다 예상 전달 시간이 가장 짧은 링크를 골라 보낸다.
+// 예상 전달 시간 = (단방향 지연 + 송신 큐 대기분과 메시지의 전송 시간) / (1 - 손실률)
+// 단방향 지연은 Timestamps=1 로 시계가 동기화된 링크면 타임스탬프로 잰 지연과 지터(clocksync.h), 아니면 평활 RTT 의 절반.
+// 전송 시간은 확인 응답으로 잰 링크의 전달 속도(최근 LINK_RATE_WINDOW_MS 동안의 최댓값)로,
+// 아직 재지 못했으면 LinkRate 로 계산한다.
+// 따라서 빛 모뎀이 살아 있으면 빛 모뎀으로, 끊기면 호출한 쪽 모르게 음향 모뎀으로 보낸다.
+// 메시지는 FRAME_TYPE_LINK_DATA 로 보내고 상대가 FRAME_TYPE_LINK_ACK 로 확인한다. RTO 안에 확인이
+// 없으면 손실로 보고 그 시점에 가장 좋은 링크로 다시 보낸다. 연속으로 LINK_DOWN_TIMEOUTS 번
+// 손실되거나 LINK_DOWN_MS 동안 아무 프레임도 오지 않으면 링크를 끊긴 것으로 표시한다.
+// 한가한 링크와 끊긴 링크에는 LINK_PROBE_MS 마다 PROBE 를 보내 RTT 를 재고 복구를 확인한다.
+// 수신 측은 메시지 id 로 중복(확인이 유실되어 다시 온 메시지)을 걸러 한 번만 전달한다.
+// 송신 측은 확인되지 않은 가장 오래된 id 로부터 SCHED_DEDUP_WINDOW 안의 id 만 쓰므로, 수신 측은
+// id % SCHED_DEDUP_WINDOW 자리마다 마지막 id 하나만 기억하면 되고, 검사는 lock 없이 비교 후 교환으로 한다.
+// 긴급 명령처럼 지연이 중요한 메시지는 SchedulerSendRedundant 로 살아 있는 모든 링크에 동시에 보내고,
+// 수신 측은 먼저 도착한 사본만 전달한다 (나머지는 같은 중복 검사로 버림).
+// 메시지는 채널로 구분되어 채널마다 등록된 콜백으로 전달/통지된다 (사용자 메시지, 링크 묶음 조각).
+
+#define SCHED_HEADER_SIZE 8   // 세션(2) | id(4) | 채널(1) | 인코딩(1)
+#define SCHED_DEDUP_WINDOW 4096
+#define SCHED_MAX_MESSAGE (FRAME_MAX_PAYLOAD - SCHED_HEADER_SIZE)
+#define SCHED_MAX_PENDING 256 // 확인을 기다리는 메시지 수 상한
+#define SCHED_MAX_ATTEMPTS 8
+#define LINK_PROBE_MS 1000
+#define LINK_DOWN_MS 3000
+#define LINK_DOWN_TIMEOUTS 2
+#define LINK_INITIAL_RTT_MS 500
+#define LINK_MIN_RTO_MS 100
+#define LINK_MAX_RTO_MS 10000
+#define LINK_RATE_WINDOW_MS 10000 // 전달 속도 표본의 최댓값을 유지하는 기간
+
+// 채널
+#define SCHED_CHANNEL_MESSAGE 0 // 'auto' 로 보낸 사용자 메시지 (SchedulerStart 의 콜백)
+#define SCHED_CHANNEL_BOND 1    // 링크 묶음 조각 (bond.h)
+#define SCHED_MAX_CHANNELS 2
+
+typedef struct {
+    bool up;
+    double rttMs;           // 평활 RTT (확인 응답 기준)
+    double rttVarMs;
+    double loss;            // 최근 손실률 (지수 이동 평균)
+    int rateBps;            // 링크 선택에 쓰는 송신 속도 (측정값, 없으면 LinkRate)
+    bool rateMeasured;
+    int32_t messagesSent;
+    int32_t messagesAcked;
+    int32_t timeouts;
+    int32_t downs;          // 끊김으로 표시된 횟수
+    int32_t failovers;      // 포트가 빠질 때 확인을 기다리던 메시지를 다른 링크로 옮긴 횟수
+    double lastFailoverMs;  // 포트가 빠진 때부터 다른 링크로 처음 확인될 때까지
+    double maxFailoverMs;
+    int64_t bytesAcked;
+} LinkStats;
+
+typedef struct {
+    int32_t routed;
+    int32_t delivered;
+    int32_t failed;
+    int32_t rerouted;       // 다른 링크로 다시 보낸 횟수
+    int32_t redundant;      // 모든 링크로 보낸 메시지
+    int32_t duplicates;     // 수신 측에서 걸러낸 중복 (모든 링크로 보낸 메시지의 늦은 사본 포함)
+    int64_t bytesDelivered;
+    double throughput;      // 첫 메시지부터 확인된 바이트/초
+    double lastFailoverMs;  // 다른 링크로 다시 보낸 메시지의 첫 송신부터 확인까지
+    double maxFailoverMs;
+} SchedulerStats;
+
+// 수신 처리 스레드에서 호출: 스케줄러로 보낸 메시지가 도착함 (중복 제거 후)
+typedef void (*SchedulerDeliverProc)(ModemConfig* modem, const BYTE* data, DWORD length);
+// 메시지가 확인되었거나(success, modem = 확인된 링크) 포기됨
+typedef void (*SchedulerDoneProc)(ModemConfig* modem, uint32_t messageId, bool success);
+
+// links 가 이 스케줄러가 고를 수 있는 링크 (모두 같은 상대와 연결된 프레임 모드 모뎀)
+// deliver, done 은 SCHED_CHANNEL_MESSAGE 채널의 콜백
+bool SchedulerStart(ModemConfig* const* links, int count, SchedulerDeliverProc deliver, SchedulerDoneProc done);
+// 다른 채널의 콜백을 등록한다 (SchedulerStart 뒤, 그 채널로 보내거나 받기 전에)
+void SchedulerSetChannel(BYTE channel, SchedulerDeliverProc deliver, SchedulerDoneProc done);
+// 확인을 기다리는 메시지는 실패로 통지하고 종료
+void SchedulerStop(void);
+
+// 메시지를 복사해 가장 좋은 링크로 보내고 메시지 id 를 반환한다.
+// 확인을 기다리는 메시지가 너무 많거나 보낼 수 없으면 0
+uint32_t SchedulerSend(const BYTE* data, DWORD length);
+uint32_t SchedulerSendOn(BYTE channel, const BYTE* data, DWORD length);
+// 같은 메시지를 살아 있는 모든 링크로 동시에 보낸다 (먼저 도착한 사본이 전달됨). 어느 사본이든 확인되면 완료
+uint32_t SchedulerSendRedundant(const BYTE* data, DWORD length);
+// length 바이트를 지금 보낸다면 고를 링크 (ARQ 로 보낼 큰 데이터용). 없으면 NULL
+ModemConfig* SchedulerPick(DWORD length);
+
+// 포트가 빠짐 (hotplug.h): 링크를 바로 끊긴 것으로 표시하고 확인을 기다리던 사본을 다른 링크로 다시 보낸다
+void SchedulerLinkFailed(ModemConfig* modem);
+// 포트가 다시 열림: 바로 PROBE 를 보내 확인되면 링크에 복귀시킨다
+void SchedulerLinkRestored(ModemConfig* modem);
+
+// 수신 처리 스레드에서 프레임마다 호출. 스케줄러 프레임이면 처리하고 true 를 반환
+bool SchedulerHandleFrame(ModemConfig* modem, const FrameHeader* header, const BYTE* payload, DWORD length);
+
+// 스케줄러 링크가 아니면 false
+bool SchedulerQueryLink(const ModemConfig* modem, LinkStats* stats);
+// index 번째 링크 (링크 수보다 크면 NULL)
+ModemConfig* SchedulerLink(int index);
+// modem 링크에서 확인 응답으로 잰 전달 속도 (bps). 아직 못 쟀거나 스케줄러 링크가 아니면 0 (lock 없이, 송신 스레드용)
+int SchedulerMeasuredRate(const ModemConfig* modem);
+void SchedulerQueryStats(SchedulerStats* stats);
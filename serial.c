@@ -0,0 +1,736 @@
+﻿#include "platform.h"
+#include "modem.h"
+
+#ifdef _WIN32
+
+#include <ntddser.h>
+
+// 중첩 I/O 완료 또는 깨우기 이벤트를 기다린다
+static int WaitOverlapped(ModemConfig* modem, OVERLAPPED* overlapped, DWORD* transferred) {
+    HANDLE handles[2] = { overlapped->hEvent, modem->io.hWakeEvent };
+    DWORD result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+    if (result == WAIT_OBJECT_0) {
+        return GetOverlappedResult(modem->hSerial, overlapped, transferred, FALSE) ? SERIAL_OK : SERIAL_ERROR;
+    }
+
+    // 깨우기 요청 또는 대기 실패: 진행 중인 I/O를 취소하고 완료될 때까지 기다림
+    CancelIoEx(modem->hSerial, overlapped);
+    GetOverlappedResult(modem->hSerial, overlapped, transferred, TRUE);
+    return result == WAIT_OBJECT_0 + 1 ? SERIAL_STOPPED : SERIAL_ERROR;
+}
+
+// 중첩 모드로 연 핸들에는 DeviceIoControl 도 OVERLAPPED 를 넘겨야 한다
+static bool SerialIoctl(ModemConfig* modem, DWORD code, LPVOID input, DWORD inputSize) {
+    OVERLAPPED overlapped = { 0 };
+    DWORD dwBytesReturned = 0;
+    overlapped.hEvent = modem->io.hWriteEvent;
+    if (!DeviceIoControl(modem->hSerial, code, input, inputSize, NULL, 0, &dwBytesReturned, &overlapped)) {
+        if (GetLastError() != ERROR_IO_PENDING) {
+            return false;
+        }
+        return GetOverlappedResult(modem->hSerial, &overlapped, &dwBytesReturned, TRUE) != FALSE;
+    }
+    return true;
+}
+
+static void CloseEvent(HANDLE* hEvent) {
+    if (*hEvent != NULL) {
+        CloseHandle(*hEvent);
+        *hEvent = NULL;
+    }
+}
+
+// 회선 설정 (보레이트, 데이터 비트, 스톱 비트, 패리티). 열 때와 실행 중 변경에 함께 쓰임.
+// DCB 의 BaudRate 는 임의의 값을 받으므로 드라이버가 실제로 적용한 속도를 다시 읽어 허용 오차 안인지 확인한다
+static bool SetLineSettings(ModemConfig* modem, int baudRate, int byteSize, int stopBits, int parity) {
+    DCB dcbSerialParams = { 0 };
+    dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
+    if (!GetCommState(modem->hSerial, &dcbSerialParams)) {
+        return false;
+    }
+    dcbSerialParams.BaudRate = baudRate;
+    dcbSerialParams.ByteSize = (BYTE)byteSize;
+    dcbSerialParams.StopBits = (BYTE)stopBits;
+    dcbSerialParams.Parity = (BYTE)parity;
+    if (!SetCommState(modem->hSerial, &dcbSerialParams) || !GetCommState(modem->hSerial, &dcbSerialParams)) {
+        return false;
+    }
+    int64_t error = (int64_t)dcbSerialParams.BaudRate - baudRate;
+    return (error < 0 ? -error : error) * 100 <= (int64_t)baudRate * SERIAL_BAUD_TOLERANCE_PERCENT;
+}
+
+// 열린 핸들에 새 회선 설정을 적용한다 (오류 메시지는 SerialReconfigure 가 냄)
+static bool ReconfigurePort(ModemConfig* modem, int baudRate, int byteSize, int stopBits, int parity) {
+    if (modem->hSerial == INVALID_HANDLE_VALUE || !SetLineSettings(modem, baudRate, byteSize, stopBits, parity)) {
+        return false;
+    }
+    // 빠른 속도에서도 SERIAL_QUEUE_MS 만큼 담도록 드라이버 큐를 다시 잡음 (드라이버가 무시할 수 있음)
+    DWORD queueSize = SerialBufferSize(baudRate);
+    SetupComm(modem->hSerial, queueSize, queueSize);
+    return true;
+}
+
+bool OpenSerialPort(ModemConfig* modem) {
+    modem->io.emulator = NULL;
+    if (EmulatorIsPort(modem->portName)) {
+        return EmulatorAttach(modem, NULL, 0); // POSIX 빌드에서만 지원
+    }
+
+    //시리얼 포트 오픈 (이벤트 기반 수신을 위해 중첩 모드로 연다)
+    modem->hSerial = CreateFile(modem->portName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+    if (modem->hSerial == INVALID_HANDLE_VALUE) {
+        _ftprintf(stderr, TEXT("Error opening serial port %s\n"), modem->portName);
+        _ftprintf(stderr, TEXT("  Error Code: %d\n"), GetLastError());
+        return false;
+    }
+
+    // 중첩 I/O 완료 이벤트 생성 (깨우기 이벤트는 자동 리셋)
+    modem->io.hReadEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    modem->io.hWaitEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    modem->io.hWriteEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    modem->io.hWakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!modem->io.hReadEvent || !modem->io.hWaitEvent || !modem->io.hWriteEvent || !modem->io.hWakeEvent) {
+        _ftprintf(stderr, TEXT("Error creating I/O events for %s\n"), modem->portName);
+        CloseSerialPort(modem);
+        return false;
+    }
+
+    // 큐 사이즈 설정 (보레이트에 맞춰 SERIAL_QUEUE_MS 동안의 바이트)
+    DWORD queueSize = SerialBufferSize(modem->baudRate);
+    if (!SetupComm(modem->hSerial, queueSize, queueSize)) {
+        _ftprintf(stderr, TEXT("Error setting queue size for %s\n"), modem->portName);
+        CloseSerialPort(modem);
+        return false;
+    }
+
+    //타임 아웃 설정
+    // 이벤트 방식: 큐에 있는 만큼 즉시 반환 (MAXDWORD, 0, 0)
+    // 폴링 방식: 기존과 동일하게 30ms 동안 모아서 반환
+    COMMTIMEOUTS timeouts = { 0 };
+    if (modem->io.rxMode == SERIAL_RX_POLL) {
+        timeouts.ReadIntervalTimeout = 0;
+        timeouts.ReadTotalTimeoutMultiplier = 0;
+        timeouts.ReadTotalTimeoutConstant = 30;
+    }
+    else {
+        timeouts.ReadIntervalTimeout = MAXDWORD;
+        timeouts.ReadTotalTimeoutMultiplier = 0;
+        timeouts.ReadTotalTimeoutConstant = 0;
+    }
+    if (!SetCommTimeouts(modem->hSerial, &timeouts)) {
+        _ftprintf(stderr, TEXT("Error setting timeout for %s\n"), modem->portName);
+        CloseSerialPort(modem);
+        return false;
+    }
+
+    // 이벤트 마스크 설정 (EV_RXCHAR: 수신 이벤트, EV_ERR: 에러 이벤트)
+    DWORD eventMask = modem->io.rxMode == SERIAL_RX_POLL ? EV_ERR : EV_RXCHAR | EV_ERR;
+    if (!SetCommMask(modem->hSerial, eventMask)) {
+        _ftprintf(stderr, TEXT("Error setting event mask for %s\n"), modem->portName);
+        CloseSerialPort(modem);
+        return false;
+    }
+
+    //DCB 설정 적용
+    if (!SetLineSettings(modem, modem->baudRate, modem->byteSize, modem->stopBits, modem->parity)) {
+        _ftprintf(stderr, TEXT("Error setting comm state for %s (%d bps)\n"), modem->portName, modem->baudRate);
+        CloseSerialPort(modem);
+        return false;
+    }
+
+    //디바이스 컨트롤
+    SERIAL_CHARS SerialChars = { 0 };
+    SerialChars.EofChar = 0x0;
+    SerialChars.ErrorChar = 0x0;
+    SerialChars.BreakChar = 0x0;
+    SerialChars.EventChar = 0x0;
+    SerialChars.XonChar = 0x11;
+    SerialChars.XoffChar = 0x13;
+
+    if (!SerialIoctl(modem, IOCTL_SERIAL_SET_CHARS, &SerialChars, sizeof(SerialChars))) {
+        _ftprintf(stderr, TEXT("Error setting comm SERIAL CHARS for %s\n"), modem->portName);
+        CloseSerialPort(modem);
+        return false;
+    }
+
+    SERIAL_HANDFLOW HandFlow = { 0 };
+    HandFlow.ControlHandShake = 0x1;
+    HandFlow.FlowReplace = 0x40;
+    HandFlow.XonLimit = 0;
+    HandFlow.XoffLimit = 16384;
+
+    if (!SerialIoctl(modem, IOCTL_SERIAL_SET_HANDFLOW, &HandFlow, sizeof(HandFlow))) {
+        _ftprintf(stderr, TEXT("Error setting comm SERIAL HANDFLOW for %s\n"), modem->portName);
+        CloseSerialPort(modem);
+        return false;
+    }
+
+    // 퍼지 커맨드 실행
+    if (!PurgeComm(modem->hSerial, PURGE_TXABORT | PURGE_RXABORT | PURGE_TXCLEAR | PURGE_RXCLEAR)) {
+        _ftprintf(stderr, TEXT("Error purging comm ports for %s\n"), modem->portName);
+        CloseSerialPort(modem);
+        return false;
+    }
+
+    return true;
+}
+
+void CloseSerialPort(ModemConfig* modem) {
+    // 다른 스레드가 이 포트에서 대기 중일 수 있으므로 먼저 깨운 뒤 닫는다
+    AtomicStoreRelease32(&modem->io.closing, 1);
+    SerialWake(modem);
+    if (modem->hSerial != INVALID_HANDLE_VALUE) {
+        CloseHandle(modem->hSerial);
+        modem->hSerial = INVALID_HANDLE_VALUE;
+    }
+    CloseEvent(&modem->io.hReadEvent);
+    CloseEvent(&modem->io.hWaitEvent);
+    CloseEvent(&modem->io.hWriteEvent);
+    CloseEvent(&modem->io.hWakeEvent);
+}
+
+int SerialWaitRead(ModemConfig* modem, BYTE* buffer, DWORD size, DWORD* bytesRead) {
+    *bytesRead = 0;
+
+    if (modem->io.rxMode == SERIAL_RX_POLL) {
+        // 기존 방식: 버퍼가 차거나 30ms 타임아웃이 지날 때까지 블록
+        OVERLAPPED overlapped = { 0 };
+        overlapped.hEvent = modem->io.hReadEvent;
+        if (!ReadFile(modem->hSerial, buffer, size, NULL, &overlapped) && GetLastError() != ERROR_IO_PENDING) {
+            return SERIAL_ERROR;
+        }
+        return WaitOverlapped(modem, &overlapped, bytesRead);
+    }
+
+    for (;;) {
+        // 드라이버 큐에 이미 데이터가 있으면 바로 읽음
+        DWORD errors = 0;
+        COMSTAT status = { 0 };
+        if (!ClearCommError(modem->hSerial, &errors, &status)) {
+            return SERIAL_ERROR;
+        }
+        if (status.cbInQue > 0) {
+            OVERLAPPED overlapped = { 0 };
+            overlapped.hEvent = modem->io.hReadEvent;
+            DWORD toRead = status.cbInQue < size ? status.cbInQue : size;
+            if (!ReadFile(modem->hSerial, buffer, toRead, NULL, &overlapped) && GetLastError() != ERROR_IO_PENDING) {
+                return SERIAL_ERROR;
+            }
+            return WaitOverlapped(modem, &overlapped, bytesRead);
+        }
+
+        // 큐가 비어 있으면 EV_RXCHAR/EV_ERR 이벤트까지 대기 (스핀 없음)
+        DWORD eventMask = 0;
+        OVERLAPPED overlapped = { 0 };
+        overlapped.hEvent = modem->io.hWaitEvent;
+        if (!WaitCommEvent(modem->hSerial, &eventMask, &overlapped)) {
+            if (GetLastError() != ERROR_IO_PENDING) {
+                return SERIAL_ERROR;
+            }
+            DWORD unused = 0;
+            int result = WaitOverlapped(modem, &overlapped, &unused);
+            if (result != SERIAL_OK) {
+                return result;
+            }
+        }
+        // EV_ERR 는 다음 루프의 ClearCommError 가 해제한다
+    }
+}
+
+bool SerialWrite(ModemConfig* modem, const BYTE* data, DWORD size, DWORD* bytesWritten) {
+    OVERLAPPED overlapped = { 0 };
+    // 하위 비트를 세우면 포트가 리액터의 IOCP 에 연결되어 있어도 완료 패킷이 큐에 들어가지 않는다
+    overlapped.hEvent = (HANDLE)((ULONG_PTR)modem->io.hWriteEvent | 1);
+    *bytesWritten = 0;
+    if (!WriteFile(modem->hSerial, data, size, NULL, &overlapped)) {
+        if (GetLastError() != ERROR_IO_PENDING) {
+            return false;
+        }
+    }
+    return GetOverlappedResult(modem->hSerial, &overlapped, bytesWritten, TRUE) && *bytesWritten == size;
+}
+
+bool SerialWriteGather(ModemConfig* modem, const SerialSegment* segments, int count, DWORD* bytesWritten) {
+    // 통신 포트 핸들은 WriteFileGather (페이지 단위, 파일 전용) 를 받지 않으므로 조각마다 쓴다.
+    // 중첩 쓰기는 드라이버 버퍼에 넣으면 끝나므로 조각 사이에 회선이 비지 않는다
+    *bytesWritten = 0;
+    for (int i = 0; i < count; i++) {
+        DWORD written = 0;
+        bool ok = SerialWrite(modem, segments[i].data, segments[i].size, &written);
+        *bytesWritten += written;
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SerialWake(ModemConfig* modem) {
+    if (modem->io.hWakeEvent != NULL) {
+        SetEvent(modem->io.hWakeEvent);
+    }
+}
+
+void SerialDrain(ModemConfig* modem) {
+    if (modem->hSerial != INVALID_HANDLE_VALUE) {
+        FlushFileBuffers(modem->hSerial);
+    }
+}
+
+bool SerialReconfigure(ModemConfig* modem, int baudRate, int byteSize, int stopBits, int parity) {
+    // 열린 핸들에 새 DCB 만 적용한다. 타임아웃, 이벤트 마스크, 흐름 제어는 그대로
+    if (!ReconfigurePort(modem, baudRate, byteSize, stopBits, parity)) {
+        _ftprintf(stderr, TEXT("Error setting comm state for %s (%d bps)\n"), modem->portName, baudRate);
+        return false;
+    }
+    return true;
+}
+
+DWORD SerialQueryOverruns(ModemConfig* modem) {
+    // 리액터가 ClearCommError 결과를 누적한다
+    return (DWORD)AtomicLoadAcquire32(&modem->driverOverruns);
+}
+
+DWORD SerialQueryDriverErrors(ModemConfig* modem) {
+    // EV_ERR 로 깨어난 리액터가 ClearCommError 의 CE_FRAME/CE_RXPARITY/CE_BREAK 를 누적한다
+    return (DWORD)AtomicLoadAcquire32(&modem->metrics.driverErrors);
+}
+
+void SerialPurgeInput(ModemConfig* modem) {
+    PurgeComm(modem->hSerial, PURGE_RXCLEAR);
+}
+
+#else
+
+#include <fcntl.h>
+#include <linux/serial.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <termios.h>
+
+// 커널의 struct termios2 (asm-generic 배치). <asm/termbits.h> 는 glibc 의 <termios.h> 와 함께 쓸 수 없어 직접 정의한다
+typedef struct {
+    tcflag_t c_iflag;
+    tcflag_t c_oflag;
+    tcflag_t c_cflag;
+    tcflag_t c_lflag;
+    cc_t c_line;
+    cc_t c_cc[19];
+    speed_t c_ispeed;
+    speed_t c_ospeed;
+} KernelTermios2;
+
+#define SERIAL_TCGETS2 _IOR('T', 0x2A, KernelTermios2)
+#define SERIAL_TCSETS2 _IOW('T', 0x2B, KernelTermios2)
+#define SERIAL_TCSETSW2 _IOW('T', 0x2C, KernelTermios2) // 남은 송신 바이트가 나간 뒤 적용
+#ifndef BOTHER
+#define BOTHER 0010000
+#endif
+
+// 표준 속도의 Bxxx 값. 표준이 아니면 B0 (termios2 의 BOTHER 로 설정)
+static speed_t BaudRateToSpeed(int baudRate) {
+    switch (baudRate) {
+    case 50: return B50;
+    case 75: return B75;
+    case 110: return B110;
+    case 134: return B134;
+    case 150: return B150;
+    case 200: return B200;
+    case 300: return B300;
+    case 600: return B600;
+    case 1200: return B1200;
+    case 1800: return B1800;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 500000: return B500000;
+    case 576000: return B576000;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 1152000: return B1152000;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+    case 2500000: return B2500000;
+    case 3000000: return B3000000;
+    case 3500000: return B3500000;
+    case 4000000: return B4000000;
+    default: return B0;
+    }
+}
+
+// 회선 설정 (보레이트, 데이터 비트, 스톱 비트, 패리티). 열 때와 실행 중 변경에 함께 쓰임
+static void ApplyLineSettings(struct termios* tio, int baudRate, int byteSize, int stopBits, int parity) {
+    tio->c_cflag &= ~(CSIZE | CSTOPB | PARENB | PARODD);
+    switch (byteSize) {
+    case 5: tio->c_cflag |= CS5; break;
+    case 6: tio->c_cflag |= CS6; break;
+    case 7: tio->c_cflag |= CS7; break;
+    default: tio->c_cflag |= CS8; break;
+    }
+    if (stopBits == TWOSTOPBITS) {
+        tio->c_cflag |= CSTOPB;
+    }
+    if (parity == ODDPARITY) {
+        tio->c_cflag |= PARENB | PARODD;
+    }
+    else if (parity == EVENPARITY) {
+        tio->c_cflag |= PARENB;
+    }
+    speed_t speed = BaudRateToSpeed(baudRate);
+    if (speed != B0) {
+        cfsetispeed(tio, speed);
+        cfsetospeed(tio, speed);
+    }
+}
+
+// tio 를 적용한다. 표준이 아닌 속도는 tio 의 나머지 설정과 함께 termios2 로 한 번에 적용해 중간 속도를 거치지 않는다.
+// 드라이버가 실제로 적용한 속도를 다시 읽어 허용 오차 안인지 확인한다 (오류 메시지 없음)
+static bool SetLineSettings(int fd, const struct termios* tio, int baudRate, bool drain) {
+    KernelTermios2 tio2;
+    if (BaudRateToSpeed(baudRate) != B0) {
+        if (tcsetattr(fd, drain ? TCSADRAIN : TCSANOW, tio) != 0) {
+            return false;
+        }
+    }
+    else {
+        if (ioctl(fd, SERIAL_TCGETS2, &tio2) != 0) {
+            return false;
+        }
+        tio2.c_iflag = tio->c_iflag;
+        tio2.c_oflag = tio->c_oflag;
+        tio2.c_cflag = (tio->c_cflag & ~(CBAUD | CIBAUD)) | BOTHER; // 입력 속도는 출력 속도를 따름
+        tio2.c_lflag = tio->c_lflag;
+        memcpy(tio2.c_cc, tio->c_cc, sizeof(tio2.c_cc));
+        tio2.c_ispeed = (speed_t)baudRate;
+        tio2.c_ospeed = (speed_t)baudRate;
+        if (ioctl(fd, drain ? SERIAL_TCSETSW2 : SERIAL_TCSETS2, &tio2) != 0) {
+            return false;
+        }
+    }
+    if (ioctl(fd, SERIAL_TCGETS2, &tio2) != 0) {
+        return true; // termios2 를 모르는 커널: 표준 속도만 여기까지 옴
+    }
+    int64_t error = (int64_t)tio2.c_ospeed - baudRate;
+    return (error < 0 ? -error : error) * 100 <= (int64_t)baudRate * SERIAL_BAUD_TOLERANCE_PERCENT;
+}
+
+static void CloseFd(int* fd) {
+    if (*fd >= 0) {
+        close(*fd);
+    }
+    *fd = -1;
+}
+
+bool OpenSerialPort(ModemConfig* modem) {
+    modem->io.epollFd = -1;
+    modem->io.wakeFd = -1;
+    modem->io.emulator = NULL;
+
+    // 에뮬레이터 포트는 에뮬레이터가 만든 pty 를 실제 포트처럼 연다
+    const TCHAR* path = modem->portName;
+    TCHAR slavePath[MAX_PATH];
+    if (EmulatorIsPort(modem->portName)) {
+        if (!EmulatorAttach(modem, slavePath, MAX_PATH)) {
+            return false;
+        }
+        path = slavePath;
+    }
+
+    //시리얼 포트 오픈 (epoll 로 감시하기 위해 논블로킹으로 연다)
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        _ftprintf(stderr, TEXT("Error opening serial port %s\n"), modem->portName);
+        _ftprintf(stderr, TEXT("  Error Code: %d\n"), errno);
+        EmulatorDetach(modem);
+        return false;
+    }
+    modem->hSerial = fd;
+
+    // termios 설정: raw 모드, 흐름 제어 없음 (Windows 쪽 HANDFLOW 설정과 동일)
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        _ftprintf(stderr, TEXT("Error getting comm state for %s\n"), modem->portName);
+        CloseSerialPort(modem);
+        return false;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    // VMIN=1: 데이터가 없을 때 논블로킹 read 가 0 대신 EAGAIN 을 돌려주도록
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    ApplyLineSettings(&tio, modem->baudRate, modem->byteSize, modem->stopBits, modem->parity);
+    if (!SetLineSettings(fd, &tio, modem->baudRate, false)) {
+        _ftprintf(stderr, TEXT("Error setting comm state for %s (%d bps)\n"), modem->portName, modem->baudRate);
+        CloseSerialPort(modem);
+        return false;
+    }
+
+    // epoll 인스턴스에 포트와 깨우기용 eventfd 등록
+    modem->io.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    modem->io.wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (modem->io.epollFd < 0 || modem->io.wakeFd < 0) {
+        _ftprintf(stderr, TEXT("Error creating I/O events for %s\n"), modem->portName);
+        CloseSerialPort(modem);
+        return false;
+    }
+    struct epoll_event event = { 0 };
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(modem->io.epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        _ftprintf(stderr, TEXT("Error setting event mask for %s\n"), modem->portName);
+        CloseSerialPort(modem);
+        return false;
+    }
+    event.events = EPOLLIN;
+    event.data.fd = modem->io.wakeFd;
+    if (epoll_ctl(modem->io.epollFd, EPOLL_CTL_ADD, modem->io.wakeFd, &event) != 0) {
+        _ftprintf(stderr, TEXT("Error setting event mask for %s\n"), modem->portName);
+        CloseSerialPort(modem);
+        return false;
+    }
+
+    // 퍼지
+    tcflush(fd, TCIOFLUSH);
+    return true;
+}
+
+void CloseSerialPort(ModemConfig* modem) {
+    // 다른 스레드가 이 포트에서 대기 중일 수 있으므로 먼저 깨운 뒤 닫는다.
+    // closing 이 설정된 동안에는 깨우기 신호를 소비하지 않으므로 대기가 다시 블록되지 않는다
+    AtomicStoreRelease32(&modem->io.closing, 1);
+    SerialWake(modem);
+    if (modem->hSerial != INVALID_HANDLE_VALUE) {
+        close((int)modem->hSerial);
+        modem->hSerial = INVALID_HANDLE_VALUE;
+    }
+    CloseFd(&modem->io.epollFd);
+    CloseFd(&modem->io.wakeFd);
+    EmulatorDetach(modem);
+}
+
+// 깨우기 eventfd 가 신호 상태인지 확인하고 비운다
+static bool ConsumeWake(ModemConfig* modem) {
+    uint64_t value;
+    if (AtomicLoadAcquire32(&modem->io.closing)) {
+        return true;
+    }
+    return read(modem->io.wakeFd, &value, sizeof(value)) == sizeof(value);
+}
+
+// 기존 Windows 동작(ReadTotalTimeoutConstant = 30)을 그대로 흉내 낸다:
+// 버퍼가 차거나 30ms 가 지날 때까지 모아서 반환
+static int PollRead(ModemConfig* modem, BYTE* buffer, DWORD size, DWORD* bytesRead) {
+    int fd = (int)modem->hSerial;
+    uint64_t deadline = PlatformNowNs() + 30 * 1000000ULL;
+    while (*bytesRead < size) {
+        ssize_t n = read(fd, buffer + *bytesRead, size - *bytesRead);
+        if (n > 0) {
+            *bytesRead += (DWORD)n;
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+            return SERIAL_ERROR;
+        }
+        uint64_t now = PlatformNowNs();
+        if (now >= deadline) {
+            break;
+        }
+        struct pollfd fds[2] = { { fd, POLLIN, 0 }, { modem->io.wakeFd, POLLIN, 0 } };
+        int timeoutMs = (int)((deadline - now + 999999) / 1000000);
+        if (poll(fds, 2, timeoutMs) > 0 && (fds[1].revents & POLLIN) && ConsumeWake(modem)) {
+            return SERIAL_STOPPED;
+        }
+    }
+    return SERIAL_OK;
+}
+
+int SerialWaitRead(ModemConfig* modem, BYTE* buffer, DWORD size, DWORD* bytesRead) {
+    *bytesRead = 0;
+    if (modem->hSerial == INVALID_HANDLE_VALUE) {
+        return SERIAL_ERROR;
+    }
+    if (modem->io.rxMode == SERIAL_RX_POLL) {
+        return PollRead(modem, buffer, size, bytesRead);
+    }
+
+    int fd = (int)modem->hSerial;
+    for (;;) {
+        // 이미 도착한 데이터가 있으면 바로 반환
+        ssize_t n = read(fd, buffer, size);
+        if (n > 0) {
+            *bytesRead = (DWORD)n;
+            return SERIAL_OK;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+            return SERIAL_ERROR; // 행업 또는 장치 오류
+        }
+
+        if (AtomicLoadAcquire32(&modem->io.closing)) {
+            return SERIAL_STOPPED;
+        }
+
+        // 데이터 도착 또는 깨우기 요청까지 대기 (스핀 없음)
+        struct epoll_event events[2];
+        int count = epoll_wait(modem->io.epollFd, events, 2, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return SERIAL_ERROR;
+        }
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == modem->io.wakeFd && ConsumeWake(modem)) {
+                return SERIAL_STOPPED;
+            }
+        }
+    }
+}
+
+bool SerialWrite(ModemConfig* modem, const BYTE* data, DWORD size, DWORD* bytesWritten) {
+    int fd = (int)modem->hSerial;
+    *bytesWritten = 0;
+    while (*bytesWritten < size) {
+        ssize_t n = write(fd, data + *bytesWritten, size - *bytesWritten);
+        if (n > 0) {
+            *bytesWritten += (DWORD)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            // 송신 큐가 가득 참: 쓸 수 있을 때까지 대기
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            poll(&pfd, 1, -1);
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+#define SERIAL_GATHER_MAX 64
+
+bool SerialWriteGather(ModemConfig* modem, const SerialSegment* segments, int count, DWORD* bytesWritten) {
+    int fd = (int)modem->hSerial;
+    DWORD total = 0;
+    for (int i = 0; i < count; i++) {
+        total += segments[i].size;
+    }
+    *bytesWritten = 0;
+    int first = 0;
+    DWORD skip = 0; // segments[first] 에서 이미 쓴 바이트
+    while (*bytesWritten < total) {
+        struct iovec iov[SERIAL_GATHER_MAX];
+        int iovCount = 0;
+        for (int i = first; i < count && iovCount < SERIAL_GATHER_MAX; i++) {
+            iov[iovCount].iov_base = (void*)(segments[i].data + (i == first ? skip : 0));
+            iov[iovCount].iov_len = segments[i].size - (i == first ? skip : 0);
+            iovCount++;
+        }
+        ssize_t n = writev(fd, iov, iovCount);
+        if (n > 0) {
+            // 일부만 쓰였으면 남은 조각부터 다시
+            *bytesWritten += (DWORD)n;
+            DWORD advance = (DWORD)n;
+            while (first < count && advance >= segments[first].size - skip) {
+                advance -= segments[first].size - skip;
+                first++;
+                skip = 0;
+            }
+            skip += advance;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            poll(&pfd, 1, -1);
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+void SerialWake(ModemConfig* modem) {
+    if (modem->hSerial != INVALID_HANDLE_VALUE && modem->io.wakeFd >= 0) {
+        uint64_t value = 1;
+        ssize_t unused = write(modem->io.wakeFd, &value, sizeof(value));
+        (void)unused;
+    }
+}
+
+void SerialDrain(ModemConfig* modem) {
+    if (modem->hSerial != INVALID_HANDLE_VALUE) {
+        tcdrain((int)modem->hSerial);
+    }
+}
+
+// 열린 fd 에 새 회선 설정만 적용한다 (오류 메시지는 SerialReconfigure 가 냄).
+// drain: 드라이버에 남은 송신 바이트가 나간 뒤 바뀜
+static bool ReconfigurePort(ModemConfig* modem, int baudRate, int byteSize, int stopBits, int parity) {
+    struct termios tio;
+    if (modem->hSerial == INVALID_HANDLE_VALUE || tcgetattr((int)modem->hSerial, &tio) != 0) {
+        return false;
+    }
+    ApplyLineSettings(&tio, baudRate, byteSize, stopBits, parity);
+    if (!SetLineSettings((int)modem->hSerial, &tio, baudRate, true)) {
+        return false;
+    }
+    EmulatorSetBaudRate(modem, baudRate);
+    return true;
+}
+
+bool SerialReconfigure(ModemConfig* modem, int baudRate, int byteSize, int stopBits, int parity) {
+    if (!ReconfigurePort(modem, baudRate, byteSize, stopBits, parity)) {
+        _ftprintf(stderr, TEXT("Error setting comm state for %s (%d bps)\n"), modem->portName, baudRate);
+        return false;
+    }
+    return true;
+}
+
+DWORD SerialQueryOverruns(ModemConfig* modem) {
+    // UART 드라이버의 오버런 카운터 (pty 등 지원하지 않는 장치는 0)
+    struct serial_icounter_struct counters;
+    if (modem->hSerial == INVALID_HANDLE_VALUE || ioctl((int)modem->hSerial, TIOCGICOUNT, &counters) != 0) {
+        return (DWORD)AtomicLoadAcquire32(&modem->driverOverruns);
+    }
+    return (DWORD)(counters.overrun + counters.buf_overrun);
+}
+
+DWORD SerialQueryDriverErrors(ModemConfig* modem) {
+    struct serial_icounter_struct counters;
+    if (modem->hSerial == INVALID_HANDLE_VALUE || ioctl((int)modem->hSerial, TIOCGICOUNT, &counters) != 0) {
+        return (DWORD)AtomicLoadAcquire32(&modem->metrics.driverErrors);
+    }
+    return (DWORD)(counters.frame + counters.parity + counters.brk);
+}
+
+void SerialPurgeInput(ModemConfig* modem) {
+    tcflush((int)modem->hSerial, TCIFLUSH);
+}
+
+#endif
+
+DWORD SerialBufferSize(int baudRate) {
+    // 바이트당 10비트
+    uint64_t bytes = (uint64_t)(baudRate > 0 ? baudRate : CBR_115200) / 10 * SERIAL_QUEUE_MS / 1000;
+    DWORD size = SERIAL_MIN_BUFFER;
+    while (size < bytes && size < SERIAL_MAX_BUFFER) {
+        size <<= 1;
+    }
+    return size;
+}
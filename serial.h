@@ -0,0 +1,69 @@
+﻿#pragma once
+#include "platform.h"
+
+// 수신 대기 방식
+#define SERIAL_RX_EVENT 0 // 데이터 도착 이벤트로 깨어남 (기본값)
+#define SERIAL_RX_POLL 1  // 기존 방식: 30ms 읽기 타임아웃 폴링 (벤치마크 비교용)
+
+// SerialWaitRead 반환값
+#define SERIAL_OK 0
+#define SERIAL_STOPPED 1
+#define SERIAL_ERROR -1
+
+// 보레이트: 표준 속도가 아니어도 이 범위면 받아들이고, 드라이버가 실제로 낸 속도가 허용 오차 밖이면 열기/변경이 실패한다
+#define SERIAL_MIN_BAUD_RATE 50
+#define SERIAL_MAX_BAUD_RATE 12000000
+#define SERIAL_BAUD_TOLERANCE_PERCENT 2
+
+// 드라이버 큐(Windows SetupComm)와 리액터 읽기 버퍼가 담는 수신 시간
+#define SERIAL_QUEUE_MS 100
+#define SERIAL_MIN_BUFFER 4096
+#define SERIAL_MAX_BUFFER 262144
+
+// 이벤트 기반 송수신에 필요한 포트별 자원
+typedef struct {
+    int rxMode;
+    volatile int32_t closing; // CloseSerialPort 진행 중 (수신 스레드가 다시 블록하지 않도록)
+    struct EmulatorEnd* emulator; // Port=EMU:... 로 연 포트의 에뮬레이터 연결 (아니면 NULL)
+#ifdef _WIN32
+    HANDLE hReadEvent;  // 중첩 ReadFile 완료
+    HANDLE hWaitEvent;  // WaitCommEvent 완료
+    HANDLE hWriteEvent; // 중첩 WriteFile / DeviceIoControl 완료
+    HANDLE hWakeEvent;  // 대기 중인 수신 스레드를 깨움
+#else
+    int epollFd;
+    int wakeFd;         // eventfd
+#endif
+} SerialIo;
+
+// SerialWriteGather 로 한 번에 쓸 조각
+typedef struct {
+    const BYTE* data;
+    DWORD size;
+} SerialSegment;
+
+struct ModemConfig;
+
+bool OpenSerialPort(struct ModemConfig* modem);
+void CloseSerialPort(struct ModemConfig* modem);
+
+// 데이터가 도착할 때까지 블록한 뒤 도착한 만큼 읽는다.
+// SerialWake 가 호출되면 SERIAL_STOPPED 를 반환한다.
+int SerialWaitRead(struct ModemConfig* modem, BYTE* buffer, DWORD size, DWORD* bytesRead);
+bool SerialWrite(struct ModemConfig* modem, const BYTE* data, DWORD size, DWORD* bytesWritten);
+// 여러 조각을 한 버퍼로 모으지 않고 차례로 쓴다 (POSIX 는 writev 한 번, Windows 는 조각마다 WriteFile)
+bool SerialWriteGather(struct ModemConfig* modem, const SerialSegment* segments, int count, DWORD* bytesWritten);
+void SerialWake(struct ModemConfig* modem);
+// 드라이버 송신 버퍼에 남은 바이트가 회선으로 다 나갈 때까지 기다린다
+void SerialDrain(struct ModemConfig* modem);
+// 열린 포트의 보레이트/데이터 비트/스톱 비트/패리티를 닫지 않고 바꾼다 (먼저 SerialDrain 으로 송신을 비울 것).
+// 성공해도 modem 의 설정 필드는 호출한 쪽이 갱신한다
+bool SerialReconfigure(struct ModemConfig* modem, int baudRate, int byteSize, int stopBits, int parity);
+// 드라이버 수신 큐에 남은 바이트를 버린다 (BaudRate=auto 가 속도를 바꾼 뒤)
+void SerialPurgeInput(struct ModemConfig* modem);
+// baudRate 로 SERIAL_QUEUE_MS 동안 들어오는 바이트를 담는 버퍼 크기 (2의 거듭제곱, SERIAL_MIN_BUFFER..SERIAL_MAX_BUFFER)
+DWORD SerialBufferSize(int baudRate);
+// 드라이버/UART 수준에서 발생한 수신 오버런 누적 횟수
+DWORD SerialQueryOverruns(struct ModemConfig* modem);
+// 드라이버가 보고한 프레이밍/패리티/브레이크 오류 수
+DWORD SerialQueryDriverErrors(struct ModemConfig* modem);
@@ -0,0 +1,749 @@
+﻿#include "platform.h"
+#include "service.h"
+#include "compress.h"
+#include "scheduler.h"
+#include "bond.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#define SERVICE_HEADER_SIZE 5   // 길이(4) | 종류(1)
+#define SERVICE_SEND_SIZE 6     // 태그(4) | 경로(1) | 종류(1)
+#define SERVICE_MODEM_ENTRY (2 + SERVICE_NAME_SIZE)
+
+typedef struct {
+    BYTE* data;
+    DWORD length;
+    DWORD capacity;
+} ServiceBuffer;
+
+typedef struct {
+    PlatformMutex lock;         // connected, subscriptions, pending (패킷을 만드는 스레드 <-> 서비스 스레드)
+    volatile int32_t connected;
+    uint32_t subscriptions;
+    ServiceBuffer pending;      // 보낼 패킷 (어느 스레드든 덧붙임)
+    ServiceBuffer sending;      // 서비스 스레드가 쓰는 중인 패킷
+    DWORD sendOffset;
+    ServiceBuffer input;        // 받았지만 아직 처리하지 않은 바이트 (서비스 스레드만)
+#ifdef _WIN32
+    HANDLE pipe;
+    OVERLAPPED readOverlapped;
+    OVERLAPPED writeOverlapped;
+    bool reading;
+    bool writing;
+#else
+    int fd;
+#endif
+} ServiceClient;
+
+static struct {
+    volatile int32_t active;
+    volatile int32_t running;
+    volatile int32_t wakePending; // 이미 깨웠음 (패킷마다 시스템 호출을 하지 않도록)
+    PlatformThread thread;
+    TCHAR path[MAX_PATH];
+    ServiceClient clients[SERVICE_MAX_CLIENTS];
+    ServiceStats stats;
+#ifdef _WIN32
+    PlatformEvent wake;
+    HANDLE listenPipe;
+    OVERLAPPED connectOverlapped;
+    bool connecting;            // ConnectNamedPipe 가 진행 중 (이미 연결되어 있었으면 false)
+#else
+    int wakePipe[2];
+    int listenFd;
+#endif
+} service;
+
+static void PutU32(BYTE* p, uint32_t value) {
+    p[0] = (BYTE)value;
+    p[1] = (BYTE)(value >> 8);
+    p[2] = (BYTE)(value >> 16);
+    p[3] = (BYTE)(value >> 24);
+}
+
+static uint32_t GetU32(const BYTE* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool BufferReserve(ServiceBuffer* buffer, DWORD extra) {
+    if (buffer->capacity - buffer->length >= extra) {
+        return true;
+    }
+    DWORD capacity = buffer->capacity > 0 ? buffer->capacity * 2 : SERVICE_READ_SIZE;
+    while (capacity - buffer->length < extra) {
+        capacity *= 2;
+    }
+    BYTE* data = (BYTE*)realloc(buffer->data, capacity);
+    if (data == NULL) {
+        return false;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+static void BufferFree(ServiceBuffer* buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+// 출력 버퍼에 패킷 하나를 덧붙인다 (client->lock 을 잡은 상태)
+static bool ClientAppend(ServiceClient* client, BYTE type, const BYTE* head, DWORD headLength, const BYTE* data, DWORD dataLength) {
+    DWORD size = SERVICE_HEADER_SIZE + headLength + dataLength;
+    ServiceBuffer* buffer = &client->pending;
+    // 읽지 않는 클라이언트 때문에 메모리가 끝없이 늘지 않게 함 (비어 있으면 큰 패킷 하나는 받음)
+    if ((buffer->length > 0 && buffer->length + size > SERVICE_OUTPUT_LIMIT) || !BufferReserve(buffer, size)) {
+        AtomicAddRelaxed64(&service.stats.droppedPackets, 1);
+        return false;
+    }
+    BYTE* p = buffer->data + buffer->length;
+    PutU32(p, size - 4);
+    p[4] = type;
+    memcpy(p + SERVICE_HEADER_SIZE, head, headLength);
+    if (dataLength > 0) {
+        memcpy(p + SERVICE_HEADER_SIZE + headLength, data, dataLength);
+    }
+    buffer->length += size;
+    AtomicAddRelaxed64(&service.stats.packetsOut, 1);
+    return true;
+}
+
+// 서비스 스레드를 깨운다. 이미 깨웠고 아직 처리되지 않았으면 아무것도 하지 않음
+static void WakeService(bool force) {
+    if (!force && AtomicLoadAcquire32(&service.wakePending) != 0) {
+        return;
+    }
+    AtomicStoreRelease32(&service.wakePending, 1);
+#ifdef _WIN32
+    PlatformEventSet(&service.wake);
+#else
+    BYTE signal = 1;
+    ssize_t written = write(service.wakePipe[1], &signal, 1);
+    (void)written; // 파이프가 가득 찼으면 이미 깨어날 것임
+#endif
+}
+
+// 보내던 버퍼를 다 썼으면 그동안 쌓인 패킷과 바꾼다. 보낼 것이 있으면 true (서비스 스레드)
+static bool TakePending(ServiceClient* client) {
+    if (client->sendOffset < client->sending.length) {
+        return true;
+    }
+    // 큰 파일을 보낸 뒤 커진 버퍼는 돌려줌
+    if (client->sending.capacity > SERVICE_OUTPUT_LIMIT) {
+        BufferFree(&client->sending);
+    }
+    PlatformMutexLock(&client->lock);
+    ServiceBuffer sent = client->sending;
+    client->sending = client->pending;
+    client->pending = sent;
+    client->pending.length = 0;
+    PlatformMutexUnlock(&client->lock);
+    client->sendOffset = 0;
+    return client->sending.length > 0;
+}
+
+static void Reply(ServiceClient* client, BYTE type, const BYTE* body, DWORD length) {
+    PlatformMutexLock(&client->lock);
+    ClientAppend(client, type, body, length, NULL, 0);
+    PlatformMutexUnlock(&client->lock);
+}
+
+static void HandleSend(ServiceClient* client, const BYTE* body, DWORD length) {
+    BYTE reply[11] = { 0 };
+    if (length < SERVICE_SEND_SIZE) {
+        reply[4] = SERVICE_STATUS_INVALID;
+        Reply(client, SERVICE_ACCEPTED, reply, sizeof(reply));
+        return;
+    }
+    memcpy(reply, body, 4);
+    // 보내자마자 완료되면 다른 스레드가 DONE 을 덧붙이므로, 그보다 먼저 ACCEPTED 자리를 잡아 두고 결과는 보낸 뒤 채움.
+    // pending 을 바꾸는 것은 이 서비스 스레드뿐이라 자리의 위치는 채울 때까지 그대로임
+    PlatformMutexLock(&client->lock);
+    DWORD slot = client->pending.length;
+    bool reserved = ClientAppend(client, SERVICE_ACCEPTED, reply, sizeof(reply), NULL, 0);
+    PlatformMutexUnlock(&client->lock);
+    BYTE route = body[4];
+    BYTE kind = body[5];
+    const BYTE* data = body + SERVICE_SEND_SIZE;
+    DWORD dataLength = length - SERVICE_SEND_SIZE;
+    BYTE status = SERVICE_STATUS_OK;
+    BYTE source = SERVICE_SOURCE_MODEM;
+    BYTE modemIndex = SERVICE_NO_MODEM;
+    uint32_t id = 0;
+
+    // 메뉴에서 보낼 때와 같은 규칙으로 경로를 고름
+    if ((kind != ARQ_KIND_MESSAGE && kind != ARQ_KIND_FILE) || dataLength == 0) {
+        status = SERVICE_STATUS_INVALID;
+    }
+    else if (route == SERVICE_ROUTE_AUTO) {
+        if (kind == ARQ_KIND_FILE || dataLength > SCHED_MAX_MESSAGE) {
+            source = SERVICE_SOURCE_BOND;
+            id = BondSend(kind, data, dataLength);
+        }
+        else {
+            source = SERVICE_SOURCE_AUTO;
+            id = SchedulerSend(data, dataLength);
+        }
+    }
+    else if (route == SERVICE_ROUTE_ALL) {
+        source = SERVICE_SOURCE_AUTO;
+        if (kind != ARQ_KIND_MESSAGE || dataLength > SCHED_MAX_MESSAGE) {
+            status = SERVICE_STATUS_INVALID;
+        }
+        else {
+            id = SchedulerSendRedundant(data, dataLength);
+        }
+    }
+    else if (route >= modemRegistry.count) {
+        status = SERVICE_STATUS_INVALID;
+    }
+    else {
+        ModemConfig* modem = &modemRegistry.modems[route];
+        modemIndex = route;
+        if (modem->hSerial == INVALID_HANDLE_VALUE) {
+            status = SERVICE_STATUS_DISCONNECTED;
+        }
+        else if (kind == ARQ_KIND_FILE || (modem->framing == FRAMING_COBS && dataLength > FRAME_MAX_PAYLOAD)) {
+            source = SERVICE_SOURCE_ARQ;
+            if (modem->framing != FRAMING_COBS) {
+                status = SERVICE_STATUS_INVALID;
+            }
+            else {
+                id = ArqSend(modem, kind, data, dataLength);
+            }
+        }
+        else {
+            CompressReport report;
+            id = CompressEnqueue(modem, data, dataLength, &report);
+        }
+    }
+    if (status == SERVICE_STATUS_OK && id == 0) {
+        status = SERVICE_STATUS_REJECTED;
+    }
+    reply[4] = status;
+    reply[5] = source;
+    reply[6] = modemIndex;
+    PutU32(reply + 7, id);
+    if (reserved) {
+        PlatformMutexLock(&client->lock);
+        memcpy(client->pending.data + slot + SERVICE_HEADER_SIZE, reply, sizeof(reply));
+        PlatformMutexUnlock(&client->lock);
+    }
+}
+
+static void HandleList(ServiceClient* client) {
+    BYTE body[1 + MAX_MODEMS * SERVICE_MODEM_ENTRY] = { 0 };
+    body[0] = (BYTE)modemRegistry.count;
+    for (int i = 0; i < modemRegistry.count; i++) {
+        const ModemConfig* modem = &modemRegistry.modems[i];
+        BYTE* entry = body + 1 + i * SERVICE_MODEM_ENTRY;
+        entry[0] = modem->hSerial != INVALID_HANDLE_VALUE ? 1 : 0;
+        entry[1] = (BYTE)modem->framing;
+#ifdef _WIN32
+        WideCharToMultiByte(CP_UTF8, 0, modem->name, -1, (char*)entry + 2, SERVICE_NAME_SIZE - 1, NULL, NULL);
+#else
+        strncpy((char*)entry + 2, modem->name, SERVICE_NAME_SIZE - 1);
+#endif
+    }
+    Reply(client, SERVICE_MODEMS, body, 1 + (DWORD)modemRegistry.count * SERVICE_MODEM_ENTRY);
+}
+
+static void HandlePacket(ServiceClient* client, BYTE type, const BYTE* body, DWORD length) {
+    AtomicAddRelaxed64(&service.stats.requests, 1);
+    switch (type) {
+    case SERVICE_SEND:
+        HandleSend(client, body, length);
+        break;
+    case SERVICE_SUBSCRIBE:
+        if (length >= 4) {
+            PlatformMutexLock(&client->lock);
+            client->subscriptions = GetU32(body);
+            PlatformMutexUnlock(&client->lock);
+        }
+        break;
+    case SERVICE_LIST:
+        HandleList(client);
+        break;
+    default:
+        break; // 모르는 종류는 무시
+    }
+}
+
+// 받은 바이트에서 완성된 패킷을 모두 처리한다. 길이가 잘못되었으면 false (연결을 끊음)
+static bool ProcessInput(ServiceClient* client) {
+    ServiceBuffer* input = &client->input;
+    DWORD position = 0;
+    while (input->length - position >= 4) {
+        DWORD size = GetU32(input->data + position);
+        if (size == 0 || size > SERVICE_MAX_PACKET) {
+            return false;
+        }
+        if (input->length - position - 4 < size) {
+            break;
+        }
+        HandlePacket(client, input->data[position + 4], input->data + position + SERVICE_HEADER_SIZE, size - 1);
+        position += 4 + size;
+    }
+    memmove(input->data, input->data + position, input->length - position);
+    input->length -= position;
+    return true;
+}
+
+static ServiceClient* FreeClient(void) {
+    for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        if (!service.clients[i].connected) {
+            return &service.clients[i];
+        }
+    }
+    return NULL;
+}
+
+static void OpenClient(ServiceClient* client) {
+    client->sendOffset = 0;
+    PlatformMutexLock(&client->lock);
+    client->subscriptions = 0;
+    client->pending.length = 0;
+    AtomicStoreRelease32(&client->connected, 1);
+    PlatformMutexUnlock(&client->lock);
+    AtomicAddRelaxed32(&service.stats.clients, 1);
+    AtomicAddRelaxed32(&service.stats.accepted, 1);
+}
+
+static void ReleaseClient(ServiceClient* client) {
+    PlatformMutexLock(&client->lock);
+    AtomicStoreRelease32(&client->connected, 0);
+    client->subscriptions = 0;
+    BufferFree(&client->pending);
+    PlatformMutexUnlock(&client->lock);
+    BufferFree(&client->sending);
+    BufferFree(&client->input);
+    client->sendOffset = 0;
+    AtomicAddRelaxed32(&service.stats.clients, -1);
+}
+
+#ifdef _WIN32
+
+static bool ListenPipe(bool first) {
+    service.listenPipe = CreateNamedPipe(service.path, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES,
+        SERVICE_READ_SIZE, SERVICE_READ_SIZE, 0, NULL);
+    if (service.listenPipe == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    ResetEvent(service.connectOverlapped.hEvent);
+    service.connecting = false;
+    if (!ConnectNamedPipe(service.listenPipe, &service.connectOverlapped)) {
+        DWORD error = GetLastError();
+        if (error == ERROR_IO_PENDING) {
+            service.connecting = true;
+        }
+        else if (error == ERROR_PIPE_CONNECTED) {
+            SetEvent(service.connectOverlapped.hEvent); // 기다리는 사이에 이미 연결됨
+        }
+        else {
+            CloseHandle(service.listenPipe);
+            service.listenPipe = INVALID_HANDLE_VALUE;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool Signaled(HANDLE event) {
+    return WaitForSingleObject(event, 0) == WAIT_OBJECT_0;
+}
+
+static bool StartRead(ServiceClient* client) {
+    if (!BufferReserve(&client->input, SERVICE_READ_SIZE)) {
+        return false;
+    }
+    if (!ReadFile(client->pipe, client->input.data + client->input.length, SERVICE_READ_SIZE, NULL, &client->readOverlapped) &&
+        GetLastError() != ERROR_IO_PENDING) {
+        return false;
+    }
+    client->reading = true;
+    return true;
+}
+
+static void CloseClient(ServiceClient* client) {
+    DWORD bytes;
+    CancelIoEx(client->pipe, NULL);
+    if (client->reading) {
+        GetOverlappedResult(client->pipe, &client->readOverlapped, &bytes, TRUE);
+    }
+    if (client->writing) {
+        GetOverlappedResult(client->pipe, &client->writeOverlapped, &bytes, TRUE);
+    }
+    client->reading = false;
+    client->writing = false;
+    DisconnectNamedPipe(client->pipe);
+    CloseHandle(client->pipe);
+    client->pipe = INVALID_HANDLE_VALUE;
+    ReleaseClient(client);
+}
+
+static void AcceptClient(void) {
+    DWORD bytes;
+    HANDLE pipe = service.listenPipe;
+    bool connected = !service.connecting || GetOverlappedResult(pipe, &service.connectOverlapped, &bytes, FALSE);
+    ServiceClient* client = connected ? FreeClient() : NULL;
+    if (client == NULL) {
+        DisconnectNamedPipe(pipe);
+        CloseHandle(pipe);
+    }
+    else {
+        client->pipe = pipe;
+        OpenClient(client);
+        if (!StartRead(client)) {
+            CloseClient(client);
+        }
+    }
+    // 다음 클라이언트를 기다리는 인스턴스
+    if (!ListenPipe(false)) {
+        _ftprintf(stderr, TEXT("Failed to create pipe %s: %lu\n"), service.path, (unsigned long)GetLastError());
+    }
+}
+
+// 끝난 읽기/쓰기를 처리하고 보낼 것이 있으면 쓰기를 시작한다. 연결이 끊겼으면 false
+static bool ServeClient(ServiceClient* client) {
+    DWORD bytes;
+    if (client->reading && Signaled(client->readOverlapped.hEvent)) {
+        client->reading = false;
+        if (!GetOverlappedResult(client->pipe, &client->readOverlapped, &bytes, FALSE)) {
+            return false;
+        }
+        client->input.length += bytes;
+        if (!ProcessInput(client) || !StartRead(client)) {
+            return false;
+        }
+    }
+    if (client->writing && Signaled(client->writeOverlapped.hEvent)) {
+        client->writing = false;
+        if (!GetOverlappedResult(client->pipe, &client->writeOverlapped, &bytes, FALSE)) {
+            return false;
+        }
+        client->sendOffset += bytes;
+    }
+    if (!client->writing && TakePending(client)) {
+        AtomicAddRelaxed64(&service.stats.writes, 1);
+        if (!WriteFile(client->pipe, client->sending.data + client->sendOffset, client->sending.length - client->sendOffset, NULL,
+            &client->writeOverlapped) && GetLastError() != ERROR_IO_PENDING) {
+            return false;
+        }
+        client->writing = true;
+    }
+    return true;
+}
+
+static DWORD WINAPI ServiceThread(LPVOID param) {
+    (void)param;
+    HANDLE handles[2 + 2 * SERVICE_MAX_CLIENTS];
+    while (AtomicLoadAcquire32(&service.running)) {
+        DWORD count = 0;
+        handles[count++] = service.wake;
+        if (service.listenPipe != INVALID_HANDLE_VALUE) {
+            handles[count++] = service.connectOverlapped.hEvent;
+        }
+        for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+            ServiceClient* client = &service.clients[i];
+            if (client->reading) {
+                handles[count++] = client->readOverlapped.hEvent;
+            }
+            if (client->writing) {
+                handles[count++] = client->writeOverlapped.hEvent;
+            }
+        }
+        WaitForMultipleObjects(count, handles, FALSE, INFINITE);
+        AtomicStoreRelease32(&service.wakePending, 0);
+
+        // 어느 핸들이 깨웠는지와 관계없이 모두 확인 (그사이 쌓인 패킷도 함께 보냄)
+        if (service.listenPipe != INVALID_HANDLE_VALUE && Signaled(service.connectOverlapped.hEvent)) {
+            AcceptClient();
+        }
+        for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+            ServiceClient* client = &service.clients[i];
+            if (client->connected && !ServeClient(client)) {
+                CloseClient(client);
+            }
+        }
+    }
+    return 0;
+}
+
+static bool OpenListener(void) {
+    if (!PlatformEventInit(&service.wake)) {
+        return false;
+    }
+    service.connectOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        service.clients[i].pipe = INVALID_HANDLE_VALUE;
+        service.clients[i].readOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        service.clients[i].writeOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    }
+    if (!ListenPipe(true)) {
+        _ftprintf(stderr, TEXT("Failed to create pipe %s: %lu\n"), service.path, (unsigned long)GetLastError());
+        return false;
+    }
+    return true;
+}
+
+static void CloseListener(void) {
+    if (service.listenPipe != INVALID_HANDLE_VALUE) {
+        DWORD bytes;
+        CancelIoEx(service.listenPipe, NULL);
+        if (service.connecting) {
+            GetOverlappedResult(service.listenPipe, &service.connectOverlapped, &bytes, TRUE);
+        }
+        CloseHandle(service.listenPipe);
+        service.listenPipe = INVALID_HANDLE_VALUE;
+    }
+    CloseHandle(service.connectOverlapped.hEvent);
+    for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        CloseHandle(service.clients[i].readOverlapped.hEvent);
+        CloseHandle(service.clients[i].writeOverlapped.hEvent);
+    }
+    PlatformEventDestroy(&service.wake);
+}
+
+#else
+
+static void CloseClient(ServiceClient* client) {
+    close(client->fd);
+    client->fd = -1;
+    ReleaseClient(client);
+}
+
+static void AcceptClient(void) {
+    int fd = accept4(service.listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    ServiceClient* client = FreeClient();
+    if (client == NULL) {
+        close(fd);
+        return;
+    }
+    client->fd = fd;
+    OpenClient(client);
+}
+
+static bool ReadClient(ServiceClient* client) {
+    if (!BufferReserve(&client->input, SERVICE_READ_SIZE)) {
+        return false;
+    }
+    ssize_t received = recv(client->fd, client->input.data + client->input.length, SERVICE_READ_SIZE, 0);
+    if (received == 0) {
+        return false;
+    }
+    if (received < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    client->input.length += (DWORD)received;
+    return ProcessInput(client);
+}
+
+// 소켓이 받아 주는 만큼 보낸다. 다 못 보낸 나머지는 POLLOUT 을 기다림
+static bool WriteClient(ServiceClient* client) {
+    while (TakePending(client)) {
+        AtomicAddRelaxed64(&service.stats.writes, 1);
+        ssize_t sent = send(client->fd, client->sending.data + client->sendOffset, client->sending.length - client->sendOffset,
+            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        client->sendOffset += (DWORD)sent;
+    }
+    return true;
+}
+
+static DWORD WINAPI ServiceThread(LPVOID param) {
+    (void)param;
+    struct pollfd fds[2 + SERVICE_MAX_CLIENTS];
+    while (AtomicLoadAcquire32(&service.running)) {
+        int count = 0;
+        fds[count].fd = service.wakePipe[0];
+        fds[count++].events = POLLIN;
+        fds[count].fd = service.listenFd;
+        fds[count++].events = POLLIN;
+        for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+            ServiceClient* client = &service.clients[i];
+            fds[count].fd = client->connected ? client->fd : -1; // 음수는 poll 이 무시함
+            fds[count++].events = (short)(POLLIN | (client->sendOffset < client->sending.length ? POLLOUT : 0));
+        }
+        if (poll(fds, (nfds_t)count, -1) < 0 && errno != EINTR) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            BYTE drain[64];
+            while (read(service.wakePipe[0], drain, sizeof(drain)) > 0) {
+            }
+            AtomicStoreRelease32(&service.wakePending, 0);
+        }
+        // 요청을 처리한 뒤 그사이 쌓인 패킷(응답, 수신 메시지, 완료 통지)을 한 번에 보냄
+        for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+            ServiceClient* client = &service.clients[i];
+            if (!client->connected) {
+                continue;
+            }
+            bool ok = true;
+            if (fds[2 + i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ok = ReadClient(client);
+            }
+            if (ok) {
+                ok = WriteClient(client);
+            }
+            if (!ok) {
+                CloseClient(client);
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            AcceptClient();
+        }
+    }
+    return 0;
+}
+
+static bool OpenListener(void) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(service.path) >= sizeof(address.sun_path)) {
+        _ftprintf(stderr, TEXT("Socket path is too long: %s\n"), service.path);
+        return false;
+    }
+    strcpy(address.sun_path, service.path);
+    if (pipe(service.wakePipe) != 0) {
+        return false;
+    }
+    fcntl(service.wakePipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(service.wakePipe[1], F_SETFL, O_NONBLOCK);
+    for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        service.clients[i].fd = -1;
+    }
+    unlink(service.path); // 이전 실행이 남긴 소켓 파일
+    service.listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (service.listenFd < 0 || bind(service.listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(service.listenFd, SERVICE_MAX_CLIENTS) != 0) {
+        _ftprintf(stderr, TEXT("Failed to listen on %s: %s\n"), service.path, strerror(errno));
+        if (service.listenFd >= 0) {
+            close(service.listenFd);
+        }
+        close(service.wakePipe[0]);
+        close(service.wakePipe[1]);
+        return false;
+    }
+    return true;
+}
+
+static void CloseListener(void) {
+    close(service.listenFd);
+    unlink(service.path);
+    close(service.wakePipe[0]);
+    close(service.wakePipe[1]);
+}
+
+#endif
+
+bool ServiceStart(const TCHAR* path) {
+    memset(&service, 0, sizeof(service));
+    _tcsncpy(service.path, path, MAX_PATH - 1);
+    for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        PlatformMutexInit(&service.clients[i].lock);
+    }
+    if (!OpenListener()) {
+        return false;
+    }
+    AtomicStoreRelease32(&service.running, 1);
+    if (!PlatformThreadStart(&service.thread, ServiceThread, NULL)) {
+        AtomicStoreRelease32(&service.running, 0);
+        CloseListener();
+        return false;
+    }
+    AtomicStoreRelease32(&service.active, 1);
+    return true;
+}
+
+void ServiceStop(void) {
+    if (!AtomicLoadAcquire32(&service.running)) {
+        return;
+    }
+    AtomicStoreRelease32(&service.active, 0);
+    AtomicStoreRelease32(&service.running, 0);
+    WakeService(true);
+    PlatformThreadJoin(service.thread);
+    for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        if (service.clients[i].connected) {
+            CloseClient(&service.clients[i]);
+        }
+    }
+    CloseListener();
+    // 클라이언트 잠금은 남겨 둠 (수신/송신 스레드가 아직 ServicePublish 에 들어와 있을 수 있음)
+}
+
+bool ServiceActive(void) {
+    return AtomicLoadAcquire32(&service.active) != 0;
+}
+
+void ServicePublish(ModemConfig* modem, BYTE kind, const BYTE* data, DWORD length) {
+    if (!AtomicLoadAcquire32(&service.active)) {
+        return;
+    }
+    int index = ModemIndex(modem);
+    BYTE head[2] = { (BYTE)index, kind };
+    bool queued = false;
+    for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        ServiceClient* client = &service.clients[i];
+        if (!AtomicLoadAcquire32(&client->connected)) {
+            continue;
+        }
+        PlatformMutexLock(&client->lock);
+        if (client->connected && (client->subscriptions & (1u << index)) != 0) {
+            queued |= ClientAppend(client, SERVICE_RECEIVED, head, sizeof(head), data, length);
+        }
+        PlatformMutexUnlock(&client->lock);
+    }
+    if (queued) {
+        WakeService(false);
+    }
+}
+
+void ServiceNotifyDone(BYTE source, const ModemConfig* modem, uint32_t id, bool success) {
+    if (!AtomicLoadAcquire32(&service.active)) {
+        return;
+    }
+    BYTE body[7];
+    body[0] = source;
+    body[1] = modem != NULL ? (BYTE)ModemIndex(modem) : SERVICE_NO_MODEM;
+    PutU32(body + 2, id);
+    body[6] = success ? 1 : 0;
+    bool queued = false;
+    for (int i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        ServiceClient* client = &service.clients[i];
+        if (!AtomicLoadAcquire32(&client->connected)) {
+            continue;
+        }
+        PlatformMutexLock(&client->lock);
+        if (client->connected) {
+            queued |= ClientAppend(client, SERVICE_DONE, body, sizeof(body), NULL, 0);
+        }
+        PlatformMutexUnlock(&client->lock);
+    }
+    if (queued) {
+        WakeService(false);
+    }
+}
+
+void ServiceQueryStats(ServiceStats* stats) {
+    stats->clients = AtomicLoadAcquire32(&service.stats.clients);
+    stats->accepted = AtomicLoadAcquire32(&service.stats.accepted);
+    stats->requests = AtomicLoadAcquire64(&service.stats.requests);
+    stats->packetsOut = AtomicLoadAcquire64(&service.stats.packetsOut);
+    stats->writes = AtomicLoadAcquire64(&service.stats.writes);
+    stats->droppedPackets = AtomicLoadAcquire64(&service.stats.droppedPackets);
+}
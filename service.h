@@ -0,0 +1,82 @@
+﻿#pragma once
+#include "platform.h"
+#include "modem.h"
+#include "arq.h"
+
+// 헤드리스 서비스 모드와 로컬 IPC
+// UHSDM --daemon [경로] 로 실행하면 메뉴 없이 모뎀을 열고, 같은 컴퓨터의 여러 클라이언트가
+// 로컬 소켓(리눅스는 유닉스 도메인 소켓, Windows 는 이름 있는 파이프)으로 모뎀을 함께 쓴다.
+// 요청 처리와 소켓 입출력은 서비스 스레드 하나가 한다. 수신/완료 통지를 만드는 스레드(수신 처리,
+// 송신, ARQ, 스케줄러)는 클라이언트별 출력 버퍼에 패킷을 덧붙이고 서비스 스레드를 깨우기만 하므로,
+// 그 사이에 쌓인 패킷은 한 번의 쓰기로 나간다. 클라이언트도 여러 요청을 한 번에 써도 된다.
+// 읽지 않는 클라이언트의 출력이 SERVICE_OUTPUT_LIMIT 을 넘으면 새 패킷을 버리고 센다 (모뎀 쪽은 기다리지 않음).
+//
+// 패킷 (모두 리틀 엔디언): 길이(4, 뒤따르는 바이트 수) | 종류(1) | 내용
+//   클라이언트 -> 서비스
+//     SEND       태그(4) | 경로(1, 모뎀 번호 / SERVICE_ROUTE_AUTO / SERVICE_ROUTE_ALL) | ARQ_KIND_*(1) | 데이터
+//     SUBSCRIBE  모뎀 마스크(4, 비트 i = 모뎀 i). 이 모뎀들이 받은 메시지를 RECEIVED 로 받음 (처음에는 0)
+//     LIST       모뎀 목록을 MODEMS 로 받음
+//   서비스 -> 클라이언트
+//     ACCEPTED   태그(4) | 상태(1) | 출처(1) | 모뎀 번호(1) | id(4)   SEND 마다 하나, 요청 순서대로
+//     RECEIVED   모뎀 번호(1) | ARQ_KIND_*(1) | 데이터                 (파일은 이름 길이(1) | 이름 | 내용)
+//     DONE       출처(1) | 모뎀 번호(1) | id(4) | 성공(1)              모든 클라이언트에 보냄 (ACCEPTED 의 id 와 맞춰 봄.
+//                                                                  보낸 클라이언트에는 늘 그 ACCEPTED 뒤에 옴)
+//     MODEMS     모뎀 수(1) | 모뎀마다 열림(1) framing(1) 이름(32, UTF-8)
+
+#ifdef _WIN32
+#define SERVICE_DEFAULT_PATH TEXT("\\\\.\\pipe\\UHSDM")
+#else
+#define SERVICE_DEFAULT_PATH "/tmp/uhsdm.sock"
+#endif
+
+#define SERVICE_MAX_CLIENTS 16
+#define SERVICE_READ_SIZE 65536
+#define SERVICE_MAX_PACKET (ARQ_MAX_TRANSFER + 16)
+#define SERVICE_OUTPUT_LIMIT (4 * 1024 * 1024)
+#define SERVICE_NAME_SIZE 32
+
+// 패킷 종류
+#define SERVICE_SEND 0x01
+#define SERVICE_SUBSCRIBE 0x02
+#define SERVICE_LIST 0x03
+#define SERVICE_ACCEPTED 0x81
+#define SERVICE_RECEIVED 0x82
+#define SERVICE_DONE 0x83
+#define SERVICE_MODEMS 0x84
+
+// SEND 의 경로 (그 밖의 값은 모뎀 번호)
+#define SERVICE_ROUTE_AUTO 0xFE // 스케줄러 (한 프레임보다 크면 링크 묶음)
+#define SERVICE_ROUTE_ALL 0xFF  // 살아 있는 모든 링크 (한 프레임에 들어가는 메시지만)
+#define SERVICE_NO_MODEM 0xFF   // ACCEPTED/DONE 에서 특정 모뎀이 없는 경우 (링크 묶음)
+
+// ACCEPTED 의 상태
+#define SERVICE_STATUS_OK 0
+#define SERVICE_STATUS_INVALID 1       // 없는 모뎀, 맞지 않는 경로/종류
+#define SERVICE_STATUS_DISCONNECTED 2  // 모뎀 포트가 닫혀 있음
+#define SERVICE_STATUS_REJECTED 3      // 큐가 가득 찼거나 너무 큼
+
+// ACCEPTED/DONE 의 출처 (id 는 출처마다 따로 매겨짐)
+#define SERVICE_SOURCE_MODEM 0     // 모뎀 송신 큐 (OnTransmitDone)
+#define SERVICE_SOURCE_ARQ 1       // 모뎀 하나로의 ARQ 전송 (OnArqDone)
+#define SERVICE_SOURCE_AUTO 2      // 스케줄러 (OnSchedulerDone)
+#define SERVICE_SOURCE_BOND 3      // 링크 묶음 전송 (OnBondDone)
+
+typedef struct {
+    int32_t clients;         // 지금 연결된 클라이언트
+    int32_t accepted;        // 지금까지 연결된 클라이언트
+    int64_t requests;
+    int64_t packetsOut;
+    int64_t writes;          // 클라이언트로의 쓰기 호출 (packetsOut / writes = 쓰기당 패킷)
+    int64_t droppedPackets;  // 출력 버퍼가 넘쳐 버린 패킷
+} ServiceStats;
+
+// 모든 모듈을 시작한 뒤 호출
+bool ServiceStart(const TCHAR* path);
+// 다른 모듈을 멈추기 전에 호출 (이후로는 요청을 받지 않음)
+void ServiceStop(void);
+bool ServiceActive(void);
+// 수신 처리 스레드: 구독한 클라이언트에게 받은 메시지를 보냄
+void ServicePublish(ModemConfig* modem, BYTE kind, const BYTE* data, DWORD length);
+// 완료 콜백에서: 모든 클라이언트에게 DONE 을 보냄. modem 이 NULL 이면 SERVICE_NO_MODEM
+void ServiceNotifyDone(BYTE source, const ModemConfig* modem, uint32_t id, bool success);
+void ServiceQueryStats(ServiceStats* stats);
@@ -0,0 +1,421 @@
+﻿#include "platform.h"
+#include "transmitter.h"
+#include "modem.h"
+#include "capture.h"
+#include "pool.h"
+#include "scheduler.h"
+
+static struct {
+    TransmitDoneProc done;
+    volatile int32_t nextId;
+} transmitter;
+
+// 다음 조각을 담을 등급. 없으면 -1 (lock 을 잡은 상태)
+// bulkFull 이면 이번 배치에는 BULK 조각을 더 담지 않음
+static int PickClass(ModemConfig* modem, bool bulkFull) {
+    TxQueue* queue = &modem->txQueue;
+    // FRAMING_RAW 는 보내다 만 메시지를 먼저 끝냄 (바이트가 섞이지 않도록)
+    if (modem->framing != FRAMING_COBS) {
+        for (int c = 0; c < TX_CLASSES; c++) {
+            if (queue->head[c] != NULL && queue->head[c]->offset > 0) {
+                return c;
+            }
+        }
+    }
+    bool weighted = modem->txWeights[0] > 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int c = 0; c < TX_CLASSES; c++) {
+            if (queue->head[c] == NULL || (c == TX_CLASS_BULK && bulkFull)) {
+                continue;
+            }
+            if (!weighted || queue->credit[c] > 0) {
+                return c;
+            }
+        }
+        if (!weighted) {
+            break;
+        }
+        // 보낼 것이 있는 등급이 모두 몫을 썼으면 새 라운드
+        for (int c = 0; c < TX_CLASSES; c++) {
+            queue->credit[c] = modem->txWeights[c];
+        }
+    }
+    return -1;
+}
+
+// BULK 를 나눠 보낼 기준 회선 속도 (bps). 0 이면 나누지 않음
+// 스케줄러가 잰 속도가 있으면 그것에 TX_PACE_HEADROOM 만큼 여유를 둔다 (잰 값은 보낸 양을 넘지 못하므로
+// 여유가 없으면 회선이 더 빨라도 처음 속도에 묶임). 아직 없으면 BaudRate 와 다르게 지정한 LinkRate.
+// 둘 다 없으면 회선이 BaudRate 로 돌고 드라이버 버퍼만큼만 앞서 나가므로 따로 나누지 않는다.
+static int PaceRate(const ModemConfig* modem) {
+    int measured = SchedulerMeasuredRate(modem);
+    if (measured > 0) {
+        return (int)((int64_t)measured * TX_PACE_HEADROOM / 100);
+    }
+    return modem->linkRateSet && modem->linkRate != modem->baudRate ? modem->linkRate : 0;
+}
+
+// 메시지의 [offset, offset + size) 를 머리와 본문에 걸친 최대 두 조각으로
+static int MessageSegments(const TxMessage* message, DWORD offset, DWORD size, FrameSegment* segments) {
+    int count = 0;
+    if (offset < message->headLength) {
+        DWORD take = message->headLength - offset < size ? message->headLength - offset : size;
+        segments[count].data = message->head + offset;
+        segments[count++].size = take;
+        offset += take;
+        size -= take;
+    }
+    if (size > 0) {
+        segments[count].data = message->body + (offset - message->headLength);
+        segments[count++].size = size;
+    }
+    return count;
+}
+
+// 바로 앞 조각과 이어진 메모리면 합침 (인코딩한 프레임은 배치 버퍼에 이어서 쌓임)
+static void AddSegment(SerialSegment* segments, int* count, const BYTE* data, DWORD size) {
+    if (*count > 0 && segments[*count - 1].data + segments[*count - 1].size == data) {
+        segments[*count - 1].size += size;
+        return;
+    }
+    segments[*count].data = data;
+    segments[(*count)++].size = size;
+}
+
+static void FreeMessage(TxMessage* message) {
+    PoolRelease(message->block);
+    PoolRelease((BYTE*)message);
+}
+
+// 큐 앞에서부터 배치 하나를 채운다. 다 담긴 메시지는 큐에서 떼어 done 목록으로 옮긴다
+// 프레임은 batch 에 인코딩하고, FRAMING_RAW 는 TX_COPY_BREAK 이상인 부분을 복사하지 않고 조각으로만 가리킨다
+// (done 목록의 메시지는 쓰기가 끝난 뒤에 놓으므로 그때까지 유효하다). 그보다 짧은 부분은 batch 에 이어 붙이는 편이
+// 조각 하나를 더 넘기는 것보다 싸다
+// 회선이 밀려 BULK 를 담지 못했으면 *holdMs 에 다시 볼 때까지의 시간을 넣는다
+static DWORD FillBatch(ModemConfig* modem, BYTE* batch, SerialSegment* segments, int* segmentCount, TxMessage** done, DWORD* holdMs) {
+    TxQueue* queue = &modem->txQueue;
+    TxMessage** doneTail = done;
+    DWORD length = 0;
+    DWORD used = 0; // batch 에 쓴 바이트
+    int rate = PaceRate(modem);
+    DWORD bulkBudget = rate > 0 ? (DWORD)((int64_t)rate / 10 * TX_BULK_BATCH_MS / 1000) : TX_BATCH_SIZE;
+    DWORD bulkBytes = 0;
+    uint64_t nowNs = PlatformNowNs();
+    uint64_t backlogNs = queue->lineBusyNs > nowNs ? queue->lineBusyNs - nowNs : 0;
+    bool lineFull = backlogNs > TX_BULK_BATCH_MS * 1000000ULL;
+    *holdMs = 0;
+    *segmentCount = 0;
+
+    PlatformMutexLock(&queue->lock);
+    int c;
+    while (length < TX_BATCH_SIZE && (c = PickClass(modem, lineFull || (bulkBytes > 0 && bulkBytes >= bulkBudget))) >= 0) {
+        TxMessage* message = queue->head[c];
+        DWORD remaining = message->length - message->offset;
+        DWORD chunk;
+        FrameSegment parts[3];
+        if (modem->framing == FRAMING_COBS) {
+            DWORD limit = FRAME_MAX_PAYLOAD;
+            if (c == TX_CLASS_BULK && message->length > FRAME_MAX_PAYLOAD && bulkBudget < limit) {
+                limit = bulkBudget > TX_MIN_FRAGMENT ? bulkBudget : TX_MIN_FRAGMENT;
+            }
+            chunk = remaining < limit ? remaining : limit;
+            // 보낸 시각은 한 프레임에 함께 들어갈 때만 붙임 (조각 크기는 그대로)
+            bool stamp = chunk + FRAME_TIMESTAMP_SIZE <= FRAME_MAX_PAYLOAD && ClockSyncStamps(modem, message->type);
+            if (FRAME_ENCODED_SIZE(chunk + (stamp ? FRAME_TIMESTAMP_SIZE : 0)) > TX_BATCH_SIZE - length) {
+                break; // 다음 배치로
+            }
+            BYTE timestamp[FRAME_TIMESTAMP_SIZE];
+            int partCount = 0;
+            if (stamp) {
+                for (int i = 0; i < FRAME_TIMESTAMP_SIZE; i++) {
+                    timestamp[i] = (BYTE)(nowNs >> (8 * i));
+                }
+                parts[partCount].data = timestamp;
+                parts[partCount++].size = FRAME_TIMESTAMP_SIZE;
+            }
+            partCount += MessageSegments(message, message->offset, chunk, parts + partCount);
+            DWORD encoded = FrameEncodeGather(message->type, stamp ? FRAME_FLAG_TIMESTAMP : 0, parts, partCount, batch + used,
+                TX_BATCH_SIZE - used);
+            AddSegment(segments, segmentCount, batch + used, encoded);
+            used += encoded;
+            length += encoded;
+        }
+        else {
+            if (*segmentCount + 2 > TX_BATCH_SEGMENTS) {
+                break;
+            }
+            chunk = remaining < TX_BATCH_SIZE - length ? remaining : TX_BATCH_SIZE - length;
+            int partCount = MessageSegments(message, message->offset, chunk, parts);
+            for (int i = 0; i < partCount; i++) {
+                if (parts[i].size >= TX_COPY_BREAK) {
+                    AddSegment(segments, segmentCount, parts[i].data, parts[i].size);
+                    continue;
+                }
+                memcpy(batch + used, parts[i].data, parts[i].size);
+                AddSegment(segments, segmentCount, batch + used, parts[i].size);
+                used += parts[i].size;
+            }
+            length += chunk;
+        }
+        message->offset += chunk;
+        queue->queuedBytes -= (int32_t)chunk;
+        queue->classBytes[c] -= (int32_t)chunk;
+        if (modem->txWeights[0] > 0) {
+            queue->credit[c]--;
+        }
+        if (c == TX_CLASS_BULK) {
+            bulkBytes += chunk;
+        }
+        for (int lower = c + 1; lower < TX_CLASSES; lower++) {
+            if (queue->head[lower] != NULL && queue->head[lower]->offset > 0) {
+                queue->preemptions++;
+                break;
+            }
+        }
+
+        if (message->offset == message->length) {
+            queue->head[c] = message->next;
+            if (queue->head[c] == NULL) {
+                queue->tail[c] = NULL;
+            }
+            message->next = NULL;
+            *doneTail = message;
+            doneTail = &message->next;
+        }
+    }
+    if (lineFull && queue->head[TX_CLASS_BULK] != NULL) {
+        *holdMs = (DWORD)((backlogNs - TX_BULK_BATCH_MS * 1000000ULL) / 1000000ULL) + 1;
+    }
+    PlatformMutexUnlock(&queue->lock);
+    return length;
+}
+
+// 보낼 것이 있었으면 true
+static bool SendBatch(ModemConfig* modem, BYTE* batch, DWORD* holdMs) {
+    TxQueue* queue = &modem->txQueue;
+    PlatformMutexLock(&queue->portLock);
+    TxMessage* done = NULL;
+    SerialSegment segments[TX_BATCH_SEGMENTS];
+    int segmentCount = 0;
+    DWORD length = FillBatch(modem, batch, segments, &segmentCount, &done, holdMs);
+    bool processed = length > 0 || done != NULL;
+    bool success = true;
+    if (length > 0) {
+        DWORD bytesWritten = 0;
+        AtomicStoreRelease32(&queue->writingBytes, (int32_t)length);
+        success = modem->hSerial != INVALID_HANDLE_VALUE && SerialWriteGather(modem, segments, segmentCount, &bytesWritten);
+        AtomicIncrement32(&queue->writes);
+        queue->bytesWritten += bytesWritten;
+        DWORD captured = 0;
+        for (int i = 0; i < segmentCount && captured < bytesWritten; i++) {
+            DWORD size = segments[i].size < bytesWritten - captured ? segments[i].size : bytesWritten - captured;
+            CaptureRecord(modem, CAPTURE_TX, segments[i].data, size);
+            captured += size;
+        }
+        AtomicStoreRelease32(&queue->writingBytes, 0);
+        // SerialWrite 는 드라이버 버퍼에 넣으면 돌아오므로 회선 속도로 나갈 시각을 따로 셈
+        uint64_t nowNs = PlatformNowNs();
+        int rate = PaceRate(modem);
+        queue->lineBusyNs = (queue->lineBusyNs > nowNs ? queue->lineBusyNs : nowNs) +
+            (rate > 0 ? (uint64_t)bytesWritten * 10 * 1000000000ULL / (uint64_t)rate : 0);
+    }
+    if (!success) {
+        // 일부가 담긴 채 큐에 남은 메시지도 실패로 보고
+        PlatformMutexLock(&queue->lock);
+        for (int c = 0; c < TX_CLASSES; c++) {
+            if (queue->head[c] != NULL && queue->head[c]->offset > 0) {
+                queue->head[c]->failed = true;
+            }
+        }
+        PlatformMutexUnlock(&queue->lock);
+    }
+    PlatformMutexUnlock(&queue->portLock);
+
+    while (done != NULL) {
+        TxMessage* next = done->next;
+        bool sent = success && !done->failed;
+        AtomicIncrement32(sent ? &queue->messagesSent : &queue->messagesFailed);
+        if (sent) {
+            uint64_t elapsedNs = PlatformNowNs() - done->queuedNs;
+            HistogramRecord(&modem->metrics.sendLatency, elapsedNs);
+            HistogramRecord(&queue->classLatency[done->priority], elapsedNs);
+        }
+        TransmitDoneProc notify = done->done != NULL ? done->done : transmitter.done;
+        if (notify != NULL) {
+            notify(modem, done->id, sent);
+        }
+        FreeMessage(done);
+        done = next;
+    }
+    return processed;
+}
+
+static DWORD WINAPI TransmitThread(LPVOID param) {
+    ModemConfig* modem = (ModemConfig*)param;
+    TxQueue* queue = &modem->txQueue;
+    static BYTE batches[MAX_MODEMS][TX_BATCH_SIZE]; // 모뎀마다 하나씩 (스레드 스택 절약)
+    BYTE* batch = batches[ModemIndex(modem)];
+    DWORD holdMs = 0;
+    while (AtomicLoadAcquire32(&queue->running)) {
+        while (SendBatch(modem, batch, &holdMs)) {
+        }
+        PlatformEventWait(&queue->ready, holdMs > 0 ? holdMs : INFINITE);
+    }
+    while (SendBatch(modem, batch, &holdMs) || holdMs > 0) {
+        if (holdMs > 0) {
+            PlatformSleepMs(holdMs);
+        }
+    }
+    return 0;
+}
+
+bool TransmitterStart(TransmitDoneProc done) {
+    transmitter.done = done;
+    for (int i = 0; i < modemRegistry.count; i++) {
+        ModemConfig* modem = &modemRegistry.modems[i];
+        TxQueue* queue = &modem->txQueue;
+        memset(queue, 0, sizeof(*queue));
+        PlatformMutexInit(&queue->lock);
+        PlatformMutexInit(&queue->portLock);
+        if (!PlatformEventInit(&queue->ready)) {
+            return false;
+        }
+        AtomicStoreRelease32(&queue->running, 1);
+        if (!PlatformThreadStart(&queue->thread, TransmitThread, modem)) {
+            AtomicStoreRelease32(&queue->running, 0);
+            return false;
+        }
+    }
+    return true;
+}
+
+void TransmitterStop(void) {
+    for (int i = 0; i < modemRegistry.count; i++) {
+        TxQueue* queue = &modemRegistry.modems[i].txQueue;
+        if (!AtomicLoadAcquire32(&queue->running)) {
+            continue;
+        }
+        AtomicStoreRelease32(&queue->running, 0);
+        PlatformEventSet(&queue->ready);
+        PlatformThreadJoin(queue->thread);
+        PlatformEventDestroy(&queue->ready);
+        PlatformMutexDestroy(&queue->portLock);
+        PlatformMutexDestroy(&queue->lock);
+    }
+}
+
+uint32_t TransmitEnqueue(ModemConfig* modem, BYTE type, const BYTE* data, DWORD length) {
+    return TransmitEnqueueNotify(modem, type, data, length, NULL);
+}
+
+BYTE TransmitClassOf(BYTE type, DWORD length) {
+    switch (type) {
+    case FRAME_TYPE_ARQ_ACK:
+    case FRAME_TYPE_HELLO:
+    case FRAME_TYPE_LINK_PROBE:
+    case FRAME_TYPE_LINK_PROBE_ACK:
+    case FRAME_TYPE_LINK_ACK:
+    case FRAME_TYPE_CLOCK_SYNC:
+    case FRAME_TYPE_CLOCK_REPLY:
+        return TX_CLASS_CONTROL;
+    case FRAME_TYPE_ARQ_DATA:
+    case FRAME_TYPE_ARQ_PARITY:
+        return TX_CLASS_BULK;
+    default:
+        return length > FRAME_MAX_PAYLOAD ? TX_CLASS_BULK : TX_CLASS_NORMAL;
+    }
+}
+
+uint32_t TransmitEnqueueNotify(ModemConfig* modem, BYTE type, const BYTE* data, DWORD length, TransmitDoneProc done) {
+    return TransmitEnqueueClass(modem, TransmitClassOf(type, length), type, data, length, done);
+}
+
+// 채운 메시지에 id 를 붙여 등급 큐 끝에 넣는다. 큐가 가득 차면 메시지를 놓고 0
+static uint32_t QueueMessage(ModemConfig* modem, TxMessage* message) {
+    TxQueue* queue = &modem->txQueue;
+    message->next = NULL;
+    message->failed = false;
+    message->offset = 0;
+    message->queuedNs = PlatformNowNs();
+
+    PlatformMutexLock(&queue->lock);
+    if (queue->queuedBytes + (int32_t)message->length > TX_QUEUE_LIMIT) {
+        PlatformMutexUnlock(&queue->lock);
+        FreeMessage(message);
+        return 0;
+    }
+    // id 0 은 실패를 뜻하므로 건너뜀
+    do {
+        message->id = (uint32_t)AtomicIncrement32(&transmitter.nextId);
+    } while (message->id == 0);
+    if (queue->tail[message->priority] != NULL) {
+        queue->tail[message->priority]->next = message;
+    }
+    else {
+        queue->head[message->priority] = message;
+    }
+    queue->tail[message->priority] = message;
+    queue->queuedBytes += (int32_t)message->length;
+    queue->classBytes[message->priority] += (int32_t)message->length;
+    uint32_t id = message->id;
+    PlatformMutexUnlock(&queue->lock);
+
+    PlatformEventSet(&queue->ready);
+    return id;
+}
+
+uint32_t TransmitEnqueueClass(ModemConfig* modem, BYTE priority, BYTE type, const BYTE* data, DWORD length, TransmitDoneProc done) {
+    if (!AtomicLoadAcquire32(&modem->txQueue.running) || length > TX_QUEUE_LIMIT) {
+        return 0;
+    }
+    TxMessage* message = (TxMessage*)PoolAlloc(sizeof(TxMessage) + length);
+    if (message == NULL) {
+        return 0;
+    }
+    message->type = type;
+    message->priority = priority < TX_CLASSES ? priority : TX_CLASS_NORMAL;
+    message->done = done;
+    message->headLength = 0;
+    message->length = length;
+    message->block = NULL;
+    message->body = message->data;
+    if (length > 0) {
+        memcpy(message->data, data, length);
+    }
+    return QueueMessage(modem, message);
+}
+
+uint32_t TransmitEnqueueGather(ModemConfig* modem, BYTE priority, BYTE type, const BYTE* head, DWORD headLength,
+    BYTE* block, const BYTE* body, DWORD bodyLength, TransmitDoneProc done) {
+    if (!AtomicLoadAcquire32(&modem->txQueue.running) || headLength > TX_HEAD_SIZE || headLength + bodyLength > TX_QUEUE_LIMIT) {
+        return 0;
+    }
+    TxMessage* message = (TxMessage*)PoolAlloc(sizeof(TxMessage));
+    if (message == NULL) {
+        return 0;
+    }
+    message->type = type;
+    message->priority = priority < TX_CLASSES ? priority : TX_CLASS_NORMAL;
+    message->done = done;
+    message->headLength = (BYTE)headLength;
+    if (headLength > 0) {
+        memcpy(message->head, head, headLength);
+    }
+    message->length = headLength + bodyLength;
+    PoolRetain(block);
+    message->block = block;
+    message->body = body;
+    return QueueMessage(modem, message);
+}
+
+void TransmitterLockPort(ModemConfig* modem) {
+    if (AtomicLoadAcquire32(&modem->txQueue.running)) {
+        PlatformMutexLock(&modem->txQueue.portLock);
+    }
+}
+
+void TransmitterUnlockPort(ModemConfig* modem) {
+    if (AtomicLoadAcquire32(&modem->txQueue.running)) {
+        PlatformMutexUnlock(&modem->txQueue.portLock);
+    }
+}
@@ -0,0 +1,106 @@
+﻿#pragma once
+#include "platform.h"
+#include "metrics.h"
+
+// 송신 처리 스레드
+// UI 등 생산자는 TransmitEnqueue 로 메시지를 모뎀별 송신 큐에 넣고 바로 돌아간다.
+// 모뎀마다 있는 송신 스레드가 쌓인 메시지를 최대 TX_BATCH_SIZE 만큼 묶어서 한 번에 쓰고,
+// 메시지마다 완료 콜백을 호출한다. 한 모뎀이 막혀도 다른 모뎀의 송신은 계속된다.
+// 큐는 우선순위 등급마다 따로 있고, 송신 스레드는 배치를 조각(프레임) 하나 담을 때마다 등급을 다시 고른다.
+// 그래서 큰 메시지를 보내는 중에도 더 높은 등급의 메시지가 다음 조각 경계에서 끼어든다
+// (FRAMING_RAW 모뎀은 바이트가 섞이면 안 되므로 메시지 경계에서만).
+// TxWeights 가 0 이면 엄격한 우선순위, "C,N,B" 면 라운드마다 등급별로 그 수만큼 조각을 보낸다 (가중 라운드 로빈).
+// 이미 드라이버에 넘긴 바이트는 되돌릴 수 없으므로, BULK 조각은 한 배치에 회선이 TX_BULK_BATCH_MS 동안
+// 보낼 만큼(최소 한 조각)만 담고, 앞서 쓴 바이트가 회선에서 다 나가기까지 TX_BULK_BATCH_MS 넘게
+// 남았으면 BULK 는 잠시 멈춘다. 그래서 끼어든 메시지 앞에 놓이는 바이트는 회선 시간으로 약 2 * TX_BULK_BATCH_MS 이다. 여러 프레임으로 나눠 가는 큰 메시지는 조각도 그 크기
+// (최소 TX_MIN_FRAGMENT) 로 잘라, 느린 링크에서도 끼어드는 메시지가 FRAME_MAX_PAYLOAD 한 조각을 기다리지 않게 한다.
+// 회선 속도는 스케줄러가 확인 응답으로 잰 값을, 아직 없으면 BaudRate 와 다르게 지정한 LinkRate 를 쓴다.
+// 둘 다 없으면 회선은 BaudRate 로 드라이버 버퍼만큼만 앞서 나가므로 BULK 를 나누지 않는다.
+// 메시지는 버퍼 풀(pool.h)의 블록에 담긴다. TransmitEnqueueGather 로 넣으면 조각 머리만 메시지에 복사하고
+// 본문은 호출한 쪽의 풀 블록을 참조로 붙잡아, 프레임 인코딩(FrameEncodeGather) 이나 FRAMING_RAW 의
+// 모아 쓰기(SerialWriteGather) 가 그 자리에서 바로 읽는다.
+
+#define TX_BATCH_SIZE 8192             // 한 번의 SerialWrite 크기 (FRAME_MAX_ENCODED 이상)
+#define TX_QUEUE_LIMIT (1024 * 1024)   // 모뎀별 대기 바이트 상한
+#define TX_BULK_BATCH_MS 100
+#define TX_PACE_HEADROOM 125           // 잰 속도로 BULK 를 나눌 때 더하는 여유 (%)
+#define TX_MIN_FRAGMENT 64
+#define TX_BATCH_SEGMENTS 64           // FRAMING_RAW 배치 하나에 모아 쓰는 조각 수 상한
+#define TX_HEAD_SIZE 16                // TransmitEnqueueGather 의 머리 최대 크기
+#define TX_COPY_BREAK 256              // FRAMING_RAW 에서 이보다 짧은 부분은 배치에 복사해 모음
+
+// 우선순위 등급 (작을수록 먼저)
+#define TX_CLASS_CONTROL 0 // 확인 응답, 링크 확인, 압축 협상, 모든 링크로 보내는 긴급 메시지
+#define TX_CLASS_NORMAL 1  // 사용자 메시지
+#define TX_CLASS_BULK 2    // ARQ/링크 묶음 조각, 한 프레임보다 큰 메시지
+#define TX_CLASSES 3
+#define TX_MAX_WEIGHT 64
+
+struct ModemConfig;
+
+// 메시지 전송이 끝났을 때 송신 스레드에서 호출된다
+typedef void (*TransmitDoneProc)(struct ModemConfig* modem, uint32_t messageId, bool success);
+
+typedef struct TxMessage {
+    struct TxMessage* next;
+    uint32_t id;
+    BYTE type;      // 프레임 종류 (FRAMING_RAW 모뎀에서는 무시)
+    BYTE priority;  // TX_CLASS_*
+    bool failed;    // 일부를 보낸 뒤 쓰기에 실패함
+    TransmitDoneProc done; // NULL 이면 TransmitterStart 에 넘긴 콜백
+    BYTE headLength;
+    DWORD length;   // headLength + 본문 길이
+    DWORD offset;   // 이미 배치에 담은 바이트 수 (큰 메시지는 여러 배치에 나눠 보냄)
+    uint64_t queuedNs; // 큐에 넣은 시각 (송신 지연 히스토그램용)
+    BYTE* block;    // 본문을 담은 풀 블록 (참조 하나를 잡고 있음). 본문이 data 면 NULL
+    const BYTE* body;
+    BYTE head[TX_HEAD_SIZE]; // 본문 앞에 붙여 보내는 머리
+    BYTE data[1];   // 복사해서 넣은 본문
+} TxMessage;
+
+typedef struct {
+    PlatformMutex lock;     // 큐 (생산자 <-> 송신 스레드)
+    PlatformMutex portLock; // 송신 스레드가 쓰는 동안 포트를 닫거나 교체하지 못하게 함
+    TxMessage* head[TX_CLASSES];
+    TxMessage* tail[TX_CLASSES];
+    int credit[TX_CLASSES];         // 가중 라운드 로빈에서 이번 라운드에 남은 조각 수 (lock)
+    uint64_t lineBusyNs;            // 드라이버에 넘긴 바이트가 회선에서 모두 나갈 예상 시각 (송신 스레드만)
+    PlatformThread thread;
+    PlatformEvent ready;
+    volatile int32_t running;
+
+    // 통계
+    volatile int32_t queuedBytes;
+    volatile int32_t classBytes[TX_CLASSES]; // queuedBytes 의 등급별 내역
+    volatile int32_t writingBytes;  // 지금 쓰고 있는 배치 (큐에서는 이미 빠짐)
+    volatile int32_t messagesSent;
+    volatile int32_t messagesFailed;
+    volatile int32_t writes;        // SerialWrite 호출 수 (묶음 효과 확인용)
+    volatile int64_t bytesWritten;
+    volatile int32_t preemptions;   // 보내다 만 낮은 등급 메시지보다 먼저 담은 조각 수
+    LatencyHistogram classLatency[TX_CLASSES]; // 등급별 송신 지연 (큐에 넣은 때부터 쓰기 완료까지)
+} TxQueue;
+
+// 모뎀 목록의 모든 모뎀에 송신 큐와 스레드를 만든다
+bool TransmitterStart(TransmitDoneProc done);
+// 큐에 남은 메시지를 모두 보낸 뒤 종료
+void TransmitterStop(void);
+
+// 메시지를 복사해서 큐에 넣고 메시지 id 를 반환한다. 큐가 가득 찼거나 송신 스레드가 없으면 0
+// 프레임 모드에서 FRAME_MAX_PAYLOAD 보다 긴 메시지는 여러 프레임으로 나뉘어 전송된다.
+// 등급은 프레임 종류로 정한다 (TransmitClassOf)
+uint32_t TransmitEnqueue(struct ModemConfig* modem, BYTE type, const BYTE* data, DWORD length);
+// 완료를 done 으로 따로 통지받는다 (ARQ 등 내부 계층용)
+uint32_t TransmitEnqueueNotify(struct ModemConfig* modem, BYTE type, const BYTE* data, DWORD length, TransmitDoneProc done);
+// 등급을 직접 정해서 넣는다
+uint32_t TransmitEnqueueClass(struct ModemConfig* modem, BYTE priority, BYTE type, const BYTE* data, DWORD length, TransmitDoneProc done);
+// 복사하지 않고 넣는다: 메시지는 head(headLength <= TX_HEAD_SIZE) 뒤에 body 를 이은 것이고,
+// body 는 풀 블록 block 안에 있어야 한다. 송신 스레드가 다 쓸 때까지 block 의 참조를 하나 더 잡는다
+uint32_t TransmitEnqueueGather(struct ModemConfig* modem, BYTE priority, BYTE type, const BYTE* head, DWORD headLength,
+    BYTE* block, const BYTE* body, DWORD bodyLength, TransmitDoneProc done);
+// 프레임 종류와 길이로 정한 기본 등급
+BYTE TransmitClassOf(BYTE type, DWORD length);
+
+// 포트를 닫거나 교체하는 동안 송신 스레드가 포트를 쓰지 않도록 잠근다
+void TransmitterLockPort(struct ModemConfig* modem);
+void TransmitterUnlockPort(struct ModemConfig* modem);